@@ -12,14 +12,25 @@
 #include <linux/init.h>
 #include <linux/module.h>
 #include <linux/kernel.h>
+#include <linux/printk.h>
 #include <linux/pid.h>
+#include <linux/ktime.h>
+#include <linux/percpu.h>
+#include <linux/workqueue.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
 
 #include <net/sock.h>
+#include <net/net_namespace.h>
+#include <net/netns/generic.h>
 #include <linux/netlink.h>
 #include <linux/skbuff.h>
 
 #include <asm-generic/errno.h>
 
+// Module Includes
+#include "com_chan_proto.h"
+
 
 //*************************************
 // Module Specifications
@@ -33,80 +44,64 @@ MODULE_VERSION("0.1");
 //*************************************
 // Module Macro Definitions
 //*************************************
-#define COM_NETLINK_LKM 31
-
-#define COM_NETLINK_KERNEL_SIG  0x00
-#define COM_NETLINK_RW_SIG      0xA5A5A5A5
-#define COM_NETLINK_DW_SIG      0x10101010
-#define COM_NETLINK_MW_SIG      0x11001100
-
-#define COM_NETLINK_MAX_PAYLOAD sizeof(ComChan_Message_t)
-
-
-#define POPULATE_COM_CHAN_QUERY(MSG, R_ID)              \
+#define POPULATE_COM_CHAN_QUERY(MSG, R_ID, SEQ_ID)      \
 {                                                       \
     memset(&(MSG), 0x00, sizeof(ComChan_Message_t));    \
     (MSG).serviceSig     = COM_NETLINK_KERNEL_SIG;      \
     (MSG).resourceInfoID = (R_ID);                      \
+    (MSG).seqID          = (SEQ_ID);                    \
 }
 
+#define COM_CHAN_SKB_POOL_SZ        64          // Preallocated reply SK-Buffers per CPU
+#define COM_CHAN_SKB_POOL_LOW       16          // Pool refill is scheduled below this level
+#define COM_CHAN_SKB_POOL_PROC      "com_chan_pool"
+#define COM_CHAN_NET_PROC           "com_chan"  // Relay registry and counters, per namespace under /proc/net
+
 
 //*************************************
 // Module Data Structures
 //*************************************
-enum
+typedef struct ComChan_SkbPool_s
 {
-    INVALID_RESOURCE_INFO_ID,
-
-    DISK_RESOURCE_INFO,
-    MEMORY_RESOURCE_INFO,
-    SERVICE_RESOURCE_INFO,
-};
-
-
-typedef struct RW_DiskInfo_s
-{
-    uint64_t                systemMemory;       ///< System total disk memory
-    uint64_t                freeMemory;         ///< System free disk memory
-} RW_DiskInfo_t;
-
-typedef struct RW_MemoryInfo_s
-{
-    uint64_t                systemMemory;       ///< System total memory
-    uint64_t                freeMemory;         ///< System free memory
-} RW_MemoryInfo_t;
-
-typedef struct ServiceInfo_s
-{
-    uint32_t                servicePID;         ///< Service process ID
-    char                    serviceHostIP4[16]; ///< Service host IPV4 address
-} ServiceInfo_t;
-
-typedef struct ComChan_Message_s
+    struct sk_buff_head     skbs;               ///< Pre-initialised reply SK-Buffers (netlink header in place)
+    u64                     nTaken;             ///< Replies sent from pool
+    u64                     nExhausted;         ///< Replies found pool empty (allocated in place)
+    u64                     nRefilled;          ///< SK-Buffers added by refill
+    u64                     nRefillFailed;      ///< Refill allocations failed
+} ComChan_SkbPool_t;
+
+typedef struct ComChan_NetState_s
 {
-    uint32_t                serviceSig;         ///< Service signature (ID)
-    uint32_t                resourceInfoID;     ///< Resource information identifier
+    struct sock            *pNLSock;            ///< Relay netlink socket of namespace
+    struct proc_dir_entry  *pStatsProc;         ///< Relay counters entry, NULL if creation failed
 
-    uint32_t                flags;              ///< Message flags
+    int                     DW_PID;                     ///< Registered disk watcher
+    int                     MW_PID;                     ///< Registered memory watcher
+    int                     RW_PID;                     ///< Registered resource watcher
+    int                     WA_PID;                     ///< Registered watcher agent
+    int                     LG_PID;                     ///< Registered LAN gateway
 
-    union
-    {
-        RW_DiskInfo_t       diskInfo;           ///< Disk information
-        RW_MemoryInfo_t     memoryInfo;         ///< Memory information
-
-        ServiceInfo_t       serviceInfo;        ///< Service information
-    } res_info;
-} ComChan_Message_t;
+    atomic_long_t           nReceived;          ///< Messages received
+    atomic_long_t           nForwarded;         ///< Queries forwarded to resource watcher
+    atomic_long_t           nReplied;           ///< Replies (and pushes) routed back to requester
+    atomic_long_t           nDropped;           ///< Queries and replies without registered receiver
+    atomic_long_t           nMalformed;         ///< Messages shorter than relay message, dropped
+    atomic_long_t           nClassForwarded[COM_CHAN_PRIO_MAX]; ///< Queries forwarded per priority class
+} ComChan_NetState_t;
 
 
 //*************************************
 // Module Local Varialbes
 //*************************************
-static struct sock *pNLSock = NULL;
+static unsigned int comChanNetID;
+
+static const char *prioNames[COM_CHAN_PRIO_MAX] = { "normal", "critical", "bulk" };
 
-static int DW_PID = 0;
-static int MW_PID = 0;
-static int RW_PID = 0;
+static DEFINE_PER_CPU(ComChan_SkbPool_t, skbPools);
+static struct proc_dir_entry *pSkbPoolProc = NULL;
+
+static void refillSkbPools(struct work_struct *pWork);
+static DECLARE_WORK(skbPoolWork, refillSkbPools);
 
 
 //*************************************
@@ -114,55 +109,99 @@ static int RW_PID = 0;
 //*************************************
 static void com_chan_recv(struct sk_buff *pSKB);
 
-static void handleDWMessage(ComChan_Message_t *pMessage);
-static void handleMWMessage(ComChan_Message_t *pMessage);
-static void handleRWMessage(ComChan_Message_t *pMessage);
+static void handleDWMessage(ComChan_NetState_t *pState, const ComChan_Message_t *pMessage, u64 relayInNs);
+static void handleMWMessage(ComChan_NetState_t *pState, const ComChan_Message_t *pMessage, u64 relayInNs);
+static void handleRWMessage(ComChan_NetState_t *pState, const ComChan_Message_t *pMessage);
+static void handleWAMessage(ComChan_NetState_t *pState, const ComChan_Message_t *pMessage, u64 relayInNs);
+static void handleLGMessage(ComChan_NetState_t *pState, const ComChan_Message_t *pMessage, u64 relayInNs);
+
+static void forwardQuery(ComChan_NetState_t *pState, uint32_t requesterSig, const ComChan_Message_t *pMessage, u64 relayInNs);
+static int* getServicePID(ComChan_NetState_t *pState, uint32_t serviceSig);
+static int sendMessage(ComChan_NetState_t *pState, int srvPID, struct sk_buff *pSKB);
 
-static void sendMessage(int srvPID, ComChan_Message_t *pMessage);
+static struct sk_buff* allocReplySkb(gfp_t gfpFlags);
+static void drainSkbPools(void);
+static void fillSkbPool(ComChan_SkbPool_t *pPool);
+static struct sk_buff* takeReplySkb(void);
+static int showSkbPoolStats(struct seq_file *pSeqFile, void *pData);
+static int showNetStats(struct seq_file *pSeqFile, void *pData);
+
+static int __net_init com_chan_net_init(struct net *pNet);
+static void __net_exit com_chan_net_exit(struct net *pNet);
 
 
 static void com_chan_recv(struct sk_buff *pSKB)
 {
-    struct nlmsghdr   *pNLHdr;
-    ComChan_Message_t *pMessage;
+    struct nlmsghdr    *pNLHdr;
+    const ComChan_Message_t *pMessage;
+    ComChan_NetState_t *pState;
+    u64 relayInNs;
 
     if (pSKB == NULL) { return; }
 
-    printk(KERN_INFO "%s\n", __func__);
+    /* Query arrival, stamped into forwarded query (received SK-Buffer is never written) */
+    relayInNs = ktime_get_ns();
+
+    pr_debug("%s\n", __func__);
+
+    /* Relay state of namespace message was sent in */
+    pState = net_generic(sock_net(pSKB->sk), comChanNetID);
+    atomic_long_inc(&pState->nReceived);
 
     /* Fetch netlink header */
-    pNLHdr = (struct nlmsghdr*)pSKB->data;
+    pNLHdr = nlmsg_hdr(pSKB);
+
+    /* Any local process can send, drop message before payload is read if it is short */
+    if ( !nlmsg_ok(pNLHdr, pSKB->len) ||
+         (nlmsg_len(pNLHdr) < (int)sizeof(ComChan_Message_t)) )
+    {
+        printk_ratelimited(KERN_WARNING "Short message (%u bytes) dropped\n", pSKB->len);
+        atomic_long_inc(&pState->nMalformed);
+        return;
+    }
 
     /* Get message pointer */
-    pMessage = (ComChan_Message_t *)nlmsg_data(pNLHdr);
+    pMessage = (const ComChan_Message_t *)nlmsg_data(pNLHdr);
 
-    printk(KERN_INFO "##############################\n");
-    printk(KERN_INFO "Signature 0x%X | Resource-ID %u\n", pMessage->serviceSig, pMessage->resourceInfoID);
+    pr_debug("##############################\n");
+    pr_debug("Signature 0x%X | Resource-ID %u\n", pMessage->serviceSig, pMessage->resourceInfoID);
     switch (pMessage->serviceSig)
     {
         case COM_NETLINK_DW_SIG:
         {
-            handleDWMessage(pMessage);
+            handleDWMessage(pState, pMessage, relayInNs);
             break;
         }
 
         case COM_NETLINK_MW_SIG:
         {
-            handleMWMessage(pMessage);
+            handleMWMessage(pState, pMessage, relayInNs);
             break;
         }
 
         case COM_NETLINK_RW_SIG:
         {
-            handleRWMessage(pMessage);
+            handleRWMessage(pState, pMessage);
+            break;
+        }
+
+        case COM_NETLINK_WA_SIG:
+        {
+            handleWAMessage(pState, pMessage, relayInNs);
+            break;
+        }
+
+        case COM_NETLINK_LG_SIG:
+        {
+            handleLGMessage(pState, pMessage, relayInNs);
             break;
         }
     }
-    printk(KERN_INFO "##############################\n");
+    pr_debug("##############################\n");
 }
 
 
-static void handleDWMessage(ComChan_Message_t *pMessage)
+static void handleDWMessage(ComChan_NetState_t *pState, const ComChan_Message_t *pMessage, u64 relayInNs)
 {
     if (pMessage == NULL) { return; }
 
@@ -170,30 +209,43 @@ static void handleDWMessage(ComChan_Message_t *pMessage)
     {
         case DISK_RESOURCE_INFO:
         {
-            printk(KERN_INFO "Disk information query received\n");
+            pr_debug("Disk information query received\n");
 
-            if ( (RW_PID > 0) &&
-                 (find_get_pid(RW_PID) != NULL) )
-            {
-                ComChan_Message_t resQuery;
-                /* TODO:: Add request to queue */
+            forwardQuery(pState, COM_NETLINK_DW_SIG, pMessage, relayInNs);
+            break;
+        }
+
+        case SUBSCRIBE_RESOURCE_INFO:
+        {
+            pr_debug("Subscription request received\n");
 
-                /* Populate resource information query */
-                POPULATE_COM_CHAN_QUERY(resQuery, DISK_RESOURCE_INFO);
+            forwardQuery(pState, COM_NETLINK_DW_SIG, pMessage, relayInNs);
+            break;
+        }
 
-                /* Send resource query to resource watcher service */
-                sendMessage(RW_PID, &resQuery);
-            }
-            else { RW_PID = 0; }
+        case HISTORY_RESOURCE_INFO:
+        case QUANTILE_RESOURCE_INFO:
+        {
+            pr_debug("History/quantile query received\n");
+
+            forwardQuery(pState, COM_NETLINK_DW_SIG, pMessage, relayInNs);
+            break;
+        }
+
+        case DU_RESOURCE_INFO:
+        {
+            pr_debug("Directory usage query (root %u) received\n", pMessage->res_info.duInfo.rootIndex);
+
+            forwardQuery(pState, COM_NETLINK_DW_SIG, pMessage, relayInNs);
             break;
         }
 
         case SERVICE_RESOURCE_INFO:
         {
-            if ( (DW_PID == 0) ||
-                 (find_get_pid(DW_PID) != NULL) )
+            if ( (pState->DW_PID == 0) ||
+                 (find_get_pid(pState->DW_PID) != NULL) )
             {
-                DW_PID = pMessage->res_info.serviceInfo.servicePID;
+                pState->DW_PID = pMessage->res_info.serviceInfo.servicePID;
                 printk(KERN_INFO "PID %u | Host %s\n", pMessage->res_info.serviceInfo.servicePID, pMessage->res_info.serviceInfo.serviceHostIP4);
             }
             break;
@@ -201,7 +253,7 @@ static void handleDWMessage(ComChan_Message_t *pMessage)
     }
 }
 
-static void handleMWMessage(ComChan_Message_t *pMessage)
+static void handleMWMessage(ComChan_NetState_t *pState, const ComChan_Message_t *pMessage, u64 relayInNs)
 {
     if (pMessage == NULL) { return; }
 
@@ -209,30 +261,67 @@ static void handleMWMessage(ComChan_Message_t *pMessage)
     {
         case MEMORY_RESOURCE_INFO:
         {
-            printk(KERN_INFO "Memory information query received\n");
+            pr_debug("Memory information query received\n");
 
-            if ( (RW_PID > 0) &&
-                 (find_get_pid(RW_PID) != NULL) )
-            {
-                ComChan_Message_t resQuery;
-                /* TODO:: Add request to queue */
+            forwardQuery(pState, COM_NETLINK_MW_SIG, pMessage, relayInNs);
+            break;
+        }
 
-                /* Populate resource information query */
-                POPULATE_COM_CHAN_QUERY(resQuery, MEMORY_RESOURCE_INFO);
+        case CPU_RESOURCE_INFO:
+        {
+            pr_debug("CPU information query received\n");
 
-                /* Send resource query to resource watcher service */
-                sendMessage(RW_PID, &resQuery);
-            }
-            else { RW_PID = 0; }
+            forwardQuery(pState, COM_NETLINK_MW_SIG, pMessage, relayInNs);
+            break;
+        }
+
+        case MULTI_RESOURCE_INFO:
+        {
+            pr_debug("Multi-resource query (mask 0x%X) received\n", pMessage->res_info.multiInfo.resourceMask);
+
+            forwardQuery(pState, COM_NETLINK_MW_SIG, pMessage, relayInNs);
+            break;
+        }
+
+        case NUMA_RESOURCE_INFO:
+        {
+            pr_debug("NUMA information query (first node %u) received\n", pMessage->res_info.numaInfo.firstNode);
+
+            forwardQuery(pState, COM_NETLINK_MW_SIG, pMessage, relayInNs);
+            break;
+        }
+
+        case FRAG_RESOURCE_INFO:
+        {
+            pr_debug("Fragmentation information query (first zone %u) received\n", pMessage->res_info.fragInfo.firstZone);
+
+            forwardQuery(pState, COM_NETLINK_MW_SIG, pMessage, relayInNs);
+            break;
+        }
+
+        case SUBSCRIBE_RESOURCE_INFO:
+        {
+            pr_debug("Subscription request received\n");
+
+            forwardQuery(pState, COM_NETLINK_MW_SIG, pMessage, relayInNs);
+            break;
+        }
+
+        case HISTORY_RESOURCE_INFO:
+        case QUANTILE_RESOURCE_INFO:
+        {
+            pr_debug("History/quantile query received\n");
+
+            forwardQuery(pState, COM_NETLINK_MW_SIG, pMessage, relayInNs);
             break;
         }
 
         case SERVICE_RESOURCE_INFO:
         {
-            if ( (MW_PID == 0) ||
-                 (find_get_pid(MW_PID) != NULL) )
+            if ( (pState->MW_PID == 0) ||
+                 (find_get_pid(pState->MW_PID) != NULL) )
             {
-                MW_PID = pMessage->res_info.serviceInfo.servicePID;
+                pState->MW_PID = pMessage->res_info.serviceInfo.servicePID;
                 printk(KERN_INFO "PID %u | Host %s\n", pMessage->res_info.serviceInfo.servicePID, pMessage->res_info.serviceInfo.serviceHostIP4);
             }
             break;
@@ -240,125 +329,427 @@ static void handleMWMessage(ComChan_Message_t *pMessage)
     }
 }
 
-static void handleRWMessage(ComChan_Message_t *pMessage)
+static void handleRWMessage(ComChan_NetState_t *pState, const ComChan_Message_t *pMessage)
 {
     if (pMessage == NULL) { return; }
 
     switch (pMessage->resourceInfoID)
     {
         case DISK_RESOURCE_INFO:
+        case MEMORY_RESOURCE_INFO:
+        case CPU_RESOURCE_INFO:
+        case HISTORY_RESOURCE_INFO:
+        case QUANTILE_RESOURCE_INFO:
+        case MULTI_RESOURCE_INFO:
+        case SUBSCRIBE_RESOURCE_INFO:
+        case NUMA_RESOURCE_INFO:
+        case FRAG_RESOURCE_INFO:
+        case DU_RESOURCE_INFO:
         {
-            /* TODO:: Check queue for query */
-            printk(KERN_INFO "Total %llu | Free %llu\n", pMessage->res_info.diskInfo.systemMemory, pMessage->res_info.diskInfo.freeMemory);
+            /* Reply (or subscription push) is routed back to the querying service by its signature */
+            int *pReqPID = getServicePID(pState, pMessage->requesterSig);
+
+            pr_debug("Resource %u reply for 0x%X\n", pMessage->resourceInfoID, pMessage->requesterSig);
+
+            if (pReqPID == NULL) { break; }
 
-            if ( (DW_PID > 0) &&
-                 (find_get_pid(DW_PID) != NULL) )
+            if ( (*pReqPID > 0) &&
+                 (find_get_pid(*pReqPID) != NULL) )
             {
-                ComChan_Message_t resInfo;
+                struct sk_buff    *pReplySKB;
+                ComChan_Message_t *pResInfo;
+
+                /* Reply is built in place in SK-Buffer, message is too large for kernel stack */
+                pReplySKB = takeReplySkb();
+                if (pReplySKB == NULL)
+                {
+                    printk_ratelimited(KERN_ALERT "Netlink message creation failed\n");
+                    atomic_long_inc(&pState->nDropped);
+                    break;
+                }
+                pResInfo = (ComChan_Message_t *)nlmsg_data(nlmsg_hdr(pReplySKB));
 
                 /* Populate resource information */
-                resInfo.serviceSig      = COM_NETLINK_KERNEL_SIG;
-                resInfo.resourceInfoID  = DISK_RESOURCE_INFO;
-                resInfo.flags           = 0;
+                memcpy(pResInfo, pMessage, sizeof(ComChan_Message_t));
+                pResInfo->serviceSig    = COM_NETLINK_KERNEL_SIG;
+                pResInfo->flags         = (pMessage->flags & COM_CHAN_FLAG_PRIO_MASK);
+                pResInfo->stageTimes[COM_CHAN_STAGE_REPLY_RELAY] = ktime_get_ns();
+
+                /* Send resource information to querying service */
+                if (sendMessage(pState, *pReqPID, pReplySKB) == 0) { atomic_long_inc(&pState->nReplied); }
+                else                                               { atomic_long_inc(&pState->nDropped); }
+            }
+            else
+            {
+                *pReqPID = 0;
+                atomic_long_inc(&pState->nDropped);
+            }
+            break;
+        }
 
-                resInfo.res_info.diskInfo.systemMemory = pMessage->res_info.diskInfo.systemMemory;
-                resInfo.res_info.diskInfo.freeMemory   = pMessage->res_info.diskInfo.freeMemory;
+        case SERVICE_RESOURCE_INFO:
+        {
+            /* TODO:: Add resource monitor to nodes queue for future queries */
 
-                /* Send resource query to resource watcher service */
-                sendMessage(DW_PID, &resInfo);
+            if ( (pState->RW_PID == 0) ||
+                 (find_get_pid(pState->RW_PID) == NULL) )
+            {
+                pState->RW_PID = pMessage->res_info.serviceInfo.servicePID;
+                printk(KERN_INFO "RW_PID:: PID %u | Host %s\n", pMessage->res_info.serviceInfo.servicePID, pMessage->res_info.serviceInfo.serviceHostIP4);
             }
-            else { DW_PID = 0; }
             break;
         }
+    }
+}
 
+static void handleWAMessage(ComChan_NetState_t *pState, const ComChan_Message_t *pMessage, u64 relayInNs)
+{
+    if (pMessage == NULL) { return; }
+
+    switch (pMessage->resourceInfoID)
+    {
+        case DISK_RESOURCE_INFO:
         case MEMORY_RESOURCE_INFO:
+        case CPU_RESOURCE_INFO:
+        case HISTORY_RESOURCE_INFO:
+        case QUANTILE_RESOURCE_INFO:
+        case MULTI_RESOURCE_INFO:
+        case SUBSCRIBE_RESOURCE_INFO:
+        case NUMA_RESOURCE_INFO:
+        case FRAG_RESOURCE_INFO:
+        case DU_RESOURCE_INFO:
         {
-            /* TODO:: Check queue for query */
-            printk(KERN_INFO "Total %llu | Free %llu\n", pMessage->res_info.memoryInfo.systemMemory, pMessage->res_info.memoryInfo.freeMemory);
+            /* Agent multiplexes all resources over its single registration */
+            pr_debug("Agent query for resource %u received\n", pMessage->resourceInfoID);
+
+            forwardQuery(pState, COM_NETLINK_WA_SIG, pMessage, relayInNs);
+            break;
+        }
 
-            if ( (MW_PID > 0) &&
-                 (find_get_pid(MW_PID) != NULL) )
+        case SERVICE_RESOURCE_INFO:
+        {
+            if ( (pState->WA_PID == 0) ||
+                 (find_get_pid(pState->WA_PID) == NULL) )
             {
-                ComChan_Message_t resInfo;
+                pState->WA_PID = pMessage->res_info.serviceInfo.servicePID;
+                printk(KERN_INFO "WA_PID:: PID %u | Host %s\n", pMessage->res_info.serviceInfo.servicePID, pMessage->res_info.serviceInfo.serviceHostIP4);
+            }
+            break;
+        }
+    }
+}
 
-                /* Populate resource information */
-                resInfo.serviceSig      = COM_NETLINK_KERNEL_SIG;
-                resInfo.resourceInfoID  = MEMORY_RESOURCE_INFO;
-                resInfo.flags           = 0;
+static void handleLGMessage(ComChan_NetState_t *pState, const ComChan_Message_t *pMessage, u64 relayInNs)
+{
+    if (pMessage == NULL) { return; }
 
-                resInfo.res_info.memoryInfo.systemMemory = pMessage->res_info.memoryInfo.systemMemory;
-                resInfo.res_info.memoryInfo.freeMemory   = pMessage->res_info.memoryInfo.freeMemory;
+    switch (pMessage->resourceInfoID)
+    {
+        case MULTI_RESOURCE_INFO:
+        {
+            /* Gateway answers LAN peers from local host summary */
+            pr_debug("Gateway query for resource %u received\n", pMessage->resourceInfoID);
 
-                /* Send resource query to resource watcher service */
-                sendMessage(MW_PID, &resInfo);
-            }
-            else { MW_PID = 0; }
+            forwardQuery(pState, COM_NETLINK_LG_SIG, pMessage, relayInNs);
             break;
         }
 
         case SERVICE_RESOURCE_INFO:
         {
-            /* TODO:: Add resource monitor to nodes queue for future queries */
-
-            if ( (RW_PID == 0) ||
-                 (find_get_pid(RW_PID) == NULL) )
+            if ( (pState->LG_PID == 0) ||
+                 (find_get_pid(pState->LG_PID) == NULL) )
             {
-                RW_PID = pMessage->res_info.serviceInfo.servicePID;
-                printk(KERN_INFO "RW_PID:: PID %u | Host %s\n", pMessage->res_info.serviceInfo.servicePID, pMessage->res_info.serviceInfo.serviceHostIP4);
+                pState->LG_PID = pMessage->res_info.serviceInfo.servicePID;
+                printk(KERN_INFO "LG_PID:: PID %u | Host %s\n", pMessage->res_info.serviceInfo.servicePID, pMessage->res_info.serviceInfo.serviceHostIP4);
             }
             break;
         }
     }
 }
 
-static void sendMessage(int srvPID, ComChan_Message_t *pMessage)
+static void forwardQuery(ComChan_NetState_t *pState, uint32_t requesterSig, const ComChan_Message_t *pMessage, u64 relayInNs)
 {
-    struct sk_buff  *pSKB;
-    struct nlmsghdr *pNLMsgHdr;
-
-    if (srvPID <= 0) { return; }
     if (pMessage == NULL) { return; }
 
-    /* Allocate memory for netlink SK-Buffer */
-    pSKB = nlmsg_new(COM_NETLINK_MAX_PAYLOAD, 0);
-    if (pSKB == NULL)
+    if ( (pState->RW_PID > 0) &&
+         (find_get_pid(pState->RW_PID) != NULL) )
     {
-        printk(KERN_ALERT "Netlink message creation failed\n");
-        return;
+        struct sk_buff    *pSKB;
+        ComChan_Message_t *pResQuery;
+        uint32_t prio = COM_CHAN_GET_PRIO(pMessage->flags);
+        /* TODO:: Add request to queue */
+
+        /* Query is built in place in SK-Buffer, message is too large for kernel stack */
+        pSKB = takeReplySkb();
+        if (pSKB == NULL)
+        {
+            printk_ratelimited(KERN_ALERT "Netlink message creation failed\n");
+            atomic_long_inc(&pState->nDropped);
+            return;
+        }
+        pResQuery = (ComChan_Message_t *)nlmsg_data(nlmsg_hdr(pSKB));
+
+        /* Populate resource information query, keep query parameters (cores window, history window) */
+        POPULATE_COM_CHAN_QUERY(*pResQuery, pMessage->resourceInfoID, pMessage->seqID);
+        memcpy(&pResQuery->res_info, &pMessage->res_info, sizeof(pResQuery->res_info));
+
+        /* Stamp requester, resource watcher echoes it in reply */
+        pResQuery->requesterSig = requesterSig;
+
+        /* Keep priority class, resource watcher queues query by it */
+        pResQuery->flags = (pMessage->flags & COM_CHAN_FLAG_PRIO_MASK);
+
+        /* Keep stage times, resource watcher echoes them in reply */
+        memcpy(pResQuery->stageTimes, pMessage->stageTimes, sizeof(pResQuery->stageTimes));
+        pResQuery->stageTimes[COM_CHAN_STAGE_RELAY_IN]  = relayInNs;
+        pResQuery->stageTimes[COM_CHAN_STAGE_RELAY_OUT] = ktime_get_ns();
+
+        /* Send resource query to resource watcher service, SK-Buffer is consumed */
+        if (sendMessage(pState, pState->RW_PID, pSKB) == 0)
+        {
+            atomic_long_inc(&pState->nForwarded);
+            atomic_long_inc(&pState->nClassForwarded[prio]);
+        }
+        else { atomic_long_inc(&pState->nDropped); }
+    }
+    else
+    {
+        pState->RW_PID = 0;
+        atomic_long_inc(&pState->nDropped);
+    }
+}
+
+static int* getServicePID(ComChan_NetState_t *pState, uint32_t serviceSig)
+{
+    switch (serviceSig)
+    {
+        case COM_NETLINK_DW_SIG: { return &pState->DW_PID; }
+        case COM_NETLINK_MW_SIG: { return &pState->MW_PID; }
+        case COM_NETLINK_WA_SIG: { return &pState->WA_PID; }
+        case COM_NETLINK_LG_SIG: { return &pState->LG_PID; }
+    }
+
+    return NULL;
+}
+
+static int sendMessage(ComChan_NetState_t *pState, int srvPID, struct sk_buff *pSKB)
+{
+    if (pSKB == NULL) { return -1; }
+    if (srvPID <= 0)
+    {
+        kfree_skb(pSKB);
+        return -1;
+    }
+
+    /* Send netlink message to service srvPID of namespace, SK-Buffer is consumed on failure as well */
+    if (nlmsg_unicast(pState->pNLSock, pSKB, srvPID) < 0)
+    {
+        printk_ratelimited(KERN_ALERT "Netlink message sending failed\n");
+        return -1;
     }
 
+    return 0;
+}
+
+static struct sk_buff* allocReplySkb(gfp_t gfpFlags)
+{
+    struct sk_buff  *pSKB;
+    struct nlmsghdr *pNLMsgHdr;
+
+    /* Allocate memory for netlink SK-Buffer */
+    pSKB = nlmsg_new(COM_NETLINK_MAX_PAYLOAD, gfpFlags);
+    if (pSKB == NULL) { return NULL; }
+
     /* Add netlink message header to SK-Buffer */
     pNLMsgHdr = nlmsg_put(pSKB, 0, 0, NLMSG_DONE, COM_NETLINK_MAX_PAYLOAD, 0);
     if (pNLMsgHdr == NULL)
     {
-        printk(KERN_ALERT "Netlink message header addition to SK-Buffer failed\n");
+        printk_ratelimited(KERN_ALERT "Netlink message header addition to SK-Buffer failed\n");
 
         /* Release netlink SK-Buffer memory */
         nlmsg_free(pSKB);
-        return;
+        return NULL;
     }
 
     /* Clear multi-cast group, flow is unicast */
     NETLINK_CB(pSKB).dst_group = 0;
 
-    /* Copy message to netlink message header */
-    memcpy(nlmsg_data(pNLMsgHdr), pMessage, COM_NETLINK_MAX_PAYLOAD);
+    return pSKB;
+}
+
+static void drainSkbPools(void)
+{
+    int cpu;
 
-    /* Send netlink message to service srvPID */
-    if (nlmsg_unicast(pNLSock, pSKB, srvPID) < 0)
+    for_each_possible_cpu(cpu)
     {
-        printk(KERN_ALERT "Netlink message sending failed\n");
+        skb_queue_purge(&per_cpu_ptr(&skbPools, cpu)->skbs);
+    }
+}
 
-        /* Release netlink SK-Buffer memory */
-        nlmsg_free(pSKB);
-        return;
+static void fillSkbPool(ComChan_SkbPool_t *pPool)
+{
+    struct sk_buff *pSKB;
+
+    /* Process context, allocation may reclaim */
+    while (skb_queue_len(&pPool->skbs) < COM_CHAN_SKB_POOL_SZ)
+    {
+        pSKB = allocReplySkb(GFP_KERNEL);
+        if (pSKB == NULL)
+        {
+            pPool->nRefillFailed++;
+            break;
+        }
+
+        skb_queue_tail(&pPool->skbs, pSKB);
+        pPool->nRefilled++;
+    }
+}
+
+static void refillSkbPools(struct work_struct *pWork)
+{
+    int cpu;
+
+    for_each_possible_cpu(cpu)
+    {
+        fillSkbPool(per_cpu_ptr(&skbPools, cpu));
+    }
+}
+
+static struct sk_buff* takeReplySkb(void)
+{
+    struct sk_buff    *pSKB;
+    ComChan_SkbPool_t *pPool;
+    int refill;
+
+    /* Pool queue lock only contends with refill work */
+    pPool = get_cpu_ptr(&skbPools);
+
+    pSKB = skb_dequeue(&pPool->skbs);
+    if (pSKB != NULL) { pPool->nTaken++; }
+    else              { pPool->nExhausted++; }
+
+    refill = (skb_queue_len(&pPool->skbs) < COM_CHAN_SKB_POOL_LOW);
+
+    put_cpu_ptr(&skbPools);
+
+    if (refill) { schedule_work(&skbPoolWork); }
+
+    /* Pool exhausted, reply still goes out if memory is available right now */
+    if (pSKB == NULL) { pSKB = allocReplySkb(GFP_ATOMIC); }
+
+    return pSKB;
+}
+
+static int showSkbPoolStats(struct seq_file *pSeqFile, void *pData)
+{
+    int cpu;
+    ComChan_SkbPool_t *pPool;
+
+    seq_printf(pSeqFile, "cpu pooled taken exhausted refilled refill_failed\n");
+
+    for_each_online_cpu(cpu)
+    {
+        pPool = per_cpu_ptr(&skbPools, cpu);
+
+        seq_printf(pSeqFile, "%d %u %llu %llu %llu %llu\n",
+                   cpu, skb_queue_len(&pPool->skbs),
+                   pPool->nTaken, pPool->nExhausted,
+                   pPool->nRefilled, pPool->nRefillFailed);
+    }
+
+    return 0;
+}
+
+static int showNetStats(struct seq_file *pSeqFile, void *pData)
+{
+    ComChan_NetState_t *pState = net_generic(seq_file_single_net(pSeqFile), comChanNetID);
+    int prio;
+
+    seq_printf(pSeqFile, "dw_pid %d\nmw_pid %d\nrw_pid %d\nwa_pid %d\nlg_pid %d\n",
+               pState->DW_PID, pState->MW_PID, pState->RW_PID,
+               pState->WA_PID, pState->LG_PID);
+
+    seq_printf(pSeqFile, "received %ld\nforwarded %ld\nreplied %ld\ndropped %ld\nmalformed %ld\n",
+               atomic_long_read(&pState->nReceived),
+               atomic_long_read(&pState->nForwarded),
+               atomic_long_read(&pState->nReplied),
+               atomic_long_read(&pState->nDropped),
+               atomic_long_read(&pState->nMalformed));
+
+    for (prio = 0; prio < COM_CHAN_PRIO_MAX; prio++)
+    {
+        seq_printf(pSeqFile, "forwarded_%s %ld\n",
+                   prioNames[prio], atomic_long_read(&pState->nClassForwarded[prio]));
     }
+
+    return 0;
 }
 
 
 //*************************************
 // Module Interface Functions
 //*************************************
+/** @brief The namespace initialization function
+ *  It is called for every network namespace, existing
+ *  ones at module installation and new ones when
+ *  created. The function creates relay socket of
+ *  namespace; registry and counters start empty.
+ *  @return returns 0 if successful
+ */
+static int __net_init com_chan_net_init(struct net *pNet)
+{
+    struct netlink_kernel_cfg cfg = { .input = com_chan_recv, };
+    ComChan_NetState_t *pState = net_generic(pNet, comChanNetID);
+
+    /* Allocate netlink socket */
+    pState->pNLSock = netlink_kernel_create(pNet, COM_NETLINK_LKM, &cfg);
+    if (pState->pNLSock == NULL)
+    {
+        printk(KERN_ALERT "Netlink socket creation failed\n");
+        return -ECHILD;
+    }
+
+    /* Relay counters are optional, relay runs without them */
+    pState->pStatsProc = proc_create_net_single(COM_CHAN_NET_PROC, 0444, pNet->proc_net, showNetStats, NULL);
+    if (pState->pStatsProc == NULL)
+    {
+        printk(KERN_WARNING "Relay statistics /proc/net/%s creation failed\n", COM_CHAN_NET_PROC);
+    }
+
+    return 0;
+}
+
+/** @brief The namespace cleanup function
+ *  It is called when network namespace is destroyed
+ *  or module is removed. The function releases relay
+ *  socket of namespace.
+ */
+static void __net_exit com_chan_net_exit(struct net *pNet)
+{
+    ComChan_NetState_t *pState = net_generic(pNet, comChanNetID);
+
+    if (pState->pStatsProc != NULL)
+    {
+        proc_remove(pState->pStatsProc);
+        pState->pStatsProc = NULL;
+    }
+
+    if (pState->pNLSock != NULL)
+    {
+        netlink_kernel_release(pState->pNLSock);
+        pState->pNLSock = NULL;
+    }
+}
+
+static struct pernet_operations comChanNetOps =
+{
+    .init = com_chan_net_init,
+    .exit = com_chan_net_exit,
+    .id   = &comChanNetID,
+    .size = sizeof(ComChan_NetState_t),
+};
+
 /** @brief The module initialization function
  *  It is the first function that will be called
  *  when module is installed (inmod). The function
@@ -370,16 +761,32 @@ static void sendMessage(int srvPID, ComChan_Message_t *pMessage)
  */
 static int __init com_chan_init(void)
 {
-    struct netlink_kernel_cfg cfg = { .input = com_chan_recv, };
+    int cpu, retVal;
 
     printk(KERN_INFO "%s\n", __func__);
 
-    /* Allocate netlink socket */
-    pNLSock = netlink_kernel_create(&init_net, COM_NETLINK_LKM, &cfg);
-    if (pNLSock == NULL)
+    /* Preallocate reply SK-Buffers, relay doesn't allocate while pools last */
+    for_each_possible_cpu(cpu)
     {
-        printk(KERN_ALERT "Netlink socket creation failed\n");
-        return -ECHILD;
+        skb_queue_head_init(&per_cpu_ptr(&skbPools, cpu)->skbs);
+    }
+    refillSkbPools(NULL);
+
+    /* Relay socket, registry and counters per network namespace; containers get their own relay */
+    retVal = register_pernet_subsys(&comChanNetOps);
+    if (retVal < 0)
+    {
+        printk(KERN_ALERT "Network namespace registration failed\n");
+
+        drainSkbPools();
+        return retVal;
+    }
+
+    /* Pool counters are optional, relay runs without them */
+    pSkbPoolProc = proc_create_single(COM_CHAN_SKB_POOL_PROC, 0444, NULL, showSkbPoolStats);
+    if (pSkbPoolProc == NULL)
+    {
+        printk(KERN_WARNING "Pool statistics /proc/%s creation failed\n", COM_CHAN_SKB_POOL_PROC);
     }
 
     return 0;
@@ -394,10 +801,19 @@ static void __exit com_chan_exit(void)
 {
     printk(KERN_INFO "%s\n", __func__);
 
-    if (pNLSock != NULL)
+    /* Entry is optional, only created one is removed */
+    if (pSkbPoolProc != NULL)
     {
-        netlink_kernel_release(pNLSock);
+        proc_remove(pSkbPoolProc);
+        pSkbPoolProc = NULL;
     }
+
+    /* Release relay socket of every namespace */
+    unregister_pernet_subsys(&comChanNetOps);
+
+    /* No sender left, release pooled SK-Buffers */
+    cancel_work_sync(&skbPoolWork);
+    drainSkbPools();
 }
 
 
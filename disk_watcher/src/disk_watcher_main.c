@@ -10,6 +10,7 @@
 
 
 // Library Includes
+#define _GNU_SOURCE                         // recvmmsg(), sendmmsg()
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -25,346 +26,189 @@
 
 #include <linux/netlink.h>
 
+// Module Includes
+#include "com_chan_client.h"
+#include "com_chan_socket.h"
+#include "com_chan_timer_wheel.h"
+#include "com_chan_log.h"
+
 
 //*************************************
 // Module Macro Definitions
 //*************************************
-#define COM_NETLINK_LKM         31
-
-#define COM_NETLINK_KERNEL_SIG  0x00
-#define COM_NETLINK_DW_SIG      0x10101010
+#define MAX_EPOLL_EVENTS        2
+#define EPOLL_EVENTS_TIMEOUT    10          // Seconds
 
-#define COM_NETLINK_SOURCE      getpid()    // Process ID as source
-#define COM_NETLINK_DESTINATION 0           // Kernel as destination
+#define RESOURCE_PUSH_INTERVAL  5           // Seconds
+#define HISTORY_QUERY_TIMEOUT   60          // Seconds
 
-#define COM_NETLINK_MAX_PAYLOAD sizeof(ComChan_Message_t)
+#define QUERY_SCHEDULES_MAX     16          // Timer wheel capacity
 
-#define MAX_EPOLL_EVENTS        2
-#define EPOLL_EVENTS_TIMEOUT    10          // Seconds
+#define QUERY_MAX_OUTSTANDING   64          // Queries in flight
+#define QUERY_REPLY_TIMEOUT     2           // Seconds
 
-#define RESOURCE_QUERY_TIMEOUT  5           // Seconds
+#define SUBSCRIPTION_ID         1           // Disk information subscription
+#define SUBSCRIPTION_RENEW_TIMEOUT 60       // Seconds, well within resource watcher lease
 
 
 //*************************************
 // Module Data Structures
 //*************************************
-enum
-{
-    INVALID_RESOURCE_INFO_ID,
-
-    DISK_RESOURCE_INFO,
-    MEMORY_RESOURCE_INFO,
-    SERVICE_RESOURCE_INFO,
-};
-
-
-typedef struct RW_DiskInfo_s
-{
-    uint64_t                systemMemory;       ///< System total disk memory
-    uint64_t                freeMemory;         ///< System free disk memory
-} RW_DiskInfo_t;
-
-typedef struct RW_MemoryInfo_s
+typedef struct QueryContext_s
 {
-    uint64_t                systemMemory;       ///< System total memory
-    uint64_t                freeMemory;         ///< System free memory
-} RW_MemoryInfo_t;
+    ComChan_Client_t       *pClient;            ///< Asynchronous query client
 
-typedef struct ServiceInfo_s
-{
-    uint32_t                servicePID;         ///< Service process ID
-    char                    serviceHostIP4[16]; ///< Service host IPV4 address
-} ServiceInfo_t;
-
-typedef struct ComChan_Message_s
-{
-    uint32_t                serviceSig;         ///< Service signature (ID)
-    uint32_t                resourceInfoID;     ///< Resource information identifier
-
-    uint32_t                flags;              ///< Message flags
-
-    union
-    {
-        RW_DiskInfo_t       diskInfo;           ///< Disk information
-        RW_MemoryInfo_t     memoryInfo;         ///< Memory information
-
-        ServiceInfo_t       serviceInfo;        ///< Service information
-    } res_info;
-} ComChan_Message_t;
+    TW_TimerWheel_t        *pWheel;             ///< Query schedules
+    int                     renewTimerID;       ///< Subscription renewal schedule
+    int                     historyTimerID;     ///< History query schedule
+} QueryContext_t;
 
 
 //*************************************
 // Module Utility Functions
 //*************************************
-static inline int64_t _GetCurrentTime();
-
-
-static struct nlmsghdr* createNLMsgHdr(int maxPayloadSz);
-static int createNLSocket(struct sockaddr_nl *pSrcAddr,
-                          struct sockaddr_nl *pDstAddr);
-
-static int destroyNLMsgHdr(struct nlmsghdr *pNLMsgHdr);
-static int destroyNLSocket(int sock);
-
-static int registerEvent(int epollFD, int eventFD);
-
-static int handleResponseMsg(const int                 sock,
-                             const struct nlmsghdr    *pNLMsgHdr);
+static void handleDiskPush(void *pArg, uint32_t seqID, const ComChan_Message_t *pPush);
+static void handleHistoryReply(void *pArg, uint32_t seqID, const ComChan_Message_t *pReply);
+static void handleSubscribeReply(void *pArg, uint32_t seqID, const ComChan_Message_t *pReply);
+static void printQueryStats(const TW_TimerWheel_t *pWheel, int timerID, const char *pName);
+static void renewSubscription(void *pArg);
+static void sendHistoryQuery(void *pArg);
 
-static int sendMessage(const int                 sock,
-                       const struct sockaddr_nl *pDstAddr,
-                       const struct nlmsghdr    *pNLMsgHdr,
-                       const ComChan_Message_t  *pMessage);
 
-
-static inline int64_t _GetCurrentTime()
-{
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    return (int64_t) ts.tv_sec;
-}
-
-
-static struct nlmsghdr* createNLMsgHdr(int maxPayloadSz)
+static void handleDiskPush(__attribute__((unused)) void *pArg, __attribute__((unused)) uint32_t seqID, const ComChan_Message_t *pPush)
 {
-    struct nlmsghdr *pNLMsgHdr;
-
-    /* Allocate netlink message header */
-    pNLMsgHdr = (struct nlmsghdr *)malloc( NLMSG_SPACE(maxPayloadSz) );
-    if (pNLMsgHdr == NULL)
+    /* Only disk information subscription pushes are expected */
+    if ( (pPush->resourceInfoID != MULTI_RESOURCE_INFO) ||
+         (pPush->res_info.multiInfo.subscriptionID != SUBSCRIPTION_ID) ||
+         ((pPush->res_info.multiInfo.resourceMask & RW_RESOURCE_MASK(DISK_RESOURCE_INFO)) == 0) )
     {
-        printf("ERROR - %s:%d :: Failed to allocate netlink message header\n",
-                __func__, __LINE__);
-        return NULL;
+        return;
     }
 
-    /* Initialize netlink message header */
-    memset(pNLMsgHdr, 0, NLMSG_SPACE(maxPayloadSz));
-    pNLMsgHdr->nlmsg_len   = NLMSG_SPACE(maxPayloadSz);
-    pNLMsgHdr->nlmsg_pid   = COM_NETLINK_SOURCE;
-    pNLMsgHdr->nlmsg_flags = 0;
-
-    return pNLMsgHdr;
+    printf("Memory Information (%lu, %lu)\n",
+            pPush->res_info.multiInfo.diskInfo.systemMemory,
+            pPush->res_info.multiInfo.diskInfo.freeMemory);
 }
 
-static int createNLSocket(struct sockaddr_nl *pSrcAddr,
-                          struct sockaddr_nl *pDstAddr)
+static void handleHistoryReply(__attribute__((unused)) void *pArg, uint32_t seqID, const ComChan_Message_t *pReply)
 {
-    int sock;
+    uint16_t point, nValid = 0;
+    int64_t  minFree = INT64_MAX, maxFree = 0, sumAvg = 0;
+
+    const RW_HistoryInfo_t *pHistoryInfo;
 
-    if ( (pSrcAddr == NULL) ||
-         (pDstAddr == NULL) )
+    if (pReply == NULL)
     {
-        printf("ERROR - %s:%d :: Invalid input arguments (%p, %p)\n",
-                __func__, __LINE__,
-                pSrcAddr, pDstAddr);
-        return -1;
+        LOG_WARNING("History query %u expired without reply",
+                    seqID);
+        return;
     }
 
-    /* Create netlink socket */
-    sock = socket(PF_NETLINK, SOCK_RAW, COM_NETLINK_LKM);
-    if (sock < 0) { return -1; }
-
-    /* Initialize source and destination addresses */
-    memset(pSrcAddr, 0x00, sizeof(struct sockaddr_nl));
-    memset(pDstAddr, 0x00, sizeof(struct sockaddr_nl));
-
-    /* Populate source address information */
-    pSrcAddr->nl_family = AF_NETLINK;
-    pSrcAddr->nl_pid    = COM_NETLINK_SOURCE;
-
-    /* Populate destination address information */
-    pDstAddr->nl_family = AF_NETLINK;
-    pDstAddr->nl_pid    = COM_NETLINK_DESTINATION;
-
-    /* Bind socket to source address */
-    bind(sock, (struct sockaddr*)pSrcAddr, sizeof(struct sockaddr_nl));
+    pHistoryInfo = &pReply->res_info.historyInfo;
 
-    return sock;
-}
-
-static int destroyNLMsgHdr(struct nlmsghdr *pNLMsgHdr)
-{
-    if (pNLMsgHdr == NULL)
+    /* Summarize history window over points holding samples */
+    for (point = 0; point < pHistoryInfo->nPoints; point++)
     {
-        printf("ERROR - %s:%d :: Invalid input netlink message header %p\n",
-                __func__, __LINE__,
-                pNLMsgHdr);
-        return -1;
-    }
+        if ((pHistoryInfo->validMask & (1ULL << point)) == 0) { continue; }
 
-    /* Release netlink message header memory */
-    free(pNLMsgHdr);
+        if (pHistoryInfo->points[point].min < minFree) { minFree = pHistoryInfo->points[point].min; }
+        if (pHistoryInfo->points[point].max > maxFree) { maxFree = pHistoryInfo->points[point].max; }
 
-    return 0;
-}
+        sumAvg += pHistoryInfo->points[point].avg;
+        nValid++;
+    }
 
-static int destroyNLSocket(int sock)
-{
-    if (sock <= 0)
+    if (nValid > 0)
     {
-        printf("ERROR - %s:%d :: Invalid input netlink socket %d\n",
-                __func__, __LINE__,
-                sock);
-        return -1;
+        printf("Disk History (last %u s | min %ld, max %ld, avg %ld)\n",
+                (pHistoryInfo->nPoints * pHistoryInfo->step),
+                minFree, maxFree, (sumAvg / nValid));
     }
-
-    close(sock);
-
-    return 0;
 }
 
-static int handleResponseMsg(const int                 sock,
-                             const struct nlmsghdr    *pNLMsgHdr)
+static void handleSubscribeReply(__attribute__((unused)) void *pArg, uint32_t seqID, const ComChan_Message_t *pReply)
 {
-    int retVal;
-
-    struct iovec ioVector;
-    struct msghdr msgHdr;
-
-    ComChan_Message_t *pMessage;
-
-    if (sock <= 0)
+    /* Renewal is retried on next schedule */
+    if (pReply == NULL)
     {
-        printf("ERROR - %s:%d :: Invalid input socket (%d) information\n",
-                __func__, __LINE__,
-                sock);
-        return -1;
+        LOG_WARNING("Subscription request %u expired without reply",
+                    seqID);
+        return;
     }
 
-    if (pNLMsgHdr == NULL)
+    if (pReply->res_info.subscribeInfo.resourceMask == 0)
     {
-        printf("ERROR - %s:%d :: Invalid input pointer arguments (%p)\n",
-                __func__, __LINE__,
-                pNLMsgHdr);
-        return -1;
+        LOG_WARNING("Disk information subscription rejected");
     }
+}
 
-    /* Reset I/O vector and message header */
-    memset(&ioVector, 0x00, sizeof(ioVector));
-    memset(&msgHdr,   0x00, sizeof(msgHdr));
-
-    /* Populate I/O vector information */
-    ioVector.iov_base = (void *)pNLMsgHdr;
-    ioVector.iov_len = pNLMsgHdr->nlmsg_len;
-
-    /* Populate message header */
-    msgHdr.msg_iov = &ioVector;
-    msgHdr.msg_iovlen = 1;                          // Single I/O vector
-
-    /* Receive message on netlink socket */
-    retVal = recvmsg(sock, &msgHdr, 0);
-    if (retVal < 0)
-    {
-        printf("ERROR - %s:%d :: Failed to read from socket (%d) [%m]\n",
-                __func__, __LINE__,
-                sock);
-        return retVal;
-    }
+static void printQueryStats(const TW_TimerWheel_t *pWheel, int timerID, const char *pName)
+{
+    TW_TimerStats_t stats;
 
-    /* Get message data */
-    pMessage = (ComChan_Message_t *)NLMSG_DATA(pNLMsgHdr);
-    if ( (pMessage != NULL) &&
-         (pMessage->serviceSig == COM_NETLINK_KERNEL_SIG) )
+    if ( (getTimerStats(pWheel, timerID, &stats) < 0) ||
+         (stats.nFired == 0) )
     {
-        switch (pMessage->resourceInfoID)
-        {
-            case DISK_RESOURCE_INFO:
-            {
-                printf("Memory Information (%lu, %lu)\n",
-                        pMessage->res_info.diskInfo.systemMemory,
-                        pMessage->res_info.diskInfo.freeMemory);
-                break;
-            }
-        }
+        return;
     }
 
-    return retVal;
+    printf("%s Schedule (%lu fired, %lu missed | late avg %ld us, max %ld us | jitter avg %ld us, max %ld us)\n",
+            pName,
+            stats.nFired, stats.nMissed,
+            (stats.sumLateNs / (int64_t)stats.nFired / 1000), (stats.maxLateNs / 1000),
+            (stats.sumJitterNs / (int64_t)stats.nFired / 1000), (stats.maxJitterNs / 1000));
 }
 
-static int registerEvent(int epollFD, int eventFD)
+static void renewSubscription(void *pArg)
 {
-    struct epoll_event epollEvent;
+    QueryContext_t *pContext = (QueryContext_t *)pArg;
 
-    if ( (epollFD < 0) || (eventFD < 0) )
-    {
-        printf("ERROR - %s:%d :: Invalid input arguments for event registration (%d, %d)\n",
-                __func__, __LINE__,
-                epollFD, eventFD);
-        return -1;
-    }
-
-    /* Initialize event information */
-    memset((void *)&epollEvent, 0x00, sizeof(struct epoll_event));
+    ComChan_Message_t memWatcherMsg;
 
-    /* Register reading event */
-    epollEvent.events = EPOLLIN;
-    epollEvent.data.fd = eventFD;
+    /* Populate message for disk information subscription, pushed every interval */
+    memset(&memWatcherMsg, 0x00, sizeof(ComChan_Message_t));
+    memWatcherMsg.serviceSig        = COM_NETLINK_DW_SIG;
+    memWatcherMsg.resourceInfoID    = SUBSCRIBE_RESOURCE_INFO;
+    memWatcherMsg.flags             = 0;
 
-    if (epoll_ctl(epollFD, EPOLL_CTL_ADD, eventFD, &epollEvent) < 0)
-    {
-        printf("ERROR - %s:%d :: Failed to register event [%m]\n", __func__, __LINE__);
-        return -1;
-    }
+    memWatcherMsg.res_info.subscribeInfo.subscriptionID = SUBSCRIPTION_ID;
+    memWatcherMsg.res_info.subscribeInfo.interval       = RESOURCE_PUSH_INTERVAL;
+    memWatcherMsg.res_info.subscribeInfo.resourceMask   = RW_RESOURCE_MASK(DISK_RESOURCE_INFO);
 
-    return 0;
+    /* Send subscription message, same identifier renews lease */
+    submitComChanQuery(pContext->pClient, &memWatcherMsg, handleSubscribeReply, NULL);
 }
 
-static int sendMessage(const int                 sock,
-                       const struct sockaddr_nl *pDstAddr,
-                       const struct nlmsghdr    *pNLMsgHdr,
-                       const ComChan_Message_t  *pMessage)
+static void sendHistoryQuery(void *pArg)
 {
-    int retVal;
-
-    struct iovec ioVector;
-    struct msghdr msgHdr;
+    QueryContext_t *pContext = (QueryContext_t *)pArg;
 
-    if (sock <= 0)
-    {
-        printf("ERROR - %s:%d :: Invalid input socket (%d) information\n",
-                __func__, __LINE__,
-                sock);
-        return -1;
-    }
+    ComChan_Message_t     memWatcherMsg;
+    ComChan_ClientStats_t clientStats;
 
-    if ( (pDstAddr  == NULL) ||
-         (pNLMsgHdr == NULL) ||
-         (pMessage  == NULL) )
-    {
-        printf("ERROR - %s:%d :: Invalid input pointer arguments (%p, %p, %p)\n",
-                __func__, __LINE__,
-                pDstAddr, pNLMsgHdr,
-                pMessage);
-        return -1;
-    }
-
-    /* Copy message to netlink buffer */
-    memcpy(NLMSG_DATA(pNLMsgHdr), pMessage, sizeof(ComChan_Message_t));
+    /* Populate message for latest history window */
+    memset(&memWatcherMsg, 0x00, sizeof(ComChan_Message_t));
+    memWatcherMsg.serviceSig        = COM_NETLINK_DW_SIG;
+    memWatcherMsg.resourceInfoID    = HISTORY_RESOURCE_INFO;
+    memWatcherMsg.flags             = COM_CHAN_PRIO_BULK;
 
-    /* Reset I/O vector and message header */
-    memset(&ioVector, 0x00, sizeof(ioVector));
-    memset(&msgHdr,   0x00, sizeof(msgHdr));
+    memWatcherMsg.res_info.historyInfo.metricID   = RW_METRIC_DISK_FREE;
+    memWatcherMsg.res_info.historyInfo.resolution = RW_HISTORY_RES_10S;
+    memWatcherMsg.res_info.historyInfo.startTime  = 0;
+    memWatcherMsg.res_info.historyInfo.nPoints    = RW_HISTORY_MAX_POINTS;
 
-    /* Populate I/O vector information */
-    ioVector.iov_base = (void *)pNLMsgHdr;
-    ioVector.iov_len = pNLMsgHdr->nlmsg_len;
+    /* Send history query message */
+    submitComChanQuery(pContext->pClient, &memWatcherMsg, handleHistoryReply, NULL);
 
-    /* Populate message header */
-    msgHdr.msg_name = (void *)pDstAddr;
-    msgHdr.msg_namelen = sizeof(struct sockaddr_nl);
-    msgHdr.msg_iov = &ioVector;
-    msgHdr.msg_iovlen = 1;                          // Single I/O vector
+    /* Report query schedules precision along with history */
+    printQueryStats(pContext->pWheel, pContext->renewTimerID,    "Subscription Renewal");
+    printQueryStats(pContext->pWheel, pContext->historyTimerID,  "History Query");
 
-    retVal = sendmsg(sock, &msgHdr, 0);
-    if (retVal < 0)
+    /* Report where replies spend their time between query and reply */
+    if (getComChanClientStats(pContext->pClient, &clientStats) == 0)
     {
-        printf("ERROR - %s:%d :: Failed to transmit message on socket (%d) [%m]\n",
-                __func__, __LINE__,
-                sock);
+        printComChanStages(&clientStats.stages, "Disk Watcher");
     }
-
-    return retVal;
 }
 
 
@@ -373,26 +217,31 @@ static int sendMessage(const int                 sock,
 //*************************************
 int main(__attribute__((unused)) int argc, __attribute__((unused)) char **args)
 {
-    int64_t queryTimeout;
     unsigned char MW_SERVICE_RUNNING = 0x01;
 
-    struct nlmsghdr *pNLMsgHdr;
+    ComChan_Client_t *pClient;
+
+    TW_TimerWheel_t *pWheel;
+    QueryContext_t queryContext;
 
-    int epollFD, sock, nEvents;
-    struct sockaddr_nl srcAddr, dstAddr;
+    int epollFD, nEvents;
     struct epoll_event epollEvents[MAX_EPOLL_EVENTS];
 
-    ComChan_Message_t memWatcherMsg;
+    /* Errors and warnings are written by log thread */
+    if (startComChanLog(STDOUT_FILENO) < 0) { return EXIT_FAILURE; }
 
-    /* Initialize netlink socket */
-    sock = createNLSocket(&srcAddr, &dstAddr);
-    if (sock <= 0) { return EXIT_FAILURE; }
+    /* Create asynchronous query client */
+    pClient = createComChanClient(COM_NETLINK_DW_SIG, QUERY_MAX_OUTSTANDING, (QUERY_REPLY_TIMEOUT * TW_NSEC_PER_SEC));
+    if (pClient == NULL) { return EXIT_FAILURE; }
 
-    /* Create netlink message header */
-    pNLMsgHdr = createNLMsgHdr(COM_NETLINK_MAX_PAYLOAD);
-    if (pNLMsgHdr == NULL)
+    /* Disk information is pushed by resource watcher */
+    setComChanPushHandler(pClient, handleDiskPush, NULL);
+
+    /* Create query schedules timer wheel */
+    pWheel = createTimerWheel(QUERY_SCHEDULES_MAX);
+    if (pWheel == NULL)
     {
-        destroyNLSocket(sock);
+        destroyComChanClient(pClient);
         return EXIT_FAILURE;
     }
 
@@ -400,100 +249,84 @@ int main(__attribute__((unused)) int argc, __attribute__((unused)) char **args)
     epollFD = epoll_create1(0);
     if (epollFD < 0)
     {
-        printf("ERROR - %s:%d :: Failed to create epoll [%m]\n", __func__, __LINE__);
+        LOG_ERROR("Failed to create epoll [%m]");
 
-        destroyNLMsgHdr(pNLMsgHdr);
-        destroyNLSocket(sock);
+        destroyTimerWheel(pWheel);
+        destroyComChanClient(pClient);
         return EXIT_FAILURE;
     }
 
-    /* Register netlink socket for events polling */
-    if (registerEvent(epollFD, sock) < 0)
+    /* Register query client and query schedules for events polling */
+    if ( (registerEvent(epollFD, getComChanClientFD(pClient)) < 0) ||
+         (registerEvent(epollFD, getTimerWheelFD(pWheel)) < 0) )
     {
-        destroyNLMsgHdr(pNLMsgHdr);
-        destroyNLSocket(sock);
+        destroyTimerWheel(pWheel);
+        destroyComChanClient(pClient);
         close(epollFD);
         return EXIT_FAILURE;
     }
 
 
-    /* Populate message for service information */
-    memWatcherMsg.serviceSig        = COM_NETLINK_DW_SIG;
-    memWatcherMsg.resourceInfoID    = SERVICE_RESOURCE_INFO;
-    memWatcherMsg.flags             = 0;
-
-    memWatcherMsg.res_info.serviceInfo.servicePID = getpid();
-    strncpy(memWatcherMsg.res_info.serviceInfo.serviceHostIP4, "127.0.0.1", strlen("127.0.0.1"));
-
     /* Send service information message */
-    if (sendMessage(sock, &dstAddr, pNLMsgHdr, &memWatcherMsg) <= 0)
+    if (registerComChanClient(pClient, "127.0.0.1") < 0)
     {
-        destroyNLMsgHdr(pNLMsgHdr);
-        destroyNLSocket(sock);
+        destroyTimerWheel(pWheel);
+        destroyComChanClient(pClient);
         close(epollFD);
         return EXIT_FAILURE;
     }
 
 
-    /* Initialize resource query timeout */
-    queryTimeout = _GetCurrentTime();
+    /* Subscribe right away, renew periodically, schedule history queries after first window */
+    queryContext.pClient = pClient;
+    queryContext.pWheel  = pWheel;
+
+    queryContext.renewTimerID    = addTimer(pWheel, 0, (SUBSCRIPTION_RENEW_TIMEOUT * TW_NSEC_PER_SEC),
+                                            renewSubscription, &queryContext);
+    queryContext.historyTimerID  = addTimer(pWheel, (HISTORY_QUERY_TIMEOUT * TW_NSEC_PER_SEC),
+                                            (HISTORY_QUERY_TIMEOUT * TW_NSEC_PER_SEC),
+                                            sendHistoryQuery, &queryContext);
 
     /* Resource watcher business logic */
     while (MW_SERVICE_RUNNING)
     {
-        if (queryTimeout < _GetCurrentTime())
-        {
-            /* Populate message for service information */
-            memset(&memWatcherMsg, 0x00, sizeof(ComChan_Message_t));
-            memWatcherMsg.serviceSig        = COM_NETLINK_DW_SIG;
-            memWatcherMsg.resourceInfoID    = DISK_RESOURCE_INFO;
-            memWatcherMsg.flags             = 0;
-
-            /* Send service information message */
-            sendMessage(sock, &dstAddr, pNLMsgHdr, &memWatcherMsg);
-
-            queryTimeout = _GetCurrentTime() + RESOURCE_QUERY_TIMEOUT;
-        }
-
         /* Wait for events */
         nEvents = epoll_wait(epollFD, epollEvents, MAX_EPOLL_EVENTS, (EPOLL_EVENTS_TIMEOUT * 1000));
 
         /* Process events */
         while (nEvents > 0)
         {
-            if (epollEvents[(nEvents - 1)].data.fd == sock)
+            if (epollEvents[(nEvents - 1)].data.fd == getComChanClientFD(pClient))
             {
-                if (epollEvents[(nEvents - 1)].events & EPOLLIN)
+                /* Complete queries with received replies, expire overdue ones */
+                if (handleComChanClient(pClient) < 0)
                 {
-                    /* Read message on netlink socket */
-                    if (handleResponseMsg(sock, pNLMsgHdr) < 0)
-                    {
-                        MW_SERVICE_RUNNING = 0;
-                        break;
-                    }
-                }
-                else if (epollEvents[(nEvents - 1)].events & (EPOLLERR | EPOLLHUP))
-                {
-                    /* Error event detected on netlink socket */
                     MW_SERVICE_RUNNING = 0;
                     break;
                 }
             }
+            else if (epollEvents[(nEvents - 1)].data.fd == getTimerWheelFD(pWheel))
+            {
+                /* Run due query schedules */
+                handleTimerWheel(pWheel);
+            }
 
             nEvents--;
         }
+
+        /* Transmit queries submitted by schedules */
+        flushComChanClient(pClient);
     }
 
 
-    /* Destroy netlink message header */
-    destroyNLMsgHdr(pNLMsgHdr);
+    /* Destroy query schedules */
+    destroyTimerWheel(pWheel);
 
-    /* Destroy netlink socket */
-    destroyNLSocket(sock);
+    /* Destroy query client */
+    destroyComChanClient(pClient);
 
     /* Close polling descriptor */
     if (epollFD > 0) { close(epollFD); }
 
     return EXIT_SUCCESS;
 }
-
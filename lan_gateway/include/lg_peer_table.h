@@ -0,0 +1,74 @@
+/**
+ * @file    lg_peer_table.h
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  LAN gateway peer table; discovered gateways with their
+ * round trip estimate and latest cluster query answer.
+ */
+
+#ifndef LG_PEER_TABLE_H_
+#define LG_PEER_TABLE_H_
+
+// Library Includes
+#include <stdint.h>
+
+#include <netinet/in.h>
+
+// Module Includes
+#include "lg_proto.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define LG_PEERS_MAX            64          // Upper bound of known peers
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+enum
+{
+    LG_PEER_IDLE,                               ///< Not part of current round
+    LG_PEER_PENDING,                            ///< Queried, waiting within deadline
+    LG_PEER_ANSWERED,                           ///< Answered within deadline
+    LG_PEER_TIMEOUT,                            ///< Deadline passed without answer
+};
+
+typedef struct LG_Peer_s
+{
+    struct sockaddr_in      addr;               ///< Gateway address, AF_UNSPEC if slot is free
+    uint32_t                gatewayID;          ///< Gateway instance identifier
+    char                    hostName[LG_HOST_NAME_MAX]; ///< Gateway host name
+
+    int64_t                 lastSeenNs;         ///< Last message received (monotonic ns)
+    int64_t                 srttNs;             ///< Smoothed round trip time, 0 until first answer
+    int64_t                 rttNs;              ///< Round trip time of latest answer
+
+    uint32_t                roundID;            ///< Round of status and summary
+    int                     status;             ///< Round status (LG_PEER_*)
+    int                     deadlineTimerID;    ///< Round deadline schedule, -1 if not armed
+
+    RW_MultiInfo_t          summary;            ///< Latest answered summary
+} LG_Peer_t;
+
+typedef struct LG_PeerTable_s LG_PeerTable_t;
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+LG_PeerTable_t* createPeerTable(uint32_t maxPeers);
+int destroyPeerTable(LG_PeerTable_t *pTable);
+
+LG_Peer_t* findPeer(LG_PeerTable_t *pTable, const struct sockaddr_in *pAddr);
+LG_Peer_t* addPeer(LG_PeerTable_t *pTable, const struct sockaddr_in *pAddr);
+LG_Peer_t* getPeer(LG_PeerTable_t *pTable, uint32_t slot);
+
+uint32_t getPeerSlots(const LG_PeerTable_t *pTable);
+uint32_t getPeerCount(const LG_PeerTable_t *pTable);
+
+int expirePeers(LG_PeerTable_t *pTable, int64_t expireNs);
+
+#endif /* LG_PEER_TABLE_H_ */
@@ -0,0 +1,67 @@
+/**
+ * @file    lg_proto.h
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  LAN gateway wire protocol; datagram layout shared by
+ * gateways for peer discovery and cluster-wide queries.
+ */
+
+#ifndef LG_PROTO_H_
+#define LG_PROTO_H_
+
+// Library Includes
+#include <stdint.h>
+
+// Module Includes
+#include "com_chan_proto.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define LG_PROTO_MAGIC          0x4C475731  // "LGW1", byte swapped on hosts of other byte order
+#define LG_DEFAULT_PORT         7031        // Gateway UDP port
+
+#define LG_HOST_NAME_MAX        32          // Host name bytes carried per message
+#define LG_PEERS_PER_MESSAGE    16          // Known peers gossiped per hello message
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+enum
+{
+    LG_MSG_HELLO,                               ///< Discovery announcement, carries known peers
+    LG_MSG_QUERY,                               ///< Cluster query for host resource summary
+    LG_MSG_REPLY,                               ///< Host resource summary
+};
+
+typedef struct LG_PeerAddr_s
+{
+    uint32_t                addr4;              ///< IPv4 address (network byte order)
+    uint16_t                port;               ///< UDP port (network byte order)
+    uint16_t                reserved;           ///< Reserved (alignment)
+} LG_PeerAddr_t;
+
+typedef struct LG_Message_s
+{
+    uint32_t                magic;              ///< Protocol magic (LG_PROTO_MAGIC)
+    uint16_t                msgType;            ///< Message type (LG_MSG_*)
+    uint16_t                nPeers;             ///< Hello: peers carried
+
+    uint32_t                gatewayID;          ///< Sender gateway instance identifier
+    uint32_t                roundID;            ///< Query round, echoed in reply
+
+    int64_t                 sendTime;           ///< Query send time (querier clock), echoed in reply
+
+    char                    hostName[LG_HOST_NAME_MAX]; ///< Sender host name
+
+    union
+    {
+        LG_PeerAddr_t       peers[LG_PEERS_PER_MESSAGE]; ///< Hello: known peers
+        RW_MultiInfo_t      summary;            ///< Reply: host disk, memory and CPU sections
+    } body;
+} LG_Message_t;
+
+#endif /* LG_PROTO_H_ */
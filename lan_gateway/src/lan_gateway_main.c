@@ -0,0 +1,1045 @@
+/**
+ * @file    lan_gateway_main.c
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  LAN aggregation gateway; discovers peer gateways over
+ * UDP, fans cluster queries out to all hosts in parallel with
+ * per-host deadlines and merges answers into one cluster view.
+ */
+
+
+// Library Includes
+#define _GNU_SOURCE                         // recvmmsg(), sendmmsg()
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+#include <sys/types.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// Module Includes
+#include "com_chan_client.h"
+#include "com_chan_socket.h"
+#include "com_chan_sysinfo.h"
+#include "com_chan_timer_wheel.h"
+#include "lg_peer_table.h"
+#include "lg_proto.h"
+#include "com_chan_log.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define MAX_EPOLL_EVENTS        3
+#define EPOLL_EVENTS_TIMEOUT    10          // Seconds
+
+#define GATEWAY_OPTIONS         "l:p:bc:t:nh"
+#define GATEWAY_SCHEDULES_MAX   (LG_PEERS_MAX + 4) // Per-peer deadlines, hello, cluster query, local summary
+
+#define SEED_PEERS_MAX          16          // Peers configured from command line
+#define SELF_ADDRS_MAX          4           // Own addresses learned from looped back messages
+
+#define HELLO_PERIOD            5           // Seconds
+#define PEER_EXPIRY_PERIODS     3           // Hello periods of silence before peer is dropped
+
+#define CLUSTER_QUERY_PERIOD    10          // Seconds
+#define PEER_DEADLINE_MAX       500         // Milliseconds, deadline of peers without round trip estimate
+#define PEER_DEADLINE_MIN       5           // Milliseconds
+#define PEER_DEADLINE_RTT_MUL   4           // Deadline in smoothed round trips
+
+#define LOCAL_SUMMARY_PERIOD    1           // Seconds
+#define LOCAL_SUMMARY_MAX_AGE   3           // Seconds, older local summary is answered empty
+
+#define QUERY_MAX_OUTSTANDING   4           // Local summary queries in flight
+#define QUERY_REPLY_TIMEOUT     2           // Seconds
+
+#define UDP_MSG_BATCH           16          // Datagrams per recvmmsg call
+
+#define GATEWAY_SUMMARY_MASK    (RW_RESOURCE_MASK(DISK_RESOURCE_INFO)   | \
+                                 RW_RESOURCE_MASK(MEMORY_RESOURCE_INFO) | \
+                                 RW_RESOURCE_MASK(CPU_RESOURCE_INFO))
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+typedef struct GatewayContext_s
+{
+    int                     sock;               ///< UDP socket, discovery and cluster queries
+    uint32_t                gatewayID;          ///< Gateway instance identifier
+    char                    hostName[LG_HOST_NAME_MAX]; ///< Host name sent with every message
+
+    LG_PeerTable_t         *pPeers;             ///< Discovered gateways
+    TW_TimerWheel_t        *pWheel;             ///< Hello, query, deadline and local summary schedules
+    ComChan_Client_t       *pClient;            ///< Local summary client, NULL if collected directly
+
+    RW_MultiInfo_t          localSummary;       ///< Latest local host summary
+    int64_t                 localSummaryNs;     ///< Time local summary was collected, 0 if never
+
+    uint32_t                roundID;            ///< Current cluster query round
+    int64_t                 roundStartNs;       ///< Current round fan out time
+    uint32_t                nPending;           ///< Peers of current round within deadline
+    uint32_t                nLate;              ///< Answers past peer deadline, all rounds
+} GatewayContext_t;
+
+typedef struct ClusterTotal_s
+{
+    uint32_t                nHosts;             ///< Hosts merged
+    uint32_t                resourceMask;       ///< Sections carried by at least one host
+
+    RW_DiskInfo_t           diskInfo;           ///< Summed disk section
+    RW_MemoryInfo_t         memoryInfo;         ///< Summed memory section
+
+    uint32_t                nCPUs;              ///< Summed CPUs
+    uint64_t                user;               ///< CPU weighted user time sum
+    uint64_t                system;             ///< CPU weighted system time sum
+    uint64_t                iowait;             ///< CPU weighted iowait time sum
+    uint64_t                steal;              ///< CPU weighted steal time sum
+} ClusterTotal_t;
+
+
+//*************************************
+// Module Utility Functions
+//*************************************
+static void collectLocalSummary(void *pArg);
+static void completeClusterQuery(void);
+static int createGatewaySocket(uint16_t port, unsigned char isBroadcast);
+static inline int64_t getMonotonicNs(void);
+static void handleGatewayHello(const struct sockaddr_in *pSrcAddr, const LG_Message_t *pMsg);
+static int handleGatewayMsgs(void);
+static void handleGatewayQuery(const struct sockaddr_in *pSrcAddr, const LG_Message_t *pMsg);
+static void handleGatewayReply(const struct sockaddr_in *pSrcAddr, const LG_Message_t *pMsg);
+static void handlePeerDeadline(void *pArg);
+static void handleSummaryReply(void *pArg, uint32_t seqID, const ComChan_Message_t *pReply);
+static void initGatewayMsg(LG_Message_t *pMsg, uint16_t msgType);
+static int isSelfAddr(const struct sockaddr_in *pAddr);
+static void mergeSummary(ClusterTotal_t *pTotal, const RW_MultiInfo_t *pSummary);
+static int parseGatewayOptions(int argc, char **args);
+static int parsePeerAddr(const char *pPeer, struct sockaddr_in *pAddr);
+static void printClusterTotal(const ClusterTotal_t *pTotal);
+static void printHostSummary(const char *pHostName, const char *pAddr, const char *pStatus, int64_t rttNs, const RW_MultiInfo_t *pSummary);
+static void printUsage(const char *pExecutable);
+static void runClusterQuery(void *pArg);
+static void sendGatewayHello(void *pArg);
+static int sendGatewayMsg(const struct sockaddr_in *pDstAddr, const LG_Message_t *pMsg);
+static LG_Peer_t* updatePeer(const struct sockaddr_in *pSrcAddr, const LG_Message_t *pMsg);
+
+
+//*************************************
+// Module Local Variables
+//*************************************
+static GatewayContext_t gatewayContext;
+
+static uint16_t listenPort    = LG_DEFAULT_PORT;
+static uint32_t queryPeriod   = CLUSTER_QUERY_PERIOD;
+static uint32_t deadlineMaxMs = PEER_DEADLINE_MAX;
+
+static unsigned char isBroadcast     = 0x00;
+static unsigned char isDirectSummary = 0x00;
+
+static struct sockaddr_in seedPeers[SEED_PEERS_MAX];
+static uint32_t nSeedPeers = 0;
+
+static struct sockaddr_in selfAddrs[SELF_ADDRS_MAX];
+static uint32_t nSelfAddrs = 0;
+
+
+static void collectLocalSummary(__attribute__((unused)) void *pArg)
+{
+    ComChan_Message_t summaryQuery;
+
+    if (gatewayContext.pClient != NULL)
+    {
+        /* Disk, memory and CPU sections in one relay round trip */
+        memset(&summaryQuery, 0x00, sizeof(ComChan_Message_t));
+        summaryQuery.serviceSig                      = COM_NETLINK_LG_SIG;
+        summaryQuery.resourceInfoID                  = MULTI_RESOURCE_INFO;
+        summaryQuery.res_info.multiInfo.resourceMask = GATEWAY_SUMMARY_MASK;
+
+        submitComChanQuery(gatewayContext.pClient, &summaryQuery, handleSummaryReply, NULL);
+        return;
+    }
+
+    /* Collect disk and memory sections in place, CPU utilisation needs resource watcher sampling */
+    gatewayContext.localSummary.resourceMask = 0;
+
+    if (getDiskMemoryInfo(&gatewayContext.localSummary.diskInfo) == 0)
+    {
+        gatewayContext.localSummary.resourceMask |= RW_RESOURCE_MASK(DISK_RESOURCE_INFO);
+    }
+
+    if (getSystemMemoryInfo(&gatewayContext.localSummary.memoryInfo) == 0)
+    {
+        gatewayContext.localSummary.resourceMask |= RW_RESOURCE_MASK(MEMORY_RESOURCE_INFO);
+    }
+
+    gatewayContext.localSummaryNs = getMonotonicNs();
+}
+
+static void completeClusterQuery(void)
+{
+    uint32_t slot;
+    int64_t  elapsedNs = getMonotonicNs() - gatewayContext.roundStartNs;
+
+    char addrStr[INET_ADDRSTRLEN + 8];
+
+    LG_Peer_t *pPeer;
+    ClusterTotal_t clusterTotal;
+
+    static const char *pPeerStatus[] = { "idle", "pending", "ok", "timeout" };
+
+    memset(&clusterTotal, 0x00, sizeof(ClusterTotal_t));
+
+    printf("Cluster View (round %u | %u peers | settled in %ld us | %u late answers)\n",
+            gatewayContext.roundID,
+            getPeerCount(gatewayContext.pPeers),
+            (elapsedNs / 1000), gatewayContext.nLate);
+
+    /* Local host answers from its own summary */
+    if ( (gatewayContext.localSummaryNs > 0) &&
+         ((getMonotonicNs() - gatewayContext.localSummaryNs) <= (LOCAL_SUMMARY_MAX_AGE * TW_NSEC_PER_SEC)) )
+    {
+        printHostSummary(gatewayContext.hostName, "local", "ok", 0, &gatewayContext.localSummary);
+        mergeSummary(&clusterTotal, &gatewayContext.localSummary);
+    }
+
+    /* Merge peers answered within their deadline */
+    for (slot = 0; slot < getPeerSlots(gatewayContext.pPeers); slot++)
+    {
+        pPeer = getPeer(gatewayContext.pPeers, slot);
+
+        if ( (pPeer == NULL) ||
+             (pPeer->roundID != gatewayContext.roundID) )
+        {
+            continue;
+        }
+
+        snprintf(addrStr, sizeof(addrStr), "%s:%u",
+                 inet_ntoa(pPeer->addr.sin_addr), ntohs(pPeer->addr.sin_port));
+
+        printHostSummary(pPeer->hostName, addrStr, pPeerStatus[pPeer->status],
+                         ((pPeer->status == LG_PEER_ANSWERED) ? pPeer->rttNs : 0),
+                         ((pPeer->status == LG_PEER_ANSWERED) ? &pPeer->summary : NULL));
+
+        if (pPeer->status == LG_PEER_ANSWERED) { mergeSummary(&clusterTotal, &pPeer->summary); }
+    }
+
+    printClusterTotal(&clusterTotal);
+}
+
+static int createGatewaySocket(uint16_t port, unsigned char isBroadcast)
+{
+    int sock, optVal = 1;
+    struct sockaddr_in srcAddr;
+
+    /* Create non-blocking UDP socket, drained in batches on readiness */
+    sock = socket(AF_INET, (SOCK_DGRAM | SOCK_NONBLOCK), 0);
+    if (sock < 0)
+    {
+        LOG_ERROR("Failed to create gateway socket [%m]");
+        return -1;
+    }
+
+    if ( (isBroadcast) &&
+         (setsockopt(sock, SOL_SOCKET, SO_BROADCAST, &optVal, sizeof(optVal)) < 0) )
+    {
+        LOG_ERROR("Failed to enable broadcast [%m]");
+        close(sock);
+        return -1;
+    }
+
+    memset(&srcAddr, 0x00, sizeof(struct sockaddr_in));
+    srcAddr.sin_family      = AF_INET;
+    srcAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    srcAddr.sin_port        = htons(port);
+
+    if (bind(sock, (struct sockaddr *)&srcAddr, sizeof(struct sockaddr_in)) < 0)
+    {
+        LOG_ERROR("Failed to bind gateway port %u [%m]",
+                  port);
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+static inline int64_t getMonotonicNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((int64_t)ts.tv_sec * TW_NSEC_PER_SEC) + ts.tv_nsec;
+}
+
+static void handleGatewayHello(const struct sockaddr_in *pSrcAddr, const LG_Message_t *pMsg)
+{
+    uint16_t peer;
+    unsigned char isNewPeer = (findPeer(gatewayContext.pPeers, pSrcAddr) == NULL) ? 0x01 : 0x00;
+
+    LG_Message_t helloMsg;
+    struct sockaddr_in peerAddr;
+
+    if (updatePeer(pSrcAddr, pMsg) == NULL) { return; }
+
+    /* Announce ourselves back to newly discovered gateway right away */
+    if (isNewPeer)
+    {
+        initGatewayMsg(&helloMsg, LG_MSG_HELLO);
+        sendGatewayMsg(pSrcAddr, &helloMsg);
+    }
+
+    /* Probe gossiped gateways not known yet, they become peers once they answer */
+    memset(&peerAddr, 0x00, sizeof(struct sockaddr_in));
+    peerAddr.sin_family = AF_INET;
+
+    for (peer = 0; (peer < pMsg->nPeers) && (peer < LG_PEERS_PER_MESSAGE); peer++)
+    {
+        peerAddr.sin_addr.s_addr = pMsg->body.peers[peer].addr4;
+        peerAddr.sin_port        = pMsg->body.peers[peer].port;
+
+        if ( (isSelfAddr(&peerAddr)) ||
+             (findPeer(gatewayContext.pPeers, &peerAddr) != NULL) )
+        {
+            continue;
+        }
+
+        initGatewayMsg(&helloMsg, LG_MSG_HELLO);
+        sendGatewayMsg(&peerAddr, &helloMsg);
+    }
+}
+
+static int handleGatewayMsgs(void)
+{
+    int nMessages, msg;
+
+    LG_Message_t       rxMsgs[UDP_MSG_BATCH];
+    struct sockaddr_in rxAddrs[UDP_MSG_BATCH];
+    struct iovec       ioVectors[UDP_MSG_BATCH];
+    struct mmsghdr     msgHdrs[UDP_MSG_BATCH];
+
+    while (1)
+    {
+        /* Prepare receive batch, address length is overwritten by every receive */
+        memset(msgHdrs, 0x00, sizeof(msgHdrs));
+
+        for (msg = 0; msg < UDP_MSG_BATCH; msg++)
+        {
+            ioVectors[msg].iov_base          = &rxMsgs[msg];
+            ioVectors[msg].iov_len           = sizeof(LG_Message_t);
+            msgHdrs[msg].msg_hdr.msg_iov     = &ioVectors[msg];
+            msgHdrs[msg].msg_hdr.msg_iovlen  = 1;
+            msgHdrs[msg].msg_hdr.msg_name    = &rxAddrs[msg];
+            msgHdrs[msg].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        }
+
+        nMessages = recvmmsg(gatewayContext.sock, msgHdrs, UDP_MSG_BATCH, MSG_DONTWAIT, NULL);
+        if (nMessages < 0)
+        {
+            if ( (errno == EAGAIN) || (errno == EWOULDBLOCK) ) { return 0; }
+
+            LOG_ERROR("Failed to receive gateway messages [%m]");
+            return -1;
+        }
+
+        for (msg = 0; msg < nMessages; msg++)
+        {
+            /* Drop foreign datagrams, truncated messages and other byte order gateways */
+            if ( (msgHdrs[msg].msg_len != sizeof(LG_Message_t)) ||
+                 (rxMsgs[msg].magic != LG_PROTO_MAGIC) )
+            {
+                continue;
+            }
+
+            /* Own messages looped back (broadcast, gossip) reveal own addresses */
+            if (rxMsgs[msg].gatewayID == gatewayContext.gatewayID)
+            {
+                if ( (!isSelfAddr(&rxAddrs[msg])) &&
+                     (nSelfAddrs < SELF_ADDRS_MAX) )
+                {
+                    memcpy(&selfAddrs[nSelfAddrs++], &rxAddrs[msg], sizeof(struct sockaddr_in));
+                }
+                continue;
+            }
+
+            rxMsgs[msg].hostName[(LG_HOST_NAME_MAX - 1)] = '\0';
+
+            switch (rxMsgs[msg].msgType)
+            {
+                case LG_MSG_HELLO: { handleGatewayHello(&rxAddrs[msg], &rxMsgs[msg]); break; }
+                case LG_MSG_QUERY: { handleGatewayQuery(&rxAddrs[msg], &rxMsgs[msg]); break; }
+                case LG_MSG_REPLY: { handleGatewayReply(&rxAddrs[msg], &rxMsgs[msg]); break; }
+            }
+        }
+
+        if (nMessages < UDP_MSG_BATCH) { return 0; }
+    }
+}
+
+static void handleGatewayQuery(const struct sockaddr_in *pSrcAddr, const LG_Message_t *pMsg)
+{
+    LG_Message_t replyMsg;
+
+    /* Querying gateway is a peer as well */
+    updatePeer(pSrcAddr, pMsg);
+
+    /* Answer right away from latest local summary, empty if it is too old */
+    initGatewayMsg(&replyMsg, LG_MSG_REPLY);
+    replyMsg.roundID  = pMsg->roundID;
+    replyMsg.sendTime = pMsg->sendTime;
+
+    if ( (gatewayContext.localSummaryNs > 0) &&
+         ((getMonotonicNs() - gatewayContext.localSummaryNs) <= (LOCAL_SUMMARY_MAX_AGE * TW_NSEC_PER_SEC)) )
+    {
+        memcpy(&replyMsg.body.summary, &gatewayContext.localSummary, sizeof(RW_MultiInfo_t));
+    }
+
+    sendGatewayMsg(pSrcAddr, &replyMsg);
+}
+
+static void handleGatewayReply(const struct sockaddr_in *pSrcAddr, const LG_Message_t *pMsg)
+{
+    LG_Peer_t *pPeer = updatePeer(pSrcAddr, pMsg);
+
+    if (pPeer == NULL) { return; }
+
+    /* Round trip estimate adapts peer deadline, late answers count as well */
+    pPeer->rttNs  = getMonotonicNs() - pMsg->sendTime;
+    pPeer->srttNs = (pPeer->srttNs == 0) ? pPeer->rttNs : (((pPeer->srttNs * 7) + pPeer->rttNs) / 8);
+
+    if ( (pMsg->roundID    != gatewayContext.roundID) ||
+         (pPeer->roundID   != gatewayContext.roundID) )
+    {
+        return;
+    }
+
+    if (pPeer->status == LG_PEER_TIMEOUT)
+    {
+        gatewayContext.nLate++;
+        return;
+    }
+
+    if (pPeer->status != LG_PEER_PENDING) { return; }
+
+    memcpy(&pPeer->summary, &pMsg->body.summary, sizeof(RW_MultiInfo_t));
+    pPeer->status = LG_PEER_ANSWERED;
+
+    cancelTimer(gatewayContext.pWheel, pPeer->deadlineTimerID);
+    pPeer->deadlineTimerID = -1;
+
+    /* Round completes with last answer, no need to wait for slowest deadline */
+    if (--gatewayContext.nPending == 0) { completeClusterQuery(); }
+}
+
+static void handlePeerDeadline(void *pArg)
+{
+    LG_Peer_t *pPeer = (LG_Peer_t *)pArg;
+
+    pPeer->deadlineTimerID = -1;
+
+    if (pPeer->status != LG_PEER_PENDING) { return; }
+
+    pPeer->status = LG_PEER_TIMEOUT;
+
+    if (--gatewayContext.nPending == 0) { completeClusterQuery(); }
+}
+
+static void handleSummaryReply(__attribute__((unused)) void *pArg, uint32_t seqID, const ComChan_Message_t *pReply)
+{
+    if (pReply == NULL)
+    {
+        LOG_WARNING("Local summary query %u expired without reply",
+                    seqID);
+        return;
+    }
+
+    memcpy(&gatewayContext.localSummary, &pReply->res_info.multiInfo, sizeof(RW_MultiInfo_t));
+    gatewayContext.localSummaryNs = getMonotonicNs();
+}
+
+static void initGatewayMsg(LG_Message_t *pMsg, uint16_t msgType)
+{
+    memset(pMsg, 0x00, sizeof(LG_Message_t));
+
+    pMsg->magic     = LG_PROTO_MAGIC;
+    pMsg->msgType   = msgType;
+    pMsg->gatewayID = gatewayContext.gatewayID;
+
+    memcpy(pMsg->hostName, gatewayContext.hostName, LG_HOST_NAME_MAX);
+}
+
+static int isSelfAddr(const struct sockaddr_in *pAddr)
+{
+    uint32_t idx;
+
+    for (idx = 0; idx < nSelfAddrs; idx++)
+    {
+        if ( (selfAddrs[idx].sin_addr.s_addr == pAddr->sin_addr.s_addr) &&
+             (selfAddrs[idx].sin_port        == pAddr->sin_port) )
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void mergeSummary(ClusterTotal_t *pTotal, const RW_MultiInfo_t *pSummary)
+{
+    pTotal->nHosts++;
+    pTotal->resourceMask |= pSummary->resourceMask;
+
+    if (pSummary->resourceMask & RW_RESOURCE_MASK(DISK_RESOURCE_INFO))
+    {
+        pTotal->diskInfo.systemMemory += pSummary->diskInfo.systemMemory;
+        pTotal->diskInfo.freeMemory   += pSummary->diskInfo.freeMemory;
+    }
+
+    if (pSummary->resourceMask & RW_RESOURCE_MASK(MEMORY_RESOURCE_INFO))
+    {
+        pTotal->memoryInfo.systemMemory += pSummary->memoryInfo.systemMemory;
+        pTotal->memoryInfo.freeMemory   += pSummary->memoryInfo.freeMemory;
+    }
+
+    /* Cluster utilisation weighs every host by its CPUs */
+    if (pSummary->resourceMask & RW_RESOURCE_MASK(CPU_RESOURCE_INFO))
+    {
+        pTotal->nCPUs  += pSummary->cpuInfo.nCPUs;
+        pTotal->user   += ((uint64_t)pSummary->cpuInfo.aggregate.user   * pSummary->cpuInfo.nCPUs);
+        pTotal->system += ((uint64_t)pSummary->cpuInfo.aggregate.system * pSummary->cpuInfo.nCPUs);
+        pTotal->iowait += ((uint64_t)pSummary->cpuInfo.aggregate.iowait * pSummary->cpuInfo.nCPUs);
+        pTotal->steal  += ((uint64_t)pSummary->cpuInfo.aggregate.steal  * pSummary->cpuInfo.nCPUs);
+    }
+}
+
+static int parseGatewayOptions(int argc, char **args)
+{
+    int option;
+
+    char *pEnd;
+    unsigned long value;
+
+    while ((option = getopt(argc, args, GATEWAY_OPTIONS)) != -1)
+    {
+        switch (option)
+        {
+            case 'b': { isBroadcast     = 0x01; continue; }
+            case 'n': { isDirectSummary = 0x01; continue; }
+
+            case 'p':
+            {
+                if (nSeedPeers == SEED_PEERS_MAX)
+                {
+                    LOG_ERROR("Too many seed peers (%u)",
+                              SEED_PEERS_MAX);
+                    return -1;
+                }
+
+                if (parsePeerAddr(optarg, &seedPeers[nSeedPeers]) < 0) { return -1; }
+
+                nSeedPeers++;
+                continue;
+            }
+
+            case 'l':
+            case 'c':
+            case 't':
+            {
+                errno = 0;
+                value = strtoul(optarg, &pEnd, 10);
+
+                if ( (errno != 0) ||
+                     (*pEnd != '\0') ||
+                     (value > UINT32_MAX) ||
+                     ((option == 'l') && ((value == 0) || (value > UINT16_MAX))) ||
+                     ((option == 't') && (value < PEER_DEADLINE_MIN)) )
+                {
+                    LOG_ERROR("Invalid value '%s' for option -%c",
+                              optarg, option);
+                    return -1;
+                }
+
+                if      (option == 'l') { listenPort    = (uint16_t)value; }
+                else if (option == 'c') { queryPeriod   = (uint32_t)value; }
+                else                    { deadlineMaxMs = (uint32_t)value; }
+                continue;
+            }
+        }
+
+        printUsage(args[0]);
+        return -1;
+    }
+
+    /* Round must settle before next one starts */
+    if ( (queryPeriod > 0) &&
+         (deadlineMaxMs >= (queryPeriod * 1000)) )
+    {
+        LOG_ERROR("Peer deadline %u ms must be shorter than query period %u s",
+                  deadlineMaxMs, queryPeriod);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int parsePeerAddr(const char *pPeer, struct sockaddr_in *pAddr)
+{
+    char addrStr[INET_ADDRSTRLEN];
+    const char *pPort = strchr(pPeer, ':');
+
+    char *pEnd;
+    unsigned long port = LG_DEFAULT_PORT;
+
+    memset(pAddr, 0x00, sizeof(struct sockaddr_in));
+    pAddr->sin_family = AF_INET;
+
+    /* Peer is given as address[:port] */
+    if (pPort != NULL)
+    {
+        errno = 0;
+        port  = strtoul((pPort + 1), &pEnd, 10);
+
+        if ( (errno != 0) ||
+             (*pEnd != '\0') ||
+             (port == 0) ||
+             (port > UINT16_MAX) )
+        {
+            pPort = NULL;
+            port  = 0;
+        }
+    }
+
+    snprintf(addrStr, sizeof(addrStr), "%.*s",
+             (int)((pPort != NULL) ? (size_t)(pPort - pPeer) : strlen(pPeer)), pPeer);
+
+    if ( (port == 0) ||
+         (inet_pton(AF_INET, addrStr, &pAddr->sin_addr) != 1) )
+    {
+        LOG_ERROR("Invalid peer address '%s'",
+                  pPeer);
+        return -1;
+    }
+
+    pAddr->sin_port = htons((uint16_t)port);
+
+    return 0;
+}
+
+static void printClusterTotal(const ClusterTotal_t *pTotal)
+{
+    printf("Cluster Hosts (%u answered)\n", pTotal->nHosts);
+
+    if (pTotal->resourceMask & RW_RESOURCE_MASK(DISK_RESOURCE_INFO))
+    {
+        printf("Cluster Disk Information (%lu, %lu)\n",
+                pTotal->diskInfo.systemMemory,
+                pTotal->diskInfo.freeMemory);
+    }
+
+    if (pTotal->resourceMask & RW_RESOURCE_MASK(MEMORY_RESOURCE_INFO))
+    {
+        printf("Cluster Memory Information (%lu, %lu)\n",
+                pTotal->memoryInfo.systemMemory,
+                pTotal->memoryInfo.freeMemory);
+    }
+
+    if ( (pTotal->resourceMask & RW_RESOURCE_MASK(CPU_RESOURCE_INFO)) &&
+         (pTotal->nCPUs > 0) )
+    {
+        printf("Cluster CPU Information (%u CPUs | user %lu.%02lu%% | system %lu.%02lu%% | iowait %lu.%02lu%% | steal %lu.%02lu%%)\n",
+                pTotal->nCPUs,
+                ((pTotal->user   / pTotal->nCPUs) / 100), ((pTotal->user   / pTotal->nCPUs) % 100),
+                ((pTotal->system / pTotal->nCPUs) / 100), ((pTotal->system / pTotal->nCPUs) % 100),
+                ((pTotal->iowait / pTotal->nCPUs) / 100), ((pTotal->iowait / pTotal->nCPUs) % 100),
+                ((pTotal->steal  / pTotal->nCPUs) / 100), ((pTotal->steal  / pTotal->nCPUs) % 100));
+    }
+}
+
+static void printHostSummary(const char *pHostName, const char *pAddr, const char *pStatus, int64_t rttNs, const RW_MultiInfo_t *pSummary)
+{
+    printf("  Host %s %s (%s | rtt %ld us", pHostName, pAddr, pStatus, (rttNs / 1000));
+
+    if (pSummary != NULL)
+    {
+        if (pSummary->resourceMask & RW_RESOURCE_MASK(DISK_RESOURCE_INFO))
+        {
+            printf(" | disk %lu, %lu", pSummary->diskInfo.systemMemory, pSummary->diskInfo.freeMemory);
+        }
+
+        if (pSummary->resourceMask & RW_RESOURCE_MASK(MEMORY_RESOURCE_INFO))
+        {
+            printf(" | memory %lu, %lu", pSummary->memoryInfo.systemMemory, pSummary->memoryInfo.freeMemory);
+        }
+
+        if (pSummary->resourceMask & RW_RESOURCE_MASK(CPU_RESOURCE_INFO))
+        {
+            printf(" | %u CPUs", pSummary->cpuInfo.nCPUs);
+        }
+    }
+
+    printf(")\n");
+}
+
+static void printUsage(const char *pExecutable)
+{
+    printf("Usage: %s [options]\n", pExecutable);
+    printf("  -l <port>          Gateway UDP port (default %u)\n", LG_DEFAULT_PORT);
+    printf("  -p <addr[:port]>   Seed peer gateway, repeatable (up to %u)\n", SEED_PEERS_MAX);
+    printf("  -b                 Discover peer gateways by LAN broadcast\n");
+    printf("  -c <seconds>       Cluster query period (default %u, 0 only answers peers)\n", CLUSTER_QUERY_PERIOD);
+    printf("  -t <milliseconds>  Per-host deadline upper bound (default %u)\n", PEER_DEADLINE_MAX);
+    printf("  -n                 Collect local summary directly instead of through communication module\n");
+    printf("  -h                 Print this help\n");
+}
+
+static void runClusterQuery(__attribute__((unused)) void *pArg)
+{
+    int nSent;
+    uint32_t slot, nPeers = 0;
+    int64_t  deadlineNs, nowNs = getMonotonicNs();
+
+    LG_Peer_t     *pPeer;
+    LG_Message_t   queryMsg;
+    struct iovec   ioVector;
+    struct mmsghdr msgHdrs[LG_PEERS_MAX];
+
+    if (gatewayContext.nPending > 0)
+    {
+        LOG_WARNING("Round %u still waits on %u peers, round skipped",
+                    gatewayContext.roundID, gatewayContext.nPending);
+        return;
+    }
+
+    gatewayContext.roundID++;
+    gatewayContext.roundStartNs = nowNs;
+
+    /* One query message for all peers, send time is echoed back for round trip estimate */
+    initGatewayMsg(&queryMsg, LG_MSG_QUERY);
+    queryMsg.roundID  = gatewayContext.roundID;
+    queryMsg.sendTime = nowNs;
+
+    ioVector.iov_base = &queryMsg;
+    ioVector.iov_len  = sizeof(LG_Message_t);
+
+    memset(msgHdrs, 0x00, sizeof(msgHdrs));
+
+    for (slot = 0; slot < getPeerSlots(gatewayContext.pPeers); slot++)
+    {
+        pPeer = getPeer(gatewayContext.pPeers, slot);
+        if (pPeer == NULL) { continue; }
+
+        /* Deadline follows peer round trip, peers without estimate get upper bound */
+        deadlineNs = (int64_t)deadlineMaxMs * TW_NSEC_PER_MSEC;
+        if ( (pPeer->srttNs > 0) &&
+             ((pPeer->srttNs * PEER_DEADLINE_RTT_MUL) < deadlineNs) )
+        {
+            deadlineNs = pPeer->srttNs * PEER_DEADLINE_RTT_MUL;
+            if (deadlineNs < (PEER_DEADLINE_MIN * TW_NSEC_PER_MSEC)) { deadlineNs = (PEER_DEADLINE_MIN * TW_NSEC_PER_MSEC); }
+        }
+
+        pPeer->roundID         = gatewayContext.roundID;
+        pPeer->status          = LG_PEER_PENDING;
+        pPeer->deadlineTimerID = addTimer(gatewayContext.pWheel, deadlineNs, 0, handlePeerDeadline, pPeer);
+
+        if (pPeer->deadlineTimerID < 0)
+        {
+            pPeer->status = LG_PEER_TIMEOUT;
+            continue;
+        }
+
+        msgHdrs[nPeers].msg_hdr.msg_name    = &pPeer->addr;
+        msgHdrs[nPeers].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        msgHdrs[nPeers].msg_hdr.msg_iov     = &ioVector;
+        msgHdrs[nPeers].msg_hdr.msg_iovlen  = 1;
+        nPeers++;
+    }
+
+    gatewayContext.nPending = nPeers;
+
+    /* Scatter query to all peers at once, unsent peers are settled by their deadline */
+    for (slot = 0; slot < nPeers; slot += (uint32_t)nSent)
+    {
+        nSent = sendmmsg(gatewayContext.sock, &msgHdrs[slot], (nPeers - slot), 0);
+        if (nSent <= 0)
+        {
+            LOG_WARNING("Failed to send round %u query to %u peers [%m]",
+                        gatewayContext.roundID, (nPeers - slot));
+            break;
+        }
+    }
+
+    /* Local host only */
+    if (nPeers == 0) { completeClusterQuery(); }
+}
+
+static void sendGatewayHello(__attribute__((unused)) void *pArg)
+{
+    uint32_t slot, seed;
+    int64_t  nowNs = getMonotonicNs();
+
+    LG_Peer_t   *pPeer;
+    LG_Message_t helloMsg;
+    struct sockaddr_in broadcastAddr;
+
+    /* Drop silent peers between rounds, deadline schedules hold peer pointers */
+    if (gatewayContext.nPending == 0)
+    {
+        expirePeers(gatewayContext.pPeers, (nowNs - ((int64_t)HELLO_PERIOD * PEER_EXPIRY_PERIODS * TW_NSEC_PER_SEC)));
+    }
+
+    /* Gossip known peers, receivers probe the ones they don't know */
+    initGatewayMsg(&helloMsg, LG_MSG_HELLO);
+
+    for (slot = 0; slot < getPeerSlots(gatewayContext.pPeers); slot++)
+    {
+        pPeer = getPeer(gatewayContext.pPeers, slot);
+
+        if ( (pPeer == NULL) ||
+             (helloMsg.nPeers == LG_PEERS_PER_MESSAGE) )
+        {
+            continue;
+        }
+
+        helloMsg.body.peers[helloMsg.nPeers].addr4 = pPeer->addr.sin_addr.s_addr;
+        helloMsg.body.peers[helloMsg.nPeers].port  = pPeer->addr.sin_port;
+        helloMsg.nPeers++;
+    }
+
+    /* Known peers keep us alive in their tables */
+    for (slot = 0; slot < getPeerSlots(gatewayContext.pPeers); slot++)
+    {
+        pPeer = getPeer(gatewayContext.pPeers, slot);
+        if (pPeer != NULL) { sendGatewayMsg(&pPeer->addr, &helloMsg); }
+    }
+
+    for (seed = 0; seed < nSeedPeers; seed++)
+    {
+        if (findPeer(gatewayContext.pPeers, &seedPeers[seed]) == NULL)
+        {
+            sendGatewayMsg(&seedPeers[seed], &helloMsg);
+        }
+    }
+
+    if (isBroadcast)
+    {
+        memset(&broadcastAddr, 0x00, sizeof(struct sockaddr_in));
+        broadcastAddr.sin_family      = AF_INET;
+        broadcastAddr.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+        broadcastAddr.sin_port        = htons(listenPort);
+
+        sendGatewayMsg(&broadcastAddr, &helloMsg);
+    }
+}
+
+static int sendGatewayMsg(const struct sockaddr_in *pDstAddr, const LG_Message_t *pMsg)
+{
+    if (sendto(gatewayContext.sock, pMsg, sizeof(LG_Message_t), 0,
+               (const struct sockaddr *)pDstAddr, sizeof(struct sockaddr_in)) < 0)
+    {
+        LOG_WARNING("Failed to send message %u to %s:%u [%m]",
+                    pMsg->msgType,
+                    inet_ntoa(pDstAddr->sin_addr), ntohs(pDstAddr->sin_port));
+        return -1;
+    }
+
+    return 0;
+}
+
+static LG_Peer_t* updatePeer(const struct sockaddr_in *pSrcAddr, const LG_Message_t *pMsg)
+{
+    LG_Peer_t *pPeer = findPeer(gatewayContext.pPeers, pSrcAddr);
+
+    if (pPeer == NULL)
+    {
+        pPeer = addPeer(gatewayContext.pPeers, pSrcAddr);
+        if (pPeer == NULL) { return NULL; }
+
+        printf("Peer Gateway %s:%u (%s) discovered\n",
+                inet_ntoa(pSrcAddr->sin_addr), ntohs(pSrcAddr->sin_port),
+                pMsg->hostName);
+    }
+
+    /* Restarted gateway starts over with round trip estimate */
+    if (pPeer->gatewayID != pMsg->gatewayID) { pPeer->srttNs = 0; }
+
+    pPeer->gatewayID  = pMsg->gatewayID;
+    pPeer->lastSeenNs = getMonotonicNs();
+    memcpy(pPeer->hostName, pMsg->hostName, LG_HOST_NAME_MAX);
+
+    return pPeer;
+}
+
+
+//*************************************
+// Module Main Function
+//*************************************
+int main(int argc, char **args)
+{
+    unsigned char LG_SERVICE_RUNNING = 0x01;
+
+    int64_t periodNs;
+
+    int epollFD, nEvents;
+    struct epoll_event epollEvents[MAX_EPOLL_EVENTS];
+
+    /* Errors and warnings are written by log thread */
+    if (startComChanLog(STDOUT_FILENO) < 0) { return EXIT_FAILURE; }
+
+    /* Configure port, peers and query period */
+    if (parseGatewayOptions(argc, args) < 0) { return EXIT_FAILURE; }
+
+    memset(&gatewayContext, 0x00, sizeof(GatewayContext_t));
+    gatewayContext.gatewayID = ((uint32_t)getpid() << 16) ^ (uint32_t)getMonotonicNs();
+
+    if (gethostname(gatewayContext.hostName, (LG_HOST_NAME_MAX - 1)) < 0)
+    {
+        snprintf(gatewayContext.hostName, LG_HOST_NAME_MAX, "unknown");
+    }
+
+    /* Create gateway socket */
+    gatewayContext.sock = createGatewaySocket(listenPort, isBroadcast);
+    if (gatewayContext.sock < 0) { return EXIT_FAILURE; }
+
+    /* Create peer table */
+    gatewayContext.pPeers = createPeerTable(LG_PEERS_MAX);
+    if (gatewayContext.pPeers == NULL)
+    {
+        close(gatewayContext.sock);
+        return EXIT_FAILURE;
+    }
+
+    /* Create gateway schedules timer wheel */
+    gatewayContext.pWheel = createTimerWheel(GATEWAY_SCHEDULES_MAX);
+    if (gatewayContext.pWheel == NULL)
+    {
+        destroyPeerTable(gatewayContext.pPeers);
+        close(gatewayContext.sock);
+        return EXIT_FAILURE;
+    }
+
+    /* Create local summary client, unless local summary is collected directly */
+    if (!isDirectSummary)
+    {
+        gatewayContext.pClient = createComChanClient(COM_NETLINK_LG_SIG, QUERY_MAX_OUTSTANDING, (QUERY_REPLY_TIMEOUT * TW_NSEC_PER_SEC));
+        if (gatewayContext.pClient == NULL)
+        {
+            destroyTimerWheel(gatewayContext.pWheel);
+            destroyPeerTable(gatewayContext.pPeers);
+            close(gatewayContext.sock);
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* Create event polling setup */
+    epollFD = epoll_create1(0);
+    if (epollFD < 0)
+    {
+        LOG_ERROR("Failed to create epoll [%m]");
+
+        if (gatewayContext.pClient != NULL) { destroyComChanClient(gatewayContext.pClient); }
+        destroyTimerWheel(gatewayContext.pWheel);
+        destroyPeerTable(gatewayContext.pPeers);
+        close(gatewayContext.sock);
+        return EXIT_FAILURE;
+    }
+
+    /* Register gateway socket, schedules and local summary client for events polling */
+    if ( (registerEvent(epollFD, gatewayContext.sock) < 0) ||
+         (registerEvent(epollFD, getTimerWheelFD(gatewayContext.pWheel)) < 0) ||
+         ( (gatewayContext.pClient != NULL) &&
+           (registerEvent(epollFD, getComChanClientFD(gatewayContext.pClient)) < 0) ) )
+    {
+        if (gatewayContext.pClient != NULL) { destroyComChanClient(gatewayContext.pClient); }
+        destroyTimerWheel(gatewayContext.pWheel);
+        destroyPeerTable(gatewayContext.pPeers);
+        close(gatewayContext.sock);
+        close(epollFD);
+        return EXIT_FAILURE;
+    }
+
+    /* Send service information message */
+    if ( (gatewayContext.pClient != NULL) &&
+         (registerComChanClient(gatewayContext.pClient, "127.0.0.1") < 0) )
+    {
+        destroyComChanClient(gatewayContext.pClient);
+        destroyTimerWheel(gatewayContext.pWheel);
+        destroyPeerTable(gatewayContext.pPeers);
+        close(gatewayContext.sock);
+        close(epollFD);
+        return EXIT_FAILURE;
+    }
+
+
+    /* Keep local summary warm, peer queries are answered without waiting on relay */
+    addTimer(gatewayContext.pWheel, 0, (LOCAL_SUMMARY_PERIOD * TW_NSEC_PER_SEC), collectLocalSummary, NULL);
+
+    /* Announce gateway right away, first cluster query once peers had a hello period to answer */
+    addTimer(gatewayContext.pWheel, 0, (HELLO_PERIOD * TW_NSEC_PER_SEC), sendGatewayHello, NULL);
+
+    if (queryPeriod > 0)
+    {
+        periodNs = ((int64_t)queryPeriod * TW_NSEC_PER_SEC);
+        addTimer(gatewayContext.pWheel, periodNs, periodNs, runClusterQuery, NULL);
+    }
+
+    /* LAN gateway business logic */
+    while (LG_SERVICE_RUNNING)
+    {
+        /* Wait for events */
+        nEvents = epoll_wait(epollFD, epollEvents, MAX_EPOLL_EVENTS, (EPOLL_EVENTS_TIMEOUT * 1000));
+
+        /* Process events */
+        while (nEvents > 0)
+        {
+            if (epollEvents[(nEvents - 1)].data.fd == gatewayContext.sock)
+            {
+                /* Serve peer hellos, queries and answers */
+                if (handleGatewayMsgs() < 0)
+                {
+                    LG_SERVICE_RUNNING = 0;
+                    break;
+                }
+            }
+            else if (epollEvents[(nEvents - 1)].data.fd == getTimerWheelFD(gatewayContext.pWheel))
+            {
+                /* Run due schedules (hello, cluster query, peer deadlines, local summary) */
+                handleTimerWheel(gatewayContext.pWheel);
+            }
+            else if ( (gatewayContext.pClient != NULL) &&
+                      (epollEvents[(nEvents - 1)].data.fd == getComChanClientFD(gatewayContext.pClient)) )
+            {
+                /* Complete local summary queries */
+                if (handleComChanClient(gatewayContext.pClient) < 0)
+                {
+                    LG_SERVICE_RUNNING = 0;
+                    break;
+                }
+            }
+
+            nEvents--;
+        }
+
+        /* Transmit local summary queries submitted by schedules */
+        if (gatewayContext.pClient != NULL) { flushComChanClient(gatewayContext.pClient); }
+    }
+
+
+    /* Destroy local summary client, schedules and peers */
+    if (gatewayContext.pClient != NULL) { destroyComChanClient(gatewayContext.pClient); }
+    destroyTimerWheel(gatewayContext.pWheel);
+    destroyPeerTable(gatewayContext.pPeers);
+
+    /* Close gateway socket and polling descriptor */
+    close(gatewayContext.sock);
+    if (epollFD > 0) { close(epollFD); }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,204 @@
+/**
+ * @file    lg_peer_table.c
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  LAN gateway peer table; fixed slots, so peer pointers
+ * handed to round deadline schedules stay valid until expiry.
+ */
+
+
+// Library Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+// Module Includes
+#include "lg_peer_table.h"
+#include "com_chan_log.h"
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+struct LG_PeerTable_s
+{
+    LG_Peer_t              *pPeers;             ///< Peer slots
+    uint32_t                nPeers;             ///< Slots in use
+    uint32_t                maxPeers;           ///< Slots allocated
+};
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+LG_PeerTable_t* createPeerTable(uint32_t maxPeers)
+{
+    LG_PeerTable_t *pTable;
+
+    if ( (maxPeers == 0) ||
+         (maxPeers > LG_PEERS_MAX) )
+    {
+        LOG_ERROR("Invalid peers count %u",
+                  maxPeers);
+        return NULL;
+    }
+
+    pTable = (LG_PeerTable_t *)calloc(1, sizeof(LG_PeerTable_t));
+    if (pTable == NULL)
+    {
+        LOG_ERROR("Failed to allocate peer table");
+        return NULL;
+    }
+
+    /* Zeroed slots are free (AF_UNSPEC) */
+    pTable->pPeers = (LG_Peer_t *)calloc(maxPeers, sizeof(LG_Peer_t));
+    if (pTable->pPeers == NULL)
+    {
+        LOG_ERROR("Failed to allocate peers");
+        free(pTable);
+        return NULL;
+    }
+
+    pTable->maxPeers = maxPeers;
+
+    return pTable;
+}
+
+int destroyPeerTable(LG_PeerTable_t *pTable)
+{
+    if (pTable == NULL)
+    {
+        LOG_ERROR("Invalid input peer table %p",
+                  pTable);
+        return -1;
+    }
+
+    free(pTable->pPeers);
+    free(pTable);
+
+    return 0;
+}
+
+LG_Peer_t* findPeer(LG_PeerTable_t *pTable, const struct sockaddr_in *pAddr)
+{
+    uint32_t slot;
+
+    if ( (pTable == NULL) ||
+         (pAddr == NULL) )
+    {
+        LOG_ERROR("Invalid input pointer arguments (%p, %p)",
+                  pTable, pAddr);
+        return NULL;
+    }
+
+    for (slot = 0; slot < pTable->maxPeers; slot++)
+    {
+        if ( (pTable->pPeers[slot].addr.sin_family      == AF_INET) &&
+             (pTable->pPeers[slot].addr.sin_addr.s_addr == pAddr->sin_addr.s_addr) &&
+             (pTable->pPeers[slot].addr.sin_port        == pAddr->sin_port) )
+        {
+            return &pTable->pPeers[slot];
+        }
+    }
+
+    return NULL;
+}
+
+LG_Peer_t* addPeer(LG_PeerTable_t *pTable, const struct sockaddr_in *pAddr)
+{
+    uint32_t slot;
+
+    LG_Peer_t *pPeer;
+
+    if ( (pTable == NULL) ||
+         (pAddr == NULL) )
+    {
+        LOG_ERROR("Invalid input pointer arguments (%p, %p)",
+                  pTable, pAddr);
+        return NULL;
+    }
+
+    if (pTable->nPeers == pTable->maxPeers)
+    {
+        LOG_WARNING("Peer table is full (%u)",
+                    pTable->nPeers);
+        return NULL;
+    }
+
+    for (slot = 0; slot < pTable->maxPeers; slot++)
+    {
+        if (pTable->pPeers[slot].addr.sin_family == AF_INET) { continue; }
+
+        pPeer = &pTable->pPeers[slot];
+
+        memset(pPeer, 0x00, sizeof(LG_Peer_t));
+        memcpy(&pPeer->addr, pAddr, sizeof(struct sockaddr_in));
+
+        pPeer->addr.sin_family   = AF_INET;
+        pPeer->status            = LG_PEER_IDLE;
+        pPeer->deadlineTimerID   = -1;
+
+        pTable->nPeers++;
+
+        return pPeer;
+    }
+
+    return NULL;
+}
+
+LG_Peer_t* getPeer(LG_PeerTable_t *pTable, uint32_t slot)
+{
+    if ( (pTable == NULL) ||
+         (slot >= pTable->maxPeers) ||
+         (pTable->pPeers[slot].addr.sin_family != AF_INET) )
+    {
+        return NULL;
+    }
+
+    return &pTable->pPeers[slot];
+}
+
+uint32_t getPeerSlots(const LG_PeerTable_t *pTable)
+{
+    return (pTable == NULL) ? 0 : pTable->maxPeers;
+}
+
+uint32_t getPeerCount(const LG_PeerTable_t *pTable)
+{
+    return (pTable == NULL) ? 0 : pTable->nPeers;
+}
+
+int expirePeers(LG_PeerTable_t *pTable, int64_t expireNs)
+{
+    int nExpired = 0;
+    uint32_t slot;
+
+    if (pTable == NULL)
+    {
+        LOG_ERROR("Invalid input peer table %p",
+                  pTable);
+        return -1;
+    }
+
+    /* Free slots of peers silent since expiry time, caller ensures no round is in flight */
+    for (slot = 0; slot < pTable->maxPeers; slot++)
+    {
+        if ( (pTable->pPeers[slot].addr.sin_family != AF_INET) ||
+             (pTable->pPeers[slot].lastSeenNs > expireNs) )
+        {
+            continue;
+        }
+
+        memset(&pTable->pPeers[slot], 0x00, sizeof(LG_Peer_t));
+
+        pTable->nPeers--;
+        nExpired++;
+    }
+
+    return nExpired;
+}
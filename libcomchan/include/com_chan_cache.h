@@ -0,0 +1,66 @@
+/**
+ * @file    com_chan_cache.h
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Resource reply cache on top of asynchronous client;
+ * reads never block, values are revalidated in background
+ * (stale-while-revalidate) with one refresh in flight per key.
+ */
+
+#ifndef COM_CHAN_CACHE_H_
+#define COM_CHAN_CACHE_H_
+
+// Library Includes
+#include <stdint.h>
+
+// Module Includes
+#include "com_chan_client.h"
+#include "com_chan_proto.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define COM_CHAN_CACHE_MAX_ENTRIES  256     // Upper bound of cached keys
+#define COM_CHAN_CACHE_REFRESH_PCT  75      // Refresh once value age passes this share of staleness bound
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+enum
+{
+    COM_CHAN_CACHE_FRESH,                       ///< Value within staleness bound
+    COM_CHAN_CACHE_STALE,                       ///< Value older than staleness bound, refresh in flight
+    COM_CHAN_CACHE_EMPTY,                       ///< No value yet, refresh in flight
+};
+
+typedef struct ComChan_CacheStats_s
+{
+    uint64_t                nFresh;             ///< Reads answered within bound
+    uint64_t                nStale;             ///< Reads answered past bound
+    uint64_t                nEmpty;             ///< Reads without value
+    uint64_t                nRefreshes;         ///< Refresh queries submitted
+    uint64_t                nCoalesced;         ///< Refreshes skipped, one already in flight
+} ComChan_CacheStats_t;
+
+typedef struct ComChan_Cache_s ComChan_Cache_t;
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+ComChan_Cache_t* createComChanCache(ComChan_Client_t *pClient, uint32_t maxEntries);
+int destroyComChanCache(ComChan_Cache_t *pCache);
+
+int readComChanCache(ComChan_Cache_t         *pCache,
+                     const ComChan_Message_t *pQuery,
+                     int64_t                  maxAgeNs,
+                     ComChan_Message_t       *pValue,
+                     int64_t                 *pAgeNs);
+
+int getComChanCacheStats(const ComChan_Cache_t *pCache,
+                         ComChan_CacheStats_t  *pStats);
+
+#endif /* COM_CHAN_CACHE_H_ */
@@ -0,0 +1,71 @@
+/**
+ * @file    com_chan_capture.h
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Message capture traces; messages are stored with their
+ * arrival offset and without trailing zero bytes, so a trace of
+ * queries stays compact and can be replayed at original pacing.
+ */
+
+#ifndef COM_CHAN_CAPTURE_H_
+#define COM_CHAN_CAPTURE_H_
+
+// Library Includes
+#include <stdint.h>
+
+// Module Includes
+#include "com_chan_proto.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define COM_CHAN_CAPTURE_MAGIC      0x43435452  // "CCTR"
+#define COM_CHAN_CAPTURE_VERSION    1
+#define COM_CHAN_CAPTURE_BUFFER_SZ  65536       // Bytes buffered before written to trace
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+typedef struct ComChan_CaptureHeader_s
+{
+    uint32_t                magic;              ///< Trace magic (COM_CHAN_CAPTURE_MAGIC)
+    uint16_t                version;            ///< Trace format version
+    uint16_t                reserved;           ///< Reserved (alignment)
+    uint32_t                messageSz;          ///< Message size of capturing build
+    uint32_t                padding;            ///< Reserved (alignment)
+    int64_t                 startTime;          ///< Wall clock time of capture start (ns)
+} ComChan_CaptureHeader_t;
+
+typedef struct ComChan_CaptureRecord_s
+{
+    int64_t                 offsetNs;           ///< Arrival time since capture start (ns)
+    uint32_t                length;             ///< Message bytes stored, rest of message is zero
+    uint32_t                reserved;           ///< Reserved (alignment)
+} ComChan_CaptureRecord_t;
+
+typedef struct ComChan_CaptureWriter_s ComChan_CaptureWriter_t;
+typedef struct ComChan_CaptureReader_s ComChan_CaptureReader_t;
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+ComChan_CaptureWriter_t* openCaptureWriter(const char *pPath);
+int closeCaptureWriter(ComChan_CaptureWriter_t *pWriter);
+
+int writeCaptureRecord(ComChan_CaptureWriter_t *pWriter, const ComChan_Message_t *pMessage);
+int flushCaptureWriter(ComChan_CaptureWriter_t *pWriter);
+uint64_t getCaptureRecordCount(const ComChan_CaptureWriter_t *pWriter);
+
+ComChan_CaptureReader_t* openCaptureReader(const char *pPath);
+int closeCaptureReader(ComChan_CaptureReader_t *pReader);
+
+int readCaptureRecord(ComChan_CaptureReader_t *pReader,
+                      int64_t                 *pOffsetNs,
+                      ComChan_Message_t       *pMessage);
+int64_t getCaptureStartTime(const ComChan_CaptureReader_t *pReader);
+
+#endif /* COM_CHAN_CAPTURE_H_ */
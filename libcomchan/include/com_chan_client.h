@@ -0,0 +1,93 @@
+/**
+ * @file    com_chan_client.h
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Asynchronous communication channel client; pipelined
+ * queries matched to replies by sequence ID, completed through
+ * callbacks or futures and driven by a single pollable descriptor.
+ */
+
+#ifndef COM_CHAN_CLIENT_H_
+#define COM_CHAN_CLIENT_H_
+
+// Library Includes
+#include <stdint.h>
+
+// Module Includes
+#include "com_chan_proto.h"
+#include "com_chan_trace.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define COM_CHAN_CLIENT_MAX_OUTSTANDING 65536   // Upper bound of queries in flight per client
+#define COM_CHAN_CLIENT_RCVBUF  (4 * 1024 * 1024) // Socket receive buffer requested for reply bursts
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+enum
+{
+    COM_CHAN_FUTURE_PENDING,                    ///< Query in flight
+    COM_CHAN_FUTURE_READY,                      ///< Reply copied to future
+    COM_CHAN_FUTURE_EXPIRED,                    ///< No reply before client timeout
+};
+
+/** Reply callback; pReply is NULL if query expired. Reply memory is only valid during the call. */
+typedef void (*ComChan_ReplyCb_t)(void *pArg, uint32_t seqID, const ComChan_Message_t *pReply);
+
+typedef struct ComChan_Future_s
+{
+    uint32_t                seqID;              ///< Sequence ID of query
+    int                     state;              ///< Future state (COM_CHAN_FUTURE_*)
+
+    ComChan_Message_t       reply;              ///< Reply, valid once state is ready
+} ComChan_Future_t;
+
+typedef struct ComChan_ClientStats_s
+{
+    uint64_t                nSubmitted;         ///< Queries submitted
+    uint64_t                nCompleted;         ///< Queries completed by a reply
+    uint64_t                nExpired;           ///< Queries expired without reply
+    uint64_t                nUnmatched;         ///< Replies without outstanding query (late, cancelled)
+
+    ComChan_StageStats_t    stages;             ///< Stage latencies of completed queries
+} ComChan_ClientStats_t;
+
+typedef struct ComChan_Client_s ComChan_Client_t;
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+ComChan_Client_t* createComChanClient(uint32_t serviceSig,
+                                      uint32_t maxOutstanding,
+                                      int64_t  timeoutNs);
+int destroyComChanClient(ComChan_Client_t *pClient);
+
+int getComChanClientFD(const ComChan_Client_t *pClient);
+int getComChanClientStats(const ComChan_Client_t *pClient,
+                          ComChan_ClientStats_t  *pStats);
+
+int registerComChanClient(ComChan_Client_t *pClient, const char *pHostIP4);
+void setComChanPushHandler(ComChan_Client_t  *pClient,
+                           ComChan_ReplyCb_t  pushCb,
+                           void              *pArg);
+
+uint32_t submitComChanQuery(ComChan_Client_t        *pClient,
+                            const ComChan_Message_t *pQuery,
+                            ComChan_ReplyCb_t        replyCb,
+                            void                    *pArg);
+uint32_t submitComChanFuture(ComChan_Client_t        *pClient,
+                             const ComChan_Message_t *pQuery,
+                             ComChan_Future_t        *pFuture);
+int cancelComChanQuery(ComChan_Client_t *pClient, uint32_t seqID);
+
+int flushComChanClient(ComChan_Client_t *pClient);
+int handleComChanClient(ComChan_Client_t *pClient);
+int waitComChanFuture(ComChan_Client_t *pClient, ComChan_Future_t *pFuture);
+
+#endif /* COM_CHAN_CLIENT_H_ */
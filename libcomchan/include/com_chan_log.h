@@ -0,0 +1,108 @@
+/**
+ * @file    com_chan_log.h
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Asynchronous logging; callers store binary records
+ * (format descriptor, arguments, timestamp) into a per-thread
+ * lock-free ring, a background thread formats and writes them
+ * in batches. Levels above COM_CHAN_LOG_LEVEL compile to nothing.
+ */
+
+#ifndef COM_CHAN_LOG_H_
+#define COM_CHAN_LOG_H_
+
+// Library Includes
+#include <stdio.h>
+#include <stdint.h>
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define COM_CHAN_LOG_ERROR      0
+#define COM_CHAN_LOG_WARNING    1
+#define COM_CHAN_LOG_INFO       2
+#define COM_CHAN_LOG_DEBUG      3
+
+#ifndef COM_CHAN_LOG_LEVEL
+#define COM_CHAN_LOG_LEVEL      COM_CHAN_LOG_INFO // Most verbose level compiled in, override with -DCOM_CHAN_LOG_LEVEL=
+#endif
+
+#define COM_CHAN_LOG_MAX_ARGS   8           // Conversions per record, formats with more are written synchronously
+#define COM_CHAN_LOG_STRINGS_SZ 160         // Bytes of %s arguments copied per record, longer ones are truncated
+#define COM_CHAN_LOG_RING_RECORDS 256       // Records per thread ring (power of two)
+#define COM_CHAN_LOG_RINGS_MAX  64          // Thread rings, threads past this log synchronously
+
+#define COM_CHAN_LOG_UNPARSED   -1          // Format arguments not parsed yet
+#define COM_CHAN_LOG_UNSUPPORTED -2         // Format can't be deferred (too many or unknown conversions)
+
+/* Format check at compile time only, record is written by writeComChanLog */
+#define COM_CHAN_LOG(LEVEL, FMT, ...)                                           \
+    do                                                                          \
+    {                                                                           \
+        static ComChan_LogFormat_t logFormat =                                  \
+            { (LEVEL), __LINE__, __func__, FMT, COM_CHAN_LOG_UNPARSED, { 0 } }; \
+        if (0) { printf(FMT, ##__VA_ARGS__); }                                  \
+        writeComChanLog(&logFormat, ##__VA_ARGS__);                             \
+    } while (0)
+
+#if (COM_CHAN_LOG_LEVEL >= COM_CHAN_LOG_ERROR)
+#define LOG_ERROR(FMT, ...)     COM_CHAN_LOG(COM_CHAN_LOG_ERROR, FMT, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(FMT, ...)     do { } while (0)
+#endif
+
+#if (COM_CHAN_LOG_LEVEL >= COM_CHAN_LOG_WARNING)
+#define LOG_WARNING(FMT, ...)   COM_CHAN_LOG(COM_CHAN_LOG_WARNING, FMT, ##__VA_ARGS__)
+#else
+#define LOG_WARNING(FMT, ...)   do { } while (0)
+#endif
+
+#if (COM_CHAN_LOG_LEVEL >= COM_CHAN_LOG_INFO)
+#define LOG_INFO(FMT, ...)      COM_CHAN_LOG(COM_CHAN_LOG_INFO, FMT, ##__VA_ARGS__)
+#else
+#define LOG_INFO(FMT, ...)      do { } while (0)
+#endif
+
+#if (COM_CHAN_LOG_LEVEL >= COM_CHAN_LOG_DEBUG)
+#define LOG_DEBUG(FMT, ...)     COM_CHAN_LOG(COM_CHAN_LOG_DEBUG, FMT, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(FMT, ...)     do { } while (0)
+#endif
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+typedef struct ComChan_LogFormat_s
+{
+    int                     level;              ///< Log level (COM_CHAN_LOG_*)
+    int                     line;               ///< Call site line
+    const char             *pFunc;              ///< Call site function
+    const char             *pFormat;            ///< printf format, without level prefix and newline
+
+    int                     nArgs;              ///< Arguments per record, parsed on first use (COM_CHAN_LOG_UNPARSED)
+    uint8_t                 argTypes[COM_CHAN_LOG_MAX_ARGS]; ///< Argument types, in format order
+} ComChan_LogFormat_t;
+
+typedef struct ComChan_LogStats_s
+{
+    uint64_t                nWritten;           ///< Records formatted and written
+    uint64_t                nDropped;           ///< Records dropped on full ring
+    uint64_t                nSynchronous;       ///< Records written in caller context
+    uint32_t                nRings;             ///< Thread rings in use
+} ComChan_LogStats_t;
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+int startComChanLog(int fd);
+int stopComChanLog(void);
+
+void writeComChanLog(ComChan_LogFormat_t *pFormat, ...);
+
+int getComChanLogStats(ComChan_LogStats_t *pStats);
+
+#endif /* COM_CHAN_LOG_H_ */
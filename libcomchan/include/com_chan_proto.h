@@ -0,0 +1,357 @@
+/**
+ * @file    com_chan_proto.h
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Communication channel wire protocol; message layout
+ * shared by kernel relay module and user space services.
+ */
+
+#ifndef COM_CHAN_PROTO_H_
+#define COM_CHAN_PROTO_H_
+
+// Library Includes
+#ifdef __KERNEL__
+#include <linux/types.h>
+#else
+#include <stdint.h>
+#endif
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define COM_NETLINK_LKM         31
+
+#define COM_NETLINK_KERNEL_SIG  0x00
+#define COM_NETLINK_RW_SIG      0xA5A5A5A5
+#define COM_NETLINK_DW_SIG      0x10101010
+#define COM_NETLINK_MW_SIG      0x11001100
+#define COM_NETLINK_WA_SIG      0x0F0F0F0F
+#define COM_NETLINK_LG_SIG      0x3C3C3C3C
+
+#define COM_NETLINK_MAX_PAYLOAD sizeof(ComChan_Message_t)
+
+#define COM_CHAN_SEQ_NONE       0           // Message not matched to a query (registration, push)
+
+#define COM_CHAN_FLAG_PRIO_MASK 0x00000003  // Priority class bits of message flags, unknown class is normal
+#define COM_CHAN_GET_PRIO(FLAGS) ((((FLAGS) & COM_CHAN_FLAG_PRIO_MASK) < COM_CHAN_PRIO_MAX) ? \
+                                  ((FLAGS) & COM_CHAN_FLAG_PRIO_MASK) : COM_CHAN_PRIO_NORMAL)
+
+#define RW_CPU_INFO_MAX_CORES   32          // Cores carried per reply message
+#define RW_NUMA_INFO_MAX_NODES  8           // NUMA nodes carried per reply message
+#define RW_FRAG_INFO_MAX_ZONES  4           // Memory zones carried per reply message
+#define RW_FRAG_MAX_ORDERS      11          // Buddy allocator orders reported (0 .. 10)
+#define RW_FRAG_ZONE_NAME_SZ    8           // Zone name length, including terminator
+#define RW_DU_INFO_MAX_ENTRIES  10          // Largest or fastest growing subtrees carried per reply message
+#define RW_DU_PATH_SZ           96          // Subtree path length, including terminator
+#define RW_DU_GROWTH_MINUTES    60          // Longest growth window (minutes)
+#define RW_HISTORY_MAX_POINTS   60          // Points carried per reply message
+#define RW_SKETCH_BINS          256         // Bins per quantile sketch, lowest bins collapse on overflow
+
+#define RW_RESOURCE_MASK(R_ID)  (1U << (R_ID)) // Section bit of resource in multi-resource query
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+enum
+{
+    INVALID_RESOURCE_INFO_ID,
+
+    DISK_RESOURCE_INFO,
+    MEMORY_RESOURCE_INFO,
+    SERVICE_RESOURCE_INFO,
+    CPU_RESOURCE_INFO,
+    HISTORY_RESOURCE_INFO,
+    QUANTILE_RESOURCE_INFO,
+    MULTI_RESOURCE_INFO,
+    SUBSCRIBE_RESOURCE_INFO,
+    NUMA_RESOURCE_INFO,
+    FRAG_RESOURCE_INFO,
+    DU_RESOURCE_INFO,
+};
+
+enum
+{
+    COM_CHAN_STAGE_SEND,                        ///< Query queued for sending by requester
+    COM_CHAN_STAGE_RELAY_IN,                    ///< Query received by relay
+    COM_CHAN_STAGE_RELAY_OUT,                   ///< Query forwarded by relay to resource watcher
+    COM_CHAN_STAGE_COLLECT_START,               ///< Query picked up by resource watcher
+    COM_CHAN_STAGE_COLLECT_END,                 ///< Reply queued by resource watcher
+    COM_CHAN_STAGE_REPLY_RELAY,                 ///< Reply forwarded by relay to requester
+    COM_CHAN_STAGE_REPLY_RECEIVED,              ///< Reply received by requester
+
+    COM_CHAN_STAGE_MAX,
+};
+
+enum
+{
+    COM_CHAN_PRIO_NORMAL,                       ///< Default class (flags 0)
+    COM_CHAN_PRIO_CRITICAL,                     ///< Served ahead of other classes under load
+    COM_CHAN_PRIO_BULK,                         ///< Dashboards, history and quantile polls
+
+    COM_CHAN_PRIO_MAX,
+};
+
+enum
+{
+    RW_METRIC_DISK_FREE,                        ///< Free disk space (bytes)
+    RW_METRIC_MEMORY_FREE,                      ///< Free memory (bytes)
+    RW_METRIC_CPU_USER,                         ///< CPU user time (1/100th of percent)
+    RW_METRIC_CPU_SYSTEM,                       ///< CPU system time (1/100th of percent)
+    RW_METRIC_CPU_IOWAIT,                       ///< CPU iowait time (1/100th of percent)
+    RW_METRIC_CPU_STEAL,                        ///< CPU steal time (1/100th of percent)
+
+    RW_METRIC_MAX,
+};
+
+enum
+{
+    RW_HISTORY_RES_1S,                          ///< 1 second points for 10 minutes
+    RW_HISTORY_RES_10S,                         ///< 10 seconds points for 6 hours
+    RW_HISTORY_RES_1M,                          ///< 1 minute points for 7 days
+
+    RW_HISTORY_RES_MAX,
+};
+
+
+typedef struct RW_DiskInfo_s
+{
+    uint64_t                systemMemory;       ///< System total disk memory
+    uint64_t                freeMemory;         ///< System free disk memory
+} RW_DiskInfo_t;
+
+typedef struct RW_MemoryInfo_s
+{
+    uint64_t                systemMemory;       ///< System total memory
+    uint64_t                freeMemory;         ///< System free memory
+} RW_MemoryInfo_t;
+
+typedef struct RW_CpuUtil_s
+{
+    uint16_t                user;               ///< User time, nice included (1/100th of percent)
+    uint16_t                system;             ///< System time, irq and softirq included (1/100th of percent)
+    uint16_t                iowait;             ///< I/O wait time (1/100th of percent)
+    uint16_t                steal;              ///< Hypervisor steal time (1/100th of percent)
+} RW_CpuUtil_t;
+
+typedef struct RW_CpuInfo_s
+{
+    uint16_t                nCPUs;              ///< Number of CPUs on host
+    uint16_t                firstCPU;           ///< First core index carried in message
+    uint16_t                nEntries;           ///< Number of cores carried in message
+    uint16_t                reserved;           ///< Reserved (alignment)
+
+    RW_CpuUtil_t            aggregate;          ///< Host aggregate utilisation
+    RW_CpuUtil_t            cores[RW_CPU_INFO_MAX_CORES]; ///< Per-core utilisation
+} RW_CpuInfo_t;
+
+typedef struct RW_NumaNode_s
+{
+    uint16_t                nodeID;             ///< NUMA node identifier
+    uint16_t                reserved;           ///< Reserved (alignment)
+    uint32_t                padding;            ///< Reserved (alignment)
+
+    uint64_t                systemMemory;       ///< Node total memory (bytes)
+    uint64_t                freeMemory;         ///< Node free memory (bytes)
+    uint64_t                fileMemory;         ///< Node page cache (bytes)
+    uint64_t                anonMemory;         ///< Node anonymous memory (bytes)
+
+    uint64_t                numaHit;            ///< Pages allocated on node as intended
+    uint64_t                numaMiss;           ///< Pages allocated on node intended for another node
+    uint64_t                numaForeign;        ///< Pages intended for node allocated on another node
+    uint64_t                interleaveHit;      ///< Interleave policy pages allocated on node as intended
+    uint64_t                localNode;          ///< Pages allocated on node by process running on it
+    uint64_t                otherNode;          ///< Pages allocated on node by process running on another node
+} RW_NumaNode_t;
+
+typedef struct RW_NumaInfo_s
+{
+    uint16_t                nNodes;             ///< Number of NUMA nodes on host
+    uint16_t                firstNode;          ///< Query: first node position requested, Reply: first node position carried
+    uint16_t                nEntries;           ///< Number of nodes carried in message
+    uint16_t                reserved;           ///< Reserved (alignment)
+
+    RW_NumaNode_t           nodes[RW_NUMA_INFO_MAX_NODES]; ///< Per-node memory, ascending node identifiers
+} RW_NumaInfo_t;
+
+typedef struct RW_FragZone_s
+{
+    uint16_t                nodeID;             ///< NUMA node of zone
+    uint16_t                nOrders;            ///< Number of orders carried
+    uint32_t                padding;            ///< Reserved (alignment)
+    char                    zoneName[RW_FRAG_ZONE_NAME_SZ]; ///< Zone name (DMA, DMA32, Normal, Movable, ...)
+
+    uint64_t                freePages;          ///< Free pages in zone, all orders
+    uint64_t                freeBlocks[RW_FRAG_MAX_ORDERS];  ///< Free blocks per order (buddyinfo)
+    uint64_t                allocatable[RW_FRAG_MAX_ORDERS]; ///< Blocks of order allocatable from free lists without compaction
+    int16_t                 fragIndex[RW_FRAG_MAX_ORDERS];   ///< External fragmentation index per order (x1000), -1000 if allocation succeeds
+    uint16_t                unusableIndex[RW_FRAG_MAX_ORDERS]; ///< Free memory unusable at order (x1000)
+
+    uint32_t                unmovableBlocks;    ///< Pageblocks of unmovable migrate type (pagetypeinfo)
+    uint32_t                movableBlocks;      ///< Pageblocks of movable migrate type (pagetypeinfo)
+    uint32_t                reclaimableBlocks;  ///< Pageblocks of reclaimable migrate type (pagetypeinfo)
+} RW_FragZone_t;
+
+typedef struct RW_FragInfo_s
+{
+    uint16_t                nZones;             ///< Number of populated zones on host
+    uint16_t                firstZone;          ///< Query: first zone position requested, Reply: first zone position carried
+    uint16_t                nEntries;           ///< Number of zones carried in message
+    uint16_t                pageblockOrder;     ///< Order of a pageblock, 0 if pagetypeinfo is unreadable
+
+    uint64_t                compactStall;       ///< Direct compaction stalls (vmstat)
+    uint64_t                compactFail;        ///< Direct compactions failed to free a block
+    uint64_t                compactSuccess;     ///< Direct compactions freed a block
+    uint64_t                compactMigrateScanned; ///< Pages scanned for migration by compaction
+    uint64_t                compactFreeScanned; ///< Pages scanned for free targets by compaction
+    uint64_t                compactDaemonWake;  ///< Background compaction (kcompactd) wakeups
+    uint64_t                thpFaultAlloc;      ///< Huge pages allocated on fault
+    uint64_t                thpFaultFallback;   ///< Huge page faults fallen back to small pages
+
+    RW_FragZone_t           zones[RW_FRAG_INFO_MAX_ZONES]; ///< Per-zone free lists, ascending node and zone order
+} RW_FragInfo_t;
+
+typedef struct RW_DuEntry_s
+{
+    uint64_t                bytes;              ///< Subtree allocated bytes, hardlinked files counted once
+    uint64_t                nFiles;             ///< Subtree non-directory entries
+    int64_t                 growth;             ///< Subtree bytes grown over query window, 0 without window
+    uint16_t                depth;              ///< Directory levels below scanned root
+    uint16_t                reserved;           ///< Reserved (alignment)
+    uint32_t                padding;            ///< Reserved (alignment)
+    char                    path[RW_DU_PATH_SZ]; ///< Subtree path, leading components elided ("...") if too long
+} RW_DuEntry_t;
+
+typedef struct RW_DuInfo_s
+{
+    uint16_t                rootIndex;          ///< Query: configured root requested
+    uint16_t                nRoots;             ///< Number of configured roots
+    uint16_t                maxDepth;           ///< Query: deepest subtree level ranked, 0 for any level
+    uint16_t                nEntries;           ///< Number of subtrees carried in message
+    uint32_t                scanDuration;       ///< Duration of last completed scan (milliseconds)
+    uint16_t                window;             ///< Query: growth window (minutes), 0 ranks largest subtrees
+    uint16_t                tracking;           ///< Set if index is kept current by filesystem events since scan
+    int64_t                 scanTime;           ///< Completion time of last scan (seconds since epoch), 0 if none completed
+
+    uint64_t                totalBytes;         ///< Root allocated bytes
+    uint64_t                nDirs;              ///< Directories indexed, scanned or added from events since
+    uint64_t                nFiles;             ///< Non-directory entries scanned
+    uint64_t                nHardlinks;         ///< Hardlinks to already counted files
+    uint64_t                nErrors;            ///< Entries not scanned (permissions, vanished, limits)
+    uint64_t                nUpdates;           ///< Directories updated from filesystem events since scan
+
+    char                    rootPath[RW_DU_PATH_SZ]; ///< Configured root path
+    RW_DuEntry_t            entries[RW_DU_INFO_MAX_ENTRIES]; ///< Largest subtrees, or fastest growing over window, descending
+} RW_DuInfo_t;
+
+typedef struct RW_HistoryPoint_s
+{
+    int64_t                 min;                ///< Minimum value in point interval
+    int64_t                 max;                ///< Maximum value in point interval
+    int64_t                 avg;                ///< Average value in point interval
+} RW_HistoryPoint_t;
+
+typedef struct RW_HistoryInfo_s
+{
+    uint32_t                padding;            ///< Reserved (alignment)
+    uint16_t                metricID;           ///< Metric identifier (RW_METRIC_*)
+    uint16_t                resolution;         ///< Resolution identifier (RW_HISTORY_RES_*)
+
+    int64_t                 startTime;          ///< Query: window start (0 = latest), Reply: time of points[0]
+    uint32_t                step;               ///< Seconds between consecutive points
+    uint16_t                nPoints;            ///< Query: points requested, Reply: points carried
+    uint16_t                reserved;           ///< Reserved (alignment)
+
+    uint64_t                validMask;          ///< Bit N set if points[N] holds samples
+
+    RW_HistoryPoint_t       points[RW_HISTORY_MAX_POINTS]; ///< Window of points
+} RW_HistoryInfo_t;
+
+typedef struct RW_Sketch_s
+{
+    uint64_t                count;              ///< Number of values added
+    uint64_t                zeroCount;          ///< Number of values <= 0
+
+    int64_t                 min;                ///< Minimum value added
+    int64_t                 max;                ///< Maximum value added
+
+    int32_t                 offset;             ///< Bin index of bins[0]
+    uint32_t                reserved;           ///< Reserved (alignment)
+
+    uint32_t                bins[RW_SKETCH_BINS]; ///< Counts of logarithmic bins
+} RW_Sketch_t;
+
+typedef struct RW_QuantileInfo_s
+{
+    uint32_t                padding;            ///< Reserved (alignment)
+    uint16_t                metricID;           ///< Metric identifier (RW_METRIC_*)
+    uint16_t                reserved;           ///< Reserved (alignment)
+
+    int64_t                 startTime;          ///< Query: window start (0 = last hour)
+    int64_t                 endTime;            ///< Query: window end (0 = now)
+
+    int64_t                 p50;                ///< 50th percentile
+    int64_t                 p95;                ///< 95th percentile
+    int64_t                 p99;                ///< 99th percentile
+
+    RW_Sketch_t             sketch;             ///< Merged window sketch, mergeable by consumer
+} RW_QuantileInfo_t;
+
+typedef struct RW_MultiInfo_s
+{
+    uint32_t                resourceMask;       ///< Query: sections requested, Reply: sections carried (RW_RESOURCE_MASK)
+    uint32_t                subscriptionID;     ///< Subscription pushing sections, 0 if reply to query
+
+    RW_DiskInfo_t           diskInfo;           ///< Disk section
+    RW_MemoryInfo_t         memoryInfo;         ///< Memory section
+    RW_CpuInfo_t            cpuInfo;            ///< CPU section, query firstCPU selects cores window
+} RW_MultiInfo_t;
+
+typedef struct RW_SubscribeInfo_s
+{
+    uint32_t                subscriptionID;     ///< Subscriber chosen identifier, same identifier updates subscription
+    uint32_t                interval;           ///< Push interval (seconds), 0 cancels subscription
+    uint32_t                resourceMask;       ///< Query: sections to push, Reply: sections accepted (0 if cancelled or rejected)
+    uint16_t                firstCPU;           ///< First core index of CPU section
+    uint16_t                reserved;           ///< Reserved (alignment)
+} RW_SubscribeInfo_t;
+
+typedef struct ServiceInfo_s
+{
+    uint32_t                servicePID;         ///< Service process ID
+    char                    serviceHostIP4[16]; ///< Service host IPV4 address
+} ServiceInfo_t;
+
+typedef struct ComChan_Message_s
+{
+    uint32_t                serviceSig;         ///< Service signature (ID)
+    uint32_t                resourceInfoID;     ///< Resource information identifier
+
+    uint32_t                flags;              ///< Message flags (priority class in COM_CHAN_FLAG_PRIO_MASK)
+    uint32_t                seqID;              ///< Query sequence ID, echoed in reply (COM_CHAN_SEQ_NONE if unmatched)
+
+    uint32_t                requesterSig;       ///< Signature of querying service, stamped by relay and echoed in reply
+    uint32_t                reserved;           ///< Reserved (alignment)
+
+    int64_t                 stageTimes[COM_CHAN_STAGE_MAX]; ///< Monotonic time (ns) each stage was passed, 0 if not passed
+
+    union
+    {
+        RW_DiskInfo_t       diskInfo;           ///< Disk information
+        RW_MemoryInfo_t     memoryInfo;         ///< Memory information
+        RW_CpuInfo_t        cpuInfo;            ///< CPU utilisation information
+        RW_NumaInfo_t       numaInfo;           ///< Per NUMA node memory information
+        RW_FragInfo_t       fragInfo;           ///< Per zone memory fragmentation information
+        RW_DuInfo_t         duInfo;             ///< Largest or fastest growing directory subtrees of a scanned root
+        RW_HistoryInfo_t    historyInfo;        ///< Metric history window
+        RW_QuantileInfo_t   quantileInfo;       ///< Metric window quantiles
+        RW_MultiInfo_t      multiInfo;          ///< Disk, memory and CPU sections collected in one pass
+        RW_SubscribeInfo_t  subscribeInfo;      ///< Periodic push subscription
+
+        ServiceInfo_t       serviceInfo;        ///< Service information
+    } res_info;
+} ComChan_Message_t;
+
+#endif /* COM_CHAN_PROTO_H_ */
@@ -0,0 +1,98 @@
+/**
+ * @file    com_chan_socket.h
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Communication channel netlink transport; sockets,
+ * message headers and batched (recvmmsg/sendmmsg) message I/O.
+ */
+
+#ifndef COM_CHAN_SOCKET_H_
+#define COM_CHAN_SOCKET_H_
+
+// Library Includes
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE                         // struct mmsghdr, include before any system header
+#endif
+#include <stdint.h>
+#include <stddef.h>
+#include <unistd.h>
+
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+#include <linux/netlink.h>
+
+// Module Includes
+#include "com_chan_proto.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define COM_NETLINK_SOURCE      getpid()    // Process ID as source
+#define COM_NETLINK_AUTOBIND    0           // Kernel assigned port for auxiliary sockets
+#define COM_NETLINK_DESTINATION 0           // Kernel as destination
+
+#define COM_NETLINK_MSG_BATCH   32          // Messages per recvmmsg/sendmmsg call
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+typedef struct ComChan_MsgBatch_s
+{
+    uint8_t                *pBuffers;           ///< Contiguous netlink message buffers
+    size_t                  bufferSz;           ///< Bytes per netlink message buffer
+    uint32_t                nMessages;          ///< Messages held in batch
+
+    struct iovec            ioVectors[COM_NETLINK_MSG_BATCH]; ///< Per message I/O vector
+    struct mmsghdr          msgHdrs[COM_NETLINK_MSG_BATCH];   ///< Per message header
+} ComChan_MsgBatch_t;
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+struct nlmsghdr* createNLMsgHdr(int maxPayloadSz);
+int destroyNLMsgHdr(struct nlmsghdr *pNLMsgHdr);
+
+int createNLSocket(struct sockaddr_nl *pSrcAddr,
+                   struct sockaddr_nl *pDstAddr,
+                   uint32_t            portID);
+int destroyNLSocket(int sock);
+
+ComChan_MsgBatch_t* createMsgBatch(int maxPayloadSz);
+int destroyMsgBatch(ComChan_MsgBatch_t *pBatch);
+
+int flushMessages(const int                 sock,
+                  const struct sockaddr_nl *pDstAddr,
+                  ComChan_MsgBatch_t       *pBatch);
+int queueMessage(const int                 sock,
+                 const struct sockaddr_nl *pDstAddr,
+                 ComChan_MsgBatch_t       *pBatch,
+                 const ComChan_Message_t  *pMessage);
+int receiveMsgBatch(const int           sock,
+                    ComChan_MsgBatch_t *pBatch);
+
+int registerEvent(int epollFD, int eventFD);
+
+int sendMessage(const int                 sock,
+                const struct sockaddr_nl *pDstAddr,
+                const struct nlmsghdr    *pNLMsgHdr,
+                const ComChan_Message_t  *pMessage);
+
+
+static inline ComChan_Message_t* getBatchMessage(const ComChan_MsgBatch_t *pBatch, uint32_t idx)
+{
+    return (ComChan_Message_t *)NLMSG_DATA((struct nlmsghdr *)(pBatch->pBuffers + (idx * pBatch->bufferSz)));
+}
+
+static inline int isCompleteMessage(const struct nlmsghdr *pNLMsgHdr, size_t nBytes)
+{
+    /* Netlink header fits datagram and its payload holds a whole message */
+    return ( NLMSG_OK(pNLMsgHdr, (int)nBytes) &&
+             (pNLMsgHdr->nlmsg_len >= NLMSG_LENGTH(sizeof(ComChan_Message_t))) );
+}
+
+#endif /* COM_CHAN_SOCKET_H_ */
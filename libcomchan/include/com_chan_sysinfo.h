@@ -0,0 +1,23 @@
+/**
+ * @file    com_chan_sysinfo.h
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Local disk and memory collectors shared by resource
+ * watcher and LAN gateway.
+ */
+
+#ifndef COM_CHAN_SYSINFO_H_
+#define COM_CHAN_SYSINFO_H_
+
+// Module Includes
+#include "com_chan_proto.h"
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+int getDiskMemoryInfo(RW_DiskInfo_t *pDiskInfo);
+int getSystemMemoryInfo(RW_MemoryInfo_t *pMemoryInfo);
+
+#endif /* COM_CHAN_SYSINFO_H_ */
@@ -0,0 +1,70 @@
+/**
+ * @file    com_chan_timer_wheel.h
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Hierarchical timing wheel driven by a single timerfd;
+ * periodic schedules with per-schedule lateness/jitter stats.
+ */
+
+#ifndef COM_CHAN_TIMER_WHEEL_H_
+#define COM_CHAN_TIMER_WHEEL_H_
+
+// Library Includes
+#include <stdint.h>
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define TW_TICK_SHIFT           17          // Wheel tick of 2^17 ns (~131 us)
+#define TW_LEVEL_BITS           6           // 64 slots per level
+#define TW_LEVELS               4           // Wheel span of 2^24 ticks (~36 min), longer delays cascade again
+
+#define TW_NSEC_PER_MSEC        1000000LL
+#define TW_NSEC_PER_SEC         1000000000LL
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+typedef void (*TW_TimerCb_t)(void *pArg);
+
+typedef struct TW_TimerStats_s
+{
+    uint64_t                nFired;             ///< Number of expirations served
+    uint64_t                nMissed;            ///< Periods skipped after stalls
+
+    int64_t                 lastLateNs;         ///< Lateness of last expiration
+    int64_t                 maxLateNs;          ///< Maximum lateness
+    int64_t                 sumLateNs;          ///< Sum of lateness (mean = sum / nFired)
+
+    int64_t                 maxJitterNs;        ///< Maximum |interval - period|
+    int64_t                 sumJitterNs;        ///< Sum of |interval - period|
+} TW_TimerStats_t;
+
+typedef struct TW_TimerWheel_s TW_TimerWheel_t;
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+TW_TimerWheel_t* createTimerWheel(uint32_t maxTimers);
+int destroyTimerWheel(TW_TimerWheel_t *pWheel);
+
+int getTimerWheelFD(const TW_TimerWheel_t *pWheel);
+
+int addTimer(TW_TimerWheel_t *pWheel,
+             int64_t          delayNs,
+             int64_t          periodNs,
+             TW_TimerCb_t     timerCb,
+             void            *pArg);
+int cancelTimer(TW_TimerWheel_t *pWheel, int timerID);
+
+int handleTimerWheel(TW_TimerWheel_t *pWheel);
+
+int getTimerStats(const TW_TimerWheel_t *pWheel,
+                  int                    timerID,
+                  TW_TimerStats_t       *pStats);
+
+#endif /* COM_CHAN_TIMER_WHEEL_H_ */
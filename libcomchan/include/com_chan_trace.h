@@ -0,0 +1,106 @@
+/**
+ * @file    com_chan_trace.h
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Query pipeline stage tracing; stage timestamps carried
+ * in messages are aggregated into per-stage latency histograms and
+ * exposed as USDT probes (provider comchan) for bpftrace and perf.
+ */
+
+#ifndef COM_CHAN_TRACE_H_
+#define COM_CHAN_TRACE_H_
+
+// Library Includes
+#include <stdint.h>
+
+// Module Includes
+#include "com_chan_proto.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define COM_CHAN_TRACE_BUCKETS  36          // Log2 latency buckets, bucket N counts [2^N, 2^(N+1)) ns, last one is open
+
+/* Probes are a nop until a tracer attaches; systemtap header is used when installed,
+   otherwise the probe note is emitted here (x86-64), other targets compile them out */
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define COM_CHAN_HAVE_SDT
+#endif
+#endif
+
+#if defined(COM_CHAN_HAVE_SDT)
+
+#define COM_CHAN_PROBE3(NAME, A1, A2, A3)  DTRACE_PROBE3(comchan, NAME, A1, A2, A3)
+
+#elif defined(__x86_64__) && !defined(COM_CHAN_NO_PROBES)
+
+#define COM_CHAN_PROBE3(NAME, A1, A2, A3)                                       \
+    __asm__ __volatile__ ("990: nop\n"                                          \
+                          ".pushsection .note.stapsdt,\"\",\"note\"\n"          \
+                          ".balign 4\n"                                         \
+                          ".4byte 992f-991f, 994f-993f, 3\n"                    \
+                          "991: .asciz \"stapsdt\"\n"                           \
+                          "992: .balign 4\n"                                    \
+                          "993: .8byte 990b\n"                                  \
+                          ".8byte _.stapsdt.base\n"                             \
+                          ".8byte 0\n"                                          \
+                          ".asciz \"comchan\"\n"                                \
+                          ".asciz \"" #NAME "\"\n"                              \
+                          ".asciz \"-8@%0 -8@%1 -8@%2\"\n"                      \
+                          "994: .balign 4\n"                                    \
+                          ".popsection\n"                                       \
+                          ".ifndef _.stapsdt.base\n"                            \
+                          ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+                          ".weak _.stapsdt.base\n"                              \
+                          ".hidden _.stapsdt.base\n"                            \
+                          "_.stapsdt.base: .space 1\n"                          \
+                          ".size _.stapsdt.base, 1\n"                           \
+                          ".popsection\n"                                       \
+                          ".endif\n"                                            \
+                          :: "nor" ((int64_t)(A1)),                             \
+                             "nor" ((int64_t)(A2)),                             \
+                             "nor" ((int64_t)(A3)))
+
+#else
+
+#define COM_CHAN_PROBE3(NAME, A1, A2, A3)  do { } while (0)
+
+#endif
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+typedef struct ComChan_StageHist_s
+{
+    uint64_t                count;              ///< Latencies recorded
+    uint64_t                sumNs;              ///< Sum of latencies (ns)
+    uint64_t                maxNs;              ///< Largest latency (ns)
+    uint64_t                buckets[COM_CHAN_TRACE_BUCKETS]; ///< Log2 latency buckets
+} ComChan_StageHist_t;
+
+typedef struct ComChan_StageStats_s
+{
+    ComChan_StageHist_t     stages[COM_CHAN_STAGE_MAX]; ///< Latency from previous passed stage to stage N
+    ComChan_StageHist_t     total;              ///< Latency from first to last passed stage
+} ComChan_StageStats_t;
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+const char* getComChanStageName(uint32_t stage);
+const char* getComChanPrioName(uint32_t prio);
+
+void stampComChanStage(ComChan_Message_t *pMessage, uint32_t stage);
+int recordComChanStages(ComChan_StageStats_t *pStats, const ComChan_Message_t *pMessage);
+void recordComChanLatency(ComChan_StageHist_t *pHist, uint64_t latencyNs);
+
+uint64_t getComChanStageQuantile(const ComChan_StageHist_t *pHist, double quantile);
+void printComChanStages(const ComChan_StageStats_t *pStats, const char *pName);
+
+#endif /* COM_CHAN_TRACE_H_ */
@@ -0,0 +1,356 @@
+/**
+ * @file    com_chan_cache.c
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Resource reply cache; open addressed table keyed by
+ * resource ID and query parameters, refreshed through the
+ * asynchronous client.
+ */
+
+
+// Library Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+// Module Includes
+#include "com_chan_cache.h"
+#include "com_chan_log.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define COM_CHAN_NSEC_PER_SEC   1000000000LL
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+typedef struct ComChan_CacheEntry_s
+{
+    ComChan_Cache_t        *pCache;             ///< Owning cache (refresh callback argument)
+
+    uint32_t                resourceInfoID;     ///< Key: resource identifier, INVALID if slot is free
+    uint32_t                subKey;             ///< Key: query parameters (metric, resolution, points, core window)
+
+    uint32_t                refreshSeqID;       ///< Refresh in flight, COM_CHAN_SEQ_NONE if idle
+    int64_t                 updateTime;         ///< Time value was received (monotonic ns), 0 if empty
+
+    ComChan_Message_t       value;              ///< Latest reply
+} ComChan_CacheEntry_t;
+
+struct ComChan_Cache_s
+{
+    ComChan_Client_t       *pClient;            ///< Client refreshes are submitted on
+
+    ComChan_CacheEntry_t   *pEntries;           ///< Entry table, indexed by key hash & entryMask
+    uint32_t                entryMask;          ///< Table size - 1 (power of two)
+    uint32_t                nEntries;           ///< Keys in use
+    uint32_t                maxEntries;         ///< Keys allowed (table kept at most half full)
+
+    ComChan_CacheStats_t    stats;              ///< Read and refresh counters
+};
+
+
+//*************************************
+// Module Utility Functions
+//*************************************
+static ComChan_CacheEntry_t* findCacheEntry(ComChan_Cache_t *pCache, const ComChan_Message_t *pQuery);
+static inline int64_t getMonotonicNs(void);
+static uint32_t getQuerySubKey(const ComChan_Message_t *pQuery);
+static void handleRefreshReply(void *pArg, uint32_t seqID, const ComChan_Message_t *pReply);
+static int isCacheableQuery(const ComChan_Message_t *pQuery);
+
+
+static ComChan_CacheEntry_t* findCacheEntry(ComChan_Cache_t *pCache, const ComChan_Message_t *pQuery)
+{
+    uint32_t slot, subKey = getQuerySubKey(pQuery);
+
+    ComChan_CacheEntry_t *pEntry;
+
+    /* Linear probing, table never fills up so a free slot ends the search */
+    slot = ((pQuery->resourceInfoID * 0x9E3779B1U) ^ subKey) & pCache->entryMask;
+
+    while (1)
+    {
+        pEntry = &pCache->pEntries[slot];
+
+        if (pEntry->resourceInfoID == INVALID_RESOURCE_INFO_ID) { break; }
+
+        if ( (pEntry->resourceInfoID == pQuery->resourceInfoID) &&
+             (pEntry->subKey         == subKey) )
+        {
+            return pEntry;
+        }
+
+        slot = (slot + 1) & pCache->entryMask;
+    }
+
+    if (pCache->nEntries == pCache->maxEntries)
+    {
+        LOG_ERROR("Cache is full (%u keys)",
+                  pCache->nEntries);
+        return NULL;
+    }
+
+    /* Claim free slot for new key */
+    pEntry->pCache         = pCache;
+    pEntry->resourceInfoID = pQuery->resourceInfoID;
+    pEntry->subKey         = subKey;
+    pEntry->refreshSeqID   = COM_CHAN_SEQ_NONE;
+    pEntry->updateTime     = 0;
+
+    pCache->nEntries++;
+
+    return pEntry;
+}
+
+static inline int64_t getMonotonicNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((int64_t)ts.tv_sec * COM_CHAN_NSEC_PER_SEC) + ts.tv_nsec;
+}
+
+static uint32_t getQuerySubKey(const ComChan_Message_t *pQuery)
+{
+    /* Query parameters selecting a different answer for same resource */
+    switch (pQuery->resourceInfoID)
+    {
+        case CPU_RESOURCE_INFO:
+        {
+            return pQuery->res_info.cpuInfo.firstCPU;
+        }
+
+        case NUMA_RESOURCE_INFO:
+        {
+            return pQuery->res_info.numaInfo.firstNode;
+        }
+
+        case FRAG_RESOURCE_INFO:
+        {
+            return pQuery->res_info.fragInfo.firstZone;
+        }
+
+        case DU_RESOURCE_INFO:
+        {
+            /* Growth window never exceeds an hour, depth fits low half */
+            return ((uint32_t)pQuery->res_info.duInfo.rootIndex << 24) |
+                   ((uint32_t)(pQuery->res_info.duInfo.window & 0xFF) << 16) |
+                   pQuery->res_info.duInfo.maxDepth;
+        }
+
+        case HISTORY_RESOURCE_INFO:
+        {
+            /* Latest window only (see isCacheableQuery), points never exceed RW_HISTORY_MAX_POINTS */
+            return ((uint32_t)(pQuery->res_info.historyInfo.resolution & 0xFF) << 24) |
+                   ((uint32_t)(pQuery->res_info.historyInfo.nPoints & 0xFF) << 16) |
+                   pQuery->res_info.historyInfo.metricID;
+        }
+
+        case QUANTILE_RESOURCE_INFO:
+        {
+            return pQuery->res_info.quantileInfo.metricID;
+        }
+
+        case MULTI_RESOURCE_INFO:
+        {
+            return ((uint32_t)pQuery->res_info.multiInfo.cpuInfo.firstCPU << 16) | pQuery->res_info.multiInfo.resourceMask;
+        }
+    }
+
+    return 0;
+}
+
+static void handleRefreshReply(void *pArg, __attribute__((unused)) uint32_t seqID, const ComChan_Message_t *pReply)
+{
+    ComChan_CacheEntry_t *pEntry = (ComChan_CacheEntry_t *)pArg;
+
+    /* Expired refresh leaves old value in place, next read retries */
+    pEntry->refreshSeqID = COM_CHAN_SEQ_NONE;
+
+    if (pReply == NULL) { return; }
+
+    memcpy(&pEntry->value, pReply, sizeof(ComChan_Message_t));
+    pEntry->updateTime = getMonotonicNs();
+}
+
+static int isCacheableQuery(const ComChan_Message_t *pQuery)
+{
+    /* Explicit windows would share key of latest window, they are queried directly */
+    switch (pQuery->resourceInfoID)
+    {
+        case HISTORY_RESOURCE_INFO:
+        {
+            return (pQuery->res_info.historyInfo.startTime == 0);
+        }
+
+        case QUANTILE_RESOURCE_INFO:
+        {
+            return ( (pQuery->res_info.quantileInfo.startTime == 0) &&
+                     (pQuery->res_info.quantileInfo.endTime   == 0) );
+        }
+    }
+
+    return 1;
+}
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+ComChan_Cache_t* createComChanCache(ComChan_Client_t *pClient, uint32_t maxEntries)
+{
+    uint32_t tableSz = 1;
+
+    ComChan_Cache_t *pCache;
+
+    if ( (pClient == NULL) ||
+         (maxEntries == 0) ||
+         (maxEntries > COM_CHAN_CACHE_MAX_ENTRIES) )
+    {
+        LOG_ERROR("Invalid input arguments (%p, %u)",
+                  pClient, maxEntries);
+        return NULL;
+    }
+
+    pCache = (ComChan_Cache_t *)calloc(1, sizeof(ComChan_Cache_t));
+    if (pCache == NULL)
+    {
+        LOG_ERROR("Failed to allocate cache");
+        return NULL;
+    }
+
+    /* Keep table at most half full, probe sequences stay short */
+    while (tableSz < (maxEntries * 2)) { tableSz <<= 1; }
+
+    pCache->pEntries = (ComChan_CacheEntry_t *)calloc(tableSz, sizeof(ComChan_CacheEntry_t));
+    if (pCache->pEntries == NULL)
+    {
+        LOG_ERROR("Failed to allocate cache entries");
+        free(pCache);
+        return NULL;
+    }
+
+    pCache->pClient    = pClient;
+    pCache->entryMask  = (tableSz - 1);
+    pCache->maxEntries = maxEntries;
+
+    return pCache;
+}
+
+int destroyComChanCache(ComChan_Cache_t *pCache)
+{
+    uint32_t slot;
+
+    if (pCache == NULL)
+    {
+        LOG_ERROR("Invalid input cache %p",
+                  pCache);
+        return -1;
+    }
+
+    /* Refresh callbacks must not reach released entries */
+    for (slot = 0; slot <= pCache->entryMask; slot++)
+    {
+        if (pCache->pEntries[slot].refreshSeqID != COM_CHAN_SEQ_NONE)
+        {
+            cancelComChanQuery(pCache->pClient, pCache->pEntries[slot].refreshSeqID);
+        }
+    }
+
+    free(pCache->pEntries);
+    free(pCache);
+
+    return 0;
+}
+
+int readComChanCache(ComChan_Cache_t         *pCache,
+                     const ComChan_Message_t *pQuery,
+                     int64_t                  maxAgeNs,
+                     ComChan_Message_t       *pValue,
+                     int64_t                 *pAgeNs)
+{
+    int state;
+    int64_t ageNs = 0;
+
+    ComChan_CacheEntry_t *pEntry;
+
+    if ( (pCache == NULL) ||
+         (pQuery == NULL) ||
+         (pValue == NULL) ||
+         (maxAgeNs <= 0) ||
+         (pQuery->resourceInfoID == INVALID_RESOURCE_INFO_ID) )
+    {
+        LOG_ERROR("Invalid input arguments (%p, %p, %p, %ld)",
+                  pCache, pQuery,
+                  pValue, maxAgeNs);
+        return -1;
+    }
+
+    if (!isCacheableQuery(pQuery))
+    {
+        LOG_ERROR("Query of resource %u with explicit window is not cacheable",
+                  pQuery->resourceInfoID);
+        return -1;
+    }
+
+    pEntry = findCacheEntry(pCache, pQuery);
+    if (pEntry == NULL) { return -1; }
+
+    if (pEntry->updateTime == 0)
+    {
+        state = COM_CHAN_CACHE_EMPTY;
+        pCache->stats.nEmpty++;
+    }
+    else
+    {
+        ageNs = getMonotonicNs() - pEntry->updateTime;
+        state = (ageNs <= maxAgeNs) ? COM_CHAN_CACHE_FRESH : COM_CHAN_CACHE_STALE;
+
+        /* Answer from cache, caller decides whether stale value is usable */
+        memcpy(pValue, &pEntry->value, sizeof(ComChan_Message_t));
+
+        if (state == COM_CHAN_CACHE_FRESH) { pCache->stats.nFresh++; }
+        else                               { pCache->stats.nStale++; }
+    }
+
+    if (pAgeNs != NULL) { *pAgeNs = ageNs; }
+
+    /* Revalidate values near expiry in background, one refresh per key at a time */
+    if ( (state != COM_CHAN_CACHE_FRESH) ||
+         (ageNs >= ((maxAgeNs / 100) * COM_CHAN_CACHE_REFRESH_PCT)) )
+    {
+        if (pEntry->refreshSeqID != COM_CHAN_SEQ_NONE)
+        {
+            pCache->stats.nCoalesced++;
+        }
+        else
+        {
+            pEntry->refreshSeqID = submitComChanQuery(pCache->pClient, pQuery, handleRefreshReply, pEntry);
+            if (pEntry->refreshSeqID != COM_CHAN_SEQ_NONE) { pCache->stats.nRefreshes++; }
+        }
+    }
+
+    return state;
+}
+
+int getComChanCacheStats(const ComChan_Cache_t *pCache,
+                         ComChan_CacheStats_t  *pStats)
+{
+    if ( (pCache == NULL) ||
+         (pStats == NULL) )
+    {
+        LOG_ERROR("Invalid input pointer arguments (%p, %p)",
+                  pCache, pStats);
+        return -1;
+    }
+
+    memcpy(pStats, &pCache->stats, sizeof(ComChan_CacheStats_t));
+
+    return 0;
+}
@@ -0,0 +1,335 @@
+/**
+ * @file    com_chan_capture.c
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Message capture traces; records are written through a
+ * stdio buffer, the capturing event loop never waits on disk for
+ * a single record.
+ */
+
+
+// Library Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+// Module Includes
+#include "com_chan_capture.h"
+#include "com_chan_log.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define COM_CHAN_NSEC_PER_SEC   1000000000LL
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+struct ComChan_CaptureWriter_s
+{
+    FILE                   *pFile;              ///< Trace file
+    char                   *pBuffer;            ///< Trace file stdio buffer
+    int64_t                 startNs;            ///< Monotonic time of capture start
+    uint64_t                nRecords;           ///< Records written
+};
+
+struct ComChan_CaptureReader_s
+{
+    FILE                   *pFile;              ///< Trace file
+    char                   *pBuffer;            ///< Trace file stdio buffer
+    ComChan_CaptureHeader_t header;             ///< Trace header
+};
+
+
+//*************************************
+// Module Utility Functions
+//*************************************
+static inline int64_t getClockNs(clockid_t clockID);
+static uint32_t getMessageLength(const ComChan_Message_t *pMessage);
+
+
+static inline int64_t getClockNs(clockid_t clockID)
+{
+    struct timespec ts;
+    clock_gettime(clockID, &ts);
+    return ((int64_t)ts.tv_sec * COM_CHAN_NSEC_PER_SEC) + ts.tv_nsec;
+}
+
+static uint32_t getMessageLength(const ComChan_Message_t *pMessage)
+{
+    const uint8_t *pBytes = (const uint8_t *)pMessage;
+    uint32_t length = sizeof(ComChan_Message_t);
+
+    /* Queries leave most of the resource union zeroed, trailing zeros are not stored */
+    while ( (length >= sizeof(uint64_t)) &&
+            (*(const uint64_t *)(pBytes + length - sizeof(uint64_t)) == 0) )
+    {
+        length -= sizeof(uint64_t);
+    }
+
+    while ( (length > 0) &&
+            (pBytes[length - 1] == 0) )
+    {
+        length--;
+    }
+
+    return length;
+}
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+ComChan_CaptureWriter_t* openCaptureWriter(const char *pPath)
+{
+    ComChan_CaptureHeader_t  header;
+    ComChan_CaptureWriter_t *pWriter;
+
+    if (pPath == NULL)
+    {
+        LOG_ERROR("Invalid input path %p",
+                  pPath);
+        return NULL;
+    }
+
+    pWriter = (ComChan_CaptureWriter_t *)calloc(1, sizeof(ComChan_CaptureWriter_t));
+    if (pWriter == NULL)
+    {
+        LOG_ERROR("Failed to allocate capture writer");
+        return NULL;
+    }
+
+    pWriter->pBuffer = (char *)malloc(COM_CHAN_CAPTURE_BUFFER_SZ);
+    if (pWriter->pBuffer == NULL)
+    {
+        LOG_ERROR("Failed to allocate capture buffer");
+        free(pWriter);
+        return NULL;
+    }
+
+    pWriter->pFile = fopen(pPath, "wb");
+    if (pWriter->pFile == NULL)
+    {
+        LOG_ERROR("Failed to create capture trace '%s' [%m]",
+                  pPath);
+        free(pWriter->pBuffer);
+        free(pWriter);
+        return NULL;
+    }
+
+    setvbuf(pWriter->pFile, pWriter->pBuffer, _IOFBF, COM_CHAN_CAPTURE_BUFFER_SZ);
+
+    memset(&header, 0x00, sizeof(ComChan_CaptureHeader_t));
+    header.magic     = COM_CHAN_CAPTURE_MAGIC;
+    header.version   = COM_CHAN_CAPTURE_VERSION;
+    header.messageSz = sizeof(ComChan_Message_t);
+    header.startTime = getClockNs(CLOCK_REALTIME);
+
+    pWriter->startNs = getClockNs(CLOCK_MONOTONIC);
+
+    if (fwrite(&header, sizeof(ComChan_CaptureHeader_t), 1, pWriter->pFile) != 1)
+    {
+        LOG_ERROR("Failed to write capture header [%m]");
+        fclose(pWriter->pFile);
+        free(pWriter->pBuffer);
+        free(pWriter);
+        return NULL;
+    }
+
+    return pWriter;
+}
+
+int closeCaptureWriter(ComChan_CaptureWriter_t *pWriter)
+{
+    int retVal = 0;
+
+    if (pWriter == NULL)
+    {
+        LOG_ERROR("Invalid input capture writer %p",
+                  pWriter);
+        return -1;
+    }
+
+    if (fclose(pWriter->pFile) != 0)
+    {
+        LOG_ERROR("Failed to close capture trace [%m]");
+        retVal = -1;
+    }
+
+    free(pWriter->pBuffer);
+    free(pWriter);
+
+    return retVal;
+}
+
+int writeCaptureRecord(ComChan_CaptureWriter_t *pWriter, const ComChan_Message_t *pMessage)
+{
+    ComChan_CaptureRecord_t record;
+
+    if ( (pWriter == NULL) ||
+         (pMessage == NULL) )
+    {
+        LOG_ERROR("Invalid input pointer arguments (%p, %p)",
+                  pWriter, pMessage);
+        return -1;
+    }
+
+    record.offsetNs = getClockNs(CLOCK_MONOTONIC) - pWriter->startNs;
+    record.length   = getMessageLength(pMessage);
+    record.reserved = 0;
+
+    if ( (fwrite(&record, sizeof(ComChan_CaptureRecord_t), 1, pWriter->pFile) != 1) ||
+         ((record.length > 0) && (fwrite(pMessage, record.length, 1, pWriter->pFile) != 1)) )
+    {
+        LOG_ERROR("Failed to write capture record [%m]");
+        return -1;
+    }
+
+    pWriter->nRecords++;
+
+    return 0;
+}
+
+int flushCaptureWriter(ComChan_CaptureWriter_t *pWriter)
+{
+    if (pWriter == NULL)
+    {
+        LOG_ERROR("Invalid input capture writer %p",
+                  pWriter);
+        return -1;
+    }
+
+    if (fflush(pWriter->pFile) != 0)
+    {
+        LOG_ERROR("Failed to flush capture trace [%m]");
+        return -1;
+    }
+
+    return 0;
+}
+
+uint64_t getCaptureRecordCount(const ComChan_CaptureWriter_t *pWriter)
+{
+    return (pWriter == NULL) ? 0 : pWriter->nRecords;
+}
+
+ComChan_CaptureReader_t* openCaptureReader(const char *pPath)
+{
+    ComChan_CaptureReader_t *pReader;
+
+    if (pPath == NULL)
+    {
+        LOG_ERROR("Invalid input path %p",
+                  pPath);
+        return NULL;
+    }
+
+    pReader = (ComChan_CaptureReader_t *)calloc(1, sizeof(ComChan_CaptureReader_t));
+    if (pReader == NULL)
+    {
+        LOG_ERROR("Failed to allocate capture reader");
+        return NULL;
+    }
+
+    pReader->pBuffer = (char *)malloc(COM_CHAN_CAPTURE_BUFFER_SZ);
+    if (pReader->pBuffer == NULL)
+    {
+        LOG_ERROR("Failed to allocate capture buffer");
+        free(pReader);
+        return NULL;
+    }
+
+    pReader->pFile = fopen(pPath, "rb");
+    if (pReader->pFile == NULL)
+    {
+        LOG_ERROR("Failed to open capture trace '%s' [%m]",
+                  pPath);
+        free(pReader->pBuffer);
+        free(pReader);
+        return NULL;
+    }
+
+    setvbuf(pReader->pFile, pReader->pBuffer, _IOFBF, COM_CHAN_CAPTURE_BUFFER_SZ);
+
+    /* Message layout must match, records are copied into messages as is */
+    if ( (fread(&pReader->header, sizeof(ComChan_CaptureHeader_t), 1, pReader->pFile) != 1) ||
+         (pReader->header.magic     != COM_CHAN_CAPTURE_MAGIC) ||
+         (pReader->header.version   != COM_CHAN_CAPTURE_VERSION) ||
+         (pReader->header.messageSz != sizeof(ComChan_Message_t)) )
+    {
+        LOG_ERROR("Invalid capture trace '%s' (magic 0x%X, version %u, message size %u)",
+                  pPath, pReader->header.magic,
+                  pReader->header.version, pReader->header.messageSz);
+        fclose(pReader->pFile);
+        free(pReader->pBuffer);
+        free(pReader);
+        return NULL;
+    }
+
+    return pReader;
+}
+
+int closeCaptureReader(ComChan_CaptureReader_t *pReader)
+{
+    if (pReader == NULL)
+    {
+        LOG_ERROR("Invalid input capture reader %p",
+                  pReader);
+        return -1;
+    }
+
+    fclose(pReader->pFile);
+    free(pReader->pBuffer);
+    free(pReader);
+
+    return 0;
+}
+
+int readCaptureRecord(ComChan_CaptureReader_t *pReader,
+                      int64_t                 *pOffsetNs,
+                      ComChan_Message_t       *pMessage)
+{
+    ComChan_CaptureRecord_t record;
+
+    if ( (pReader == NULL) ||
+         (pOffsetNs == NULL) ||
+         (pMessage == NULL) )
+    {
+        LOG_ERROR("Invalid input pointer arguments (%p, %p, %p)",
+                  pReader, pOffsetNs,
+                  pMessage);
+        return -1;
+    }
+
+    /* End of trace; a record cut short by capture exit ends it as well */
+    if (fread(&record, sizeof(ComChan_CaptureRecord_t), 1, pReader->pFile) != 1) { return 0; }
+
+    if (record.length > sizeof(ComChan_Message_t))
+    {
+        LOG_ERROR("Invalid capture record length %u",
+                  record.length);
+        return -1;
+    }
+
+    memset(pMessage, 0x00, sizeof(ComChan_Message_t));
+    if ( (record.length > 0) &&
+         (fread(pMessage, record.length, 1, pReader->pFile) != 1) )
+    {
+        return 0;
+    }
+
+    *pOffsetNs = record.offsetNs;
+
+    return 1;
+}
+
+int64_t getCaptureStartTime(const ComChan_CaptureReader_t *pReader)
+{
+    return (pReader == NULL) ? 0 : pReader->header.startTime;
+}
@@ -0,0 +1,595 @@
+/**
+ * @file    com_chan_client.c
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Asynchronous communication channel client; queries are
+ * batched out, kept in a sequence ID window and completed as
+ * replies arrive or their deadline passes.
+ */
+
+
+// Library Includes
+#define _GNU_SOURCE                         // recvmmsg(), sendmmsg()
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <poll.h>
+
+#include <sys/types.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+
+#include <linux/netlink.h>
+
+// Module Includes
+#include "com_chan_client.h"
+#include "com_chan_socket.h"
+#include "com_chan_log.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define COM_CHAN_NSEC_PER_SEC   1000000000LL
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+typedef struct ComChan_Pending_s
+{
+    uint32_t                seqID;              ///< Outstanding query, COM_CHAN_SEQ_NONE if slot is free
+    int64_t                 deadline;           ///< Expiry time (monotonic ns)
+
+    ComChan_ReplyCb_t       replyCb;            ///< Completion callback
+    void                   *pArg;               ///< Completion callback argument
+} ComChan_Pending_t;
+
+struct ComChan_Client_s
+{
+    int                     sock;               ///< Netlink socket bound to service PID
+    struct sockaddr_nl      srcAddr;            ///< Service source address
+    struct sockaddr_nl      dstAddr;            ///< Kernel destination address
+
+    int                     epollFD;            ///< Pollable descriptor (socket and expiry timer)
+    int                     timerFD;            ///< Expiry timer of oldest outstanding query
+    int64_t                 armedDeadline;      ///< Expiry timer deadline, 0 if disarmed
+
+    uint32_t                serviceSig;         ///< Signature stamped on queries
+    int64_t                 timeoutNs;          ///< Reply timeout per query
+
+    ComChan_MsgBatch_t     *pRxBatch;           ///< Reply message batch
+    ComChan_MsgBatch_t     *pTxBatch;           ///< Query message batch
+
+    ComChan_Pending_t      *pPending;           ///< Outstanding queries, indexed by seqID & pendingMask
+    uint32_t                pendingMask;        ///< Window size - 1 (power of two)
+    uint32_t                nextSeqID;          ///< Sequence ID of next query
+    uint32_t                tailSeqID;          ///< Oldest sequence ID possibly outstanding
+    uint32_t                nOutstanding;       ///< Queries in flight
+
+    ComChan_ReplyCb_t       pushCb;             ///< Handler of messages without sequence ID
+    void                   *pPushArg;           ///< Push handler argument
+
+    ComChan_ClientStats_t   stats;              ///< Query counters
+};
+
+
+//*************************************
+// Module Utility Functions
+//*************************************
+static int armExpiryTimer(ComChan_Client_t *pClient, int64_t deadline);
+static void completeFuture(void *pArg, uint32_t seqID, const ComChan_Message_t *pReply);
+static void dispatchReply(ComChan_Client_t *pClient, const ComChan_Message_t *pReply);
+static void expireQueries(ComChan_Client_t *pClient);
+static inline int64_t getMonotonicNs(void);
+static inline uint32_t nextSeqID(uint32_t seqID);
+
+
+static int armExpiryTimer(ComChan_Client_t *pClient, int64_t deadline)
+{
+    struct itimerspec timerSpec;
+
+    if (deadline == pClient->armedDeadline) { return 0; }
+
+    /* Absolute expiry, zero deadline disarms timer */
+    memset(&timerSpec, 0x00, sizeof(timerSpec));
+    timerSpec.it_value.tv_sec  = (deadline / COM_CHAN_NSEC_PER_SEC);
+    timerSpec.it_value.tv_nsec = (deadline % COM_CHAN_NSEC_PER_SEC);
+
+    if (timerfd_settime(pClient->timerFD, TFD_TIMER_ABSTIME, &timerSpec, NULL) < 0)
+    {
+        LOG_ERROR("Failed to arm query expiry timer [%m]");
+        return -1;
+    }
+
+    pClient->armedDeadline = deadline;
+
+    return 0;
+}
+
+static void completeFuture(void *pArg, __attribute__((unused)) uint32_t seqID, const ComChan_Message_t *pReply)
+{
+    ComChan_Future_t *pFuture = (ComChan_Future_t *)pArg;
+
+    if (pReply == NULL)
+    {
+        pFuture->state = COM_CHAN_FUTURE_EXPIRED;
+        return;
+    }
+
+    memcpy(&pFuture->reply, pReply, sizeof(ComChan_Message_t));
+    pFuture->state = COM_CHAN_FUTURE_READY;
+}
+
+static void dispatchReply(ComChan_Client_t *pClient, const ComChan_Message_t *pReply)
+{
+    ComChan_Pending_t *pPending;
+    ComChan_ReplyCb_t  replyCb;
+    void              *pArg;
+
+    if (pReply->serviceSig != COM_NETLINK_KERNEL_SIG) { return; }
+
+    /* Unsolicited message, hand it to push handler */
+    if (pReply->seqID == COM_CHAN_SEQ_NONE)
+    {
+        if (pClient->pushCb != NULL) { pClient->pushCb(pClient->pPushArg, COM_CHAN_SEQ_NONE, pReply); }
+        return;
+    }
+
+    pPending = &pClient->pPending[pReply->seqID & pClient->pendingMask];
+    if (pPending->seqID != pReply->seqID)
+    {
+        /* Late reply of expired or cancelled query */
+        pClient->stats.nUnmatched++;
+        return;
+    }
+
+    /* Release slot before callback, callback may submit follow-up queries */
+    replyCb = pPending->replyCb;
+    pArg    = pPending->pArg;
+
+    pPending->seqID = COM_CHAN_SEQ_NONE;
+    pClient->nOutstanding--;
+    pClient->stats.nCompleted++;
+
+    recordComChanStages(&pClient->stats.stages, pReply);
+
+    replyCb(pArg, pReply->seqID, pReply);
+}
+
+static void expireQueries(ComChan_Client_t *pClient)
+{
+    int64_t now = getMonotonicNs();
+    uint32_t seqID;
+
+    ComChan_Pending_t *pPending;
+    ComChan_ReplyCb_t  replyCb;
+    void              *pArg;
+
+    /* Every query shares the timeout, so window tail is always the first to expire */
+    while (pClient->tailSeqID != pClient->nextSeqID)
+    {
+        seqID    = pClient->tailSeqID;
+        pPending = &pClient->pPending[seqID & pClient->pendingMask];
+
+        if (pPending->seqID == seqID)
+        {
+            if (pPending->deadline > now)
+            {
+                /* Wake up again when oldest outstanding query is due */
+                armExpiryTimer(pClient, pPending->deadline);
+                return;
+            }
+
+            replyCb = pPending->replyCb;
+            pArg    = pPending->pArg;
+
+            pPending->seqID = COM_CHAN_SEQ_NONE;
+            pClient->nOutstanding--;
+            pClient->stats.nExpired++;
+
+            replyCb(pArg, seqID, NULL);
+        }
+
+        pClient->tailSeqID = nextSeqID(seqID);
+    }
+
+    /* Nothing outstanding */
+    armExpiryTimer(pClient, 0);
+}
+
+static inline int64_t getMonotonicNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((int64_t)ts.tv_sec * COM_CHAN_NSEC_PER_SEC) + ts.tv_nsec;
+}
+
+static inline uint32_t nextSeqID(uint32_t seqID)
+{
+    /* Sequence ID zero is reserved for unmatched messages */
+    seqID++;
+    return (seqID == COM_CHAN_SEQ_NONE) ? (seqID + 1) : seqID;
+}
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+ComChan_Client_t* createComChanClient(uint32_t serviceSig,
+                                      uint32_t maxOutstanding,
+                                      int64_t  timeoutNs)
+{
+    int rcvBufSz = COM_CHAN_CLIENT_RCVBUF;
+    uint32_t windowSz = 1;
+
+    ComChan_Client_t *pClient;
+    struct epoll_event epollEvent;
+
+    if ( (maxOutstanding == 0) ||
+         (maxOutstanding > COM_CHAN_CLIENT_MAX_OUTSTANDING) ||
+         (timeoutNs <= 0) )
+    {
+        LOG_ERROR("Invalid input arguments (%u, %ld)",
+                  maxOutstanding, timeoutNs);
+        return NULL;
+    }
+
+    pClient = (ComChan_Client_t *)calloc(1, sizeof(ComChan_Client_t));
+    if (pClient == NULL)
+    {
+        LOG_ERROR("Failed to allocate client");
+        return NULL;
+    }
+
+    pClient->serviceSig = serviceSig;
+    pClient->timeoutNs  = timeoutNs;
+    pClient->nextSeqID  = nextSeqID(COM_CHAN_SEQ_NONE);
+    pClient->tailSeqID  = pClient->nextSeqID;
+    pClient->epollFD    = -1;
+    pClient->timerFD    = -1;
+
+    /* Sequence window, power of two for masked slot lookup */
+    while (windowSz < maxOutstanding) { windowSz <<= 1; }
+    pClient->pendingMask = (windowSz - 1);
+
+    pClient->pPending = (ComChan_Pending_t *)calloc(windowSz, sizeof(ComChan_Pending_t));
+    pClient->pRxBatch = createMsgBatch(COM_NETLINK_MAX_PAYLOAD);
+    pClient->pTxBatch = createMsgBatch(COM_NETLINK_MAX_PAYLOAD);
+    if ( (pClient->pPending == NULL) ||
+         (pClient->pRxBatch == NULL) ||
+         (pClient->pTxBatch == NULL) )
+    {
+        LOG_ERROR("Failed to allocate client buffers");
+        destroyComChanClient(pClient);
+        return NULL;
+    }
+
+    /* Relay routes replies to service PID */
+    pClient->sock = createNLSocket(&pClient->srcAddr, &pClient->dstAddr, COM_NETLINK_SOURCE);
+    if (pClient->sock <= 0)
+    {
+        LOG_ERROR("Failed to create client socket [%m]");
+        destroyComChanClient(pClient);
+        return NULL;
+    }
+
+    /* Room for reply bursts of pipelined queries, best effort (capped by rmem_max) */
+    setsockopt(pClient->sock, SOL_SOCKET, SO_RCVBUF, &rcvBufSz, sizeof(rcvBufSz));
+
+    pClient->timerFD = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    pClient->epollFD = epoll_create1(EPOLL_CLOEXEC);
+    if ( (pClient->timerFD < 0) ||
+         (pClient->epollFD < 0) )
+    {
+        LOG_ERROR("Failed to create client descriptors [%m]");
+        destroyComChanClient(pClient);
+        return NULL;
+    }
+
+    /* Socket and expiry timer behind one descriptor for external event loops */
+    memset(&epollEvent, 0x00, sizeof(epollEvent));
+    epollEvent.events  = EPOLLIN;
+    epollEvent.data.fd = pClient->sock;
+
+    if (epoll_ctl(pClient->epollFD, EPOLL_CTL_ADD, pClient->sock, &epollEvent) < 0)
+    {
+        LOG_ERROR("Failed to register client socket [%m]");
+        destroyComChanClient(pClient);
+        return NULL;
+    }
+
+    epollEvent.data.fd = pClient->timerFD;
+
+    if (epoll_ctl(pClient->epollFD, EPOLL_CTL_ADD, pClient->timerFD, &epollEvent) < 0)
+    {
+        LOG_ERROR("Failed to register client expiry timer [%m]");
+        destroyComChanClient(pClient);
+        return NULL;
+    }
+
+    return pClient;
+}
+
+int destroyComChanClient(ComChan_Client_t *pClient)
+{
+    if (pClient == NULL)
+    {
+        LOG_ERROR("Invalid input client %p",
+                  pClient);
+        return -1;
+    }
+
+    /* Outstanding queries are dropped without callbacks */
+    if (pClient->epollFD >= 0) { close(pClient->epollFD); }
+    if (pClient->timerFD >= 0) { close(pClient->timerFD); }
+    if (pClient->sock     > 0) { destroyNLSocket(pClient->sock); }
+
+    if (pClient->pTxBatch != NULL) { destroyMsgBatch(pClient->pTxBatch); }
+    if (pClient->pRxBatch != NULL) { destroyMsgBatch(pClient->pRxBatch); }
+
+    free(pClient->pPending);
+    free(pClient);
+
+    return 0;
+}
+
+int getComChanClientFD(const ComChan_Client_t *pClient)
+{
+    return (pClient != NULL) ? pClient->epollFD : -1;
+}
+
+int getComChanClientStats(const ComChan_Client_t *pClient,
+                          ComChan_ClientStats_t  *pStats)
+{
+    if ( (pClient == NULL) ||
+         (pStats  == NULL) )
+    {
+        LOG_ERROR("Invalid input pointer arguments (%p, %p)",
+                  pClient, pStats);
+        return -1;
+    }
+
+    memcpy(pStats, &pClient->stats, sizeof(ComChan_ClientStats_t));
+
+    return 0;
+}
+
+int registerComChanClient(ComChan_Client_t *pClient, const char *pHostIP4)
+{
+    ComChan_Message_t serviceMsg;
+
+    if ( (pClient  == NULL) ||
+         (pHostIP4 == NULL) )
+    {
+        LOG_ERROR("Invalid input pointer arguments (%p, %p)",
+                  pClient, pHostIP4);
+        return -1;
+    }
+
+    /* Populate message for service information */
+    memset(&serviceMsg, 0x00, sizeof(ComChan_Message_t));
+    serviceMsg.serviceSig        = pClient->serviceSig;
+    serviceMsg.resourceInfoID    = SERVICE_RESOURCE_INFO;
+    serviceMsg.flags             = 0;
+    serviceMsg.seqID             = COM_CHAN_SEQ_NONE;
+
+    serviceMsg.res_info.serviceInfo.servicePID = getpid();
+    strncpy(serviceMsg.res_info.serviceInfo.serviceHostIP4, pHostIP4,
+            (sizeof(serviceMsg.res_info.serviceInfo.serviceHostIP4) - 1));
+
+    /* Send service information message ahead of queued queries */
+    if (queueMessage(pClient->sock, &pClient->dstAddr, pClient->pTxBatch, &serviceMsg) < 0)
+    {
+        return -1;
+    }
+
+    return (flushComChanClient(pClient) <= 0) ? -1 : 0;
+}
+
+void setComChanPushHandler(ComChan_Client_t  *pClient,
+                           ComChan_ReplyCb_t  pushCb,
+                           void              *pArg)
+{
+    if (pClient == NULL) { return; }
+
+    pClient->pushCb   = pushCb;
+    pClient->pPushArg = pArg;
+}
+
+uint32_t submitComChanQuery(ComChan_Client_t        *pClient,
+                            const ComChan_Message_t *pQuery,
+                            ComChan_ReplyCb_t        replyCb,
+                            void                    *pArg)
+{
+    uint32_t seqID;
+
+    ComChan_Message_t *pMessage;
+    ComChan_Pending_t *pPending;
+
+    if ( (pClient == NULL) ||
+         (pQuery  == NULL) ||
+         (replyCb == NULL) )
+    {
+        LOG_ERROR("Invalid input pointer arguments (%p, %p, %p)",
+                  pClient, pQuery,
+                  replyCb);
+        return COM_CHAN_SEQ_NONE;
+    }
+
+    /* Window is full while oldest query still occupies next slot */
+    seqID    = pClient->nextSeqID;
+    pPending = &pClient->pPending[seqID & pClient->pendingMask];
+    if (pPending->seqID != COM_CHAN_SEQ_NONE)
+    {
+        errno = EAGAIN;
+        return COM_CHAN_SEQ_NONE;
+    }
+
+    /* Queue query, batch goes out when full or on flush */
+    if (queueMessage(pClient->sock, &pClient->dstAddr, pClient->pTxBatch, pQuery) < 0)
+    {
+        return COM_CHAN_SEQ_NONE;
+    }
+
+    /* Stamp queued copy, caller's query stays untouched */
+    pMessage = getBatchMessage(pClient->pTxBatch, (pClient->pTxBatch->nMessages - 1));
+    pMessage->serviceSig = pClient->serviceSig;
+    pMessage->seqID      = seqID;
+
+    memset(pMessage->stageTimes, 0x00, sizeof(pMessage->stageTimes));
+    stampComChanStage(pMessage, COM_CHAN_STAGE_SEND);
+
+    pPending->seqID    = seqID;
+    pPending->deadline = getMonotonicNs() + pClient->timeoutNs;
+    pPending->replyCb  = replyCb;
+    pPending->pArg     = pArg;
+
+    pClient->nextSeqID = nextSeqID(seqID);
+    pClient->nOutstanding++;
+    pClient->stats.nSubmitted++;
+
+    /* First query in flight starts expiry timer, later ones are picked up on expiry */
+    if (pClient->armedDeadline == 0) { armExpiryTimer(pClient, pPending->deadline); }
+
+    return seqID;
+}
+
+uint32_t submitComChanFuture(ComChan_Client_t        *pClient,
+                             const ComChan_Message_t *pQuery,
+                             ComChan_Future_t        *pFuture)
+{
+    if (pFuture == NULL)
+    {
+        LOG_ERROR("Invalid input future %p",
+                  pFuture);
+        return COM_CHAN_SEQ_NONE;
+    }
+
+    pFuture->state = COM_CHAN_FUTURE_PENDING;
+    pFuture->seqID = submitComChanQuery(pClient, pQuery, completeFuture, pFuture);
+
+    return pFuture->seqID;
+}
+
+int cancelComChanQuery(ComChan_Client_t *pClient, uint32_t seqID)
+{
+    ComChan_Pending_t *pPending;
+
+    if ( (pClient == NULL) ||
+         (seqID   == COM_CHAN_SEQ_NONE) )
+    {
+        LOG_ERROR("Invalid input arguments (%p, %u)",
+                  pClient, seqID);
+        return -1;
+    }
+
+    pPending = &pClient->pPending[seqID & pClient->pendingMask];
+    if (pPending->seqID != seqID) { return -1; }
+
+    /* Release slot, reply (if any) is dropped as unmatched */
+    pPending->seqID = COM_CHAN_SEQ_NONE;
+    pClient->nOutstanding--;
+
+    return 0;
+}
+
+int flushComChanClient(ComChan_Client_t *pClient)
+{
+    if (pClient == NULL)
+    {
+        LOG_ERROR("Invalid input client %p",
+                  pClient);
+        return -1;
+    }
+
+    if (pClient->pTxBatch->nMessages == 0) { return 0; }
+
+    return flushMessages(pClient->sock, &pClient->dstAddr, pClient->pTxBatch);
+}
+
+int handleComChanClient(ComChan_Client_t *pClient)
+{
+    int nMessages, nReceived = 0;
+    uint32_t idx;
+    uint64_t nExpirations;
+
+    ComChan_Message_t *pMessage;
+
+    if (pClient == NULL)
+    {
+        LOG_ERROR("Invalid input client %p",
+                  pClient);
+        return -1;
+    }
+
+    /* Drain netlink socket, batch by batch */
+    do
+    {
+        nMessages = receiveMsgBatch(pClient->sock, pClient->pRxBatch);
+        if (nMessages < 0) { return -1; }
+
+        for (idx = 0; idx < (uint32_t)nMessages; idx++)
+        {
+            pMessage = getBatchMessage(pClient->pRxBatch, idx);
+
+            stampComChanStage(pMessage, COM_CHAN_STAGE_REPLY_RECEIVED);
+            dispatchReply(pClient, pMessage);
+        }
+
+        nReceived += nMessages;
+    } while (nMessages == COM_NETLINK_MSG_BATCH);
+
+    /* Acknowledge expiry timer, it is re-armed for oldest outstanding query */
+    if (read(pClient->timerFD, &nExpirations, sizeof(nExpirations)) == sizeof(nExpirations))
+    {
+        pClient->armedDeadline = 0;
+    }
+
+    expireQueries(pClient);
+
+    /* Transmit follow-up queries submitted by callbacks */
+    flushComChanClient(pClient);
+
+    return nReceived;
+}
+
+int waitComChanFuture(ComChan_Client_t *pClient, ComChan_Future_t *pFuture)
+{
+    struct pollfd pollFD;
+
+    if ( (pClient == NULL) ||
+         (pFuture == NULL) ||
+         (pFuture->seqID == COM_CHAN_SEQ_NONE) )
+    {
+        LOG_ERROR("Invalid input arguments (%p, %p)",
+                  pClient, pFuture);
+        return -1;
+    }
+
+    if (flushComChanClient(pClient) < 0) { return -1; }
+
+    pollFD.fd     = pClient->epollFD;
+    pollFD.events = POLLIN;
+
+    /* Client timeout bounds the wait, query either completes or expires */
+    while (pFuture->state == COM_CHAN_FUTURE_PENDING)
+    {
+        if ( (poll(&pollFD, 1, -1) < 0) &&
+             (errno != EINTR) )
+        {
+            LOG_ERROR("Failed to wait for reply [%m]");
+            return -1;
+        }
+
+        if (handleComChanClient(pClient) < 0) { return -1; }
+    }
+
+    return (pFuture->state == COM_CHAN_FUTURE_READY) ? 0 : -1;
+}
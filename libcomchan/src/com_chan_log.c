@@ -0,0 +1,776 @@
+/**
+ * @file    com_chan_log.c
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Asynchronous logging; each thread owns a single producer
+ * single consumer ring of binary records, the log thread drains all
+ * rings, formats records and writes them in batches.
+ */
+
+
+// Library Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+// Module Includes
+#include "com_chan_log.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define LOG_RING_MASK           (COM_CHAN_LOG_RING_RECORDS - 1)
+#define LOG_BATCH_SZ            16384       // Bytes formatted per write()
+#define LOG_LINE_SZ             1024        // Bytes per formatted log line
+#define LOG_SPEC_SZ             32          // Bytes per conversion specification
+#define LOG_IDLE_NS             5000000L    // Log thread sleep when all rings are empty
+#define LOG_DROP_REPORT_NS      1000000000LL // Minimum interval between dropped records reports
+
+#define LOG_NSEC_PER_SEC        1000000000LL
+#define LOG_NSEC_PER_USEC       1000
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+typedef enum ComChan_LogArg_e
+{
+    LOG_ARG_INT = 0,
+    LOG_ARG_LONG,
+    LOG_ARG_LLONG,
+    LOG_ARG_SIZE,
+    LOG_ARG_INTMAX,
+    LOG_ARG_PTRDIFF,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_PTR,
+    LOG_ARG_STR
+} ComChan_LogArg_t;
+
+typedef struct ComChan_LogRecord_s
+{
+    int64_t                     timestamp;      ///< Wall clock time of call (ns)
+    const ComChan_LogFormat_t  *pFormat;        ///< Call site format descriptor
+    int                         savedErrno;     ///< errno at call, for %m
+    uint32_t                    strLen;         ///< Bytes used in strings
+    uint64_t                    args[COM_CHAN_LOG_MAX_ARGS]; ///< Raw arguments, string offsets for %s
+    char                        strings[COM_CHAN_LOG_STRINGS_SZ]; ///< Copied %s arguments
+} ComChan_LogRecord_t;
+
+typedef struct ComChan_LogRing_s
+{
+    uint32_t                head;               ///< Next record to write (owner thread)
+    uint32_t                inUse;              ///< Ring claimed by a live thread
+    uint64_t                nDropped;           ///< Records dropped on full ring (owner thread)
+    uint8_t                 pad0[48];           ///< Keep producer and consumer indexes apart
+
+    uint32_t                tail;               ///< Next record to read (log thread)
+    uint8_t                 pad1[60];
+
+    ComChan_LogRecord_t     records[COM_CHAN_LOG_RING_RECORDS]; ///< Record slots
+} ComChan_LogRing_t;
+
+
+//*************************************
+// Module Utility Functions
+//*************************************
+static int parseLogFormat(ComChan_LogFormat_t *pFormat);
+static void createRingKey(void);
+static ComChan_LogRing_t* getThreadRing(void);
+static void releaseThreadRing(void *pArg);
+static int64_t getWallTime(void);
+static int formatLogRecord(const ComChan_LogRecord_t *pRecord, char *pBuffer, int bufferSz);
+static int formatLogPrefix(const ComChan_LogFormat_t *pFormat, int64_t timestamp, char *pBuffer, int bufferSz);
+static void writeLogBuffer(const char *pBuffer, int length);
+static int drainLogRings(char *pBatch, int *pBatchLen);
+static void* runLogThread(void *pArg);
+static void stopLogAtExit(void);
+
+
+//*************************************
+// Module Local Variables
+//*************************************
+static const char *logLevelNames[] = { "ERROR", "WARNING", "INFO", "DEBUG" };
+
+static ComChan_LogRing_t *pLogRings[COM_CHAN_LOG_RINGS_MAX];
+static uint32_t nLogRings = 0;
+
+static __thread ComChan_LogRing_t *pThreadRing = NULL;
+static __thread int threadRingless = 0;
+
+static pthread_key_t ringKey;
+static pthread_once_t ringKeyOnce = PTHREAD_ONCE_INIT;
+
+static pthread_t logThread;
+static int logFD = STDOUT_FILENO;
+static int logRunning = 0;
+static int logExitRegistered = 0;
+
+static uint64_t nLogWritten = 0;
+static uint64_t nLogSynchronous = 0;
+static uint64_t nLogDroppedReported = 0;
+
+static ComChan_LogFormat_t dropFormat =
+    { COM_CHAN_LOG_WARNING, __LINE__, "runLogThread", "%llu log records dropped on full rings", 1, { LOG_ARG_LLONG } };
+
+
+//*************************************
+// Module Utility Functions
+//*************************************
+static int parseLogFormat(ComChan_LogFormat_t *pFormat)
+{
+    int nArgs = 0;
+    int isLong, isLongLong, isSize, isIntmax, isPtrdiff, isLongDouble;
+
+    const char *pChar = pFormat->pFormat;
+
+    while ((pChar = strchr(pChar, '%')) != NULL)
+    {
+        pChar++;
+        if (*pChar == '%') { pChar++; continue; }
+
+        /* Flags, width and precision; '*' consumes an int argument */
+        while (strchr("-+ #0'", *pChar) && (*pChar != '\0')) { pChar++; }
+
+        if (*pChar == '*')
+        {
+            if (nArgs == COM_CHAN_LOG_MAX_ARGS) { return COM_CHAN_LOG_UNSUPPORTED; }
+            pFormat->argTypes[nArgs++] = LOG_ARG_INT;
+            pChar++;
+        }
+        while ((*pChar >= '0') && (*pChar <= '9')) { pChar++; }
+
+        if (*pChar == '.')
+        {
+            pChar++;
+            if (*pChar == '*')
+            {
+                if (nArgs == COM_CHAN_LOG_MAX_ARGS) { return COM_CHAN_LOG_UNSUPPORTED; }
+                pFormat->argTypes[nArgs++] = LOG_ARG_INT;
+                pChar++;
+            }
+            while ((*pChar >= '0') && (*pChar <= '9')) { pChar++; }
+        }
+
+        /* Length modifier, hh and h arguments are promoted to int */
+        isLong = isLongLong = isSize = isIntmax = isPtrdiff = isLongDouble = 0;
+        while (strchr("hlLqjzt", *pChar) && (*pChar != '\0'))
+        {
+            switch (*pChar)
+            {
+                case 'l': if (isLong) { isLongLong = 1; } isLong = 1; break;
+                case 'q': isLongLong = 1; break;
+                case 'L': isLongDouble = 1; break;
+                case 'j': isIntmax = 1; break;
+                case 'z': isSize = 1; break;
+                case 't': isPtrdiff = 1; break;
+                default: break;
+            }
+            pChar++;
+        }
+
+        /* %m prints errno saved in record, no argument */
+        if (*pChar == 'm') { pChar++; continue; }
+
+        if (nArgs == COM_CHAN_LOG_MAX_ARGS) { return COM_CHAN_LOG_UNSUPPORTED; }
+
+        switch (*pChar)
+        {
+            case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+                if (isLongLong)     { pFormat->argTypes[nArgs++] = LOG_ARG_LLONG; }
+                else if (isLong)    { pFormat->argTypes[nArgs++] = LOG_ARG_LONG; }
+                else if (isSize)    { pFormat->argTypes[nArgs++] = LOG_ARG_SIZE; }
+                else if (isIntmax)  { pFormat->argTypes[nArgs++] = LOG_ARG_INTMAX; }
+                else if (isPtrdiff) { pFormat->argTypes[nArgs++] = LOG_ARG_PTRDIFF; }
+                else                { pFormat->argTypes[nArgs++] = LOG_ARG_INT; }
+                break;
+
+            case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+                if (isLongDouble) { return COM_CHAN_LOG_UNSUPPORTED; }
+                pFormat->argTypes[nArgs++] = LOG_ARG_DOUBLE;
+                break;
+
+            case 's':
+                if (isLong) { return COM_CHAN_LOG_UNSUPPORTED; }
+                pFormat->argTypes[nArgs++] = LOG_ARG_STR;
+                break;
+
+            case 'p':
+                pFormat->argTypes[nArgs++] = LOG_ARG_PTR;
+                break;
+
+            default:
+                return COM_CHAN_LOG_UNSUPPORTED;
+        }
+
+        pChar++;
+    }
+
+    return nArgs;
+}
+
+static void createRingKey(void)
+{
+    pthread_key_create(&ringKey, releaseThreadRing);
+}
+
+static ComChan_LogRing_t* getThreadRing(void)
+{
+    uint32_t slot, nRings;
+    uint32_t expected;
+
+    ComChan_LogRing_t *pRing;
+
+    if (pThreadRing != NULL) { return pThreadRing; }
+    if (threadRingless)      { return NULL; }
+
+    pthread_once(&ringKeyOnce, createRingKey);
+
+    /* Reuse ring released by an exited thread, records left in it are still drained */
+    nRings = __atomic_load_n(&nLogRings, __ATOMIC_ACQUIRE);
+    for (slot = 0; slot < nRings; slot++)
+    {
+        pRing = __atomic_load_n(&pLogRings[slot], __ATOMIC_ACQUIRE);
+        if (pRing == NULL) { continue; }
+
+        expected = 0;
+        if (__atomic_compare_exchange_n(&pRing->inUse, &expected, 1, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+        {
+            pThreadRing = pRing;
+            pthread_setspecific(ringKey, pRing);
+            return pRing;
+        }
+    }
+
+    slot = __atomic_fetch_add(&nLogRings, 1, __ATOMIC_ACQ_REL);
+    if (slot >= COM_CHAN_LOG_RINGS_MAX)
+    {
+        __atomic_fetch_sub(&nLogRings, 1, __ATOMIC_ACQ_REL);
+        threadRingless = 1;
+        return NULL;
+    }
+
+    pRing = (ComChan_LogRing_t *)calloc(1, sizeof(ComChan_LogRing_t));
+    if (pRing == NULL)
+    {
+        /* Slot stays reserved and empty, log thread skips it */
+        threadRingless = 1;
+        return NULL;
+    }
+
+    pRing->inUse = 1;
+    __atomic_store_n(&pLogRings[slot], pRing, __ATOMIC_RELEASE);
+
+    pThreadRing = pRing;
+    pthread_setspecific(ringKey, pRing);
+
+    return pRing;
+}
+
+static void releaseThreadRing(void *pArg)
+{
+    ComChan_LogRing_t *pRing = (ComChan_LogRing_t *)pArg;
+
+    __atomic_store_n(&pRing->inUse, 0, __ATOMIC_RELEASE);
+}
+
+static int64_t getWallTime(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    return ((int64_t)now.tv_sec * LOG_NSEC_PER_SEC) + now.tv_nsec;
+}
+
+static int formatLogPrefix(const ComChan_LogFormat_t *pFormat, int64_t timestamp, char *pBuffer, int bufferSz)
+{
+    int length;
+
+    length = snprintf(pBuffer, bufferSz, "%lld.%06lld %s - %s:%d :: ",
+                      (long long)(timestamp / LOG_NSEC_PER_SEC),
+                      (long long)((timestamp % LOG_NSEC_PER_SEC) / LOG_NSEC_PER_USEC),
+                      logLevelNames[pFormat->level & 0x03],
+                      pFormat->pFunc, pFormat->line);
+
+    return (length < bufferSz) ? length : (bufferSz - 1);
+}
+
+static int formatLogRecord(const ComChan_LogRecord_t *pRecord, char *pBuffer, int bufferSz)
+{
+    int arg = 0;
+    int length, specLen;
+    int written;
+
+    const char *pChar, *pSpec;
+    char spec[LOG_SPEC_SZ];
+    uint64_t value;
+
+    const ComChan_LogFormat_t *pFormat = pRecord->pFormat;
+
+    /* Leave room for newline */
+    bufferSz--;
+
+    length = formatLogPrefix(pFormat, pRecord->timestamp, pBuffer, bufferSz);
+
+    pChar = pFormat->pFormat;
+    while ((*pChar != '\0') && (length < bufferSz))
+    {
+        if (*pChar != '%')
+        {
+            pBuffer[length++] = *pChar++;
+            continue;
+        }
+
+        if (pChar[1] == '%')
+        {
+            pBuffer[length++] = '%';
+            pChar += 2;
+            continue;
+        }
+
+        /* Copy one conversion specification, '*' replaced by its argument */
+        pSpec = pChar++;
+        specLen = 0;
+        spec[specLen++] = *pSpec;
+
+        while ((*pChar != '\0') && (strchr("diouxXceEfFgGaAspm", *pChar) == NULL))
+        {
+            if (*pChar == '*')
+            {
+                specLen += snprintf(&spec[specLen], LOG_SPEC_SZ - specLen - 1, "%d",
+                                    (int)pRecord->args[arg++]);
+
+                /* snprintf returns untruncated length, keep room for conversion and NUL */
+                if (specLen > (LOG_SPEC_SZ - 2)) { specLen = (LOG_SPEC_SZ - 2); }
+            }
+            else if (specLen < (LOG_SPEC_SZ - 2))
+            {
+                spec[specLen++] = *pChar;
+            }
+            pChar++;
+        }
+        if (*pChar == '\0') { break; }
+
+        spec[specLen++] = *pChar;
+        spec[specLen]   = '\0';
+
+        written = 0;
+        if (*pChar == 'm')
+        {
+            errno = pRecord->savedErrno;
+            written = snprintf(&pBuffer[length], bufferSz - length, spec, 0);
+        }
+        else
+        {
+            value = pRecord->args[arg];
+
+            switch (pFormat->argTypes[arg])
+            {
+                case LOG_ARG_INT:
+                    written = snprintf(&pBuffer[length], bufferSz - length, spec, (int)value);
+                    break;
+                case LOG_ARG_LONG:
+                    written = snprintf(&pBuffer[length], bufferSz - length, spec, (long)value);
+                    break;
+                case LOG_ARG_LLONG:
+                    written = snprintf(&pBuffer[length], bufferSz - length, spec, (long long)value);
+                    break;
+                case LOG_ARG_SIZE:
+                    written = snprintf(&pBuffer[length], bufferSz - length, spec, (size_t)value);
+                    break;
+                case LOG_ARG_INTMAX:
+                    written = snprintf(&pBuffer[length], bufferSz - length, spec, (intmax_t)value);
+                    break;
+                case LOG_ARG_PTRDIFF:
+                    written = snprintf(&pBuffer[length], bufferSz - length, spec, (ptrdiff_t)value);
+                    break;
+                case LOG_ARG_DOUBLE:
+                {
+                    double real;
+
+                    memcpy(&real, &value, sizeof(double));
+                    written = snprintf(&pBuffer[length], bufferSz - length, spec, real);
+                    break;
+                }
+                case LOG_ARG_PTR:
+                    written = snprintf(&pBuffer[length], bufferSz - length, spec, (void *)(uintptr_t)value);
+                    break;
+                case LOG_ARG_STR:
+                    written = snprintf(&pBuffer[length], bufferSz - length, spec, &pRecord->strings[value]);
+                    break;
+                default:
+                    break;
+            }
+            arg++;
+        }
+
+        if (written > 0)
+        {
+            length += written;
+            if (length > bufferSz) { length = bufferSz; }
+        }
+        pChar++;
+    }
+
+    pBuffer[length++] = '\n';
+
+    return length;
+}
+
+static void writeLogBuffer(const char *pBuffer, int length)
+{
+    ssize_t written;
+
+    while (length > 0)
+    {
+        written = write(logFD, pBuffer, length);
+        if (written < 0)
+        {
+            if (errno == EINTR) { continue; }
+            return;
+        }
+
+        pBuffer += written;
+        length  -= written;
+    }
+}
+
+static int drainLogRings(char *pBatch, int *pBatchLen)
+{
+    int nDrained = 0;
+    uint32_t slot, nRings;
+    uint32_t head, tail;
+
+    ComChan_LogRing_t *pRing;
+
+    nRings = __atomic_load_n(&nLogRings, __ATOMIC_ACQUIRE);
+    if (nRings > COM_CHAN_LOG_RINGS_MAX) { nRings = COM_CHAN_LOG_RINGS_MAX; }
+
+    for (slot = 0; slot < nRings; slot++)
+    {
+        pRing = __atomic_load_n(&pLogRings[slot], __ATOMIC_ACQUIRE);
+        if (pRing == NULL) { continue; }
+
+        tail = pRing->tail;
+        head = __atomic_load_n(&pRing->head, __ATOMIC_ACQUIRE);
+
+        while (tail != head)
+        {
+            if ((LOG_BATCH_SZ - *pBatchLen) < LOG_LINE_SZ)
+            {
+                writeLogBuffer(pBatch, *pBatchLen);
+                *pBatchLen = 0;
+            }
+
+            *pBatchLen += formatLogRecord(&pRing->records[tail & LOG_RING_MASK],
+                                          &pBatch[*pBatchLen], LOG_LINE_SZ);
+            tail++;
+            nDrained++;
+        }
+
+        /* Hand slots back to producer once formatted */
+        __atomic_store_n(&pRing->tail, tail, __ATOMIC_RELEASE);
+    }
+
+    __atomic_fetch_add(&nLogWritten, nDrained, __ATOMIC_RELAXED);
+
+    return nDrained;
+}
+
+static void* runLogThread(void *pArg)
+{
+    int running;
+    int nDrained;
+    int batchLen = 0;
+    int64_t lastReport = 0;
+    uint64_t nDropped;
+
+    char *pBatch;
+    struct timespec idle = { 0, LOG_IDLE_NS };
+    ComChan_LogStats_t stats;
+    ComChan_LogRecord_t dropRecord = { .pFormat = &dropFormat };
+
+    (void)pArg;
+
+    pBatch = (char *)malloc(LOG_BATCH_SZ);
+    if (pBatch == NULL)
+    {
+        printf("ERROR - %s:%d :: Failed to allocate log batch [%m]\n",
+                __func__, __LINE__);
+        return NULL;
+    }
+
+    do
+    {
+        running  = __atomic_load_n(&logRunning, __ATOMIC_ACQUIRE);
+        nDrained = drainLogRings(pBatch, &batchLen);
+
+        /* Dropped records are counted by producers, reported here at most once a second */
+        getComChanLogStats(&stats);
+        nDropped = stats.nDropped - nLogDroppedReported;
+        if ( (nDropped > 0) &&
+             ((getWallTime() - lastReport) >= LOG_DROP_REPORT_NS) )
+        {
+            if ((LOG_BATCH_SZ - batchLen) < LOG_LINE_SZ)
+            {
+                writeLogBuffer(pBatch, batchLen);
+                batchLen = 0;
+            }
+            dropRecord.timestamp = getWallTime();
+            dropRecord.args[0]   = nDropped;
+            batchLen += formatLogRecord(&dropRecord, &pBatch[batchLen], LOG_LINE_SZ);
+
+            nLogDroppedReported += nDropped;
+            lastReport = getWallTime();
+        }
+
+        if (batchLen > 0)
+        {
+            writeLogBuffer(pBatch, batchLen);
+            batchLen = 0;
+        }
+
+        if (nDrained == 0) { nanosleep(&idle, NULL); }
+
+    } while (running || (nDrained > 0));
+
+    free(pBatch);
+
+    return NULL;
+}
+
+static void stopLogAtExit(void)
+{
+    stopComChanLog();
+}
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+int startComChanLog(int fd)
+{
+    int status;
+
+    if (fd < 0)
+    {
+        printf("ERROR - %s:%d :: Invalid log descriptor %d\n",
+                __func__, __LINE__,
+                fd);
+        return -1;
+    }
+
+    if (__atomic_load_n(&logRunning, __ATOMIC_ACQUIRE))
+    {
+        printf("ERROR - %s:%d :: Log thread already running\n",
+                __func__, __LINE__);
+        return -1;
+    }
+
+    /* Log lines are written around stdio, drain what is pending first */
+    fflush(stdout);
+
+    logFD = fd;
+    __atomic_store_n(&logRunning, 1, __ATOMIC_RELEASE);
+
+    status = pthread_create(&logThread, NULL, runLogThread, NULL);
+    if (status != 0)
+    {
+        errno = status;
+        printf("ERROR - %s:%d :: Failed to create log thread [%m]\n",
+                __func__, __LINE__);
+        __atomic_store_n(&logRunning, 0, __ATOMIC_RELEASE);
+        return -1;
+    }
+
+    /* Records logged right before exit are drained too */
+    if (logExitRegistered == 0)
+    {
+        atexit(stopLogAtExit);
+        logExitRegistered = 1;
+    }
+
+    return 0;
+}
+
+int stopComChanLog(void)
+{
+    if (__atomic_exchange_n(&logRunning, 0, __ATOMIC_ACQ_REL) == 0)
+    {
+        return 0;
+    }
+
+    fflush(stdout);
+
+    /* Log thread makes a last pass over all rings before returning */
+    pthread_join(logThread, NULL);
+
+    return 0;
+}
+
+void writeComChanLog(ComChan_LogFormat_t *pFormat, ...)
+{
+    int savedErrno = errno;
+    int nArgs, arg;
+    int length;
+    uint32_t head, tail;
+    uint32_t strLen;
+
+    va_list args;
+    const char *pString;
+    char line[LOG_LINE_SZ];
+
+    ComChan_LogRing_t   *pRing;
+    ComChan_LogRecord_t *pRecord;
+
+    /* Arguments parsed once per call site, racing threads parse to same result */
+    nArgs = __atomic_load_n(&pFormat->nArgs, __ATOMIC_ACQUIRE);
+    if (nArgs == COM_CHAN_LOG_UNPARSED)
+    {
+        nArgs = parseLogFormat(pFormat);
+        __atomic_store_n(&pFormat->nArgs, nArgs, __ATOMIC_RELEASE);
+    }
+
+    pRing = NULL;
+    if ( (nArgs != COM_CHAN_LOG_UNSUPPORTED) &&
+         __atomic_load_n(&logRunning, __ATOMIC_ACQUIRE) )
+    {
+        pRing = getThreadRing();
+    }
+
+    /* No log thread, no ring or format not deferrable; format and write in caller context */
+    if (pRing == NULL)
+    {
+        length = formatLogPrefix(pFormat, getWallTime(), line, sizeof(line) - 1);
+
+        errno = savedErrno;
+        va_start(args, pFormat);
+        length += vsnprintf(&line[length], sizeof(line) - 1 - length, pFormat->pFormat, args);
+        va_end(args);
+
+        if (length > (int)(sizeof(line) - 2)) { length = sizeof(line) - 2; }
+        line[length++] = '\n';
+
+        fflush(stdout);
+        writeLogBuffer(line, length);
+
+        __atomic_fetch_add(&nLogSynchronous, 1, __ATOMIC_RELAXED);
+        errno = savedErrno;
+        return;
+    }
+
+    head = pRing->head;
+    tail = __atomic_load_n(&pRing->tail, __ATOMIC_ACQUIRE);
+
+    /* Never block caller, count record as dropped */
+    if ((head - tail) >= COM_CHAN_LOG_RING_RECORDS)
+    {
+        __atomic_store_n(&pRing->nDropped, pRing->nDropped + 1, __ATOMIC_RELAXED);
+        errno = savedErrno;
+        return;
+    }
+
+    pRecord = &pRing->records[head & LOG_RING_MASK];
+
+    pRecord->timestamp  = getWallTime();
+    pRecord->pFormat    = pFormat;
+    pRecord->savedErrno = savedErrno;
+
+    strLen = 0;
+
+    va_start(args, pFormat);
+    for (arg = 0; arg < nArgs; arg++)
+    {
+        switch (pFormat->argTypes[arg])
+        {
+            case LOG_ARG_INT:     pRecord->args[arg] = (uint64_t)(int64_t)va_arg(args, int); break;
+            case LOG_ARG_LONG:    pRecord->args[arg] = (uint64_t)(int64_t)va_arg(args, long); break;
+            case LOG_ARG_LLONG:   pRecord->args[arg] = (uint64_t)va_arg(args, long long); break;
+            case LOG_ARG_SIZE:    pRecord->args[arg] = (uint64_t)va_arg(args, size_t); break;
+            case LOG_ARG_INTMAX:  pRecord->args[arg] = (uint64_t)va_arg(args, intmax_t); break;
+            case LOG_ARG_PTRDIFF: pRecord->args[arg] = (uint64_t)va_arg(args, ptrdiff_t); break;
+            case LOG_ARG_PTR:     pRecord->args[arg] = (uint64_t)(uintptr_t)va_arg(args, void *); break;
+
+            case LOG_ARG_DOUBLE:
+            {
+                double real = va_arg(args, double);
+
+                memcpy(&pRecord->args[arg], &real, sizeof(double));
+                break;
+            }
+
+            /* Strings may not outlive the call, copy them into record */
+            case LOG_ARG_STR:
+            {
+                size_t copyLen;
+
+                pString = va_arg(args, const char *);
+                if (pString == NULL) { pString = "(null)"; }
+
+                copyLen = strnlen(pString, COM_CHAN_LOG_STRINGS_SZ - 1 - strLen);
+                memcpy(&pRecord->strings[strLen], pString, copyLen);
+                pRecord->strings[strLen + copyLen] = '\0';
+
+                pRecord->args[arg] = strLen;
+                strLen += copyLen;
+                if (strLen < (COM_CHAN_LOG_STRINGS_SZ - 1)) { strLen++; }
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+    va_end(args);
+
+    pRecord->strLen = strLen;
+
+    /* Publish record to log thread */
+    __atomic_store_n(&pRing->head, head + 1, __ATOMIC_RELEASE);
+
+    errno = savedErrno;
+}
+
+int getComChanLogStats(ComChan_LogStats_t *pStats)
+{
+    uint32_t slot, nRings;
+
+    ComChan_LogRing_t *pRing;
+
+    if (pStats == NULL)
+    {
+        printf("ERROR - %s:%d :: Invalid input stats %p\n",
+                __func__, __LINE__,
+                pStats);
+        return -1;
+    }
+
+    memset(pStats, 0x00, sizeof(ComChan_LogStats_t));
+
+    nRings = __atomic_load_n(&nLogRings, __ATOMIC_ACQUIRE);
+    if (nRings > COM_CHAN_LOG_RINGS_MAX) { nRings = COM_CHAN_LOG_RINGS_MAX; }
+
+    for (slot = 0; slot < nRings; slot++)
+    {
+        pRing = __atomic_load_n(&pLogRings[slot], __ATOMIC_ACQUIRE);
+        if (pRing == NULL) { continue; }
+
+        pStats->nDropped += __atomic_load_n(&pRing->nDropped, __ATOMIC_RELAXED);
+        pStats->nRings++;
+    }
+
+    pStats->nWritten     = __atomic_load_n(&nLogWritten, __ATOMIC_RELAXED);
+    pStats->nSynchronous = __atomic_load_n(&nLogSynchronous, __ATOMIC_RELAXED);
+
+    return 0;
+}
@@ -0,0 +1,390 @@
+/**
+ * @file    com_chan_socket.c
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Communication channel netlink transport shared by
+ * resource, disk and memory watcher services.
+ */
+
+
+// Library Includes
+#define _GNU_SOURCE                         // recvmmsg(), sendmmsg()
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/types.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include <linux/netlink.h>
+
+// Module Includes
+#include "com_chan_socket.h"
+#include "com_chan_log.h"
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+ComChan_MsgBatch_t* createMsgBatch(int maxPayloadSz)
+{
+    uint32_t idx;
+
+    struct nlmsghdr *pNLMsgHdr;
+    ComChan_MsgBatch_t *pBatch;
+
+    /* Allocate message batch */
+    pBatch = (ComChan_MsgBatch_t *)calloc(1, sizeof(ComChan_MsgBatch_t));
+    if (pBatch == NULL)
+    {
+        LOG_ERROR("Failed to allocate message batch");
+        return NULL;
+    }
+
+    /* Allocate contiguous netlink message buffers */
+    pBatch->bufferSz = NLMSG_SPACE(maxPayloadSz);
+    pBatch->pBuffers = (uint8_t *)calloc(COM_NETLINK_MSG_BATCH, pBatch->bufferSz);
+    if (pBatch->pBuffers == NULL)
+    {
+        LOG_ERROR("Failed to allocate message batch buffers");
+        free(pBatch);
+        return NULL;
+    }
+
+    for (idx = 0; idx < COM_NETLINK_MSG_BATCH; idx++)
+    {
+        pNLMsgHdr = (struct nlmsghdr *)(pBatch->pBuffers + (idx * pBatch->bufferSz));
+
+        /* Initialize netlink message header */
+        pNLMsgHdr->nlmsg_len   = pBatch->bufferSz;
+        pNLMsgHdr->nlmsg_pid   = COM_NETLINK_SOURCE;
+        pNLMsgHdr->nlmsg_flags = 0;
+
+        /* Populate I/O vector and message header, single I/O vector per message */
+        pBatch->ioVectors[idx].iov_base = (void *)pNLMsgHdr;
+        pBatch->ioVectors[idx].iov_len  = pBatch->bufferSz;
+
+        pBatch->msgHdrs[idx].msg_hdr.msg_iov    = &pBatch->ioVectors[idx];
+        pBatch->msgHdrs[idx].msg_hdr.msg_iovlen = 1;
+    }
+
+    return pBatch;
+}
+
+struct nlmsghdr* createNLMsgHdr(int maxPayloadSz)
+{
+    struct nlmsghdr *pNLMsgHdr;
+
+    /* Allocate netlink message header */
+    pNLMsgHdr = (struct nlmsghdr *)malloc( NLMSG_SPACE(maxPayloadSz) );
+    if (pNLMsgHdr == NULL)
+    {
+        LOG_ERROR("Failed to allocate netlink message header");
+        return NULL;
+    }
+
+    /* Initialize netlink message header */
+    memset(pNLMsgHdr, 0, NLMSG_SPACE(maxPayloadSz));
+    pNLMsgHdr->nlmsg_len   = NLMSG_SPACE(maxPayloadSz);
+    pNLMsgHdr->nlmsg_pid   = COM_NETLINK_SOURCE;
+    pNLMsgHdr->nlmsg_flags = 0;
+
+    return pNLMsgHdr;
+}
+
+int createNLSocket(struct sockaddr_nl *pSrcAddr,
+                   struct sockaddr_nl *pDstAddr,
+                   uint32_t            portID)
+{
+    int sock;
+
+    if ( (pSrcAddr == NULL) ||
+         (pDstAddr == NULL) )
+    {
+        LOG_ERROR("Invalid input arguments (%p, %p)",
+                  pSrcAddr, pDstAddr);
+        return -1;
+    }
+
+    /* Create netlink socket */
+    sock = socket(PF_NETLINK, SOCK_RAW, COM_NETLINK_LKM);
+    if (sock < 0) { return -1; }
+
+    /* Initialize source and destination addresses */
+    memset(pSrcAddr, 0x00, sizeof(struct sockaddr_nl));
+    memset(pDstAddr, 0x00, sizeof(struct sockaddr_nl));
+
+    /* Populate source address information */
+    pSrcAddr->nl_family = AF_NETLINK;
+    pSrcAddr->nl_pid    = portID;
+
+    /* Populate destination address information */
+    pDstAddr->nl_family = AF_NETLINK;
+    pDstAddr->nl_pid    = COM_NETLINK_DESTINATION;
+
+    /* Bind socket to source address */
+    bind(sock, (struct sockaddr*)pSrcAddr, sizeof(struct sockaddr_nl));
+
+    return sock;
+}
+
+int destroyMsgBatch(ComChan_MsgBatch_t *pBatch)
+{
+    if (pBatch == NULL)
+    {
+        LOG_ERROR("Invalid input message batch %p",
+                  pBatch);
+        return -1;
+    }
+
+    /* Release message buffers and batch memory */
+    free(pBatch->pBuffers);
+    free(pBatch);
+
+    return 0;
+}
+
+int destroyNLMsgHdr(struct nlmsghdr *pNLMsgHdr)
+{
+    if (pNLMsgHdr == NULL)
+    {
+        LOG_ERROR("Invalid input netlink message header %p",
+                  pNLMsgHdr);
+        return -1;
+    }
+
+    /* Release netlink message header memory */
+    free(pNLMsgHdr);
+
+    return 0;
+}
+
+int destroyNLSocket(int sock)
+{
+    if (sock <= 0)
+    {
+        LOG_ERROR("Invalid input netlink socket %d",
+                  sock);
+        return -1;
+    }
+
+    close(sock);
+
+    return 0;
+}
+
+int flushMessages(const int                 sock,
+                  const struct sockaddr_nl *pDstAddr,
+                  ComChan_MsgBatch_t       *pBatch)
+{
+    int retVal = 0;
+    uint32_t idx, nSent = 0;
+
+    if ( (sock     <= 0)    ||
+         (pDstAddr == NULL) ||
+         (pBatch   == NULL) )
+    {
+        LOG_ERROR("Invalid input arguments (%d, %p, %p)",
+                  sock, pDstAddr, pBatch);
+        return -1;
+    }
+
+    for (idx = 0; idx < pBatch->nMessages; idx++)
+    {
+        pBatch->msgHdrs[idx].msg_hdr.msg_name    = (void *)pDstAddr;
+        pBatch->msgHdrs[idx].msg_hdr.msg_namelen = sizeof(struct sockaddr_nl);
+    }
+
+    /* Transmit queued messages, resume after partial transmission */
+    while (nSent < pBatch->nMessages)
+    {
+        retVal = sendmmsg(sock, &pBatch->msgHdrs[nSent], (pBatch->nMessages - nSent), 0);
+        if (retVal < 0)
+        {
+            if (errno == EINTR) { continue; }
+
+            LOG_ERROR("Failed to transmit messages on socket (%d) [%m]",
+                      sock);
+            break;
+        }
+
+        nSent += retVal;
+    }
+
+    pBatch->nMessages = 0;
+
+    return (retVal < 0) ? -1 : (int)nSent;
+}
+
+int queueMessage(const int                 sock,
+                 const struct sockaddr_nl *pDstAddr,
+                 ComChan_MsgBatch_t       *pBatch,
+                 const ComChan_Message_t  *pMessage)
+{
+    if ( (pBatch   == NULL) ||
+         (pMessage == NULL) )
+    {
+        LOG_ERROR("Invalid input pointer arguments (%p, %p)",
+                  pBatch, pMessage);
+        return -1;
+    }
+
+    /* Transmit batch if every message buffer is in use */
+    if ( (pBatch->nMessages == COM_NETLINK_MSG_BATCH) &&
+         (flushMessages(sock, pDstAddr, pBatch) < 0) )
+    {
+        return -1;
+    }
+
+    /* Copy message to next netlink buffer */
+    memcpy(getBatchMessage(pBatch, pBatch->nMessages), pMessage, sizeof(ComChan_Message_t));
+    pBatch->nMessages++;
+
+    return 0;
+}
+
+int receiveMsgBatch(const int           sock,
+                    ComChan_MsgBatch_t *pBatch)
+{
+    int nMessages, idx, nComplete = 0;
+    struct nlmsghdr *pNLMsgHdr;
+
+    if ( (sock   <= 0) ||
+         (pBatch == NULL) )
+    {
+        LOG_ERROR("Invalid input arguments (%d, %p)",
+                  sock, pBatch);
+        return -1;
+    }
+
+    /* Receive messages queued on netlink socket, without waiting for more */
+    nMessages = recvmmsg(sock, pBatch->msgHdrs, COM_NETLINK_MSG_BATCH, MSG_DONTWAIT, NULL);
+    if (nMessages < 0)
+    {
+        pBatch->nMessages = 0;
+
+        if ( (errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR) ) { return 0; }
+
+        /* Receive queue overran, dropped messages are lost but socket stays usable */
+        if (errno == ENOBUFS)
+        {
+            LOG_WARNING("Receive queue overrun on socket (%d), messages dropped",
+                        sock);
+            return 0;
+        }
+
+        LOG_ERROR("Failed to read from socket (%d) [%m]",
+                  sock);
+        return -1;
+    }
+
+    /* Drop short messages, buffer would otherwise be read with stale bytes of a previous message */
+    for (idx = 0; idx < nMessages; idx++)
+    {
+        pNLMsgHdr = (struct nlmsghdr *)(pBatch->pBuffers + (idx * pBatch->bufferSz));
+
+        if (!isCompleteMessage(pNLMsgHdr, pBatch->msgHdrs[idx].msg_len))
+        {
+            LOG_WARNING("Short message (%u bytes) dropped on socket (%d)",
+                        pBatch->msgHdrs[idx].msg_len, sock);
+            continue;
+        }
+
+        /* Keep complete messages contiguous at front of batch */
+        if (nComplete != idx)
+        {
+            memcpy((pBatch->pBuffers + (nComplete * pBatch->bufferSz)), pNLMsgHdr, pBatch->bufferSz);
+        }
+        nComplete++;
+    }
+
+    pBatch->nMessages = nComplete;
+
+    return nComplete;
+}
+
+int registerEvent(int epollFD, int eventFD)
+{
+    struct epoll_event epollEvent;
+
+    if ( (epollFD < 0) || (eventFD < 0) )
+    {
+        LOG_ERROR("Invalid input arguments for event registration (%d, %d)",
+                  epollFD, eventFD);
+        return -1;
+    }
+
+    /* Initialize event information */
+    memset((void *)&epollEvent, 0x00, sizeof(struct epoll_event));
+
+    /* Register reading event */
+    epollEvent.events = EPOLLIN;
+    epollEvent.data.fd = eventFD;
+
+    if (epoll_ctl(epollFD, EPOLL_CTL_ADD, eventFD, &epollEvent) < 0)
+    {
+        LOG_ERROR("Failed to register event [%m]");
+        return -1;
+    }
+
+    return 0;
+}
+
+int sendMessage(const int                 sock,
+                const struct sockaddr_nl *pDstAddr,
+                const struct nlmsghdr    *pNLMsgHdr,
+                const ComChan_Message_t  *pMessage)
+{
+    int retVal;
+
+    struct iovec ioVector;
+    struct msghdr msgHdr;
+
+    if (sock <= 0)
+    {
+        LOG_ERROR("Invalid input socket (%d) information",
+                  sock);
+        return -1;
+    }
+
+    if ( (pDstAddr  == NULL) ||
+         (pNLMsgHdr == NULL) ||
+         (pMessage  == NULL) )
+    {
+        LOG_ERROR("Invalid input pointer arguments (%p, %p, %p)",
+                  pDstAddr, pNLMsgHdr,
+                  pMessage);
+        return -1;
+    }
+
+    /* Copy message to netlink buffer */
+    memcpy(NLMSG_DATA(pNLMsgHdr), pMessage, sizeof(ComChan_Message_t));
+
+    /* Reset I/O vector and message header */
+    memset(&ioVector, 0x00, sizeof(ioVector));
+    memset(&msgHdr,   0x00, sizeof(msgHdr));
+
+    /* Populate I/O vector information */
+    ioVector.iov_base = (void *)pNLMsgHdr;
+    ioVector.iov_len = pNLMsgHdr->nlmsg_len;
+
+    /* Populate message header */
+    msgHdr.msg_name = (void *)pDstAddr;
+    msgHdr.msg_namelen = sizeof(struct sockaddr_nl);
+    msgHdr.msg_iov = &ioVector;
+    msgHdr.msg_iovlen = 1;                          // Single I/O vector
+
+    retVal = sendmsg(sock, &msgHdr, 0);
+    if (retVal < 0)
+    {
+        LOG_ERROR("Failed to transmit message on socket (%d) [%m]",
+                  sock);
+    }
+
+    return retVal;
+}
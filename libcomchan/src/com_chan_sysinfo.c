@@ -0,0 +1,95 @@
+/**
+ * @file    com_chan_sysinfo.c
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Local disk (root file system) and memory (physical pages)
+ * collectors.
+ */
+
+
+// Library Includes
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <sys/statvfs.h>
+
+// Module Includes
+#include "com_chan_sysinfo.h"
+#include "com_chan_log.h"
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+int getDiskMemoryInfo(RW_DiskInfo_t *pDiskInfo)
+{
+    struct statvfs diskStats;
+
+    if (pDiskInfo == NULL)
+    {
+        LOG_ERROR("Invalid input argument for disk information (%p)",
+                  pDiskInfo);
+        return -1;
+    }
+
+    /* Get disk statistics */
+    if (statvfs("/", &diskStats) < 0)
+    {
+        LOG_ERROR("Failed to get disk statistics [%m]");
+        return -1;
+    }
+
+    /* Compute system's total disk size in bytes */
+    pDiskInfo->systemMemory = (diskStats.f_bsize * diskStats.f_blocks);
+
+    /* Compute system's available disk size in bytes */
+    pDiskInfo->freeMemory = (diskStats.f_bsize * diskStats.f_bfree);
+
+    return 0;
+}
+
+int getSystemMemoryInfo(RW_MemoryInfo_t *pMemoryInfo)
+{
+    int64_t nPages, szPage;
+
+    if (pMemoryInfo == NULL)
+    {
+        LOG_ERROR("Invalid input argument for memory information (%p)",
+                  pMemoryInfo);
+        return -1;
+    }
+
+    /* Get system's page size in bytes */
+    szPage = sysconf(_SC_PAGESIZE);
+    if (szPage < 1)
+    {
+        LOG_ERROR("Failed to get page size [%m]");
+        return -1;
+    }
+
+    /* Get system's total number pages */
+    nPages = sysconf(_SC_PHYS_PAGES);
+    if (nPages < 0)
+    {
+        LOG_ERROR("Failed to get total number of pages [%m]");
+        return -1;
+    }
+
+    /* Compute system's total memory in bytes */
+    pMemoryInfo->systemMemory = (nPages * szPage);
+
+    /* Get system's available number of pages */
+    nPages = sysconf(_SC_AVPHYS_PAGES);
+    if (nPages < 0)
+    {
+        LOG_ERROR("Failed to get available number of pages [%m]");
+        return -1;
+    }
+
+    /* Compute system's available memory in bytes */
+    pMemoryInfo->freeMemory = (nPages * szPage);
+
+    return 0;
+}
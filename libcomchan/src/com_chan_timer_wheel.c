@@ -0,0 +1,590 @@
+/**
+ * @file    com_chan_timer_wheel.c
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Hierarchical timing wheel driven by a single timerfd.
+ * Timers are kept in O(1) slots per level with an occupancy bitmap,
+ * the timerfd is armed at the exact nanosecond of the earliest
+ * expiry (or the next cascade), so periodic schedules run on time
+ * regardless of how many are configured.
+ */
+
+
+// Library Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+#include <sys/timerfd.h>
+
+// Module Includes
+#include "com_chan_timer_wheel.h"
+#include "com_chan_log.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define TW_SLOTS                (1U << TW_LEVEL_BITS)
+#define TW_SLOT_MASK            (TW_SLOTS - 1)
+
+#define TW_LEVEL_SHIFT(L)       ((L) * TW_LEVEL_BITS)
+#define TW_LEVEL_SPAN(L)        (1ULL << TW_LEVEL_SHIFT((L) + 1))   // Ticks covered up to level L
+#define TW_WHEEL_SPAN           TW_LEVEL_SPAN(TW_LEVELS - 1)
+
+#define TW_LEVEL_DEFERRED       -1          // Due tick reached, deadline not yet
+#define TW_LEVEL_NONE           -2          // Not linked (free)
+
+#define TW_TICK_NONE            UINT64_MAX
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+typedef struct TW_Timer_s
+{
+    struct TW_Timer_s      *pNext;              ///< Next timer in slot/list
+    struct TW_Timer_s      *pPrev;              ///< Previous timer in slot/list
+
+    int16_t                 level;              ///< Wheel level, TW_LEVEL_* otherwise
+    uint16_t                slot;               ///< Slot within level
+    uint32_t                active;             ///< Set while scheduled
+
+    int64_t                 deadlineNs;         ///< Next expiry (CLOCK_MONOTONIC)
+    int64_t                 periodNs;           ///< Period, 0 for one-shot
+    int64_t                 lastFireNs;         ///< Time of previous expiration
+
+    TW_TimerCb_t            timerCb;            ///< Expiration callback
+    void                   *pArg;               ///< Callback argument
+
+    TW_TimerStats_t         stats;              ///< Lateness and jitter statistics
+} TW_Timer_t;
+
+struct TW_TimerWheel_s
+{
+    int                     timerFD;            ///< Wheel timerfd
+    int64_t                 armedNs;            ///< Expiry timerfd is armed at, 0 if disarmed
+
+    uint64_t                curTick;            ///< Next tick to process
+
+    uint64_t                bitmaps[TW_LEVELS]; ///< Occupied slots per level
+    TW_Timer_t             *pSlots[TW_LEVELS][TW_SLOTS]; ///< Slot lists per level
+    TW_Timer_t             *pDeferred;          ///< Due timers ahead of their deadline
+
+    uint32_t                maxTimers;          ///< Number of preallocated timers
+    TW_Timer_t             *pTimers;            ///< Preallocated timers
+    TW_Timer_t             *pFree;              ///< Free timers list
+};
+
+
+//*************************************
+// Module Utility Functions
+//*************************************
+static inline int64_t  _GetCurrentTimeNs(void);
+static inline uint64_t _RotateRight(uint64_t value, uint32_t shift);
+
+static void linkTimer(TW_TimerWheel_t *pWheel, TW_Timer_t *pTimer, int16_t level, uint16_t slot);
+static void unlinkTimer(TW_TimerWheel_t *pWheel, TW_Timer_t *pTimer);
+static void insertTimer(TW_TimerWheel_t *pWheel, TW_Timer_t *pTimer);
+
+static void cascadeTimers(TW_TimerWheel_t *pWheel, uint64_t tick);
+static void fireTimer(TW_TimerWheel_t *pWheel, TW_Timer_t *pTimer, int64_t nowNs);
+
+static uint64_t getNextTick(const TW_TimerWheel_t *pWheel, uint64_t *pCascadeTick);
+static int advanceTimerWheel(TW_TimerWheel_t *pWheel, int64_t nowNs);
+static int armTimerWheel(TW_TimerWheel_t *pWheel);
+
+
+static inline int64_t _GetCurrentTimeNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((int64_t)ts.tv_sec * TW_NSEC_PER_SEC) + ts.tv_nsec;
+}
+
+static inline uint64_t _RotateRight(uint64_t value, uint32_t shift)
+{
+    return (shift == 0) ? value : ((value >> shift) | (value << (64 - shift)));
+}
+
+static void linkTimer(TW_TimerWheel_t *pWheel, TW_Timer_t *pTimer, int16_t level, uint16_t slot)
+{
+    TW_Timer_t **ppHead = (level >= 0) ? &pWheel->pSlots[level][slot] : &pWheel->pDeferred;
+
+    pTimer->level = level;
+    pTimer->slot  = slot;
+    pTimer->pPrev = NULL;
+    pTimer->pNext = *ppHead;
+
+    if (*ppHead != NULL) { (*ppHead)->pPrev = pTimer; }
+    *ppHead = pTimer;
+
+    if (level >= 0) { pWheel->bitmaps[level] |= (1ULL << slot); }
+}
+
+static void unlinkTimer(TW_TimerWheel_t *pWheel, TW_Timer_t *pTimer)
+{
+    TW_Timer_t **ppHead;
+
+    if (pTimer->level == TW_LEVEL_NONE) { return; }
+
+    ppHead = (pTimer->level >= 0) ? &pWheel->pSlots[pTimer->level][pTimer->slot] : &pWheel->pDeferred;
+
+    if (pTimer->pPrev != NULL) { pTimer->pPrev->pNext = pTimer->pNext; }
+    else                       { *ppHead = pTimer->pNext; }
+
+    if (pTimer->pNext != NULL) { pTimer->pNext->pPrev = pTimer->pPrev; }
+
+    if ( (pTimer->level >= 0) &&
+         (*ppHead == NULL) )
+    {
+        pWheel->bitmaps[pTimer->level] &= ~(1ULL << pTimer->slot);
+    }
+
+    pTimer->pNext = NULL;
+    pTimer->pPrev = NULL;
+    pTimer->level = TW_LEVEL_NONE;
+}
+
+static void insertTimer(TW_TimerWheel_t *pWheel, TW_Timer_t *pTimer)
+{
+    int16_t  level;
+    uint64_t expiryTick, delta;
+
+    /* Past deadlines land in current tick and fire on next advance */
+    expiryTick = (pTimer->deadlineNs > 0) ? ((uint64_t)pTimer->deadlineNs >> TW_TICK_SHIFT) : 0;
+    if (expiryTick < pWheel->curTick) { expiryTick = pWheel->curTick; }
+
+    /* Delays beyond wheel span park in top level and cascade again */
+    delta = expiryTick - pWheel->curTick;
+    if (delta >= TW_WHEEL_SPAN)
+    {
+        delta      = TW_WHEEL_SPAN - 1;
+        expiryTick = pWheel->curTick + delta;
+    }
+
+    for (level = 0; level < (TW_LEVELS - 1); level++)
+    {
+        if (delta < TW_LEVEL_SPAN(level)) { break; }
+    }
+
+    linkTimer(pWheel, pTimer, level, (uint16_t)((expiryTick >> TW_LEVEL_SHIFT(level)) & TW_SLOT_MASK));
+}
+
+static void cascadeTimers(TW_TimerWheel_t *pWheel, uint64_t tick)
+{
+    int16_t level;
+    uint16_t slot;
+    TW_Timer_t *pTimer, *pList;
+
+    /* Level L slot is due when all lower level bits of tick wrap to zero */
+    for (level = 1; level < TW_LEVELS; level++)
+    {
+        if ((tick & ((1ULL << TW_LEVEL_SHIFT(level)) - 1)) != 0) { break; }
+
+        slot = (uint16_t)((tick >> TW_LEVEL_SHIFT(level)) & TW_SLOT_MASK);
+
+        /* Detach whole slot, timers beyond wheel span may park in it again */
+        pList = pWheel->pSlots[level][slot];
+
+        pWheel->pSlots[level][slot] = NULL;
+        pWheel->bitmaps[level] &= ~(1ULL << slot);
+
+        while ((pTimer = pList) != NULL)
+        {
+            pList = pTimer->pNext;
+
+            pTimer->pNext = NULL;
+            pTimer->pPrev = NULL;
+            pTimer->level = TW_LEVEL_NONE;
+
+            insertTimer(pWheel, pTimer);
+        }
+    }
+}
+
+static void fireTimer(TW_TimerWheel_t *pWheel, TW_Timer_t *pTimer, int64_t nowNs)
+{
+    int64_t lateNs, jitterNs, nMissed;
+
+    TW_TimerCb_t timerCb = pTimer->timerCb;
+    void        *pArg    = pTimer->pArg;
+
+    /* Update lateness and jitter statistics */
+    lateNs = nowNs - pTimer->deadlineNs;
+
+    pTimer->stats.nFired++;
+    pTimer->stats.lastLateNs  = lateNs;
+    pTimer->stats.sumLateNs  += lateNs;
+    if (lateNs > pTimer->stats.maxLateNs) { pTimer->stats.maxLateNs = lateNs; }
+
+    if ( (pTimer->periodNs   > 0) &&
+         (pTimer->lastFireNs > 0) )
+    {
+        jitterNs = (nowNs - pTimer->lastFireNs) - pTimer->periodNs;
+        if (jitterNs < 0) { jitterNs = -jitterNs; }
+
+        pTimer->stats.sumJitterNs += jitterNs;
+        if (jitterNs > pTimer->stats.maxJitterNs) { pTimer->stats.maxJitterNs = jitterNs; }
+    }
+
+    pTimer->lastFireNs = nowNs;
+
+    if (pTimer->periodNs > 0)
+    {
+        /* Next deadline stays on period grid, periods missed by stalls are skipped */
+        pTimer->deadlineNs += pTimer->periodNs;
+
+        if (pTimer->deadlineNs <= nowNs)
+        {
+            nMissed = ((nowNs - pTimer->deadlineNs) / pTimer->periodNs) + 1;
+
+            pTimer->stats.nMissed += nMissed;
+            pTimer->deadlineNs    += (nMissed * pTimer->periodNs);
+        }
+
+        insertTimer(pWheel, pTimer);
+    }
+    else
+    {
+        /* One-shot timer returns to free list */
+        pTimer->active = 0;
+        pTimer->pNext  = pWheel->pFree;
+        pWheel->pFree  = pTimer;
+    }
+
+    /* Callback runs last, it may cancel or add timers */
+    timerCb(pArg);
+}
+
+static uint64_t getNextTick(const TW_TimerWheel_t *pWheel, uint64_t *pCascadeTick)
+{
+    int16_t  level;
+    uint32_t shift;
+    uint64_t nextTick = TW_TICK_NONE, cascadeTick = TW_TICK_NONE, block, tick;
+
+    /* Level 0 slots map one-to-one onto the next 64 ticks */
+    if (pWheel->bitmaps[0] != 0)
+    {
+        nextTick = pWheel->curTick +
+                   (uint64_t)__builtin_ctzll(_RotateRight(pWheel->bitmaps[0], (uint32_t)(pWheel->curTick & TW_SLOT_MASK)));
+    }
+
+    /* Higher level slots are due at start of their next block */
+    for (level = 1; level < TW_LEVELS; level++)
+    {
+        if (pWheel->bitmaps[level] == 0) { continue; }
+
+        shift = TW_LEVEL_SHIFT(level);
+        block = (pWheel->curTick + (1ULL << shift) - 1) >> shift;
+
+        tick  = (block + (uint64_t)__builtin_ctzll(_RotateRight(pWheel->bitmaps[level], (uint32_t)(block & TW_SLOT_MASK)))) << shift;
+
+        if (tick < cascadeTick) { cascadeTick = tick; }
+    }
+
+    if (pCascadeTick != NULL) { *pCascadeTick = cascadeTick; }
+
+    return (cascadeTick < nextTick) ? cascadeTick : nextTick;
+}
+
+static int advanceTimerWheel(TW_TimerWheel_t *pWheel, int64_t nowNs)
+{
+    int nFired = 0;
+    uint64_t tick, nowTick;
+    TW_Timer_t *pTimer;
+
+    nowTick = (uint64_t)nowNs >> TW_TICK_SHIFT;
+
+    /* Jump from one occupied tick (or cascade) to next, idle ticks cost nothing */
+    while ((tick = getNextTick(pWheel, NULL)) <= nowTick)
+    {
+        pWheel->curTick = tick;
+
+        cascadeTimers(pWheel, tick);
+
+        while ((pTimer = pWheel->pSlots[0][(tick & TW_SLOT_MASK)]) != NULL)
+        {
+            unlinkTimer(pWheel, pTimer);
+
+            /* Sub-tick precision, keep timers whose deadline is still ahead */
+            if (pTimer->deadlineNs > nowNs)
+            {
+                linkTimer(pWheel, pTimer, TW_LEVEL_DEFERRED, 0);
+                continue;
+            }
+
+            fireTimer(pWheel, pTimer, nowNs);
+            nFired++;
+        }
+
+        if (pWheel->pDeferred != NULL)
+        {
+            /* Current tick stays open until its remaining deadlines pass */
+            while ((pTimer = pWheel->pDeferred) != NULL)
+            {
+                unlinkTimer(pWheel, pTimer);
+                insertTimer(pWheel, pTimer);
+            }
+
+            return nFired;
+        }
+
+        pWheel->curTick = tick + 1;
+    }
+
+    /* Nothing due up to now, skip idle ticks */
+    if (pWheel->curTick < nowTick) { pWheel->curTick = nowTick; }
+
+    return nFired;
+}
+
+static int armTimerWheel(TW_TimerWheel_t *pWheel)
+{
+    int64_t expiryNs;
+    uint64_t tick, cascadeTick;
+
+    TW_Timer_t *pTimer;
+    struct itimerspec timerSpec;
+
+    memset(&timerSpec, 0x00, sizeof(timerSpec));
+
+    tick = getNextTick(pWheel, &cascadeTick);
+    if (tick == TW_TICK_NONE)
+    {
+        expiryNs = 0;                               // Wheel is empty, disarm
+    }
+    else if (tick == cascadeTick)
+    {
+        expiryNs = (int64_t)(tick << TW_TICK_SHIFT);
+    }
+    else
+    {
+        /* Earliest deadline within due level 0 slot */
+        expiryNs = INT64_MAX;
+
+        for (pTimer = pWheel->pSlots[0][(tick & TW_SLOT_MASK)]; pTimer != NULL; pTimer = pTimer->pNext)
+        {
+            if (pTimer->deadlineNs < expiryNs) { expiryNs = pTimer->deadlineNs; }
+        }
+
+        if (expiryNs <= 0) { expiryNs = 1; }      // Zero would disarm timerfd
+    }
+
+    if (expiryNs == pWheel->armedNs) { return 0; }
+
+    timerSpec.it_value.tv_sec  = expiryNs / TW_NSEC_PER_SEC;
+    timerSpec.it_value.tv_nsec = expiryNs % TW_NSEC_PER_SEC;
+
+    if (timerfd_settime(pWheel->timerFD, TFD_TIMER_ABSTIME, &timerSpec, NULL) < 0)
+    {
+        LOG_ERROR("Failed to arm timer wheel [%m]");
+        return -1;
+    }
+
+    pWheel->armedNs = expiryNs;
+
+    return 0;
+}
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+TW_TimerWheel_t* createTimerWheel(uint32_t maxTimers)
+{
+    uint32_t idx;
+    TW_TimerWheel_t *pWheel;
+
+    if (maxTimers == 0)
+    {
+        LOG_ERROR("Invalid input number of timers (%u)",
+                  maxTimers);
+        return NULL;
+    }
+
+    pWheel = (TW_TimerWheel_t *)calloc(1, sizeof(TW_TimerWheel_t));
+    if (pWheel == NULL)
+    {
+        LOG_ERROR("Failed to allocate timer wheel");
+        return NULL;
+    }
+
+    pWheel->pTimers = (TW_Timer_t *)calloc(maxTimers, sizeof(TW_Timer_t));
+    if (pWheel->pTimers == NULL)
+    {
+        LOG_ERROR("Failed to allocate %u timers",
+                  maxTimers);
+        free(pWheel);
+        return NULL;
+    }
+
+    pWheel->timerFD = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (pWheel->timerFD < 0)
+    {
+        LOG_ERROR("Failed to create wheel timer [%m]");
+        free(pWheel->pTimers);
+        free(pWheel);
+        return NULL;
+    }
+
+    /* Chain preallocated timers into free list, lowest ID first */
+    pWheel->maxTimers = maxTimers;
+
+    for (idx = maxTimers; idx > 0; idx--)
+    {
+        pWheel->pTimers[(idx - 1)].level = TW_LEVEL_NONE;
+        pWheel->pTimers[(idx - 1)].pNext = pWheel->pFree;
+        pWheel->pFree = &pWheel->pTimers[(idx - 1)];
+    }
+
+    pWheel->curTick = (uint64_t)_GetCurrentTimeNs() >> TW_TICK_SHIFT;
+
+    return pWheel;
+}
+
+int destroyTimerWheel(TW_TimerWheel_t *pWheel)
+{
+    if (pWheel == NULL)
+    {
+        LOG_ERROR("Invalid input timer wheel %p",
+                  pWheel);
+        return -1;
+    }
+
+    close(pWheel->timerFD);
+
+    free(pWheel->pTimers);
+    free(pWheel);
+
+    return 0;
+}
+
+int getTimerWheelFD(const TW_TimerWheel_t *pWheel)
+{
+    return (pWheel != NULL) ? pWheel->timerFD : -1;
+}
+
+int addTimer(TW_TimerWheel_t *pWheel,
+             int64_t          delayNs,
+             int64_t          periodNs,
+             TW_TimerCb_t     timerCb,
+             void            *pArg)
+{
+    TW_Timer_t *pTimer;
+
+    if ( (pWheel  == NULL) ||
+         (timerCb == NULL) ||
+         (delayNs  < 0) ||
+         (periodNs < 0) )
+    {
+        LOG_ERROR("Invalid input arguments (%p, %ld, %ld, %p)",
+                  pWheel, delayNs,
+                  periodNs, timerCb);
+        return -1;
+    }
+
+    pTimer = pWheel->pFree;
+    if (pTimer == NULL)
+    {
+        LOG_ERROR("No free timer (%u in use)",
+                  pWheel->maxTimers);
+        return -1;
+    }
+
+    pWheel->pFree = pTimer->pNext;
+
+    memset(&pTimer->stats, 0x00, sizeof(TW_TimerStats_t));
+
+    pTimer->active     = 1;
+    pTimer->deadlineNs = _GetCurrentTimeNs() + delayNs;
+    pTimer->periodNs   = periodNs;
+    pTimer->lastFireNs = 0;
+    pTimer->timerCb    = timerCb;
+    pTimer->pArg       = pArg;
+
+    insertTimer(pWheel, pTimer);
+    armTimerWheel(pWheel);
+
+    return (int)(pTimer - pWheel->pTimers);
+}
+
+int cancelTimer(TW_TimerWheel_t *pWheel, int timerID)
+{
+    TW_Timer_t *pTimer;
+
+    if ( (pWheel  == NULL) ||
+         (timerID < 0) ||
+         ((uint32_t)timerID >= pWheel->maxTimers) ||
+         (pWheel->pTimers[timerID].active == 0) )
+    {
+        LOG_ERROR("Invalid input timer (%p, %d)",
+                  pWheel, timerID);
+        return -1;
+    }
+
+    pTimer = &pWheel->pTimers[timerID];
+
+    unlinkTimer(pWheel, pTimer);
+
+    pTimer->active = 0;
+    pTimer->pNext  = pWheel->pFree;
+    pWheel->pFree  = pTimer;
+
+    return armTimerWheel(pWheel);
+}
+
+int handleTimerWheel(TW_TimerWheel_t *pWheel)
+{
+    int nFired;
+    uint64_t nExpirations;
+
+    if (pWheel == NULL)
+    {
+        LOG_ERROR("Invalid input timer wheel %p",
+                  pWheel);
+        return -1;
+    }
+
+    /* Acknowledge timerfd expiration, wheel is advanced to current time */
+    if ( (read(pWheel->timerFD, &nExpirations, sizeof(nExpirations)) < 0) &&
+         (errno != EAGAIN) )
+    {
+        LOG_ERROR("Failed to read wheel timer [%m]");
+        return -1;
+    }
+
+    pWheel->armedNs = 0;
+
+    nFired = advanceTimerWheel(pWheel, _GetCurrentTimeNs());
+
+    armTimerWheel(pWheel);
+
+    return nFired;
+}
+
+int getTimerStats(const TW_TimerWheel_t *pWheel,
+                  int                    timerID,
+                  TW_TimerStats_t       *pStats)
+{
+    if ( (pWheel  == NULL) ||
+         (pStats  == NULL) ||
+         (timerID < 0) ||
+         ((uint32_t)timerID >= pWheel->maxTimers) ||
+         (pWheel->pTimers[timerID].active == 0) )
+    {
+        LOG_ERROR("Invalid input arguments (%p, %d, %p)",
+                  pWheel, timerID,
+                  pStats);
+        return -1;
+    }
+
+    memcpy(pStats, &pWheel->pTimers[timerID].stats, sizeof(TW_TimerStats_t));
+
+    return 0;
+}
@@ -0,0 +1,213 @@
+/**
+ * @file    com_chan_trace.c
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Query pipeline stage tracing; histograms are updated with
+ * relaxed atomics, so worker threads share one set of statistics.
+ */
+
+
+// Library Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+// Module Includes
+#include "com_chan_trace.h"
+#include "com_chan_log.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define COM_CHAN_NSEC_PER_SEC   1000000000LL
+
+
+//*************************************
+// Module Utility Functions
+//*************************************
+static inline int64_t getMonotonicNs(void);
+
+
+//*************************************
+// Module Local Variables
+//*************************************
+static const char *stageNames[COM_CHAN_STAGE_MAX] =
+{
+    "send",
+    "relay_in",
+    "relay_out",
+    "collect_start",
+    "collect_end",
+    "reply_relay",
+    "reply_received",
+};
+
+static const char *prioNames[COM_CHAN_PRIO_MAX] =
+{
+    "normal",
+    "critical",
+    "bulk",
+};
+
+
+//*************************************
+// Module Utility Functions
+//*************************************
+static inline int64_t getMonotonicNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((int64_t)ts.tv_sec * COM_CHAN_NSEC_PER_SEC) + ts.tv_nsec;
+}
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+const char* getComChanStageName(uint32_t stage)
+{
+    return (stage < COM_CHAN_STAGE_MAX) ? stageNames[stage] : "total";
+}
+
+const char* getComChanPrioName(uint32_t prio)
+{
+    return (prio < COM_CHAN_PRIO_MAX) ? prioNames[prio] : "unknown";
+}
+
+void stampComChanStage(ComChan_Message_t *pMessage, uint32_t stage)
+{
+    if ( (pMessage == NULL) ||
+         (stage >= COM_CHAN_STAGE_MAX) )
+    {
+        return;
+    }
+
+    /* Same clock as relay (ktime_get_ns), stages compare across processes */
+    pMessage->stageTimes[stage] = getMonotonicNs();
+
+    COM_CHAN_PROBE3(stage, pMessage->seqID, stage, pMessage->stageTimes[stage]);
+}
+
+int recordComChanStages(ComChan_StageStats_t *pStats, const ComChan_Message_t *pMessage)
+{
+    int nStages = 0;
+    uint32_t stage;
+    int64_t firstTime = 0, lastTime = 0;
+    int64_t latencyNs;
+
+    if ( (pStats == NULL) ||
+         (pMessage == NULL) )
+    {
+        LOG_ERROR("Invalid input pointer arguments (%p, %p)",
+                  pStats, pMessage);
+        return -1;
+    }
+
+    /* Each passed stage is timed from previous passed stage, stages not passed are skipped */
+    for (stage = 0; stage < COM_CHAN_STAGE_MAX; stage++)
+    {
+        if (pMessage->stageTimes[stage] <= 0) { continue; }
+
+        if (lastTime > 0)
+        {
+            latencyNs = pMessage->stageTimes[stage] - lastTime;
+            if (latencyNs < 0) { latencyNs = 0; }
+
+            recordComChanLatency(&pStats->stages[stage], (uint64_t)latencyNs);
+            COM_CHAN_PROBE3(latency, pMessage->seqID, stage, latencyNs);
+        }
+        else { firstTime = pMessage->stageTimes[stage]; }
+
+        lastTime = pMessage->stageTimes[stage];
+        nStages++;
+    }
+
+    if (nStages > 1)
+    {
+        recordComChanLatency(&pStats->total, (uint64_t)(lastTime - firstTime));
+        COM_CHAN_PROBE3(total, pMessage->seqID, pMessage->resourceInfoID, (lastTime - firstTime));
+    }
+
+    return nStages;
+}
+
+void recordComChanLatency(ComChan_StageHist_t *pHist, uint64_t latencyNs)
+{
+    uint32_t bucket;
+    uint64_t maxNs;
+
+    bucket = (latencyNs == 0) ? 0 : (uint32_t)(63 - __builtin_clzll(latencyNs));
+    if (bucket >= COM_CHAN_TRACE_BUCKETS) { bucket = (COM_CHAN_TRACE_BUCKETS - 1); }
+
+    __atomic_fetch_add(&pHist->buckets[bucket], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&pHist->sumNs, latencyNs, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&pHist->count, 1, __ATOMIC_RELAXED);
+
+    maxNs = __atomic_load_n(&pHist->maxNs, __ATOMIC_RELAXED);
+    while ( (latencyNs > maxNs) &&
+            !__atomic_compare_exchange_n(&pHist->maxNs, &maxNs, latencyNs, 1,
+                                         __ATOMIC_RELAXED, __ATOMIC_RELAXED) )
+    {
+        ;
+    }
+}
+
+uint64_t getComChanStageQuantile(const ComChan_StageHist_t *pHist, double quantile)
+{
+    uint32_t bucket;
+    uint64_t rank, seen = 0;
+
+    if ( (pHist == NULL) ||
+         (pHist->count == 0) )
+    {
+        return 0;
+    }
+
+    /* Upper bound of bucket holding the rank, capped by largest latency seen */
+    rank = (uint64_t)(quantile * (double)pHist->count);
+    if (rank >= pHist->count) { rank = pHist->count - 1; }
+
+    for (bucket = 0; bucket < COM_CHAN_TRACE_BUCKETS; bucket++)
+    {
+        seen += pHist->buckets[bucket];
+        if (seen > rank) { break; }
+    }
+
+    if (bucket >= (COM_CHAN_TRACE_BUCKETS - 1)) { return pHist->maxNs; }
+
+    return ((2ULL << bucket) < pHist->maxNs) ? (2ULL << bucket) : pHist->maxNs;
+}
+
+void printComChanStages(const ComChan_StageStats_t *pStats, const char *pName)
+{
+    uint32_t stage;
+
+    const ComChan_StageHist_t *pHist;
+
+    if (pStats == NULL) { return; }
+
+    if (pStats->total.count == 0) { return; }
+
+    printf("%s Stage Latency (%lu replies | p50 %lu us | p99 %lu us | max %lu us)\n",
+            pName, pStats->total.count,
+            (getComChanStageQuantile(&pStats->total, 0.50) / 1000),
+            (getComChanStageQuantile(&pStats->total, 0.99) / 1000),
+            (pStats->total.maxNs / 1000));
+
+    for (stage = 0; stage < COM_CHAN_STAGE_MAX; stage++)
+    {
+        pHist = &pStats->stages[stage];
+        if (pHist->count == 0) { continue; }
+
+        printf("  %-15s (avg %lu us | p50 %lu us | p99 %lu us | max %lu us)\n",
+                getComChanStageName(stage),
+                ((pHist->sumNs / pHist->count) / 1000),
+                (getComChanStageQuantile(pHist, 0.50) / 1000),
+                (getComChanStageQuantile(pHist, 0.99) / 1000),
+                (pHist->maxNs / 1000));
+    }
+}
@@ -0,0 +1,49 @@
+/**
+ * @file    rw_cpu_info.h
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Per-core CPU utilisation collector (/proc/stat) for
+ * resource watcher.
+ */
+
+#ifndef RW_CPU_INFO_H_
+#define RW_CPU_INFO_H_
+
+// Library Includes
+#include <stdint.h>
+#include <stddef.h>
+
+// Module Includes
+#include "com_chan_proto.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define RW_CPU_UTIL_SCALE       10000       // Utilisation unit, 1/100th of percent
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+typedef struct RW_CpuCollector_s RW_CpuCollector_t;
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+RW_CpuCollector_t* createCpuCollector(void);
+int destroyCpuCollector(RW_CpuCollector_t *pCollector);
+
+int sampleCpuCollector(RW_CpuCollector_t *pCollector);
+int loadCpuCollector(RW_CpuCollector_t *pCollector,
+                     const char        *pStatBuf,
+                     size_t             nBytes);
+int getCpuCount(const RW_CpuCollector_t *pCollector);
+int getCpuStatFD(const RW_CpuCollector_t *pCollector);
+int getCpuUtilInfo(const RW_CpuCollector_t *pCollector,
+                   uint16_t                 firstCPU,
+                   RW_CpuInfo_t            *pCpuInfo);
+
+#endif /* RW_CPU_INFO_H_ */
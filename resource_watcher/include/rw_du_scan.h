@@ -0,0 +1,57 @@
+/**
+ * @file    rw_du_scan.h
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Directory usage scanner for resource watcher; configured
+ * directory trees are scanned on a work-stealing thread pool within CPU
+ * and inode budgets, then kept current from fanotify filesystem events
+ * (rescanned periodically where filesystem cannot be marked).
+ */
+
+#ifndef RW_DU_SCAN_H_
+#define RW_DU_SCAN_H_
+
+// Library Includes
+#include <stdint.h>
+
+// Module Includes
+#include "com_chan_proto.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define RW_DU_MAX_ROOTS         4           // Directory trees scanned
+#define RW_DU_MAX_THREADS       16          // Scan threads
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+typedef struct RW_DuScanner_s RW_DuScanner_t;
+
+typedef struct RW_DuScanConfig_s
+{
+    const char             *pRoots[RW_DU_MAX_ROOTS]; ///< Directory trees scanned, one at a time
+    uint32_t                nRoots;             ///< Number of directory trees
+    uint32_t                nThreads;           ///< Scan threads sharing a tree
+    uint32_t                cpuBudget;          ///< CPU time of all scan threads (percent of one CPU), 0 unlimited
+    uint32_t                inodeBudget;        ///< Inodes examined per second by all scan threads, 0 unlimited
+    uint32_t                period;             ///< Seconds between scans of a tree not kept current by events
+} RW_DuScanConfig_t;
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+RW_DuScanner_t* createDuScanner(const RW_DuScanConfig_t *pConfig);
+int destroyDuScanner(RW_DuScanner_t *pScanner);
+
+int getDiskUsageInfo(RW_DuScanner_t *pScanner,
+                     uint16_t        rootIndex,
+                     uint16_t        maxDepth,
+                     uint16_t        window,
+                     RW_DuInfo_t    *pDuInfo);
+
+#endif /* RW_DU_SCAN_H_ */
@@ -0,0 +1,36 @@
+/**
+ * @file    rw_frag_info.h
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Memory fragmentation collector (buddyinfo, pagetypeinfo,
+ * vmstat compaction counters) for resource watcher.
+ */
+
+#ifndef RW_FRAG_INFO_H_
+#define RW_FRAG_INFO_H_
+
+// Library Includes
+#include <stdint.h>
+
+// Module Includes
+#include "com_chan_proto.h"
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+typedef struct RW_FragCollector_s RW_FragCollector_t;
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+RW_FragCollector_t* createFragCollector(void);
+int destroyFragCollector(RW_FragCollector_t *pCollector);
+
+int getFragmentationInfo(const RW_FragCollector_t *pCollector,
+                         uint16_t                  firstZone,
+                         RW_FragInfo_t            *pFragInfo);
+
+#endif /* RW_FRAG_INFO_H_ */
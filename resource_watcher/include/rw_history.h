@@ -0,0 +1,39 @@
+/**
+ * @file    rw_history.h
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Fixed-memory multi-resolution metric history with
+ * incremental min/max/avg rollups for resource watcher.
+ */
+
+#ifndef RW_HISTORY_H_
+#define RW_HISTORY_H_
+
+// Library Includes
+#include <stdint.h>
+
+// Module Includes
+#include "com_chan_proto.h"
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+typedef struct RW_History_s RW_History_t;
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+RW_History_t* createHistory(void);
+int destroyHistory(RW_History_t *pHistory);
+
+int insertHistorySample(RW_History_t  *pHistory,
+                        int64_t        timestamp,
+                        const int64_t  values[RW_METRIC_MAX]);
+
+int queryHistory(const RW_History_t *pHistory,
+                 RW_HistoryInfo_t   *pHistoryInfo);
+
+#endif /* RW_HISTORY_H_ */
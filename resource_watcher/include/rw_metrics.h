@@ -0,0 +1,54 @@
+/**
+ * @file    rw_metrics.h
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Prometheus text exposition of latest resource sample,
+ * query stage latencies and request queues; response is rendered once per sample and
+ * served as is to every scrape.
+ */
+
+#ifndef RW_METRICS_H_
+#define RW_METRICS_H_
+
+// Library Includes
+#include <stdint.h>
+
+// Module Includes
+#include "com_chan_proto.h"
+#include "com_chan_trace.h"
+#include "rw_cpu_info.h"
+#include "rw_worker_pool.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define RW_METRICS_PORT         9465        // Default exposition port (loopback only)
+#define RW_METRICS_BUFFER_SZ    32768       // Bytes per rendered response, per-core series excluded
+#define RW_METRICS_CORE_SZ      320         // Bytes per rendered core series
+#define RW_METRICS_CLIENTS_MAX  32          // Scrape connections served at once
+#define RW_METRICS_REQUEST_SZ   1024        // Bytes of request head kept per connection
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+typedef struct RW_MetricsServer_s RW_MetricsServer_t;
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+RW_MetricsServer_t* createMetricsServer(uint16_t port, uint32_t nCPUs);
+int destroyMetricsServer(RW_MetricsServer_t *pServer);
+
+int publishMetrics(RW_MetricsServer_t          *pServer,
+                   const RW_MultiInfo_t        *pSample,
+                   const RW_CpuCollector_t     *pCpuCollector,
+                   const ComChan_StageStats_t  *pStages,
+                   const RW_WorkerClassStats_t *pClasses,
+                   uint32_t                     nClasses,
+                   int64_t                      timestamp);
+
+#endif /* RW_METRICS_H_ */
@@ -0,0 +1,43 @@
+/**
+ * @file    rw_numa_info.h
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Per NUMA node memory collector (node meminfo/numastat)
+ * for resource watcher.
+ */
+
+#ifndef RW_NUMA_INFO_H_
+#define RW_NUMA_INFO_H_
+
+// Library Includes
+#include <stdint.h>
+
+// Module Includes
+#include "com_chan_proto.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define RW_NUMA_MAX_NODES       64          // Upper bound of collected NUMA nodes
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+typedef struct RW_NumaCollector_s RW_NumaCollector_t;
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+RW_NumaCollector_t* createNumaCollector(void);
+int destroyNumaCollector(RW_NumaCollector_t *pCollector);
+
+uint32_t getNumaNodeCount(const RW_NumaCollector_t *pCollector);
+int getNumaMemoryInfo(const RW_NumaCollector_t *pCollector,
+                      uint16_t                  firstNode,
+                      RW_NumaInfo_t            *pNumaInfo);
+
+#endif /* RW_NUMA_INFO_H_ */
@@ -0,0 +1,50 @@
+/**
+ * @file    rw_sketch.h
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Mergeable streaming quantile sketches (DDSketch) per
+ * metric per rollup window for resource watcher.
+ */
+
+#ifndef RW_SKETCH_H_
+#define RW_SKETCH_H_
+
+// Library Includes
+#include <stdint.h>
+
+// Module Includes
+#include "rw_history.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define RW_SKETCH_ALPHA         0.02        // Relative accuracy of quantiles
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+typedef struct RW_SketchStore_s RW_SketchStore_t;
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+void initSketch(RW_Sketch_t *pSketch);
+void addSketchValue(RW_Sketch_t *pSketch, int64_t value);
+int mergeSketch(RW_Sketch_t *pDstSketch, const RW_Sketch_t *pSrcSketch);
+int64_t getSketchQuantile(const RW_Sketch_t *pSketch, double quantile);
+
+RW_SketchStore_t* createSketchStore(void);
+int destroySketchStore(RW_SketchStore_t *pStore);
+
+int insertSketchSample(RW_SketchStore_t *pStore,
+                       int64_t           timestamp,
+                       const int64_t     values[RW_METRIC_MAX]);
+
+int querySketchStore(const RW_SketchStore_t *pStore,
+                     RW_QuantileInfo_t      *pQuantileInfo);
+
+#endif /* RW_SKETCH_H_ */
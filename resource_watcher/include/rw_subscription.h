@@ -0,0 +1,71 @@
+/**
+ * @file    rw_subscription.h
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Periodic resource subscriptions for resource watcher;
+ * subscribers sharing an interval are pushed from the same
+ * sampling pass.
+ */
+
+#ifndef RW_SUBSCRIPTION_H_
+#define RW_SUBSCRIPTION_H_
+
+// Library Includes
+#include <stdint.h>
+
+// Module Includes
+#include "com_chan_proto.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define RW_SUBSCRIPTIONS_MAX    64          // Upper bound of active subscriptions
+#define RW_SUBSCRIPTION_LEASE   180         // Seconds without renewal before subscription is dropped
+
+#define RW_SUBSCRIPTION_MASK    (RW_RESOURCE_MASK(DISK_RESOURCE_INFO)   | \
+                                 RW_RESOURCE_MASK(MEMORY_RESOURCE_INFO) | \
+                                 RW_RESOURCE_MASK(CPU_RESOURCE_INFO))    // Sections which can be pushed
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+typedef struct RW_Subscription_s
+{
+    uint32_t                requesterSig;       ///< Subscriber signature, pushes are routed by it
+    uint32_t                subscriptionID;     ///< Subscriber chosen identifier
+    uint32_t                interval;           ///< Push interval (seconds)
+    uint32_t                resourceMask;       ///< Sections pushed (RW_RESOURCE_MASK)
+    uint16_t                firstCPU;           ///< First core index of CPU section
+    uint16_t                prioClass;          ///< Priority class of subscribe request, kept on pushes
+
+    int64_t                 nextDue;            ///< Next push time (seconds), on interval grid
+    int64_t                 expireTime;         ///< Lease end (seconds), renewed by every update
+} RW_Subscription_t;
+
+/** @brief Push handler, run for every due subscription */
+typedef int (*RW_SubscriptionPushCb_t)(void *pArg, const RW_Subscription_t *pSubscription);
+
+typedef struct RW_SubscriptionTable_s RW_SubscriptionTable_t;
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+RW_SubscriptionTable_t* createSubscriptionTable(uint32_t maxSubscriptions);
+int destroySubscriptionTable(RW_SubscriptionTable_t *pTable);
+
+int updateSubscription(RW_SubscriptionTable_t *pTable,
+                       uint32_t                requesterSig,
+                       uint32_t                prioClass,
+                       RW_SubscribeInfo_t     *pSubscribeInfo,
+                       int64_t                 now);
+
+int pushDueSubscriptions(RW_SubscriptionTable_t  *pTable,
+                         int64_t                  now,
+                         RW_SubscriptionPushCb_t  pushCb,
+                         void                    *pArg);
+
+#endif /* RW_SUBSCRIPTION_H_ */
@@ -0,0 +1,60 @@
+/**
+ * @file    rw_tsdb.h
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Compressed append-only on-disk time-series store for
+ * resource watcher samples.
+ */
+
+#ifndef RW_TSDB_H_
+#define RW_TSDB_H_
+
+// Library Includes
+#include <stdint.h>
+
+// Module Includes
+#include "rw_history.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define RW_TSDB_DIR             "/var/lib/rwatcher"   // Default segments directory
+
+#define RW_TSDB_CHUNK_SAMPLES   120         // Samples per appended chunk
+#define RW_TSDB_CHUNK_PERIOD    60          // Seconds covered by a pending chunk before appending it early
+#define RW_TSDB_SEGMENT_PERIOD  3600        // Seconds covered by a segment before sealing
+#define RW_TSDB_RETENTION       (28 * 24 * 3600)      // Seconds sealed segments are kept
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+/** @brief Scan callback, invoked once per stored sample in time order
+ *  within a segment; returning negative value stops the scan.
+ */
+typedef int (*RW_TsdbScanCb_t)(void          *pArg,
+                               int64_t        timestamp,
+                               const int64_t  values[RW_METRIC_MAX]);
+
+typedef struct RW_Tsdb_s RW_Tsdb_t;
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+RW_Tsdb_t* createTsdb(const char *pDirPath);
+int destroyTsdb(RW_Tsdb_t *pTsdb);
+
+int appendTsdbSample(RW_Tsdb_t     *pTsdb,
+                     int64_t        timestamp,
+                     const int64_t  values[RW_METRIC_MAX]);
+
+int scanTsdb(RW_Tsdb_t       *pTsdb,
+             int64_t          startTime,
+             int64_t          endTime,
+             RW_TsdbScanCb_t  scanCb,
+             void            *pArg);
+
+#endif /* RW_TSDB_H_ */
@@ -0,0 +1,68 @@
+/**
+ * @file    rw_uring.h
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Minimal io_uring ring (raw system calls) for resource
+ * watcher event loop backend.
+ */
+
+#ifndef RW_URING_H_
+#define RW_URING_H_
+
+// Library Includes
+#include <stdint.h>
+#include <stddef.h>
+
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+#include <linux/io_uring.h>
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+typedef struct RW_Uring_s RW_Uring_t;
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+RW_Uring_t* createUring(uint32_t nEntries);
+int destroyUring(RW_Uring_t *pRing);
+
+int registerUringBuffers(RW_Uring_t         *pRing,
+                         const struct iovec *pIoVectors,
+                         uint32_t            nVectors);
+
+struct io_uring_sqe* getUringSqe(RW_Uring_t *pRing);
+int submitUring(RW_Uring_t *pRing, uint32_t waitNr);
+
+struct io_uring_cqe* peekUringCqe(RW_Uring_t *pRing);
+void seenUringCqe(RW_Uring_t *pRing);
+
+void prepUringRecvMultishot(struct io_uring_sqe *pSqe,
+                            int                  fd,
+                            uint16_t             bufGroup,
+                            uint64_t             userData);
+void prepUringProvideBuffers(struct io_uring_sqe *pSqe,
+                             void                *pBuffers,
+                             uint32_t             bufLen,
+                             uint32_t             nBuffers,
+                             uint16_t             bufGroup,
+                             uint16_t             firstBufID,
+                             uint64_t             userData);
+void prepUringReadFixed(struct io_uring_sqe *pSqe,
+                        int                  fd,
+                        void                *pBuf,
+                        uint32_t             len,
+                        uint64_t             offset,
+                        uint16_t             bufIndex,
+                        uint64_t             userData);
+void prepUringSendmsg(struct io_uring_sqe *pSqe,
+                      int                  fd,
+                      const struct msghdr *pMsgHdr,
+                      uint64_t             userData);
+
+#endif /* RW_URING_H_ */
@@ -0,0 +1,71 @@
+/**
+ * @file    rw_worker_pool.h
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Request worker pool for resource watcher; every worker
+ * owns its context (netlink socket, message buffer) and serves
+ * queued requests in parallel. Requests are queued per class and
+ * classes are served by weighted round robin.
+ */
+
+#ifndef RW_WORKER_POOL_H_
+#define RW_WORKER_POOL_H_
+
+// Library Includes
+#include <stdint.h>
+#include <stddef.h>
+
+// Module Includes
+#include "com_chan_trace.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define RW_WORKER_POOL_MAX_WORKERS  16      // Upper bound of worker threads
+#define RW_WORKER_POOL_QUEUE_DEPTH  256     // Queued requests per class before submission fails
+#define RW_WORKER_POOL_MAX_CLASSES  4       // Upper bound of request classes
+#define RW_WORKER_POOL_MAX_BATCH    32      // Requests handed to a worker per wakeup
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+/** @brief Worker context constructor/destructor, run on worker thread */
+typedef void* (*RW_WorkerInit_t)(uint32_t workerID);
+typedef void  (*RW_WorkerExit_t)(void *pWorkerCtx);
+
+/** @brief Request batch handler, run on worker thread with worker context */
+typedef int   (*RW_WorkerHandler_t)(void *pWorkerCtx, const void *pRequests, uint32_t nRequests);
+
+typedef struct RW_WorkerClassStats_s
+{
+    uint64_t                nSubmitted;         ///< Requests queued
+    uint64_t                nOverflows;         ///< Requests refused with class queue full
+    uint32_t                nQueued;            ///< Requests waiting
+    uint32_t                weight;             ///< Requests served per round
+    ComChan_StageHist_t     queueDelay;         ///< Time from submission to worker pickup
+} RW_WorkerClassStats_t;
+
+typedef struct RW_WorkerPool_s RW_WorkerPool_t;
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+RW_WorkerPool_t* createWorkerPool(uint32_t           nWorkers,
+                                  size_t             requestSz,
+                                  uint32_t           nClasses,
+                                  const uint32_t    *pWeights,
+                                  RW_WorkerInit_t    initCb,
+                                  RW_WorkerHandler_t handlerCb,
+                                  RW_WorkerExit_t    exitCb);
+int destroyWorkerPool(RW_WorkerPool_t *pPool);
+
+int submitWorkerRequest(RW_WorkerPool_t *pPool, const void *pRequest, uint32_t classID);
+
+uint32_t getWorkerCount(const RW_WorkerPool_t *pPool);
+int getWorkerClassStats(RW_WorkerPool_t *pPool, uint32_t classID, RW_WorkerClassStats_t *pStats);
+
+#endif /* RW_WORKER_POOL_H_ */
@@ -3,478 +3,1218 @@
  * @author  Kamran Rauf
  * @date    25 July 2017
  * @version 0.1
- * @brief  Simple system resource (memory, disk) watcher
+ * @brief  Simple system resource (memory, disk, cpu) watcher
  * with interface to listen for resource status query.
  */
 
 
 // Library Includes
+#define _GNU_SOURCE                         // recvmmsg(), sendmmsg()
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <unistd.h>
 #include <string.h>
+#include <time.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
 
 #include <sys/types.h>
 #include <sys/epoll.h>
 #include <sys/socket.h>
-#include <sys/statvfs.h>
+#include <sys/timerfd.h>
 
 #include <linux/netlink.h>
 
+// Module Includes
+#include "com_chan_proto.h"
+#include "com_chan_capture.h"
+#include "com_chan_socket.h"
+#include "com_chan_sysinfo.h"
+#include "com_chan_trace.h"
+#include "rw_cpu_info.h"
+#include "rw_du_scan.h"
+#include "rw_frag_info.h"
+#include "rw_history.h"
+#include "rw_metrics.h"
+#include "rw_numa_info.h"
+#include "rw_sketch.h"
+#include "rw_subscription.h"
+#include "rw_tsdb.h"
+#include "rw_uring.h"
+#include "rw_worker_pool.h"
+#include "com_chan_log.h"
 
 //*************************************
 // Module Macro Definitions
 //*************************************
-#define COM_NETLINK_LKM         31
+#define MAX_EPOLL_EVENTS        2
+#define EPOLL_EVENTS_TIMEOUT    10          // Seconds
 
-#define COM_NETLINK_KERNEL_SIG  0x00
-#define COM_NETLINK_RW_SIG      0xA5A5A5A5
+#define RW_HISTORY_SAMPLE_PERIOD 1          // Seconds
+#define RW_HISTORY_WARM_PERIOD  (7 * 24 * 3600) // Seconds of stored samples replayed at startup
 
-#define COM_NETLINK_SOURCE      getpid()    // Process ID as source
-#define COM_NETLINK_DESTINATION 0           // Kernel as destination
+#define RW_URING_ENTRIES        256         // Submission ring entries of io_uring event loop
+#define RW_URING_RECV_BUFFERS   64          // Provided buffers for multishot receive
+#define RW_URING_RECV_GROUP     0           // Provided buffers group identifier
+#define RW_URING_STAT_BUF_SZ    65536       // Registered /proc/stat read buffer size
 
-#define COM_NETLINK_MAX_PAYLOAD sizeof(ComChan_Message_t)
-
-#define MAX_EPOLL_EVENTS        2
-#define EPOLL_EVENTS_TIMEOUT    10          // Seconds
+#define RW_DU_SCAN_THREADS      4           // Directory usage scan threads
+#define RW_DU_SCAN_CPU_BUDGET   50          // Percent of one CPU used by all scan threads
+#define RW_DU_SCAN_INODE_BUDGET 100000      // Inodes examined per second by all scan threads
+#define RW_DU_SCAN_PERIOD       900         // Seconds between scans of a tree not kept current by filesystem events
 
 //*************************************
 // Module Data Structures
 //*************************************
-enum
+typedef enum
 {
-    INVALID_RESOURCE_INFO_ID,
+    RW_BACKEND_EPOLL,                           ///< epoll readiness, batched recvmmsg/sendmmsg
+    RW_BACKEND_URING,                           ///< io_uring completions, batched SQEs
+} RW_Backend_t;
 
-    DISK_RESOURCE_INFO,
-    MEMORY_RESOURCE_INFO,
-    SERVICE_RESOURCE_INFO,
+enum
+{
+    RW_URING_TAG_RECV = 1,                      ///< Multishot netlink receive
+    RW_URING_TAG_PROVIDE,                       ///< Receive buffer (re)provided
+    RW_URING_TAG_TIMER,                         ///< Sampling timer expiration read
+    RW_URING_TAG_STAT,                          ///< /proc/stat read
+    RW_URING_TAG_SEND,                          ///< Netlink reply sent
 };
 
 
-typedef struct RW_DiskInfo_s
+typedef struct RW_PushContext_s
 {
-    uint64_t                systemMemory;       ///< System total disk memory
-    uint64_t                freeMemory;         ///< System free disk memory
-} RW_DiskInfo_t;
+    int                     sock;               ///< Netlink socket pushes are sent on
+    const struct sockaddr_nl *pDstAddr;         ///< Kernel destination address
+    ComChan_MsgBatch_t     *pTxBatch;           ///< Push message batch
+} RW_PushContext_t;
 
-typedef struct RW_MemoryInfo_s
+typedef struct RW_RequestWorker_s
 {
-    uint64_t                systemMemory;       ///< System total memory
-    uint64_t                freeMemory;         ///< System free memory
-} RW_MemoryInfo_t;
+    int                     sock;               ///< Worker netlink socket for replies
+    struct sockaddr_nl      srcAddr;            ///< Worker source address
+    struct sockaddr_nl      dstAddr;            ///< Kernel destination address
+    ComChan_MsgBatch_t     *pTxBatch;           ///< Worker reply message batch
+    RW_Uring_t             *pRing;              ///< Worker send ring (io_uring backend)
+} RW_RequestWorker_t;
 
-typedef struct ServiceInfo_s
-{
-    uint32_t                servicePID;         ///< Service process ID
-    char                    serviceHostIP4[16]; ///< Service host IPV4 address
-} ServiceInfo_t;
 
-typedef struct ComChan_Message_s
+//*************************************
+// Module Local Variables
+//*************************************
+static RW_CpuCollector_t *pCpuCollector = NULL;
+static RW_NumaCollector_t *pNumaCollector = NULL;
+static RW_FragCollector_t *pFragCollector = NULL;
+static RW_DuScanner_t    *pDuScanner    = NULL;
+static RW_History_t      *pHistory      = NULL;
+static RW_Tsdb_t         *pTsdb         = NULL;
+static RW_SketchStore_t  *pSketchStore  = NULL;
+static RW_WorkerPool_t   *pWorkerPool   = NULL;
+static RW_SubscriptionTable_t *pSubscriptionTable = NULL;
+static RW_MetricsServer_t *pMetricsServer = NULL;
+static ComChan_CaptureWriter_t *pCapture = NULL;
+static RW_Backend_t       rwBackend     = RW_BACKEND_EPOLL;
+static uint16_t           metricsPort   = RW_METRICS_PORT;
+static const char        *pCapturePath  = NULL;
+static RW_DuScanConfig_t  duConfig      = { { NULL }, 0, RW_DU_SCAN_THREADS, RW_DU_SCAN_CPU_BUDGET,
+                                            RW_DU_SCAN_INODE_BUDGET, RW_DU_SCAN_PERIOD };
+
+static volatile sig_atomic_t stopSignal  = 0;  ///< Stop signal received (SIGTERM, SIGINT), 0 if none
+
+static pthread_mutex_t    cpuLock       = PTHREAD_MUTEX_INITIALIZER;  ///< Serializes CPU collector sampling (timer only) and reads
+static pthread_rwlock_t   metricsLock   = PTHREAD_RWLOCK_INITIALIZER; ///< Guards history and sketches
+
+static RW_MultiInfo_t     latestSample;         ///< Sections of latest periodic sample, pushed to subscribers
+static int64_t            latestSampleTime = 0; ///< Time of latest periodic sample (seconds)
+static ComChan_StageStats_t stageStats;       ///< Stage latencies of served queries, updated by workers
+
+/* Requests served per round of each priority class, critical queries jump ahead of dashboard floods */
+static const uint32_t     classWeights[COM_CHAN_PRIO_MAX] =
 {
-    uint32_t                serviceSig;         ///< Service signature (ID)
-    uint32_t                resourceInfoID;     ///< Resource information identifier
-
-    uint32_t                flags;              ///< Message flags
-
-    union
-    {
-        RW_DiskInfo_t       diskInfo;           ///< Disk information
-        RW_MemoryInfo_t     memoryInfo;         ///< Memory information
-
-        ServiceInfo_t       serviceInfo;        ///< Service information
-    } res_info;
-} ComChan_Message_t;
+    4,                                          // COM_CHAN_PRIO_NORMAL
+    16,                                         // COM_CHAN_PRIO_CRITICAL
+    1,                                          // COM_CHAN_PRIO_BULK
+};
 
 
 //*************************************
 // Module Utility Functions
 //*************************************
-static struct nlmsghdr* createNLMsgHdr(int maxPayloadSz);
-static int createNLSocket(struct sockaddr_nl *pSrcAddr,
-                          struct sockaddr_nl *pDstAddr);
+static int createSampleTimer(int periodSec);
+static void* createRequestWorker(uint32_t workerID);
 
-static int destroyNLMsgHdr(struct nlmsghdr *pNLMsgHdr);
-static int destroyNLSocket(int sock);
+static void destroyRequestWorker(void *pWorkerCtx);
 
-static int getDiskMemoryInfo(RW_DiskInfo_t *pDiskInfo);
-static int getSystemMemoryInfo(RW_MemoryInfo_t *pMemoryInfo);
+static int dispatchRequestMsg(const int                 sock,
+                              const struct sockaddr_nl *pDstAddr,
+                              ComChan_MsgBatch_t       *pTxBatch,
+                              const ComChan_Message_t  *pMessage);
+static int flushUringMessages(RW_Uring_t               *pRing,
+                              const int                 sock,
+                              const struct sockaddr_nl *pDstAddr,
+                              ComChan_MsgBatch_t       *pBatch);
 
 static int handleRequestMsg(const int                 sock,
                             const struct sockaddr_nl *pDstAddr,
-                            const struct nlmsghdr    *pNLMsgHdr);
-
-static int registerEvent(int epollFD, int eventFD);
+                            ComChan_MsgBatch_t       *pRxBatch,
+                            ComChan_MsgBatch_t       *pTxBatch);
+static int handleSampleTimer(const int                 sock,
+                             const struct sockaddr_nl *pDstAddr,
+                             ComChan_MsgBatch_t       *pTxBatch,
+                             const int                 timerFD);
+static void handleStopSignal(int signum);
+static int processRequestMsg(const int                 sock,
+                             const struct sockaddr_nl *pDstAddr,
+                             ComChan_MsgBatch_t       *pTxBatch,
+                             const ComChan_Message_t  *pMessage);
+static int parseArguments(int argc, char **args);
+static int processSubscribeMsg(const int                 sock,
+                               const struct sockaddr_nl *pDstAddr,
+                               ComChan_MsgBatch_t       *pTxBatch,
+                               const ComChan_Message_t  *pMessage);
+static int pushSubscription(void *pArg, const RW_Subscription_t *pSubscription);
+static int pushSubscriptions(const int                 sock,
+                             const struct sockaddr_nl *pDstAddr,
+                             ComChan_MsgBatch_t       *pTxBatch);
+static int queueReplyMsg(const int                 sock,
+                         const struct sockaddr_nl *pDstAddr,
+                         ComChan_MsgBatch_t       *pTxBatch,
+                         ComChan_Message_t        *pReply);
+static int recordSample(const RW_CpuInfo_t *pCpuInfo);
+static int restoreSample(void          *pArg,
+                         int64_t        timestamp,
+                         const int64_t  values[RW_METRIC_MAX]);
+
+static int runUringLoop(const int                 sock,
+                        const struct sockaddr_nl *pDstAddr,
+                        ComChan_MsgBatch_t       *pTxBatch,
+                        const int                 timerFD);
+
+static int serveRequests(void *pWorkerCtx, const void *pRequests, uint32_t nRequests);
+
+
+static int createSampleTimer(int periodSec)
+{
+    int timerFD;
+    struct itimerspec timerSpec;
 
-static int sendMessage(const int                 sock,
-                       const struct sockaddr_nl *pDstAddr,
-                       const struct nlmsghdr    *pNLMsgHdr,
-                       const ComChan_Message_t  *pMessage);
+    if (periodSec <= 0)
+    {
+        LOG_ERROR("Invalid input timer period (%d)",
+                  periodSec);
+        return -1;
+    }
 
+    /* Create periodic sampling timer */
+    timerFD = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timerFD < 0)
+    {
+        LOG_ERROR("Failed to create sampling timer [%m]");
+        return -1;
+    }
 
-static struct nlmsghdr* createNLMsgHdr(int maxPayloadSz)
-{
-    struct nlmsghdr *pNLMsgHdr;
+    memset(&timerSpec, 0x00, sizeof(timerSpec));
+    timerSpec.it_value.tv_sec    = periodSec;
+    timerSpec.it_interval.tv_sec = periodSec;
 
-    /* Allocate netlink message header */
-    pNLMsgHdr = (struct nlmsghdr *)malloc( NLMSG_SPACE(maxPayloadSz) );
-    if (pNLMsgHdr == NULL)
+    if (timerfd_settime(timerFD, 0, &timerSpec, NULL) < 0)
     {
-        printf("ERROR - %s:%d :: Failed to allocate netlink message header\n",
-                __func__, __LINE__);
-        return NULL;
+        LOG_ERROR("Failed to arm sampling timer [%m]");
+        close(timerFD);
+        return -1;
     }
 
-    /* Initialize netlink message header */
-    memset(pNLMsgHdr, 0, NLMSG_SPACE(maxPayloadSz));
-    pNLMsgHdr->nlmsg_len   = NLMSG_SPACE(maxPayloadSz);
-    pNLMsgHdr->nlmsg_pid   = COM_NETLINK_SOURCE;
-    pNLMsgHdr->nlmsg_flags = 0;
-
-    return pNLMsgHdr;
+    return timerFD;
 }
 
-static int createNLSocket(struct sockaddr_nl *pSrcAddr,
-                          struct sockaddr_nl *pDstAddr)
+static void* createRequestWorker(uint32_t workerID)
 {
-    int sock;
+    RW_RequestWorker_t *pWorker;
 
-    if ( (pSrcAddr == NULL) ||
-         (pDstAddr == NULL) )
+    pWorker = (RW_RequestWorker_t *)calloc(1, sizeof(RW_RequestWorker_t));
+    if (pWorker == NULL)
     {
-        printf("ERROR - %s:%d :: Invalid input arguments (%p, %p)\n",
-                __func__, __LINE__,
-                pSrcAddr, pDstAddr);
-        return -1;
+        LOG_ERROR("Failed to allocate request worker %u",
+                  workerID);
+        return NULL;
     }
 
-    /* Create netlink socket */
-    sock = socket(PF_NETLINK, SOCK_RAW, COM_NETLINK_LKM);
-    if (sock < 0) { return -1; }
-
-    /* Initialize source and destination addresses */
-    memset(pSrcAddr, 0x00, sizeof(struct sockaddr_nl));
-    memset(pDstAddr, 0x00, sizeof(struct sockaddr_nl));
-
-    /* Populate source address information */
-    pSrcAddr->nl_family = AF_NETLINK;
-    pSrcAddr->nl_pid    = COM_NETLINK_SOURCE;
+    /* Worker replies on its own socket, only main socket is bound to service PID */
+    pWorker->sock = createNLSocket(&pWorker->srcAddr, &pWorker->dstAddr, COM_NETLINK_AUTOBIND);
+    if (pWorker->sock <= 0)
+    {
+        LOG_ERROR("Failed to create socket for request worker %u [%m]",
+                  workerID);
+        free(pWorker);
+        return NULL;
+    }
 
-    /* Populate destination address information */
-    pDstAddr->nl_family = AF_NETLINK;
-    pDstAddr->nl_pid    = COM_NETLINK_DESTINATION;
+    pWorker->pTxBatch = createMsgBatch(COM_NETLINK_MAX_PAYLOAD);
+    if (pWorker->pTxBatch == NULL)
+    {
+        destroyNLSocket(pWorker->sock);
+        free(pWorker);
+        return NULL;
+    }
 
-    /* Bind socket to source address */
-    bind(sock, (struct sockaddr*)pSrcAddr, sizeof(struct sockaddr_nl));
+    /* Replies go out as batched SQEs with io_uring backend, sendmmsg if ring is unavailable */
+    if (rwBackend == RW_BACKEND_URING) { pWorker->pRing = createUring(COM_NETLINK_MSG_BATCH); }
 
-    return sock;
+    return pWorker;
 }
 
-static int destroyNLMsgHdr(struct nlmsghdr *pNLMsgHdr)
+static void destroyRequestWorker(void *pWorkerCtx)
 {
-    if (pNLMsgHdr == NULL)
-    {
-        printf("ERROR - %s:%d :: Invalid input netlink message header %p\n",
-                __func__, __LINE__,
-                pNLMsgHdr);
-        return -1;
-    }
+    RW_RequestWorker_t *pWorker = (RW_RequestWorker_t *)pWorkerCtx;
 
-    /* Release netlink message header memory */
-    free(pNLMsgHdr);
+    if (pWorker->pRing != NULL) { destroyUring(pWorker->pRing); }
 
-    return 0;
+    destroyMsgBatch(pWorker->pTxBatch);
+    destroyNLSocket(pWorker->sock);
+
+    free(pWorker);
 }
 
-static int destroyNLSocket(int sock)
+static int dispatchRequestMsg(const int                 sock,
+                              const struct sockaddr_nl *pDstAddr,
+                              ComChan_MsgBatch_t       *pTxBatch,
+                              const ComChan_Message_t  *pMessage)
 {
-    if (sock <= 0)
+    if (pMessage->serviceSig != COM_NETLINK_KERNEL_SIG) { return 0; }
+
+    /* Capture request with its arrival time for offline replay */
+    if (pCapture != NULL) { writeCaptureRecord(pCapture, pMessage); }
+
+    /* Subscriptions are owned by main thread, served inline */
+    if (pMessage->resourceInfoID == SUBSCRIBE_RESOURCE_INFO)
     {
-        printf("ERROR - %s:%d :: Invalid input netlink socket %d\n",
-                __func__, __LINE__,
-                sock);
-        return -1;
+        return processSubscribeMsg(sock, pDstAddr, pTxBatch, pMessage);
     }
 
-    close(sock);
+    /* Hand request to worker queue of its priority class, full class queue drops it (counted as overflow) */
+    submitWorkerRequest(pWorkerPool, pMessage, COM_CHAN_GET_PRIO(pMessage->flags));
 
     return 0;
 }
 
-static int getDiskMemoryInfo(RW_DiskInfo_t *pDiskInfo)
+static int flushUringMessages(RW_Uring_t               *pRing,
+                              const int                 sock,
+                              const struct sockaddr_nl *pDstAddr,
+                              ComChan_MsgBatch_t       *pBatch)
 {
-    struct statvfs diskStats;
+    int retVal = 0;
+    uint32_t idx, nQueued = 0, nCompleted = 0;
+
+    struct io_uring_sqe *pSqe;
+    struct io_uring_cqe *pCqe;
 
-    if (pDiskInfo == NULL)
+    if ( (pRing    == NULL) ||
+         (pDstAddr == NULL) ||
+         (pBatch   == NULL) )
     {
-        printf("ERROR - %s:%d :: Invalid input argument for disk information (%p)\n",
-                __func__, __LINE__,
-                pDiskInfo);
+        LOG_ERROR("Invalid input pointer arguments (%p, %p, %p)",
+                  pRing, pDstAddr,
+                  pBatch);
         return -1;
     }
 
-    /* Get disk statistics */
-    if (statvfs("/", &diskStats) < 0)
+    /* One send entry per queued message */
+    for (idx = 0; idx < pBatch->nMessages; idx++)
     {
-        printf("ERROR - %s:%d :: Failed to get disk statistics [%m]\n", __func__, __LINE__);
-        return -1;
+        pSqe = getUringSqe(pRing);
+        if (pSqe == NULL) { break; }
+
+        pBatch->msgHdrs[idx].msg_hdr.msg_name    = (void *)pDstAddr;
+        pBatch->msgHdrs[idx].msg_hdr.msg_namelen = sizeof(struct sockaddr_nl);
+
+        prepUringSendmsg(pSqe, sock, &pBatch->msgHdrs[idx].msg_hdr, RW_URING_TAG_SEND);
+        nQueued++;
     }
 
-    /* Compute system's total disk size in bytes */
-    pDiskInfo->systemMemory = (diskStats.f_bsize * diskStats.f_blocks);
+    /* Submit and wait for all sends, message buffers are reused afterwards */
+    while (nCompleted < nQueued)
+    {
+        if (submitUring(pRing, (nQueued - nCompleted)) < 0)
+        {
+            retVal = -1;
+            break;
+        }
+
+        while ((pCqe = peekUringCqe(pRing)) != NULL)
+        {
+            if (pCqe->res < 0)
+            {
+                LOG_ERROR("Failed to transmit message on socket (%d) [%s]",
+                          sock, strerror(-pCqe->res));
+                retVal = -1;
+            }
+
+            seenUringCqe(pRing);
+            nCompleted++;
+        }
+    }
 
-    /* Compute system's available disk size in bytes */
-    pDiskInfo->freeMemory = (diskStats.f_bsize * diskStats.f_bfree);
+    pBatch->nMessages = 0;
 
-    return 0;
+    return (retVal < 0) ? -1 : (int)nCompleted;
 }
 
-static int getSystemMemoryInfo(RW_MemoryInfo_t *pMemoryInfo)
+static int handleRequestMsg(const int                 sock,
+                            const struct sockaddr_nl *pDstAddr,
+                            ComChan_MsgBatch_t       *pRxBatch,
+                            ComChan_MsgBatch_t       *pTxBatch)
 {
-    int64_t nPages, szPage;
+    int nMessages, nReceived = 0;
+    uint32_t idx;
 
-    if (pMemoryInfo == NULL)
+    if (sock <= 0)
     {
-        printf("ERROR - %s:%d :: Invalid input argument for memory information (%p)\n",
-                __func__, __LINE__,
-                pMemoryInfo);
+        LOG_ERROR("Invalid input socket (%d) information",
+                  sock);
         return -1;
     }
 
-    /* Get system's page size in bytes */
-    szPage = sysconf(_SC_PAGESIZE);
-    if (szPage < 1)
+    if ( (pDstAddr == NULL) ||
+         (pRxBatch == NULL) ||
+         (pTxBatch == NULL) )
     {
-        printf("ERROR - %s:%d :: Failed to get page size [%m]\n", __func__, __LINE__);
+        LOG_ERROR("Invalid input pointer arguments (%p, %p, %p)",
+                  pDstAddr, pRxBatch,
+                  pTxBatch);
         return -1;
     }
 
-    /* Get system's total number pages */
-    nPages = sysconf(_SC_PHYS_PAGES);
-    if (nPages < 0)
+    /* Drain netlink socket, batch by batch */
+    do
     {
-        printf("ERROR - %s:%d :: Failed to get total number of pages [%m]\n", __func__, __LINE__);
-        return -1;
-    }
+        nMessages = receiveMsgBatch(sock, pRxBatch);
+        if (nMessages < 0) { return -1; }
 
-    /* Compute system's total memory in bytes */
-    pMemoryInfo->systemMemory = (nPages * szPage);
+        for (idx = 0; idx < (uint32_t)nMessages; idx++)
+        {
+            dispatchRequestMsg(sock, pDstAddr, pTxBatch, getBatchMessage(pRxBatch, idx));
+        }
 
-    /* Get system's available number of pages */
-    nPages = sysconf(_SC_AVPHYS_PAGES);
-    if (nPages < 0)
-    {
-        printf("ERROR - %s:%d :: Failed to get available number of pages [%m]\n", __func__, __LINE__);
-        return -1;
-    }
+        nReceived += nMessages;
+    } while (nMessages == COM_NETLINK_MSG_BATCH);
 
-    /* Compute system's available memory in bytes */
-    pMemoryInfo->freeMemory = (nPages * szPage);
+    /* Transmit replies of subscription requests served inline */
+    if (pTxBatch->nMessages > 0) { flushMessages(sock, pDstAddr, pTxBatch); }
 
-    return 0;
+    return nReceived;
 }
 
-static int handleRequestMsg(const int                 sock,
-                            const struct sockaddr_nl *pDstAddr,
-                            const struct nlmsghdr    *pNLMsgHdr)
+static int processRequestMsg(const int                 sock,
+                             const struct sockaddr_nl *pDstAddr,
+                             ComChan_MsgBatch_t       *pTxBatch,
+                             const ComChan_Message_t  *pMessage)
 {
     int retVal;
 
-    struct iovec ioVector;
-    struct msghdr msgHdr;
-
-    ComChan_Message_t *pMessage;
-    ComChan_Message_t  resWatcherMsg;
+    ComChan_Message_t resWatcherMsg;
 
-    if (sock <= 0)
+    if ( (pDstAddr == NULL) ||
+         (pTxBatch == NULL) ||
+         (pMessage == NULL) )
     {
-        printf("ERROR - %s:%d :: Invalid input socket (%d) information\n",
-                __func__, __LINE__,
-                sock);
+        LOG_ERROR("Invalid input pointer arguments (%p, %p, %p)",
+                  pDstAddr, pTxBatch,
+                  pMessage);
         return -1;
     }
 
-    if ( (pDstAddr  == NULL) ||
-         (pNLMsgHdr == NULL) )
-    {
-        printf("ERROR - %s:%d :: Invalid input pointer arguments (%p, %p)\n",
-                __func__, __LINE__,
-                pDstAddr, pNLMsgHdr);
-        return -1;
-    }
+    /* Reply leaves the process, no stale stack bytes in unused union members or reserved fields */
+    memset(&resWatcherMsg, 0x00, sizeof(ComChan_Message_t));
 
-    /* Reset I/O vector and message header */
-    memset(&ioVector, 0x00, sizeof(ioVector));
-    memset(&msgHdr,   0x00, sizeof(msgHdr));
+    /* Echo query sequence ID and requester, relay routes reply by requester and requester matches it by sequence ID */
+    resWatcherMsg.seqID        = pMessage->seqID;
+    resWatcherMsg.requesterSig = pMessage->requesterSig;
 
-    /* Populate I/O vector information */
-    ioVector.iov_base = (void *)pNLMsgHdr;
-    ioVector.iov_len = pNLMsgHdr->nlmsg_len;
+    /* Reply keeps priority class of its query */
+    resWatcherMsg.flags        = (pMessage->flags & COM_CHAN_FLAG_PRIO_MASK);
 
-    /* Populate message header */
-    msgHdr.msg_iov = &ioVector;
-    msgHdr.msg_iovlen = 1;                          // Single I/O vector
+    /* Echo stage times, collection is timed from here */
+    memcpy(resWatcherMsg.stageTimes, pMessage->stageTimes, sizeof(resWatcherMsg.stageTimes));
+    stampComChanStage(&resWatcherMsg, COM_CHAN_STAGE_COLLECT_START);
 
-    /* Receive message on netlink socket */
-    retVal = recvmsg(sock, &msgHdr, 0);
-    if (retVal < 0)
+    switch (pMessage->resourceInfoID)
     {
-        printf("ERROR - %s:%d :: Failed to read from socket (%d) [%m]\n",
-                __func__, __LINE__,
-                sock);
-        return retVal;
-    }
+        case DISK_RESOURCE_INFO:
+        {
+            /* Populate message for disk information */
+            resWatcherMsg.serviceSig        = COM_NETLINK_RW_SIG;
+            resWatcherMsg.resourceInfoID    = DISK_RESOURCE_INFO;
 
-    /* Get message data */
-    pMessage = (ComChan_Message_t *)NLMSG_DATA(pNLMsgHdr);
-    if ( (pMessage != NULL) &&
-         (pMessage->serviceSig == COM_NETLINK_KERNEL_SIG) )
-    {
-        switch (pMessage->resourceInfoID)
+            /* Populate system disk memory information */
+            if (getDiskMemoryInfo(&resWatcherMsg.res_info.diskInfo) == 0)
+            {
+                /* Queue reply, transmitted with rest of batch */
+                queueReplyMsg(sock, pDstAddr, pTxBatch, &resWatcherMsg);
+            }
+
+            break;
+        }
+
+        case MEMORY_RESOURCE_INFO:
         {
-            case DISK_RESOURCE_INFO:
+            /* Populate message for memory information */
+            resWatcherMsg.serviceSig        = COM_NETLINK_RW_SIG;
+            resWatcherMsg.resourceInfoID    = MEMORY_RESOURCE_INFO;
+
+            /* Populate system memory information */
+            if (getSystemMemoryInfo(&resWatcherMsg.res_info.memoryInfo) == 0)
             {
-                /* Populate message for disk information */
-                resWatcherMsg.serviceSig        = COM_NETLINK_RW_SIG;
-                resWatcherMsg.resourceInfoID    = DISK_RESOURCE_INFO;
-                resWatcherMsg.flags             = 0;
+                /* Queue reply, transmitted with rest of batch */
+                queueReplyMsg(sock, pDstAddr, pTxBatch, &resWatcherMsg);
+            }
 
-                /* Populate system disk memory information */
-                if (getDiskMemoryInfo(&resWatcherMsg.res_info.diskInfo) == 0)
-                {
-                    /* Send service information message */
-                    sendMessage(sock, pDstAddr, pNLMsgHdr, &resWatcherMsg);
-                }
+            break;
+        }
+
+        case HISTORY_RESOURCE_INFO:
+        {
+            /* Populate message for history window, query parameters are echoed */
+            resWatcherMsg.serviceSig        = COM_NETLINK_RW_SIG;
+            resWatcherMsg.resourceInfoID    = HISTORY_RESOURCE_INFO;
+
+            memcpy(&resWatcherMsg.res_info.historyInfo, &pMessage->res_info.historyInfo, sizeof(RW_HistoryInfo_t));
 
-                break;
+            /* Populate requested metric window from history */
+            pthread_rwlock_rdlock(&metricsLock);
+            retVal = queryHistory(pHistory, &resWatcherMsg.res_info.historyInfo);
+            pthread_rwlock_unlock(&metricsLock);
+
+            if (retVal == 0)
+            {
+                /* Queue reply, transmitted with rest of batch */
+                queueReplyMsg(sock, pDstAddr, pTxBatch, &resWatcherMsg);
             }
 
-            case MEMORY_RESOURCE_INFO:
+            break;
+        }
+
+        case QUANTILE_RESOURCE_INFO:
+        {
+            /* Populate message for window quantiles, query parameters are echoed */
+            resWatcherMsg.serviceSig        = COM_NETLINK_RW_SIG;
+            resWatcherMsg.resourceInfoID    = QUANTILE_RESOURCE_INFO;
+
+            memcpy(&resWatcherMsg.res_info.quantileInfo, &pMessage->res_info.quantileInfo, sizeof(RW_QuantileInfo_t));
+
+            /* Merge window sketches and compute quantiles */
+            pthread_rwlock_rdlock(&metricsLock);
+            retVal = querySketchStore(pSketchStore, &resWatcherMsg.res_info.quantileInfo);
+            pthread_rwlock_unlock(&metricsLock);
+
+            if (retVal == 0)
             {
-                /* Populate message for memory information */
-                resWatcherMsg.serviceSig        = COM_NETLINK_RW_SIG;
-                resWatcherMsg.resourceInfoID    = MEMORY_RESOURCE_INFO;
-                resWatcherMsg.flags             = 0;
+                /* Queue reply, transmitted with rest of batch */
+                queueReplyMsg(sock, pDstAddr, pTxBatch, &resWatcherMsg);
+            }
 
-                /* Populate system memory information */
-                if (getSystemMemoryInfo(&resWatcherMsg.res_info.memoryInfo) == 0)
-                {
-                    /* Send service information message */
-                    sendMessage(sock, pDstAddr, pNLMsgHdr, &resWatcherMsg);
-                }
+            break;
+        }
 
-                break;
+        case MULTI_RESOURCE_INFO:
+        {
+            uint32_t       resourceMask = pMessage->res_info.multiInfo.resourceMask;
+            RW_MultiInfo_t *pMultiInfo  = &resWatcherMsg.res_info.multiInfo;
+
+            /* Populate message for requested sections, collected in one pass */
+            resWatcherMsg.serviceSig        = COM_NETLINK_RW_SIG;
+            resWatcherMsg.resourceInfoID    = MULTI_RESOURCE_INFO;
+
+            memset(pMultiInfo, 0x00, sizeof(RW_MultiInfo_t));
+            pMultiInfo->cpuInfo.firstCPU = pMessage->res_info.multiInfo.cpuInfo.firstCPU;
+
+            /* Reply mask carries sections collected, failed or unknown sections are left out */
+            if ( (resourceMask & RW_RESOURCE_MASK(DISK_RESOURCE_INFO)) &&
+                 (getDiskMemoryInfo(&pMultiInfo->diskInfo) == 0) )
+            {
+                pMultiInfo->resourceMask |= RW_RESOURCE_MASK(DISK_RESOURCE_INFO);
+            }
+
+            if ( (resourceMask & RW_RESOURCE_MASK(MEMORY_RESOURCE_INFO)) &&
+                 (getSystemMemoryInfo(&pMultiInfo->memoryInfo) == 0) )
+            {
+                pMultiInfo->resourceMask |= RW_RESOURCE_MASK(MEMORY_RESOURCE_INFO);
+            }
+
+            if (resourceMask & RW_RESOURCE_MASK(CPU_RESOURCE_INFO))
+            {
+                /* Latest utilisation of sampling timer, queries don't move sample baseline */
+                pthread_mutex_lock(&cpuLock);
+                retVal = getCpuUtilInfo(pCpuCollector, pMultiInfo->cpuInfo.firstCPU, &pMultiInfo->cpuInfo);
+                pthread_mutex_unlock(&cpuLock);
+
+                if (retVal == 0) { pMultiInfo->resourceMask |= RW_RESOURCE_MASK(CPU_RESOURCE_INFO); }
+            }
+
+            /* Queue combined reply, transmitted with rest of batch */
+            queueReplyMsg(sock, pDstAddr, pTxBatch, &resWatcherMsg);
+
+            break;
+        }
+
+        case CPU_RESOURCE_INFO:
+        {
+            uint16_t firstCPU = pMessage->res_info.cpuInfo.firstCPU;
+
+            /* Populate message for CPU information */
+            resWatcherMsg.serviceSig        = COM_NETLINK_RW_SIG;
+            resWatcherMsg.resourceInfoID    = CPU_RESOURCE_INFO;
+
+            /* Populate requested cores window from latest utilisation of sampling timer */
+            pthread_mutex_lock(&cpuLock);
+            retVal = getCpuUtilInfo(pCpuCollector, firstCPU, &resWatcherMsg.res_info.cpuInfo);
+            pthread_mutex_unlock(&cpuLock);
+
+            if (retVal == 0)
+            {
+                /* Queue reply, transmitted with rest of batch */
+                queueReplyMsg(sock, pDstAddr, pTxBatch, &resWatcherMsg);
+            }
+
+            break;
+        }
+
+        case NUMA_RESOURCE_INFO:
+        {
+            uint16_t firstNode = pMessage->res_info.numaInfo.firstNode;
+
+            /* Unanswered if host exposes no NUMA nodes */
+            if (pNumaCollector == NULL) { break; }
+
+            /* Populate message for NUMA nodes information */
+            resWatcherMsg.serviceSig        = COM_NETLINK_RW_SIG;
+            resWatcherMsg.resourceInfoID    = NUMA_RESOURCE_INFO;
+
+            /* Read node files and populate requested nodes window, node files are read without locking */
+            if (getNumaMemoryInfo(pNumaCollector, firstNode, &resWatcherMsg.res_info.numaInfo) == 0)
+            {
+                /* Queue reply, transmitted with rest of batch */
+                queueReplyMsg(sock, pDstAddr, pTxBatch, &resWatcherMsg);
+            }
+
+            break;
+        }
+
+        case FRAG_RESOURCE_INFO:
+        {
+            uint16_t firstZone = pMessage->res_info.fragInfo.firstZone;
+
+            /* Unanswered if free block counts are unavailable */
+            if (pFragCollector == NULL) { break; }
+
+            /* Populate message for memory fragmentation information */
+            resWatcherMsg.serviceSig        = COM_NETLINK_RW_SIG;
+            resWatcherMsg.resourceInfoID    = FRAG_RESOURCE_INFO;
+
+            /* Read free lists and compaction counters, populate requested zones window */
+            if (getFragmentationInfo(pFragCollector, firstZone, &resWatcherMsg.res_info.fragInfo) == 0)
+            {
+                /* Queue reply, transmitted with rest of batch */
+                queueReplyMsg(sock, pDstAddr, pTxBatch, &resWatcherMsg);
+            }
+
+            break;
+        }
+
+        case DU_RESOURCE_INFO:
+        {
+            uint16_t rootIndex = pMessage->res_info.duInfo.rootIndex;
+            uint16_t maxDepth  = pMessage->res_info.duInfo.maxDepth;
+            uint16_t window    = pMessage->res_info.duInfo.window;
+
+            /* Unanswered if no directory tree is scanned */
+            if (pDuScanner == NULL) { break; }
+
+            /* Populate message for directory usage information */
+            resWatcherMsg.serviceSig        = COM_NETLINK_RW_SIG;
+            resWatcherMsg.resourceInfoID    = DU_RESOURCE_INFO;
+
+            /* Rank largest subtrees, or fastest growing over window, of scanner index */
+            if (getDiskUsageInfo(pDuScanner, rootIndex, maxDepth, window, &resWatcherMsg.res_info.duInfo) == 0)
+            {
+                /* Queue reply, transmitted with rest of batch */
+                queueReplyMsg(sock, pDstAddr, pTxBatch, &resWatcherMsg);
             }
+
+            break;
         }
     }
 
-    return retVal;
+    return 0;
 }
 
-static int registerEvent(int epollFD, int eventFD)
+static int handleSampleTimer(const int                 sock,
+                             const struct sockaddr_nl *pDstAddr,
+                             ComChan_MsgBatch_t       *pTxBatch,
+                             const int                 timerFD)
 {
-    struct epoll_event epollEvent;
+    int      retVal;
+    uint64_t nExpirations;
+
+    RW_CpuInfo_t    cpuInfo;
 
-    if ( (epollFD < 0) || (eventFD < 0) )
+    /* Acknowledge timer expiration(s) */
+    if (read(timerFD, &nExpirations, sizeof(nExpirations)) < 0)
     {
-        printf("ERROR - %s:%d :: Invalid input arguments for event registration (%d, %d)\n",
-                __func__, __LINE__,
-                epollFD, eventFD);
+        if (errno == EAGAIN) { return 0; }
+
+        LOG_ERROR("Failed to read sampling timer [%m]");
         return -1;
     }
 
-    /* Initialize event information */
-    memset((void *)&epollEvent, 0x00, sizeof(struct epoll_event));
+    pthread_mutex_lock(&cpuLock);
+    retVal = sampleCpuCollector(pCpuCollector);
+    if (retVal == 0) { retVal = getCpuUtilInfo(pCpuCollector, 0, &cpuInfo); }
+    pthread_mutex_unlock(&cpuLock);
+
+    /* Skip sample if CPU collector fails */
+    if (retVal < 0) { return 0; }
+
+    retVal = recordSample(&cpuInfo);
 
-    /* Register reading event */
-    epollEvent.events = EPOLLIN;
-    epollEvent.data.fd = eventFD;
+    /* Push sample to due subscribers */
+    pushSubscriptions(sock, pDstAddr, pTxBatch);
+    if (pTxBatch->nMessages > 0) { flushMessages(sock, pDstAddr, pTxBatch); }
 
-    if (epoll_ctl(epollFD, EPOLL_CTL_ADD, eventFD, &epollEvent) < 0)
+    return retVal;
+}
+
+static void handleStopSignal(int signum)
+{
+    /* Only flag stop, event loop leaves on its next wake up (at most one sampling period) */
+    stopSignal = signum;
+}
+
+static int parseArguments(int argc, char **args)
+{
+    int option;
+
+    char *pEnd;
+    unsigned long port, budget;
+
+    while ((option = getopt(argc, args, "b:m:r:u:c:i:")) != -1)
     {
-        printf("ERROR - %s:%d :: Failed to register event [%m]\n", __func__, __LINE__);
-        return -1;
+        if ( (option == 'b') && (strcmp(optarg, "epoll") == 0) )
+        {
+            rwBackend = RW_BACKEND_EPOLL;
+        }
+        else if ( (option == 'b') && (strcmp(optarg, "uring") == 0) )
+        {
+            rwBackend = RW_BACKEND_URING;
+        }
+        else if (option == 'm')
+        {
+            /* Metrics exposition port, 0 disables exposition */
+            errno = 0;
+            port  = strtoul(optarg, &pEnd, 10);
+
+            if ( (errno != 0) ||
+                 (*pEnd != '\0') ||
+                 (port > UINT16_MAX) )
+            {
+                LOG_ERROR("Invalid metrics port '%s'",
+                          optarg);
+                return -1;
+            }
+
+            metricsPort = (uint16_t)port;
+        }
+        else if (option == 'r')
+        {
+            /* Capture every request into trace file */
+            pCapturePath = optarg;
+        }
+        else if (option == 'u')
+        {
+            /* Directory tree scanned for usage, repeated for every tree */
+            if (duConfig.nRoots == RW_DU_MAX_ROOTS)
+            {
+                LOG_ERROR("More than %u disk usage roots, '%s' is not scanned",
+                          RW_DU_MAX_ROOTS, optarg);
+                return -1;
+            }
+
+            duConfig.pRoots[duConfig.nRoots++] = optarg;
+        }
+        else if ( (option == 'c') || (option == 'i') )
+        {
+            /* Disk usage scan budgets, 0 lifts budget */
+            errno  = 0;
+            budget = strtoul(optarg, &pEnd, 10);
+
+            if ( (errno != 0) ||
+                 (*pEnd != '\0') ||
+                 (budget > UINT32_MAX) )
+            {
+                LOG_ERROR("Invalid disk usage scan budget '%s' for option -%c",
+                          optarg, option);
+                return -1;
+            }
+
+            if (option == 'c') { duConfig.cpuBudget   = (uint32_t)budget; }
+            else               { duConfig.inodeBudget = (uint32_t)budget; }
+        }
+        else
+        {
+            printf("Usage: %s [-b epoll|uring] [-m port] [-r trace] [-u directory]... [-c cpu percent] [-i inodes per second]\n", args[0]);
+            return -1;
+        }
     }
 
     return 0;
 }
 
-static int sendMessage(const int                 sock,
-                       const struct sockaddr_nl *pDstAddr,
-                       const struct nlmsghdr    *pNLMsgHdr,
-                       const ComChan_Message_t  *pMessage)
+static int processSubscribeMsg(const int                 sock,
+                               const struct sockaddr_nl *pDstAddr,
+                               ComChan_MsgBatch_t       *pTxBatch,
+                               const ComChan_Message_t  *pMessage)
 {
-    int retVal;
+    ComChan_Message_t resWatcherMsg;
 
-    struct iovec ioVector;
-    struct msghdr msgHdr;
+    /* Populate acknowledgement, subscription parameters are echoed with accepted sections */
+    memset(&resWatcherMsg, 0x00, sizeof(ComChan_Message_t));
+    resWatcherMsg.serviceSig        = COM_NETLINK_RW_SIG;
+    resWatcherMsg.resourceInfoID    = SUBSCRIBE_RESOURCE_INFO;
+    resWatcherMsg.flags             = (pMessage->flags & COM_CHAN_FLAG_PRIO_MASK);
+    resWatcherMsg.seqID             = pMessage->seqID;
+    resWatcherMsg.requesterSig      = pMessage->requesterSig;
 
-    if (sock <= 0)
+    memcpy(resWatcherMsg.stageTimes, pMessage->stageTimes, sizeof(resWatcherMsg.stageTimes));
+    stampComChanStage(&resWatcherMsg, COM_CHAN_STAGE_COLLECT_START);
+
+    memcpy(&resWatcherMsg.res_info.subscribeInfo, &pMessage->res_info.subscribeInfo, sizeof(RW_SubscribeInfo_t));
+
+    /* Add, renew, update or cancel subscription of requester */
+    updateSubscription(pSubscriptionTable, pMessage->requesterSig,
+                       COM_CHAN_GET_PRIO(pMessage->flags),
+                       &resWatcherMsg.res_info.subscribeInfo, (int64_t)time(NULL));
+
+    /* Queue acknowledgement, transmitted with rest of batch */
+    return queueReplyMsg(sock, pDstAddr, pTxBatch, &resWatcherMsg);
+}
+
+static int pushSubscription(void *pArg, const RW_Subscription_t *pSubscription)
+{
+    int retVal = 0;
+
+    RW_PushContext_t *pContext = (RW_PushContext_t *)pArg;
+    ComChan_Message_t resWatcherMsg;
+
+    /* Populate push message from latest sample, unmatched by any query */
+    memset(&resWatcherMsg, 0x00, sizeof(ComChan_Message_t));
+    resWatcherMsg.serviceSig        = COM_NETLINK_RW_SIG;
+    resWatcherMsg.resourceInfoID    = MULTI_RESOURCE_INFO;
+    resWatcherMsg.flags             = pSubscription->prioClass;
+    resWatcherMsg.seqID             = COM_CHAN_SEQ_NONE;
+    resWatcherMsg.requesterSig      = pSubscription->requesterSig;
+
+    memcpy(&resWatcherMsg.res_info.multiInfo, &latestSample, sizeof(RW_MultiInfo_t));
+    resWatcherMsg.res_info.multiInfo.resourceMask  &= pSubscription->resourceMask;
+    resWatcherMsg.res_info.multiInfo.subscriptionID = pSubscription->subscriptionID;
+
+    /* Sample holds cores window from core 0, other windows come from same collector sample */
+    if ( (resWatcherMsg.res_info.multiInfo.resourceMask & RW_RESOURCE_MASK(CPU_RESOURCE_INFO)) &&
+         (pSubscription->firstCPU != 0) )
+    {
+        pthread_mutex_lock(&cpuLock);
+        retVal = getCpuUtilInfo(pCpuCollector, pSubscription->firstCPU, &resWatcherMsg.res_info.multiInfo.cpuInfo);
+        pthread_mutex_unlock(&cpuLock);
+
+        if (retVal < 0) { resWatcherMsg.res_info.multiInfo.resourceMask &= ~RW_RESOURCE_MASK(CPU_RESOURCE_INFO); }
+    }
+
+    /* Queue push, transmitted with rest of batch */
+    return queueMessage(pContext->sock, pContext->pDstAddr, pContext->pTxBatch, &resWatcherMsg);
+}
+
+static int pushSubscriptions(const int                 sock,
+                             const struct sockaddr_nl *pDstAddr,
+                             ComChan_MsgBatch_t       *pTxBatch)
+{
+    RW_PushContext_t context;
+
+    if (latestSampleTime == 0) { return 0; }
+
+    context.sock     = sock;
+    context.pDstAddr = pDstAddr;
+    context.pTxBatch = pTxBatch;
+
+    /* One sampling pass serves every subscriber due at this tick */
+    return pushDueSubscriptions(pSubscriptionTable, latestSampleTime, pushSubscription, &context);
+}
+
+static int queueReplyMsg(const int                 sock,
+                         const struct sockaddr_nl *pDstAddr,
+                         ComChan_MsgBatch_t       *pTxBatch,
+                         ComChan_Message_t        *pReply)
+{
+    /* Reply carries stages passed so far, record them before it leaves */
+    stampComChanStage(pReply, COM_CHAN_STAGE_COLLECT_END);
+    recordComChanStages(&stageStats, pReply);
+
+    return queueMessage(sock, pDstAddr, pTxBatch, pReply);
+}
+
+static int recordSample(const RW_CpuInfo_t *pCpuInfo)
+{
+    int      retVal;
+    int64_t  timestamp;
+    uint32_t classID;
+
+    RW_WorkerClassStats_t classStats[COM_CHAN_PRIO_MAX];
+
+    RW_DiskInfo_t   diskInfo;
+    RW_MemoryInfo_t memoryInfo;
+
+    int64_t values[RW_METRIC_MAX];
+
+    /* Collect resource information, skip sample if any collector fails */
+    if ( (getDiskMemoryInfo(&diskInfo) < 0) ||
+         (getSystemMemoryInfo(&memoryInfo) < 0) )
+    {
+        return 0;
+    }
+
+    /* Keep sections of latest sample for subscribers */
+    latestSample.resourceMask = (RW_RESOURCE_MASK(DISK_RESOURCE_INFO)   |
+                                 RW_RESOURCE_MASK(MEMORY_RESOURCE_INFO) |
+                                 RW_RESOURCE_MASK(CPU_RESOURCE_INFO));
+    memcpy(&latestSample.diskInfo,   &diskInfo,   sizeof(RW_DiskInfo_t));
+    memcpy(&latestSample.memoryInfo, &memoryInfo, sizeof(RW_MemoryInfo_t));
+    memcpy(&latestSample.cpuInfo,    pCpuInfo,    sizeof(RW_CpuInfo_t));
+
+    values[RW_METRIC_DISK_FREE]   = (int64_t)diskInfo.freeMemory;
+    values[RW_METRIC_MEMORY_FREE] = (int64_t)memoryInfo.freeMemory;
+    values[RW_METRIC_CPU_USER]    = pCpuInfo->aggregate.user;
+    values[RW_METRIC_CPU_SYSTEM]  = pCpuInfo->aggregate.system;
+    values[RW_METRIC_CPU_IOWAIT]  = pCpuInfo->aggregate.iowait;
+    values[RW_METRIC_CPU_STEAL]   = pCpuInfo->aggregate.steal;
+
+    timestamp        = (int64_t)time(NULL);
+    latestSampleTime = timestamp;
+
+    /* Render exposition once per sample, scrapes are served from rendered response */
+    if (pMetricsServer != NULL)
+    {
+        memset(classStats, 0x00, sizeof(classStats));
+        for (classID = 0; classID < COM_CHAN_PRIO_MAX; classID++)
+        {
+            getWorkerClassStats(pWorkerPool, classID, &classStats[classID]);
+        }
+
+        /* Collector is only sampled on this thread, cores are read without CPU lock */
+        publishMetrics(pMetricsServer, &latestSample, pCpuCollector, &stageStats, classStats, COM_CHAN_PRIO_MAX, timestamp);
+    }
+
+    /* Write captured requests out once per sample, a capture cut short loses at most one second */
+    if (pCapture != NULL) { flushCaptureWriter(pCapture); }
+
+    /* Persist sample, store is optional if segments directory is unavailable */
+    if (pTsdb != NULL) { appendTsdbSample(pTsdb, timestamp, values); }
+
+    pthread_rwlock_wrlock(&metricsLock);
+
+    /* Update current window quantile sketches */
+    insertSketchSample(pSketchStore, timestamp, values);
+
+    /* Insert sample into history, rollups are updated on insert */
+    retVal = insertHistorySample(pHistory, timestamp, values);
+
+    pthread_rwlock_unlock(&metricsLock);
+
+    return retVal;
+}
+
+static int restoreSample(__attribute__((unused)) void *pArg,
+                         int64_t                      timestamp,
+                         const int64_t                values[RW_METRIC_MAX])
+{
+    /* Replay stored sample into quantile sketches and history rings */
+    insertSketchSample(pSketchStore, timestamp, values);
+
+    return insertHistorySample(pHistory, timestamp, values);
+}
+
+static int runUringLoop(const int                 sock,
+                        const struct sockaddr_nl *pDstAddr,
+                        ComChan_MsgBatch_t       *pTxBatch,
+                        const int                 timerFD)
+{
+    int  result;
+    char statPending = 0x00;
+    unsigned char RW_SERVICE_RUNNING = 0x01;
+
+    uint16_t bufID;
+    uint32_t flags, recvBufSz;
+    uint64_t tag;
+
+    uint8_t  *pRecvBuffers, *pFixedBuf;
+    uint64_t *pExpirations;
+    char     *pStatBuf;
+
+    RW_Uring_t *pRing;
+    RW_CpuInfo_t cpuInfo;
+
+    struct nlmsghdr *pNLMsgHdr;
+
+    struct iovec fixedVector;
+    struct io_uring_sqe *pSqe;
+    struct io_uring_cqe *pCqe;
+
+    /* Create event loop ring */
+    pRing = createUring(RW_URING_ENTRIES);
+    if (pRing == NULL) { return -1; }
+
+    /* Receive buffers are provided to kernel, picked per datagram by multishot receive */
+    recvBufSz    = NLMSG_SPACE(COM_NETLINK_MAX_PAYLOAD);
+    pRecvBuffers = (uint8_t *)malloc(RW_URING_RECV_BUFFERS * recvBufSz);
+
+    /* Registered buffer holds timer expirations followed by /proc/stat contents */
+    pFixedBuf = (uint8_t *)malloc(sizeof(uint64_t) + RW_URING_STAT_BUF_SZ);
+
+    if ( (pRecvBuffers == NULL) ||
+         (pFixedBuf    == NULL) )
     {
-        printf("ERROR - %s:%d :: Invalid input socket (%d) information\n",
-                __func__, __LINE__,
-                sock);
+        LOG_ERROR("Failed to allocate ring buffers");
+
+        free(pFixedBuf);
+        free(pRecvBuffers);
+        destroyUring(pRing);
         return -1;
     }
 
-    if ( (pDstAddr  == NULL) ||
-         (pNLMsgHdr == NULL) ||
-         (pMessage  == NULL) )
+    fixedVector.iov_base = pFixedBuf;
+    fixedVector.iov_len  = sizeof(uint64_t) + RW_URING_STAT_BUF_SZ;
+
+    if (registerUringBuffers(pRing, &fixedVector, 1) < 0)
     {
-        printf("ERROR - %s:%d :: Invalid input pointer arguments (%p, %p, %p)\n",
-                __func__, __LINE__,
-                pDstAddr, pNLMsgHdr,
-                pMessage);
+        free(pFixedBuf);
+        free(pRecvBuffers);
+        destroyUring(pRing);
         return -1;
     }
 
-    /* Copy message to netlink buffer */
-    memcpy(NLMSG_DATA(pNLMsgHdr), pMessage, sizeof(ComChan_Message_t));
+    pExpirations = (uint64_t *)pFixedBuf;
+    pStatBuf     = (char *)(pFixedBuf + sizeof(uint64_t));
+
+    /* Timer reads are completed by ring, not polled */
+    fcntl(timerFD, F_SETFL, (fcntl(timerFD, F_GETFL) & ~O_NONBLOCK));
 
-    /* Reset I/O vector and message header */
-    memset(&ioVector, 0x00, sizeof(ioVector));
-    memset(&msgHdr,   0x00, sizeof(msgHdr));
+    /* Provide receive buffers, arm multishot receive and timer read in one submission */
+    pSqe = getUringSqe(pRing);
+    prepUringProvideBuffers(pSqe, pRecvBuffers, recvBufSz, RW_URING_RECV_BUFFERS,
+                            RW_URING_RECV_GROUP, 0, RW_URING_TAG_PROVIDE);
 
-    /* Populate I/O vector information */
-    ioVector.iov_base = (void *)pNLMsgHdr;
-    ioVector.iov_len = pNLMsgHdr->nlmsg_len;
+    pSqe = getUringSqe(pRing);
+    prepUringRecvMultishot(pSqe, sock, RW_URING_RECV_GROUP, RW_URING_TAG_RECV);
 
-    /* Populate message header */
-    msgHdr.msg_name = (void *)pDstAddr;
-    msgHdr.msg_namelen = sizeof(struct sockaddr_nl);
-    msgHdr.msg_iov = &ioVector;
-    msgHdr.msg_iovlen = 1;                          // Single I/O vector
+    pSqe = getUringSqe(pRing);
+    prepUringReadFixed(pSqe, timerFD, pExpirations, sizeof(uint64_t), 0, 0, RW_URING_TAG_TIMER);
 
-    retVal = sendmsg(sock, &msgHdr, 0);
-    if (retVal < 0)
+    while ( RW_SERVICE_RUNNING &&
+            (stopSignal == 0) )
     {
-        printf("ERROR - %s:%d :: Failed to transmit message on socket (%d) [%m]\n",
-                __func__, __LINE__,
-                sock);
+        /* Submit queued entries and wait for at least one completion */
+        if (submitUring(pRing, 1) < 0) { break; }
+
+        /* Process completions */
+        while ((pCqe = peekUringCqe(pRing)) != NULL)
+        {
+            result = pCqe->res;
+            flags  = pCqe->flags;
+            tag    = pCqe->user_data;
+
+            seenUringCqe(pRing);
+
+            switch (tag)
+            {
+                case RW_URING_TAG_RECV:
+                {
+                    if (flags & IORING_CQE_F_BUFFER)
+                    {
+                        bufID = (uint16_t)(flags >> IORING_CQE_BUFFER_SHIFT);
+
+                        pNLMsgHdr = (struct nlmsghdr *)(pRecvBuffers + (bufID * recvBufSz));
+
+                        /* Short message would be read with stale bytes of previous message in this buffer */
+                        if ( (result > 0) &&
+                             isCompleteMessage(pNLMsgHdr, (size_t)result) )
+                        {
+                            dispatchRequestMsg(sock, pDstAddr, pTxBatch, (ComChan_Message_t *)NLMSG_DATA(pNLMsgHdr));
+                        }
+                        else if (result > 0)
+                        {
+                            LOG_WARNING("Short message (%d bytes) dropped on socket (%d)",
+                                        result, sock);
+                        }
+
+                        /* Request is copied out, hand buffer back to kernel */
+                        if ((pSqe = getUringSqe(pRing)) != NULL)
+                        {
+                            prepUringProvideBuffers(pSqe, (pRecvBuffers + (bufID * recvBufSz)), recvBufSz, 1,
+                                                    RW_URING_RECV_GROUP, bufID, RW_URING_TAG_PROVIDE);
+                        }
+                    }
+
+                    if ( (result < 0) && (result != -ENOBUFS) )
+                    {
+                        /* Error detected on netlink socket */
+                        LOG_ERROR("Failed to read from socket (%d) [%s]",
+                                  sock, strerror(-result));
+                        RW_SERVICE_RUNNING = 0;
+                    }
+                    else if ((flags & IORING_CQE_F_MORE) == 0)
+                    {
+                        /* Multishot receive terminated (e.g. out of buffers), re-arm */
+                        if ((pSqe = getUringSqe(pRing)) == NULL) { RW_SERVICE_RUNNING = 0; break; }
+
+                        prepUringRecvMultishot(pSqe, sock, RW_URING_RECV_GROUP, RW_URING_TAG_RECV);
+                    }
+
+                    break;
+                }
+
+                case RW_URING_TAG_PROVIDE:
+                {
+                    if (result < 0)
+                    {
+                        LOG_ERROR("Failed to provide receive buffers [%s]",
+                                  strerror(-result));
+                    }
+
+                    break;
+                }
+
+                case RW_URING_TAG_TIMER:
+                {
+                    if (result < 0)
+                    {
+                        LOG_ERROR("Failed to read sampling timer [%s]",
+                                  strerror(-result));
+                        RW_SERVICE_RUNNING = 0;
+                        break;
+                    }
+
+                    /* Read /proc/stat into registered buffer, skip if previous read is in flight */
+                    if ( (statPending == 0x00) &&
+                         ((pSqe = getUringSqe(pRing)) != NULL) )
+                    {
+                        prepUringReadFixed(pSqe, getCpuStatFD(pCpuCollector), pStatBuf,
+                                           RW_URING_STAT_BUF_SZ, 0, 0, RW_URING_TAG_STAT);
+                        statPending = 0x01;
+                    }
+
+                    /* Re-arm timer read */
+                    if ((pSqe = getUringSqe(pRing)) == NULL) { RW_SERVICE_RUNNING = 0; break; }
+
+                    prepUringReadFixed(pSqe, timerFD, pExpirations, sizeof(uint64_t), 0, 0, RW_URING_TAG_TIMER);
+                    break;
+                }
+
+                case RW_URING_TAG_STAT:
+                {
+                    statPending = 0x00;
+
+                    if (result < 0)
+                    {
+                        LOG_ERROR("Failed to read /proc/stat [%s]",
+                                  strerror(-result));
+                        break;
+                    }
+
+                    /* Parse contents; if buffer was filled, fall back to synchronous read */
+                    pthread_mutex_lock(&cpuLock);
+                    if ( ((uint32_t)result >= RW_URING_STAT_BUF_SZ) ||
+                         (loadCpuCollector(pCpuCollector, pStatBuf, (size_t)result) < 0) )
+                    {
+                        result = sampleCpuCollector(pCpuCollector);
+                    }
+                    else
+                    {
+                        result = 0;
+                    }
+                    if (result == 0) { result = getCpuUtilInfo(pCpuCollector, 0, &cpuInfo); }
+                    pthread_mutex_unlock(&cpuLock);
+
+                    /* Collect periodic sample into history, push it to due subscribers */
+                    if (result == 0)
+                    {
+                        recordSample(&cpuInfo);
+                        pushSubscriptions(sock, pDstAddr, pTxBatch);
+                    }
+                    break;
+                }
+            }
+        }
+
+        /* Transmit replies of subscription requests served inline */
+        if (pTxBatch->nMessages > 0) { flushMessages(sock, pDstAddr, pTxBatch); }
     }
 
-    return retVal;
+    /* Ring teardown cancels in-flight requests before their buffers are released */
+    destroyUring(pRing);
+
+    free(pFixedBuf);
+    free(pRecvBuffers);
+
+    return 0;
+}
+
+static int serveRequests(void *pWorkerCtx, const void *pRequests, uint32_t nRequests)
+{
+    uint32_t idx;
+
+    RW_RequestWorker_t      *pWorker  = (RW_RequestWorker_t *)pWorkerCtx;
+    const ComChan_Message_t *pMessage = (const ComChan_Message_t *)pRequests;
+
+    /* Serve queued requests, replies go out in one batch on worker socket */
+    for (idx = 0; idx < nRequests; idx++)
+    {
+        processRequestMsg(pWorker->sock, &pWorker->dstAddr, pWorker->pTxBatch, &pMessage[idx]);
+    }
+
+    if (pWorker->pRing != NULL)
+    {
+        return flushUringMessages(pWorker->pRing, pWorker->sock, &pWorker->dstAddr, pWorker->pTxBatch);
+    }
+
+    return flushMessages(pWorker->sock, &pWorker->dstAddr, pWorker->pTxBatch);
 }
 
 
 //*************************************
 // Module Main Function
 //*************************************
-int main(__attribute__((unused)) int argc, __attribute__((unused)) char **args)
+int main(int argc, char **args)
 {
     unsigned char RW_SERVICE_RUNNING = 0x01;
 
     struct nlmsghdr *pNLMsgHdr;
+    ComChan_MsgBatch_t *pRxBatch, *pTxBatch;
 
-    int epollFD, sock, nEvents;
+    int epollFD, sock, timerFD, nEvents;
+    long nWorkers;
     struct sockaddr_nl srcAddr, dstAddr;
     struct epoll_event epollEvents[MAX_EPOLL_EVENTS];
+    struct sigaction stopAction;
 
     ComChan_Message_t resWatcherMsg;
 
+    /* Errors and warnings are written by log thread */
+    if (startComChanLog(STDOUT_FILENO) < 0) { return EXIT_FAILURE; }
+
+    /* Select event loop backend */
+    if (parseArguments(argc, args) < 0) { return EXIT_FAILURE; }
+
     /* Initialize netlink socket */
-    sock = createNLSocket(&srcAddr, &dstAddr);
+    sock = createNLSocket(&srcAddr, &dstAddr, COM_NETLINK_SOURCE);
     if (sock <= 0) { return EXIT_FAILURE; }
 
     /* Create netlink message header */
@@ -485,20 +1225,154 @@ int main(__attribute__((unused)) int argc, __attribute__((unused)) char **args)
         return EXIT_FAILURE;
     }
 
+    /* Create receive and transmit message batches */
+    pRxBatch = createMsgBatch(COM_NETLINK_MAX_PAYLOAD);
+    pTxBatch = createMsgBatch(COM_NETLINK_MAX_PAYLOAD);
+    if ( (pRxBatch == NULL) ||
+         (pTxBatch == NULL) )
+    {
+        if (pRxBatch != NULL) { destroyMsgBatch(pRxBatch); }
+        if (pTxBatch != NULL) { destroyMsgBatch(pTxBatch); }
+        destroyNLMsgHdr(pNLMsgHdr);
+        destroyNLSocket(sock);
+        return EXIT_FAILURE;
+    }
+
+    /* Create CPU utilisation collector */
+    pCpuCollector = createCpuCollector();
+    if (pCpuCollector == NULL)
+    {
+        destroyMsgBatch(pTxBatch);
+        destroyMsgBatch(pRxBatch);
+        destroyNLMsgHdr(pNLMsgHdr);
+        destroyNLSocket(sock);
+        return EXIT_FAILURE;
+    }
+
+    /* Create metric history */
+    pHistory = createHistory();
+    if (pHistory == NULL)
+    {
+        destroyCpuCollector(pCpuCollector);
+        destroyMsgBatch(pTxBatch);
+        destroyMsgBatch(pRxBatch);
+        destroyNLMsgHdr(pNLMsgHdr);
+        destroyNLSocket(sock);
+        return EXIT_FAILURE;
+    }
+
+    /* Create metric quantile sketches */
+    pSketchStore = createSketchStore();
+    if (pSketchStore == NULL)
+    {
+        destroyHistory(pHistory);
+        destroyCpuCollector(pCpuCollector);
+        destroyMsgBatch(pTxBatch);
+        destroyMsgBatch(pRxBatch);
+        destroyNLMsgHdr(pNLMsgHdr);
+        destroyNLSocket(sock);
+        return EXIT_FAILURE;
+    }
+
+    /* Create periodic push subscriptions */
+    pSubscriptionTable = createSubscriptionTable(RW_SUBSCRIPTIONS_MAX);
+    if (pSubscriptionTable == NULL)
+    {
+        destroySketchStore(pSketchStore);
+        destroyHistory(pHistory);
+        destroyCpuCollector(pCpuCollector);
+        destroyMsgBatch(pTxBatch);
+        destroyMsgBatch(pRxBatch);
+        destroyNLMsgHdr(pNLMsgHdr);
+        destroyNLSocket(sock);
+        return EXIT_FAILURE;
+    }
+
+    /* Open time-series store and restore history from stored samples */
+    pTsdb = createTsdb(RW_TSDB_DIR);
+    if (pTsdb != NULL)
+    {
+        int64_t now = (int64_t)time(NULL);
+
+        scanTsdb(pTsdb, (now - RW_HISTORY_WARM_PERIOD), now, restoreSample, NULL);
+    }
+    else
+    {
+        LOG_WARNING("Samples are not persisted, history starts empty");
+    }
+
+    /* Create periodic history sampling timer */
+    timerFD = createSampleTimer(RW_HISTORY_SAMPLE_PERIOD);
+    if (timerFD < 0)
+    {
+        if (pTsdb != NULL) { destroyTsdb(pTsdb); }
+        destroySubscriptionTable(pSubscriptionTable);
+        destroySketchStore(pSketchStore);
+        destroyHistory(pHistory);
+        destroyCpuCollector(pCpuCollector);
+        destroyMsgBatch(pTxBatch);
+        destroyMsgBatch(pRxBatch);
+        destroyNLMsgHdr(pNLMsgHdr);
+        destroyNLSocket(sock);
+        return EXIT_FAILURE;
+    }
+
+    /* Create request workers, one per online CPU */
+    nWorkers = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nWorkers < 1) { nWorkers = 1; }
+
+    /* Workers serve a queue per priority class by weighted round robin */
+    pWorkerPool = createWorkerPool((uint32_t)nWorkers, sizeof(ComChan_Message_t),
+                                   COM_CHAN_PRIO_MAX, classWeights,
+                                   createRequestWorker, serveRequests, destroyRequestWorker);
+    if (pWorkerPool == NULL)
+    {
+        close(timerFD);
+        if (pTsdb != NULL) { destroyTsdb(pTsdb); }
+        destroySubscriptionTable(pSubscriptionTable);
+        destroySketchStore(pSketchStore);
+        destroyHistory(pHistory);
+        destroyCpuCollector(pCpuCollector);
+        destroyMsgBatch(pTxBatch);
+        destroyMsgBatch(pRxBatch);
+        destroyNLMsgHdr(pNLMsgHdr);
+        destroyNLSocket(sock);
+        return EXIT_FAILURE;
+    }
+
     /* Create event polling setup */
     epollFD = epoll_create1(0);
     if (epollFD < 0)
     {
-        printf("ERROR - %s:%d :: Failed to create epoll [%m]\n", __func__, __LINE__);
-
+        LOG_ERROR("Failed to create epoll [%m]");
+
+        destroyWorkerPool(pWorkerPool);
+        close(timerFD);
+        if (pTsdb != NULL) { destroyTsdb(pTsdb); }
+        destroySubscriptionTable(pSubscriptionTable);
+        destroySketchStore(pSketchStore);
+        destroyHistory(pHistory);
+        destroyCpuCollector(pCpuCollector);
+        destroyMsgBatch(pTxBatch);
+        destroyMsgBatch(pRxBatch);
         destroyNLMsgHdr(pNLMsgHdr);
         destroyNLSocket(sock);
         return EXIT_FAILURE;
     }
 
-    /* Register netlink socket for events polling */
-    if (registerEvent(epollFD, sock) < 0)
+    /* Register netlink socket and sampling timer for events polling */
+    if ( (registerEvent(epollFD, sock) < 0) ||
+         (registerEvent(epollFD, timerFD) < 0) )
     {
+        destroyWorkerPool(pWorkerPool);
+        close(timerFD);
+        if (pTsdb != NULL) { destroyTsdb(pTsdb); }
+        destroySubscriptionTable(pSubscriptionTable);
+        destroySketchStore(pSketchStore);
+        destroyHistory(pHistory);
+        destroyCpuCollector(pCpuCollector);
+        destroyMsgBatch(pTxBatch);
+        destroyMsgBatch(pRxBatch);
         destroyNLMsgHdr(pNLMsgHdr);
         destroyNLSocket(sock);
         close(epollFD);
@@ -517,6 +1391,15 @@ int main(__attribute__((unused)) int argc, __attribute__((unused)) char **args)
     /* Send service information message */
     if (sendMessage(sock, &dstAddr, pNLMsgHdr, &resWatcherMsg) <= 0)
     {
+        destroyWorkerPool(pWorkerPool);
+        close(timerFD);
+        if (pTsdb != NULL) { destroyTsdb(pTsdb); }
+        destroySubscriptionTable(pSubscriptionTable);
+        destroySketchStore(pSketchStore);
+        destroyHistory(pHistory);
+        destroyCpuCollector(pCpuCollector);
+        destroyMsgBatch(pTxBatch);
+        destroyMsgBatch(pRxBatch);
         destroyNLMsgHdr(pNLMsgHdr);
         destroyNLSocket(sock);
         close(epollFD);
@@ -524,8 +1407,79 @@ int main(__attribute__((unused)) int argc, __attribute__((unused)) char **args)
     }
 
 
-    /* Resource watcher business logic */
-    while (RW_SERVICE_RUNNING)
+    /* Serve metrics exposition, optional if port is unavailable */
+    if (metricsPort > 0)
+    {
+        pMetricsServer = createMetricsServer(metricsPort, (uint32_t)getCpuCount(pCpuCollector));
+        if (pMetricsServer == NULL)
+        {
+            LOG_WARNING("Metrics are not exposed on port %u",
+                        metricsPort);
+        }
+    }
+
+    /* Capture requests into trace, optional if trace can't be created */
+    if (pCapturePath != NULL)
+    {
+        pCapture = openCaptureWriter(pCapturePath);
+        if (pCapture == NULL)
+        {
+            LOG_WARNING("Requests are not captured to '%s'",
+                        pCapturePath);
+        }
+    }
+
+    /* Collect per NUMA node memory, optional if node files are unavailable */
+    pNumaCollector = createNumaCollector();
+    if (pNumaCollector == NULL)
+    {
+        LOG_WARNING("NUMA node memory is not collected");
+    }
+
+    /* Collect memory fragmentation, optional if free block counts are unavailable */
+    pFragCollector = createFragCollector();
+    if (pFragCollector == NULL)
+    {
+        LOG_WARNING("Memory fragmentation is not collected");
+    }
+
+    /* Scan directory usage of configured trees and track their changes, optional if scanner can't start */
+    if (duConfig.nRoots > 0)
+    {
+        pDuScanner = createDuScanner(&duConfig);
+        if (pDuScanner == NULL)
+        {
+            LOG_WARNING("Directory usage is not scanned");
+        }
+    }
+
+    /* Leave event loop on stop signal, so pending samples are persisted and components shut down */
+    memset(&stopAction, 0x00, sizeof(stopAction));
+    stopAction.sa_handler = handleStopSignal;
+    sigemptyset(&stopAction.sa_mask);
+
+    if ( (sigaction(SIGTERM, &stopAction, NULL) < 0) ||
+         (sigaction(SIGINT,  &stopAction, NULL) < 0) )
+    {
+        LOG_WARNING("Failed to install stop signal handler [%m]");
+    }
+
+    /* Resource watcher business logic on io_uring backend, epoll if ring is unavailable */
+    if (rwBackend == RW_BACKEND_URING)
+    {
+        if (runUringLoop(sock, &dstAddr, pTxBatch, timerFD) == 0)
+        {
+            RW_SERVICE_RUNNING = 0;
+        }
+        else
+        {
+            LOG_WARNING("io_uring backend unavailable, running on epoll");
+        }
+    }
+
+    /* Resource watcher business logic, epoll wait is interrupted by stop signal */
+    while ( RW_SERVICE_RUNNING &&
+            (stopSignal == 0) )
     {
         nEvents = epoll_wait(epollFD, epollEvents, MAX_EPOLL_EVENTS, (EPOLL_EVENTS_TIMEOUT * 1000));
 
@@ -537,7 +1491,7 @@ int main(__attribute__((unused)) int argc, __attribute__((unused)) char **args)
                 if (epollEvents[(nEvents - 1)].events & EPOLLIN)
                 {
                     /* Read message on netlink socket */
-                    if (handleRequestMsg(sock, &dstAddr, pNLMsgHdr) < 0)
+                    if (handleRequestMsg(sock, &dstAddr, pRxBatch, pTxBatch) < 0)
                     {
                         RW_SERVICE_RUNNING = 0;
                         break;
@@ -550,11 +1504,62 @@ int main(__attribute__((unused)) int argc, __attribute__((unused)) char **args)
                     break;
                 }
             }
+            else if (epollEvents[(nEvents - 1)].data.fd == timerFD)
+            {
+                /* Collect periodic sample into history, push it to due subscribers */
+                handleSampleTimer(sock, &dstAddr, pTxBatch, timerFD);
+            }
 
             nEvents--;
         }
     }
 
+    if (stopSignal != 0) { LOG_INFO("Stopping on signal %d", (int)stopSignal); }
+
+    /* Drain queued requests and stop request workers */
+    destroyWorkerPool(pWorkerPool);
+
+    /* Stop metrics exposition */
+    if (pMetricsServer != NULL) { destroyMetricsServer(pMetricsServer); }
+
+    /* Flush and close request capture */
+    if (pCapture != NULL)
+    {
+        LOG_INFO("Captured %lu requests to '%s'",
+                 getCaptureRecordCount(pCapture), pCapturePath);
+        closeCaptureWriter(pCapture);
+    }
+
+    /* Destroy NUMA nodes collector */
+    if (pNumaCollector != NULL) { destroyNumaCollector(pNumaCollector); }
+
+    /* Destroy memory fragmentation collector */
+    if (pFragCollector != NULL) { destroyFragCollector(pFragCollector); }
+
+    /* Stop directory usage scans, running scan is abandoned */
+    if (pDuScanner != NULL) { destroyDuScanner(pDuScanner); }
+
+    /* Close sampling timer */
+    close(timerFD);
+
+    /* Flush and close time-series store */
+    if (pTsdb != NULL) { destroyTsdb(pTsdb); }
+
+    /* Destroy push subscriptions */
+    destroySubscriptionTable(pSubscriptionTable);
+
+    /* Destroy metric quantile sketches */
+    destroySketchStore(pSketchStore);
+
+    /* Destroy metric history */
+    destroyHistory(pHistory);
+
+    /* Destroy CPU utilisation collector */
+    destroyCpuCollector(pCpuCollector);
+
+    /* Destroy message batches */
+    destroyMsgBatch(pTxBatch);
+    destroyMsgBatch(pRxBatch);
 
     /* Destroy netlink message header */
     destroyNLMsgHdr(pNLMsgHdr);
@@ -0,0 +1,437 @@
+/**
+ * @file    rw_cpu_info.c
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Per-core CPU utilisation collector (/proc/stat) for
+ * resource watcher. Counters are kept in structure-of-arrays
+ * layout so utilisation deltas for all cores are computed in
+ * straight, branch-free loops.
+ */
+
+
+// Library Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+
+// Module Includes
+#include "rw_cpu_info.h"
+#include "com_chan_log.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define RW_CPU_STAT_PATH        "/proc/stat"
+#define RW_CPU_STAT_LINE_SZ     256         // Bytes reserved per "cpuN" line
+
+#define RW_CPU_BANKS            2           // Previous and current counters
+
+// Slot 0 holds the host aggregate ("cpu" line), slot (N + 1) holds core N
+#define RW_CPU_AGGREGATE_SLOT   0
+#define RW_CPU_CORE_SLOT(N)     ((N) + 1)
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+typedef struct RW_CpuCounters_s
+{
+    uint64_t               *pUser;              ///< user + nice jiffies
+    uint64_t               *pSystem;            ///< system + irq + softirq jiffies
+    uint64_t               *pIowait;            ///< iowait jiffies
+    uint64_t               *pSteal;             ///< steal jiffies
+    uint64_t               *pTotal;             ///< Sum of all jiffies
+} RW_CpuCounters_t;
+
+struct RW_CpuCollector_s
+{
+    int                     statFD;             ///< Persistent /proc/stat descriptor
+
+    char                   *pStatBuf;           ///< /proc/stat read buffer
+    size_t                  statBufSz;          ///< /proc/stat read buffer size
+
+    uint32_t                nCPUs;              ///< Number of configured CPUs
+    uint32_t                nSlots;             ///< Aggregate slot + per-core slots
+
+    uint32_t                curBank;            ///< Index of current counters bank
+    RW_CpuCounters_t        banks[RW_CPU_BANKS];///< Previous/current counters
+
+    uint16_t               *pUtilUser;          ///< Per-slot user utilisation
+    uint16_t               *pUtilSystem;        ///< Per-slot system utilisation
+    uint16_t               *pUtilIowait;        ///< Per-slot iowait utilisation
+    uint16_t               *pUtilSteal;         ///< Per-slot steal utilisation
+
+    void                   *pArena;             ///< Single allocation for all arrays
+};
+
+
+//*************************************
+// Module Utility Functions
+//*************************************
+static inline const char* _ParseU64(const char *pCur, uint64_t *pValue);
+
+static int  readStatFile(RW_CpuCollector_t *pCollector);
+static int  parseStatFile(RW_CpuCollector_t *pCollector, RW_CpuCounters_t *pCounters);
+static void computeUtilisation(RW_CpuCollector_t *pCollector);
+
+
+static inline const char* _ParseU64(const char *pCur, uint64_t *pValue)
+{
+    uint64_t value = 0;
+
+    while (*pCur == ' ') { pCur++; }
+
+    while ( (*pCur >= '0') && (*pCur <= '9') )
+    {
+        value = (value * 10) + (uint64_t)(*pCur - '0');
+        pCur++;
+    }
+
+    *pValue = value;
+    return pCur;
+}
+
+static int readStatFile(RW_CpuCollector_t *pCollector)
+{
+    ssize_t nBytes;
+
+    while (1)
+    {
+        /* Read whole file from offset 0, descriptor remains open */
+        nBytes = pread(pCollector->statFD, pCollector->pStatBuf, (pCollector->statBufSz - 1), 0);
+        if (nBytes < 0)
+        {
+            LOG_ERROR("Failed to read %s [%m]",
+                      RW_CPU_STAT_PATH);
+            return -1;
+        }
+
+        if ((size_t)nBytes < (pCollector->statBufSz - 1)) { break; }
+
+        /* Buffer was filled, grow and re-read; happens once at most per growth */
+        char *pBuf = (char *)realloc(pCollector->pStatBuf, (pCollector->statBufSz * 2));
+        if (pBuf == NULL)
+        {
+            LOG_ERROR("Failed to grow /proc/stat buffer");
+            return -1;
+        }
+
+        pCollector->pStatBuf   = pBuf;
+        pCollector->statBufSz *= 2;
+    }
+
+    pCollector->pStatBuf[nBytes] = '\0';
+
+    return 0;
+}
+
+static int parseStatFile(RW_CpuCollector_t *pCollector, RW_CpuCounters_t *pCounters)
+{
+    const char *pCur = pCollector->pStatBuf;
+
+    /* Offline cores are not listed; their counters stay zero */
+    memset(pCounters->pTotal, 0x00, (pCollector->nSlots * sizeof(uint64_t)));
+
+    /* "cpu" lines are at the top of /proc/stat */
+    while ( (pCur[0] == 'c') && (pCur[1] == 'p') && (pCur[2] == 'u') )
+    {
+        uint32_t slot;
+        uint64_t user, nice, system, idle, iowait, irq, softirq, steal;
+
+        pCur += 3;
+
+        if (*pCur == ' ')
+        {
+            slot = RW_CPU_AGGREGATE_SLOT;
+        }
+        else
+        {
+            uint64_t core;
+
+            pCur = _ParseU64(pCur, &core);
+            slot = (core < pCollector->nCPUs) ? RW_CPU_CORE_SLOT(core) : pCollector->nSlots;
+        }
+
+        pCur = _ParseU64(pCur, &user);
+        pCur = _ParseU64(pCur, &nice);
+        pCur = _ParseU64(pCur, &system);
+        pCur = _ParseU64(pCur, &idle);
+        pCur = _ParseU64(pCur, &iowait);
+        pCur = _ParseU64(pCur, &irq);
+        pCur = _ParseU64(pCur, &softirq);
+        pCur = _ParseU64(pCur, &steal);
+
+        /* guest/guest_nice are already accounted in user/nice */
+        if (slot < pCollector->nSlots)
+        {
+            pCounters->pUser[slot]   = user + nice;
+            pCounters->pSystem[slot] = system + irq + softirq;
+            pCounters->pIowait[slot] = iowait;
+            pCounters->pSteal[slot]  = steal;
+            pCounters->pTotal[slot]  = user + nice + system + idle + iowait + irq + softirq + steal;
+        }
+
+        /* Move to next line */
+        pCur = strchr(pCur, '\n');
+        if (pCur == NULL) { break; }
+        pCur++;
+    }
+
+    return 0;
+}
+
+static void computeUtilisation(RW_CpuCollector_t *pCollector)
+{
+    uint32_t idx;
+    const uint32_t nSlots = pCollector->nSlots;
+
+    const RW_CpuCounters_t *pCur  = &pCollector->banks[pCollector->curBank];
+    const RW_CpuCounters_t *pPrev = &pCollector->banks[(pCollector->curBank ^ 1)];
+
+    const uint64_t * restrict pCurUser    = pCur->pUser;
+    const uint64_t * restrict pCurSystem  = pCur->pSystem;
+    const uint64_t * restrict pCurIowait  = pCur->pIowait;
+    const uint64_t * restrict pCurSteal   = pCur->pSteal;
+    const uint64_t * restrict pCurTotal   = pCur->pTotal;
+
+    const uint64_t * restrict pPrevUser   = pPrev->pUser;
+    const uint64_t * restrict pPrevSystem = pPrev->pSystem;
+    const uint64_t * restrict pPrevIowait = pPrev->pIowait;
+    const uint64_t * restrict pPrevSteal  = pPrev->pSteal;
+    const uint64_t * restrict pPrevTotal  = pPrev->pTotal;
+
+    uint16_t * restrict pUtilUser   = pCollector->pUtilUser;
+    uint16_t * restrict pUtilSystem = pCollector->pUtilSystem;
+    uint16_t * restrict pUtilIowait = pCollector->pUtilIowait;
+    uint16_t * restrict pUtilSteal  = pCollector->pUtilSteal;
+
+    /* Branch-free loop over all slots; counters going backwards (hotplug) yield 0 */
+    for (idx = 0; idx < nSlots; idx++)
+    {
+        float dTotal = (pCurTotal[idx] > pPrevTotal[idx]) ? (float)(pCurTotal[idx] - pPrevTotal[idx]) : 0.0f;
+        float scale  = (dTotal > 0.0f) ? ((float)RW_CPU_UTIL_SCALE / dTotal) : 0.0f;
+
+        float dUser   = (pCurUser[idx]   > pPrevUser[idx])   ? (float)(pCurUser[idx]   - pPrevUser[idx])   : 0.0f;
+        float dSystem = (pCurSystem[idx] > pPrevSystem[idx]) ? (float)(pCurSystem[idx] - pPrevSystem[idx]) : 0.0f;
+        float dIowait = (pCurIowait[idx] > pPrevIowait[idx]) ? (float)(pCurIowait[idx] - pPrevIowait[idx]) : 0.0f;
+        float dSteal  = (pCurSteal[idx]  > pPrevSteal[idx])  ? (float)(pCurSteal[idx]  - pPrevSteal[idx])  : 0.0f;
+
+        pUtilUser[idx]   = (uint16_t)(dUser   * scale);
+        pUtilSystem[idx] = (uint16_t)(dSystem * scale);
+        pUtilIowait[idx] = (uint16_t)(dIowait * scale);
+        pUtilSteal[idx]  = (uint16_t)(dSteal  * scale);
+    }
+}
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+RW_CpuCollector_t* createCpuCollector(void)
+{
+    long nCPUs;
+    size_t bankSz, utilSz, bank;
+    uint8_t *pArena;
+
+    RW_CpuCollector_t *pCollector;
+
+    /* Get number of configured (not only online) CPUs */
+    nCPUs = sysconf(_SC_NPROCESSORS_CONF);
+    if (nCPUs < 1)
+    {
+        LOG_ERROR("Failed to get number of CPUs [%m]");
+        return NULL;
+    }
+
+    pCollector = (RW_CpuCollector_t *)calloc(1, sizeof(RW_CpuCollector_t));
+    if (pCollector == NULL)
+    {
+        LOG_ERROR("Failed to allocate CPU collector");
+        return NULL;
+    }
+
+    pCollector->nCPUs  = (uint32_t)nCPUs;
+    pCollector->nSlots = (uint32_t)nCPUs + 1;
+
+    /* Allocate all counter and utilisation arrays in one block */
+    bankSz = pCollector->nSlots * sizeof(uint64_t);
+    utilSz = pCollector->nSlots * sizeof(uint16_t);
+
+    pArena = (uint8_t *)calloc(1, (RW_CPU_BANKS * 5 * bankSz) + (4 * utilSz));
+    if (pArena == NULL)
+    {
+        LOG_ERROR("Failed to allocate CPU counters");
+        free(pCollector);
+        return NULL;
+    }
+
+    pCollector->pArena = pArena;
+
+    for (bank = 0; bank < RW_CPU_BANKS; bank++)
+    {
+        pCollector->banks[bank].pUser   = (uint64_t *)pArena; pArena += bankSz;
+        pCollector->banks[bank].pSystem = (uint64_t *)pArena; pArena += bankSz;
+        pCollector->banks[bank].pIowait = (uint64_t *)pArena; pArena += bankSz;
+        pCollector->banks[bank].pSteal  = (uint64_t *)pArena; pArena += bankSz;
+        pCollector->banks[bank].pTotal  = (uint64_t *)pArena; pArena += bankSz;
+    }
+
+    pCollector->pUtilUser   = (uint16_t *)pArena; pArena += utilSz;
+    pCollector->pUtilSystem = (uint16_t *)pArena; pArena += utilSz;
+    pCollector->pUtilIowait = (uint16_t *)pArena; pArena += utilSz;
+    pCollector->pUtilSteal  = (uint16_t *)pArena;
+
+    /* Allocate /proc/stat buffer sized for the number of cores */
+    pCollector->statBufSz = 4096 + (pCollector->nSlots * RW_CPU_STAT_LINE_SZ);
+    pCollector->pStatBuf  = (char *)malloc(pCollector->statBufSz);
+    if (pCollector->pStatBuf == NULL)
+    {
+        LOG_ERROR("Failed to allocate /proc/stat buffer");
+        free(pCollector->pArena);
+        free(pCollector);
+        return NULL;
+    }
+
+    /* Keep /proc/stat open, every sample is a single pread */
+    pCollector->statFD = open(RW_CPU_STAT_PATH, O_RDONLY | O_CLOEXEC);
+    if (pCollector->statFD < 0)
+    {
+        LOG_ERROR("Failed to open %s [%m]",
+                  RW_CPU_STAT_PATH);
+        free(pCollector->pStatBuf);
+        free(pCollector->pArena);
+        free(pCollector);
+        return NULL;
+    }
+
+    /* Take baseline sample, first timer sample reports utilisation since then */
+    sampleCpuCollector(pCollector);
+
+    return pCollector;
+}
+
+int destroyCpuCollector(RW_CpuCollector_t *pCollector)
+{
+    if (pCollector == NULL)
+    {
+        LOG_ERROR("Invalid input CPU collector %p",
+                  pCollector);
+        return -1;
+    }
+
+    if (pCollector->statFD >= 0) { close(pCollector->statFD); }
+
+    free(pCollector->pStatBuf);
+    free(pCollector->pArena);
+    free(pCollector);
+
+    return 0;
+}
+
+int sampleCpuCollector(RW_CpuCollector_t *pCollector)
+{
+    if (pCollector == NULL)
+    {
+        LOG_ERROR("Invalid input CPU collector %p",
+                  pCollector);
+        return -1;
+    }
+
+    if (readStatFile(pCollector) < 0) { return -1; }
+
+    /* Current bank becomes previous, parse into the other bank */
+    pCollector->curBank ^= 1;
+
+    parseStatFile(pCollector, &pCollector->banks[pCollector->curBank]);
+
+    computeUtilisation(pCollector);
+
+    return 0;
+}
+
+int loadCpuCollector(RW_CpuCollector_t *pCollector,
+                     const char        *pStatBuf,
+                     size_t             nBytes)
+{
+    if ( (pCollector == NULL) ||
+         (pStatBuf   == NULL) )
+    {
+        LOG_ERROR("Invalid input arguments (%p, %p)",
+                  pCollector, pStatBuf);
+        return -1;
+    }
+
+    /* Contents read elsewhere (e.g. asynchronously), must fit read buffer */
+    if (nBytes >= pCollector->statBufSz) { return -1; }
+
+    memcpy(pCollector->pStatBuf, pStatBuf, nBytes);
+    pCollector->pStatBuf[nBytes] = '\0';
+
+    /* Current bank becomes previous, parse into the other bank */
+    pCollector->curBank ^= 1;
+
+    parseStatFile(pCollector, &pCollector->banks[pCollector->curBank]);
+
+    computeUtilisation(pCollector);
+
+    return 0;
+}
+
+int getCpuCount(const RW_CpuCollector_t *pCollector)
+{
+    return (pCollector != NULL) ? (int)pCollector->nCPUs : -1;
+}
+
+int getCpuStatFD(const RW_CpuCollector_t *pCollector)
+{
+    return (pCollector != NULL) ? pCollector->statFD : -1;
+}
+
+int getCpuUtilInfo(const RW_CpuCollector_t *pCollector,
+                   uint16_t                 firstCPU,
+                   RW_CpuInfo_t            *pCpuInfo)
+{
+    uint32_t idx, slot;
+
+    if ( (pCollector == NULL) ||
+         (pCpuInfo   == NULL) )
+    {
+        LOG_ERROR("Invalid input arguments (%p, %p)",
+                  pCollector, pCpuInfo);
+        return -1;
+    }
+
+    memset(pCpuInfo, 0x00, sizeof(RW_CpuInfo_t));
+
+    pCpuInfo->nCPUs    = (uint16_t)pCollector->nCPUs;
+    pCpuInfo->firstCPU = firstCPU;
+
+    /* Populate host aggregate */
+    pCpuInfo->aggregate.user   = pCollector->pUtilUser[RW_CPU_AGGREGATE_SLOT];
+    pCpuInfo->aggregate.system = pCollector->pUtilSystem[RW_CPU_AGGREGATE_SLOT];
+    pCpuInfo->aggregate.iowait = pCollector->pUtilIowait[RW_CPU_AGGREGATE_SLOT];
+    pCpuInfo->aggregate.steal  = pCollector->pUtilSteal[RW_CPU_AGGREGATE_SLOT];
+
+    /* Populate requested window of cores */
+    for (idx = 0; idx < RW_CPU_INFO_MAX_CORES; idx++)
+    {
+        if ((uint32_t)(firstCPU + idx) >= pCollector->nCPUs) { break; }
+
+        slot = RW_CPU_CORE_SLOT(firstCPU + idx);
+
+        pCpuInfo->cores[idx].user   = pCollector->pUtilUser[slot];
+        pCpuInfo->cores[idx].system = pCollector->pUtilSystem[slot];
+        pCpuInfo->cores[idx].iowait = pCollector->pUtilIowait[slot];
+        pCpuInfo->cores[idx].steal  = pCollector->pUtilSteal[slot];
+    }
+
+    pCpuInfo->nEntries = (uint16_t)idx;
+
+    return 0;
+}
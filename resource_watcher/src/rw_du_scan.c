@@ -0,0 +1,2133 @@
+/**
+ * @file    rw_du_scan.c
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Directory usage scanner for resource watcher. A scan thread
+ * scans configured trees one after another; every tree is walked by a
+ * pool of threads with a directory deque each, owners take newest
+ * directories (depth first) and idle threads steal oldest ones (large
+ * subtrees near root). Directories are listed with getdents64 and
+ * entries examined with statx relative to directory descriptor; files
+ * with several links are counted once. Completed scans are kept as a
+ * directory index ranked on query. Where filesystem of a tree can be
+ * marked with fanotify, index is kept current from directory entry
+ * events instead of rescans: changed directories are relisted once per
+ * tick and their byte change is added to ancestors and to per-minute
+ * growth of those, ranked for growth queries.
+ */
+
+
+// Library Includes
+#define _GNU_SOURCE                         // statx()
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <limits.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+#include <sys/syscall.h>
+
+#include <linux/fanotify.h>
+
+// Module Includes
+#include "rw_du_scan.h"
+#include "com_chan_log.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define RW_DU_NSEC_PER_SEC      1000000000LL
+#define RW_DU_NSEC_PER_MSEC     1000000LL
+#define RW_DU_SEC_PER_MIN       60
+
+#define RW_DU_CHUNK_SHIFT       16
+#define RW_DU_CHUNK_DIRS        (1U << RW_DU_CHUNK_SHIFT) // Directories per index chunk
+#define RW_DU_MAX_CHUNKS        256         // Index chunks, 16M directories per tree
+#define RW_DU_MAX_DIRS          (RW_DU_CHUNK_DIRS * RW_DU_MAX_CHUNKS)
+
+#define RW_DU_DEQUE_SZ          1024        // Initial directory deque slots, doubled when full
+#define RW_DU_DIRENT_BUF_SZ     32768       // getdents64 buffer per thread
+#define RW_DU_ARENA_SZ          (1 << 20)   // Directory name block size
+#define RW_DU_LINK_SHARDS       64          // Hardlink set shards
+#define RW_DU_LINK_SLOTS        1024        // Initial hardlink shard slots, doubled at half load
+#define RW_DU_BLOCK_SZ          512         // statx block unit
+#define RW_DU_MAX_LEVELS        (PATH_MAX / 2) // Ancestors walked, bounds walk of a corrupt parent chain
+#define RW_DU_NO_DIR            UINT32_MAX  // Directory not found in index
+
+#define RW_DU_HANDLE_SLOTS      1024        // Initial directory handle map slots, doubled at half load
+#define RW_DU_DIRTY_SZ          256         // Initial changed directory slots, doubled when full
+#define RW_DU_GROWTH_SLOT_BITS  14
+#define RW_DU_GROWTH_SLOTS      (1U << RW_DU_GROWTH_SLOT_BITS) // Growth map slots
+#define RW_DU_GROWTH_MAX_DIRS   (RW_DU_GROWTH_SLOTS / 2) // Directories with growth tracked per tree, map kept at half load
+#define RW_DU_EVENT_BUF_SZ      65536       // fanotify read buffer
+#define RW_DU_TICK_SEC          1           // Interval of event reads and changed directory updates
+#define RW_DU_RANK_SEC          10          // Shortest interval between size rankings of a tree changed by events
+
+#define RW_DU_IDLE_NS           50000       // Pause of thread finding no directory to steal
+#define RW_DU_MAX_PAUSE_NS      (RW_DU_NSEC_PER_SEC / 4) // Longest budget pause, stop is checked in between
+
+#define RW_DU_IOPRIO_WHO_PROCESS 1          // ioprio_set() target is a thread
+#define RW_DU_IOPRIO_IDLE       (3 << 13)   // Idle I/O scheduling class
+
+#define RW_DU_STATX_MASK        (STATX_TYPE | STATX_NLINK | STATX_INO | STATX_BLOCKS)
+#define RW_DU_STATX_FLAGS       (AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT | AT_STATX_DONT_SYNC)
+
+#define RW_DU_DIR_DIRTY         0x0001      // Directory queued for update
+#define RW_DU_DIR_REMOVED       0x0002      // Directory deleted or moved out of tree
+#define RW_DU_DIR_MOVED         0x0004      // Directory moved within tree, its pending move event is consumed
+#define RW_DU_DIR_NEW           0x0008      // Directory added from events, its subdirectories are indexed at its update
+
+#define RW_DU_FAN_INIT_FLAGS    (FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK | FAN_REPORT_DFID_NAME)
+#define RW_DU_FAN_MARK_FLAGS    (FAN_MARK_ADD | FAN_MARK_FILESYSTEM)
+#define RW_DU_FAN_MASK          (FAN_CREATE | FAN_DELETE | FAN_MODIFY | FAN_MOVED_FROM | FAN_MOVED_TO | \
+                                 FAN_DELETE_SELF | FAN_MOVE_SELF | FAN_ONDIR)
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+typedef struct RW_DuDirent64_s
+{
+    uint64_t                d_ino;              ///< Entry inode
+    int64_t                 d_off;              ///< Offset of next entry
+    unsigned short          d_reclen;           ///< Entry record length
+    unsigned char           d_type;             ///< Entry type
+    char                    d_name[];           ///< Entry name
+} RW_DuDirent64_t;
+
+typedef struct RW_DuDir_s
+{
+    uint32_t                parent;             ///< Parent directory index, 0 for root
+    uint16_t                depth;              ///< Levels below root (scan time depth below moved directories)
+    uint16_t                flags;              ///< RW_DU_DIR_* flags
+    const char             *pName;              ///< Name in parent directory (name arena)
+    uint64_t                handleHash;         ///< Hash of directory file handle, 0 if not tracked
+    uint64_t                ownBytes;           ///< Bytes of directory and its non-directory entries
+    uint64_t                linkBytes;          ///< Own bytes of files with several links, kept from scan
+    uint64_t                bytes;              ///< Subtree bytes (own bytes until scan completes)
+    uint64_t                nFiles;             ///< Subtree non-directory entries (own until scan completes)
+    uint32_t                ownFiles;           ///< Own non-directory entries
+    uint32_t                linkFiles;          ///< Own files with several links, kept from scan
+} RW_DuDir_t;
+
+typedef struct RW_DuSizeRank_s
+{
+    uint32_t                nRanked;            ///< Directories ranked at depth
+    uint32_t                dirs[RW_DU_INFO_MAX_ENTRIES]; ///< Largest live subtrees at depth, descending at ranking
+} RW_DuSizeRank_t;
+
+typedef struct RW_DuGrowth_s
+{
+    uint32_t                dirIndex;           ///< Directory grown or shrunk
+    uint32_t                lastMinute;         ///< Monotonic minute of latest change
+    int64_t                 total;              ///< Sum of ring, change over longest window ending at latest change
+    int64_t                 deltas[RW_DU_GROWTH_MINUTES]; ///< Subtree byte change per minute, ring indexed by minute
+} RW_DuGrowth_t;
+
+typedef struct RW_DuArena_s
+{
+    struct RW_DuArena_s    *pNext;              ///< Next name block
+    uint32_t                used;               ///< Bytes used in block
+    char                    names[];            ///< Directory names
+} RW_DuArena_t;
+
+typedef struct RW_DuIndex_s
+{
+    RW_DuDir_t             *pChunks[RW_DU_MAX_CHUNKS]; ///< Directory chunks, parents precede children
+    uint32_t                nDirs;              ///< Directories indexed
+    RW_DuArena_t           *pArenas;            ///< Directory name blocks
+
+    int64_t                 scanTime;           ///< Completion time (seconds since epoch)
+    uint32_t                scanDuration;       ///< Scan duration (milliseconds)
+    uint64_t                nHardlinks;         ///< Hardlinks to already counted files
+    uint64_t                nErrors;            ///< Entries not scanned
+
+    uint32_t               *pHandleSlots;       ///< Directory handle map, open addressing on handle hash, index + 1
+    uint32_t                nHandleSlots;       ///< Handle map slots, power of two
+    uint32_t                nHandles;           ///< Occupied handle map slots
+    uint32_t               *pDirty;             ///< Directories queued for update, oldest first
+    uint32_t                nDirty;             ///< Queued directories
+    uint32_t                dirtySlots;         ///< Queue slots
+    uint64_t                nUpdates;           ///< Directories updated since scan
+
+    RW_DuGrowth_t          *pGrowth;            ///< Directories changed within longest window, dense
+    uint32_t               *pGrowthSlots;       ///< Growth map, open addressing on directory index, growth index + 1
+    uint32_t                nGrowth;            ///< Directories with growth tracked
+    uint32_t                growthMinute;       ///< Minute of last expiry of growth entries
+
+    RW_DuSizeRank_t        *pSizeRanks;         ///< Largest subtrees per depth, NULL until ranked
+    uint32_t                nRankLevels;        ///< Depths ranked, deepest directory depth + 1
+    int                     rankStale;          ///< Set if sizes or tree changed since ranking
+    int64_t                 rankNs;             ///< Monotonic time of latest ranking
+} RW_DuIndex_t;
+
+typedef struct RW_DuLinkShard_s
+{
+    pthread_mutex_t         lock;               ///< Protects shard
+    uint64_t               *pInodes;            ///< Open addressing slots, 0 is free
+    uint32_t                nSlots;             ///< Slots, power of two
+    uint32_t                nInodes;            ///< Occupied slots
+} RW_DuLinkShard_t;
+
+struct RW_DuScan_s;
+
+typedef struct RW_DuWorker_s
+{
+    struct RW_DuScan_s     *pScan;              ///< Owning scan
+    uint32_t                workerID;           ///< Worker index
+    pthread_t               thread;             ///< Worker thread
+    int                     started;            ///< Set if thread was created
+
+    pthread_mutex_t         lock;               ///< Protects deque
+    uint32_t               *pDeque;             ///< Directory indices, ring
+    uint32_t                nSlots;             ///< Deque slots, power of two
+    uint32_t                head;               ///< Oldest directory, stolen first
+    uint32_t                count;              ///< Queued directories
+
+    char                   *pDirents;           ///< getdents64 buffer
+    RW_DuArena_t           *pArena;             ///< Current name block
+    int64_t                 startNs;            ///< Monotonic time of scan start
+    int64_t                 startCpuNs;         ///< Thread CPU time of scan start
+    uint64_t                nInodes;            ///< Inodes examined
+} RW_DuWorker_t;
+
+typedef struct RW_DuScan_s
+{
+    RW_DuScanner_t         *pScanner;           ///< Owning scanner
+    RW_DuIndex_t           *pIndex;             ///< Index under construction
+    const char             *pRootPath;          ///< Tree scanned
+    uint32_t                devMajor;           ///< Filesystem of tree, mounts below are skipped
+    uint32_t                devMinor;           ///< Filesystem of tree, mounts below are skipped
+    int                     tracked;            ///< Set if directory handles are recorded for event updates
+
+    pthread_mutex_t         chunkLock;          ///< Serializes index chunk allocation
+    uint32_t                nPending;           ///< Directories queued or being listed
+    int                     failed;             ///< Set if index chunk allocation failed, scan is abandoned
+    uint64_t                nHardlinks;         ///< Hardlinks to already counted files
+    uint64_t                nErrors;            ///< Entries not scanned
+
+    RW_DuLinkShard_t        links[RW_DU_LINK_SHARDS]; ///< Inodes of files with several links
+    RW_DuWorker_t           workers[RW_DU_MAX_THREADS]; ///< Scan threads
+} RW_DuScan_t;
+
+typedef struct RW_DuRoot_s
+{
+    int                     watched;            ///< Set if filesystem of tree is marked for events
+    int                     rescan;             ///< Set if events were lost, tree is rescanned a period after last scan
+    int                     fsid[2];            ///< Filesystem identifier reported with events
+    uint32_t                devMajor;           ///< Filesystem of tree, mounts below are not indexed from events
+    uint32_t                devMinor;           ///< Filesystem of tree, mounts below are not indexed from events
+    int64_t                 scanNs;             ///< Monotonic time of last scan attempt, 0 before first
+} RW_DuRoot_t;
+
+struct RW_DuScanner_s
+{
+    RW_DuScanConfig_t       config;             ///< Scanner configuration
+    pthread_t               thread;             ///< Scan scheduling thread
+
+    pthread_mutex_t         lock;               ///< Protects published indices, root state and stop
+    pthread_cond_t          stopCond;           ///< Signalled on stop
+    int                     stop;               ///< Set on scanner destruction
+
+    int                     fanFD;              ///< fanotify group of marked filesystems, -1 if none
+    char                   *pEvents;            ///< fanotify read buffer
+    char                   *pDirents;           ///< getdents64 buffer of directory updates
+
+    RW_DuRoot_t             roots[RW_DU_MAX_ROOTS]; ///< Event tracking and scan state per tree
+    RW_DuIndex_t           *pIndices[RW_DU_MAX_ROOTS]; ///< Last completed scan per tree, updated from events
+};
+
+
+//*************************************
+// Module Utility Functions
+//*************************************
+static void addGrowth(RW_DuIndex_t *pIndex, uint32_t dirIndex, int64_t delta, uint32_t minute);
+static void adjustAncestors(RW_DuIndex_t *pIndex, uint32_t dirIndex, int64_t deltaBytes, int64_t deltaFiles, uint32_t minute);
+static RW_DuDir_t* allocDir(RW_DuScan_t *pScan, uint32_t *pIndex);
+static const char* allocName(RW_DuArena_t **ppArena, const char *pName, size_t length);
+static RW_DuDir_t* appendDir(RW_DuIndex_t *pIndex, uint32_t *pDirIndex);
+static int attachDir(RW_DuScanner_t *pScanner, uint32_t root, uint32_t parent, const char *pName, int moved, uint32_t minute);
+static const char* buildDirPath(const RW_DuIndex_t *pIndex, const char *pRootPath, uint32_t dirIndex, char *pBuf, size_t bufSz);
+static RW_DuScan_t* createScan(RW_DuScanner_t *pScanner, uint32_t root);
+static void destroyIndex(RW_DuIndex_t *pIndex);
+static void destroyScan(RW_DuScan_t *pScan);
+static void detachDir(RW_DuIndex_t *pIndex, uint32_t dirIndex, uint32_t minute);
+static uint32_t findDir(const RW_DuIndex_t *pIndex, uint64_t handleHash);
+static inline int64_t getClockNs(clockid_t clockID);
+static inline RW_DuDir_t* getDir(const RW_DuIndex_t *pIndex, uint32_t dirIndex);
+static int64_t getGrowth(const RW_DuGrowth_t *pGrowth, uint32_t window, uint32_t minute);
+static uint64_t getHandleHash(int dirFD, const char *pPath, int flags);
+static inline uint32_t getMinute(void);
+static void handleEvent(RW_DuScanner_t *pScanner, uint64_t mask, const int *pFsid, uint64_t handleHash, const char *pName, uint32_t minute);
+static uint64_t hashHandle(const struct file_handle *pHandle);
+static int insertHandle(RW_DuIndex_t *pIndex, uint32_t dirIndex);
+static int insertHardlink(RW_DuScan_t *pScan, uint64_t inode);
+static void insertRanked(uint32_t *pRanked, int64_t *pValues, uint32_t *pnRanked, uint32_t dirIndex, int64_t value);
+static int isDirLive(const RW_DuIndex_t *pIndex, uint32_t dirIndex);
+static void markDirty(RW_DuIndex_t *pIndex, uint32_t dirIndex);
+static void paceWorker(RW_DuWorker_t *pWorker);
+static int popDir(RW_DuWorker_t *pWorker, uint32_t *pDirIndex);
+static int pushDir(RW_DuWorker_t *pWorker, uint32_t dirIndex);
+static int rankSizes(RW_DuScanner_t *pScanner, RW_DuIndex_t *pIndex);
+static void readEvents(RW_DuScanner_t *pScanner, uint32_t minute);
+static int relistDirectory(RW_DuScanner_t *pScanner, uint32_t root, uint32_t dirIndex, const char *pPath,
+                           uint64_t *pBytes, uint32_t *pFiles, uint64_t *pnInodes, uint32_t minute);
+static int scanAborted(RW_DuScan_t *pScan);
+static void scanDirectory(RW_DuWorker_t *pWorker, uint32_t dirIndex);
+static void* scanMain(void *pArg);
+static int scanRoot(RW_DuScanner_t *pScanner, uint32_t root);
+static int scanStopped(RW_DuScanner_t *pScanner);
+static int stealDir(RW_DuWorker_t *pWorker, uint32_t *pDirIndex);
+static void trimGrowth(RW_DuIndex_t *pIndex, uint32_t minute);
+static void updateDirs(RW_DuScanner_t *pScanner, uint32_t root, uint32_t minute, uint64_t *pnInodes);
+static void watchRoots(RW_DuScanner_t *pScanner);
+static void* workerMain(void *pArg);
+
+
+static void addGrowth(RW_DuIndex_t *pIndex, uint32_t dirIndex, int64_t delta, uint32_t minute)
+{
+    uint32_t slot, idx, elapsed;
+
+    RW_DuGrowth_t *pGrowth;
+
+    /* Growth table is allocated on first change after scan */
+    if (pIndex->pGrowth == NULL)
+    {
+        pIndex->pGrowth      = (RW_DuGrowth_t *)malloc(RW_DU_GROWTH_MAX_DIRS * sizeof(RW_DuGrowth_t));
+        pIndex->pGrowthSlots = (uint32_t *)calloc(RW_DU_GROWTH_SLOTS, sizeof(uint32_t));
+        pIndex->growthMinute = minute;
+
+        if ( (pIndex->pGrowth == NULL) ||
+             (pIndex->pGrowthSlots == NULL) )
+        {
+            free(pIndex->pGrowth);
+            free(pIndex->pGrowthSlots);
+            pIndex->pGrowth      = NULL;
+            pIndex->pGrowthSlots = NULL;
+            return;
+        }
+    }
+
+    slot = (uint32_t)(((uint64_t)dirIndex * 0x9E3779B97F4A7C15ULL) >> (64 - RW_DU_GROWTH_SLOT_BITS));
+    while ( (pIndex->pGrowthSlots[slot] != 0) &&
+            (pIndex->pGrowth[pIndex->pGrowthSlots[slot] - 1].dirIndex != dirIndex) )
+    {
+        slot = (slot + 1) & (RW_DU_GROWTH_SLOTS - 1);
+    }
+
+    if (pIndex->pGrowthSlots[slot] == 0)
+    {
+        /* Table stays at half load, further directories are not ranked until entries expire */
+        if (pIndex->nGrowth == RW_DU_GROWTH_MAX_DIRS) { return; }
+
+        pGrowth = &pIndex->pGrowth[pIndex->nGrowth];
+        memset(pGrowth, 0x00, sizeof(RW_DuGrowth_t));
+        pGrowth->dirIndex   = dirIndex;
+        pGrowth->lastMinute = minute;
+
+        pIndex->pGrowthSlots[slot] = ++pIndex->nGrowth;
+    }
+    else
+    {
+        pGrowth = &pIndex->pGrowth[pIndex->pGrowthSlots[slot] - 1];
+    }
+
+    /* Minutes without change are cleared before their ring slots are reused */
+    if (minute != pGrowth->lastMinute)
+    {
+        elapsed = minute - pGrowth->lastMinute;
+        if (elapsed > RW_DU_GROWTH_MINUTES) { elapsed = RW_DU_GROWTH_MINUTES; }
+
+        for (idx = 1; idx <= elapsed; idx++)
+        {
+            pGrowth->total -= pGrowth->deltas[(pGrowth->lastMinute + idx) % RW_DU_GROWTH_MINUTES];
+            pGrowth->deltas[(pGrowth->lastMinute + idx) % RW_DU_GROWTH_MINUTES] = 0;
+        }
+
+        pGrowth->lastMinute = minute;
+    }
+
+    pGrowth->deltas[minute % RW_DU_GROWTH_MINUTES] += delta;
+    pGrowth->total                                 += delta;
+}
+
+static void adjustAncestors(RW_DuIndex_t *pIndex, uint32_t dirIndex, int64_t deltaBytes, int64_t deltaFiles, uint32_t minute)
+{
+    uint32_t level;
+
+    RW_DuDir_t *pDir;
+
+    pIndex->rankStale = 1;
+
+    /* Removed directory takes changes of its subtree, its former ancestors were already reduced */
+    for (level = 0; level < RW_DU_MAX_LEVELS; level++)
+    {
+        pDir = getDir(pIndex, dirIndex);
+
+        pDir->bytes  += (uint64_t)deltaBytes;
+        pDir->nFiles += (uint64_t)deltaFiles;
+
+        if (deltaBytes != 0) { addGrowth(pIndex, dirIndex, deltaBytes, minute); }
+
+        if ( (dirIndex == 0) ||
+             (pDir->flags & RW_DU_DIR_REMOVED) )
+        {
+            break;
+        }
+
+        dirIndex = pDir->parent;
+    }
+}
+
+static RW_DuDir_t* allocDir(RW_DuScan_t *pScan, uint32_t *pIndex)
+{
+    uint32_t dirIndex, chunk;
+
+    RW_DuDir_t *pChunk;
+
+    dirIndex = __atomic_fetch_add(&pScan->pIndex->nDirs, 1, __ATOMIC_RELAXED);
+    if (dirIndex >= RW_DU_MAX_DIRS)
+    {
+        __atomic_fetch_sub(&pScan->pIndex->nDirs, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    /* First directory of a chunk allocates it, others may race to it */
+    chunk  = dirIndex >> RW_DU_CHUNK_SHIFT;
+    pChunk = __atomic_load_n(&pScan->pIndex->pChunks[chunk], __ATOMIC_ACQUIRE);
+    if (pChunk == NULL)
+    {
+        pthread_mutex_lock(&pScan->chunkLock);
+
+        pChunk = pScan->pIndex->pChunks[chunk];
+        if (pChunk == NULL)
+        {
+            pChunk = (RW_DuDir_t *)calloc(RW_DU_CHUNK_DIRS, sizeof(RW_DuDir_t));
+            __atomic_store_n(&pScan->pIndex->pChunks[chunk], pChunk, __ATOMIC_RELEASE);
+        }
+
+        pthread_mutex_unlock(&pScan->chunkLock);
+
+        /* Index would hold a directory hole, scan is abandoned */
+        if (pChunk == NULL)
+        {
+            __atomic_store_n(&pScan->failed, 1, __ATOMIC_RELEASE);
+            return NULL;
+        }
+    }
+
+    *pIndex = dirIndex;
+
+    return &pChunk[dirIndex & (RW_DU_CHUNK_DIRS - 1)];
+}
+
+static const char* allocName(RW_DuArena_t **ppArena, const char *pName, size_t length)
+{
+    char *pCopy;
+
+    RW_DuArena_t *pArena = *ppArena;
+
+    if ( (pArena == NULL) ||
+         ((pArena->used + length + 1) > (RW_DU_ARENA_SZ - sizeof(RW_DuArena_t))) )
+    {
+        pArena = (RW_DuArena_t *)malloc(RW_DU_ARENA_SZ);
+        if (pArena == NULL) { return NULL; }
+
+        pArena->pNext   = *ppArena;
+        pArena->used    = 0;
+        *ppArena        = pArena;
+    }
+
+    pCopy = &pArena->names[pArena->used];
+    memcpy(pCopy, pName, length);
+    pCopy[length] = '\0';
+
+    pArena->used += (uint32_t)(length + 1);
+
+    return pCopy;
+}
+
+static RW_DuDir_t* appendDir(RW_DuIndex_t *pIndex, uint32_t *pDirIndex)
+{
+    uint32_t chunk;
+
+    RW_DuDir_t *pChunk;
+
+    if (pIndex->nDirs >= RW_DU_MAX_DIRS) { return NULL; }
+
+    /* Directories created after scan follow scanned ones, chunk slots start zeroed */
+    chunk  = pIndex->nDirs >> RW_DU_CHUNK_SHIFT;
+    pChunk = pIndex->pChunks[chunk];
+    if (pChunk == NULL)
+    {
+        pChunk = (RW_DuDir_t *)calloc(RW_DU_CHUNK_DIRS, sizeof(RW_DuDir_t));
+        if (pChunk == NULL) { return NULL; }
+
+        __atomic_store_n(&pIndex->pChunks[chunk], pChunk, __ATOMIC_RELEASE);
+    }
+
+    *pDirIndex = pIndex->nDirs++;
+
+    return &pChunk[*pDirIndex & (RW_DU_CHUNK_DIRS - 1)];
+}
+
+static int attachDir(RW_DuScanner_t *pScanner, uint32_t root, uint32_t parent, const char *pName, int moved, uint32_t minute)
+{
+    int length;
+    uint32_t dirIndex;
+    uint64_t handleHash;
+    char path[PATH_MAX], childPath[PATH_MAX];
+    const char *pPath, *pCopy;
+
+    RW_DuIndex_t *pIndex  = pScanner->pIndices[root];
+    RW_DuDir_t   *pParent = getDir(pIndex, parent);
+    RW_DuDir_t   *pDir;
+
+    pPath = buildDirPath(pIndex, pScanner->config.pRoots[root], parent, path, sizeof(path));
+    if (pPath == NULL) { return 0; }
+
+    length = snprintf(childPath, sizeof(childPath), "%s%s%s",
+                      pPath, (pPath[strlen(pPath) - 1] == '/') ? "" : "/", pName);
+    if (length >= (int)sizeof(childPath)) { return 0; }
+
+    /* Directory gone again since event, its removal follows */
+    handleHash = getHandleHash(AT_FDCWD, childPath, 0);
+    if (handleHash == 0) { return 0; }
+
+    dirIndex = findDir(pIndex, handleHash);
+    if (dirIndex == RW_DU_NO_DIR)
+    {
+        pDir = appendDir(pIndex, &dirIndex);
+        if (pDir == NULL) { return -1; }
+
+        pDir->parent     = parent;
+        pDir->depth      = (uint16_t)(pParent->depth + 1);
+        pDir->flags      = (uint16_t)(RW_DU_DIR_NEW | (moved ? RW_DU_DIR_MOVED : 0));
+        pDir->pName      = allocName(&pIndex->pArenas, pName, strlen(pName));
+        pDir->handleHash = handleHash;
+
+        if (pDir->pName == NULL) { pDir->pName = ""; }
+
+        if (insertHandle(pIndex, dirIndex) < 0) { return -1; }
+
+        /* Entries of new directory, or of subtree moved in from outside tree, are indexed by updates */
+        markDirty(pIndex, dirIndex);
+        return 0;
+    }
+
+    /* Root never moves below its own subtree */
+    if (dirIndex == 0) { return 0; }
+
+    pDir = getDir(pIndex, dirIndex);
+
+    /* Subtree leaves old ancestors and joins new ones, descendants keep their scan depth */
+    if ( (pDir->parent != parent) ||
+         (pDir->flags & RW_DU_DIR_REMOVED) )
+    {
+        if (!(pDir->flags & RW_DU_DIR_REMOVED))
+        {
+            adjustAncestors(pIndex, pDir->parent, -(int64_t)pDir->bytes, -(int64_t)pDir->nFiles, minute);
+        }
+
+        pDir->parent = parent;
+        pDir->depth  = (uint16_t)(pParent->depth + 1);
+        pDir->flags &= (uint16_t)~RW_DU_DIR_REMOVED;
+
+        adjustAncestors(pIndex, parent, (int64_t)pDir->bytes, (int64_t)pDir->nFiles, minute);
+    }
+
+    if (strcmp(pDir->pName, pName) != 0)
+    {
+        pCopy = allocName(&pIndex->pArenas, pName, strlen(pName));
+        if (pCopy != NULL) { pDir->pName = pCopy; }
+    }
+
+    /* Moved directory reports its own move event next */
+    if (moved) { pDir->flags |= RW_DU_DIR_MOVED; }
+
+    return 0;
+}
+
+static const char* buildDirPath(const RW_DuIndex_t *pIndex, const char *pRootPath, uint32_t dirIndex, char *pBuf, size_t bufSz)
+{
+    size_t pos = bufSz - 1;
+    size_t length;
+
+    const RW_DuDir_t *pDir;
+
+    pBuf[pos] = '\0';
+
+    /* Names are prepended from directory up to root */
+    while (dirIndex != 0)
+    {
+        pDir   = getDir(pIndex, dirIndex);
+        length = strlen(pDir->pName);
+
+        if (pos < (length + 1)) { return NULL; }
+
+        pos -= length;
+        memcpy(&pBuf[pos], pDir->pName, length);
+        pBuf[--pos] = '/';
+
+        dirIndex = pDir->parent;
+    }
+
+    length = strlen(pRootPath);
+
+    /* Root "/" joins its children without a separator of its own */
+    if ( (pos < bufSz - 1) &&
+         (length > 0) &&
+         (pRootPath[length - 1] == '/') )
+    {
+        length--;
+    }
+
+    if (pos < length) { return NULL; }
+
+    pos -= length;
+    memcpy(&pBuf[pos], pRootPath, length);
+
+    return &pBuf[pos];
+}
+
+static RW_DuScan_t* createScan(RW_DuScanner_t *pScanner, uint32_t root)
+{
+    uint32_t idx;
+
+    RW_DuScan_t *pScan;
+
+    pScan = (RW_DuScan_t *)calloc(1, sizeof(RW_DuScan_t));
+    if (pScan == NULL)
+    {
+        LOG_ERROR("Failed to allocate disk usage scan");
+        return NULL;
+    }
+
+    pScan->pScanner  = pScanner;
+    pScan->pRootPath = pScanner->config.pRoots[root];
+    pthread_mutex_init(&pScan->chunkLock, NULL);
+
+    for (idx = 0; idx < RW_DU_LINK_SHARDS; idx++)
+    {
+        pthread_mutex_init(&pScan->links[idx].lock, NULL);
+    }
+
+    for (idx = 0; idx < pScanner->config.nThreads; idx++)
+    {
+        pScan->workers[idx].pScan    = pScan;
+        pScan->workers[idx].workerID = idx;
+        pScan->workers[idx].nSlots   = RW_DU_DEQUE_SZ;
+        pScan->workers[idx].pDeque   = (uint32_t *)malloc(RW_DU_DEQUE_SZ * sizeof(uint32_t));
+        pScan->workers[idx].pDirents = (char *)malloc(RW_DU_DIRENT_BUF_SZ);
+        pthread_mutex_init(&pScan->workers[idx].lock, NULL);
+    }
+
+    pScan->pIndex = (RW_DuIndex_t *)calloc(1, sizeof(RW_DuIndex_t));
+
+    for (idx = 0; idx < pScanner->config.nThreads; idx++)
+    {
+        if ( (pScan->workers[idx].pDeque == NULL) ||
+             (pScan->workers[idx].pDirents == NULL) )
+        {
+            break;
+        }
+    }
+
+    if ( (pScan->pIndex == NULL) ||
+         (idx < pScanner->config.nThreads) )
+    {
+        LOG_ERROR("Failed to allocate disk usage scan of '%s'",
+                  pScan->pRootPath);
+        destroyScan(pScan);
+        return NULL;
+    }
+
+    return pScan;
+}
+
+static void destroyIndex(RW_DuIndex_t *pIndex)
+{
+    uint32_t chunk;
+
+    RW_DuArena_t *pArena;
+
+    for (chunk = 0; chunk < RW_DU_MAX_CHUNKS; chunk++)
+    {
+        if (pIndex->pChunks[chunk] == NULL) { break; }
+        free(pIndex->pChunks[chunk]);
+    }
+
+    while (pIndex->pArenas != NULL)
+    {
+        pArena           = pIndex->pArenas;
+        pIndex->pArenas  = pArena->pNext;
+        free(pArena);
+    }
+
+    free(pIndex->pHandleSlots);
+    free(pIndex->pDirty);
+    free(pIndex->pGrowth);
+    free(pIndex->pGrowthSlots);
+    free(pIndex->pSizeRanks);
+    free(pIndex);
+}
+
+static void destroyScan(RW_DuScan_t *pScan)
+{
+    uint32_t idx;
+
+    RW_DuArena_t *pArena;
+
+    for (idx = 0; idx < pScan->pScanner->config.nThreads; idx++)
+    {
+        while (pScan->workers[idx].pArena != NULL)
+        {
+            pArena                      = pScan->workers[idx].pArena;
+            pScan->workers[idx].pArena  = pArena->pNext;
+            free(pArena);
+        }
+
+        free(pScan->workers[idx].pDeque);
+        free(pScan->workers[idx].pDirents);
+        pthread_mutex_destroy(&pScan->workers[idx].lock);
+    }
+
+    for (idx = 0; idx < RW_DU_LINK_SHARDS; idx++)
+    {
+        free(pScan->links[idx].pInodes);
+        pthread_mutex_destroy(&pScan->links[idx].lock);
+    }
+
+    if (pScan->pIndex != NULL) { destroyIndex(pScan->pIndex); }
+
+    pthread_mutex_destroy(&pScan->chunkLock);
+    free(pScan);
+}
+
+static void detachDir(RW_DuIndex_t *pIndex, uint32_t dirIndex, uint32_t minute)
+{
+    RW_DuDir_t *pDir = getDir(pIndex, dirIndex);
+
+    if ( (dirIndex == 0) ||
+         (pDir->flags & RW_DU_DIR_REMOVED) )
+    {
+        return;
+    }
+
+    /* Subtree stays indexed below removed directory, ranking skips it */
+    adjustAncestors(pIndex, pDir->parent, -(int64_t)pDir->bytes, -(int64_t)pDir->nFiles, minute);
+    pDir->flags |= RW_DU_DIR_REMOVED;
+}
+
+static uint32_t findDir(const RW_DuIndex_t *pIndex, uint64_t handleHash)
+{
+    uint32_t slot;
+
+    if (pIndex->pHandleSlots == NULL) { return RW_DU_NO_DIR; }
+
+    slot = (uint32_t)handleHash & (pIndex->nHandleSlots - 1);
+    while (pIndex->pHandleSlots[slot] != 0)
+    {
+        if (getDir(pIndex, pIndex->pHandleSlots[slot] - 1)->handleHash == handleHash)
+        {
+            return pIndex->pHandleSlots[slot] - 1;
+        }
+
+        slot = (slot + 1) & (pIndex->nHandleSlots - 1);
+    }
+
+    return RW_DU_NO_DIR;
+}
+
+static inline int64_t getClockNs(clockid_t clockID)
+{
+    struct timespec ts;
+    clock_gettime(clockID, &ts);
+    return ((int64_t)ts.tv_sec * RW_DU_NSEC_PER_SEC) + ts.tv_nsec;
+}
+
+static inline RW_DuDir_t* getDir(const RW_DuIndex_t *pIndex, uint32_t dirIndex)
+{
+    RW_DuDir_t *pChunk = __atomic_load_n(&pIndex->pChunks[dirIndex >> RW_DU_CHUNK_SHIFT], __ATOMIC_ACQUIRE);
+    return &pChunk[dirIndex & (RW_DU_CHUNK_DIRS - 1)];
+}
+
+static int64_t getGrowth(const RW_DuGrowth_t *pGrowth, uint32_t window, uint32_t minute)
+{
+    int64_t first, nMinutes, growth = 0;
+    uint32_t slot;
+
+    if (minute < pGrowth->lastMinute) { minute = pGrowth->lastMinute; }
+
+    /* Window ends with current minute, ring holds minutes up to last change */
+    first = (int64_t)minute - window + 1;
+    if (first < 0) { first = 0; }
+
+    nMinutes = (int64_t)pGrowth->lastMinute - first + 1;
+    if (nMinutes <= 0) { return 0; }
+
+    /* Long windows subtract minutes before window from ring total, at most half the ring is summed */
+    if (nMinutes > (RW_DU_GROWTH_MINUTES / 2))
+    {
+        growth   = pGrowth->total;
+        nMinutes = RW_DU_GROWTH_MINUTES - nMinutes;
+        slot     = (pGrowth->lastMinute + 1) % RW_DU_GROWTH_MINUTES;
+
+        for (; nMinutes > 0; nMinutes--)
+        {
+            growth -= pGrowth->deltas[slot];
+            if (++slot == RW_DU_GROWTH_MINUTES) { slot = 0; }
+        }
+
+        return growth;
+    }
+
+    slot = (uint32_t)(first % RW_DU_GROWTH_MINUTES);
+
+    for (; nMinutes > 0; nMinutes--)
+    {
+        growth += pGrowth->deltas[slot];
+        if (++slot == RW_DU_GROWTH_MINUTES) { slot = 0; }
+    }
+
+    return growth;
+}
+
+static uint64_t getHandleHash(int dirFD, const char *pPath, int flags)
+{
+    int mountID;
+    uint64_t handleBuf[(sizeof(struct file_handle) + MAX_HANDLE_SZ + sizeof(uint64_t) - 1) / sizeof(uint64_t)];
+
+    struct file_handle *pHandle = (struct file_handle *)handleBuf;
+
+    pHandle->handle_bytes = MAX_HANDLE_SZ;
+
+    if (name_to_handle_at(dirFD, pPath, pHandle, &mountID, flags) < 0) { return 0; }
+
+    return hashHandle(pHandle);
+}
+
+static inline uint32_t getMinute(void)
+{
+    return (uint32_t)(getClockNs(CLOCK_MONOTONIC) / (RW_DU_NSEC_PER_SEC * RW_DU_SEC_PER_MIN));
+}
+
+static void handleEvent(RW_DuScanner_t *pScanner, uint64_t mask, const int *pFsid, uint64_t handleHash, const char *pName, uint32_t minute)
+{
+    uint32_t root, dirIndex;
+
+    RW_DuRoot_t  *pRoot;
+    RW_DuIndex_t *pIndex;
+    RW_DuDir_t   *pDir;
+
+    /* Trees sharing a filesystem apply event to their own index each */
+    for (root = 0; root < pScanner->config.nRoots; root++)
+    {
+        pRoot  = &pScanner->roots[root];
+        pIndex = pScanner->pIndices[root];
+
+        if ( (!pRoot->watched) ||
+             (pIndex == NULL) ||
+             (pRoot->fsid[0] != pFsid[0]) ||
+             (pRoot->fsid[1] != pFsid[1]) )
+        {
+            continue;
+        }
+
+        /* Directories outside tree are not indexed */
+        dirIndex = findDir(pIndex, handleHash);
+        if (dirIndex == RW_DU_NO_DIR) { continue; }
+
+        /* File entries are counted by relisting their directory */
+        if (!(mask & FAN_ONDIR))
+        {
+            markDirty(pIndex, dirIndex);
+            continue;
+        }
+
+        pDir = getDir(pIndex, dirIndex);
+
+        /* Self events report directory itself */
+        if (mask & FAN_DELETE_SELF) { detachDir(pIndex, dirIndex, minute); }
+
+        if (mask & FAN_MOVE_SELF)
+        {
+            /* Move within tree was applied at its entry event, other moves left tree */
+            if (pDir->flags & RW_DU_DIR_MOVED) { pDir->flags &= (uint16_t)~RW_DU_DIR_MOVED; }
+            else                               { detachDir(pIndex, dirIndex, minute); }
+        }
+
+        /* Entry events report parent of subdirectory, its own size changes with entries */
+        if (mask & (FAN_CREATE | FAN_DELETE | FAN_MOVED_FROM | FAN_MOVED_TO)) { markDirty(pIndex, dirIndex); }
+
+        if ( (mask & (FAN_CREATE | FAN_MOVED_TO)) &&
+             (pName[0] != '\0') &&
+             (strcmp(pName, ".") != 0) &&
+             (attachDir(pScanner, root, dirIndex, pName, ((mask & FAN_MOVED_TO) != 0), minute) < 0) )
+        {
+            pRoot->rescan = 1;
+        }
+    }
+}
+
+static uint64_t hashHandle(const struct file_handle *pHandle)
+{
+    uint32_t idx;
+    uint64_t hash = 0xCBF29CE484222325ULL ^ (uint32_t)pHandle->handle_type;
+
+    for (idx = 0; idx < pHandle->handle_bytes; idx++)
+    {
+        hash ^= pHandle->f_handle[idx];
+        hash *= 0x100000001B3ULL;
+    }
+
+    /* Final mix spreads handle over map slots, 0 marks untracked directories */
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+
+    return (hash != 0) ? hash : 1;
+}
+
+static int insertHandle(RW_DuIndex_t *pIndex, uint32_t dirIndex)
+{
+    uint32_t slot, idx, nSlots;
+    uint32_t *pSlots;
+
+    /* Grow at half load, slots are rehashed */
+    if ((pIndex->nHandles * 2) >= pIndex->nHandleSlots)
+    {
+        nSlots = (pIndex->nHandleSlots == 0) ? RW_DU_HANDLE_SLOTS : (pIndex->nHandleSlots * 2);
+        pSlots = (uint32_t *)calloc(nSlots, sizeof(uint32_t));
+        if (pSlots == NULL) { return -1; }
+
+        for (idx = 0; idx < pIndex->nHandleSlots; idx++)
+        {
+            if (pIndex->pHandleSlots[idx] == 0) { continue; }
+
+            slot = (uint32_t)getDir(pIndex, pIndex->pHandleSlots[idx] - 1)->handleHash & (nSlots - 1);
+            while (pSlots[slot] != 0) { slot = (slot + 1) & (nSlots - 1); }
+            pSlots[slot] = pIndex->pHandleSlots[idx];
+        }
+
+        free(pIndex->pHandleSlots);
+        pIndex->pHandleSlots = pSlots;
+        pIndex->nHandleSlots = nSlots;
+    }
+
+    slot = (uint32_t)getDir(pIndex, dirIndex)->handleHash & (pIndex->nHandleSlots - 1);
+    while (pIndex->pHandleSlots[slot] != 0) { slot = (slot + 1) & (pIndex->nHandleSlots - 1); }
+
+    pIndex->pHandleSlots[slot] = dirIndex + 1;
+    pIndex->nHandles++;
+
+    return 0;
+}
+
+static int insertHardlink(RW_DuScan_t *pScan, uint64_t inode)
+{
+    uint64_t hash = inode * 0x9E3779B97F4A7C15ULL;
+    uint64_t *pInodes;
+    uint32_t slot, idx, nSlots;
+    int inserted = 1;
+
+    RW_DuLinkShard_t *pShard = &pScan->links[hash >> 58];
+
+    pthread_mutex_lock(&pShard->lock);
+
+    /* Grow at half load, slots are rehashed */
+    if ((pShard->nInodes * 2) >= pShard->nSlots)
+    {
+        nSlots  = (pShard->nSlots == 0) ? RW_DU_LINK_SLOTS : (pShard->nSlots * 2);
+        pInodes = (uint64_t *)calloc(nSlots, sizeof(uint64_t));
+        if (pInodes == NULL)
+        {
+            pthread_mutex_unlock(&pShard->lock);
+            return 1;
+        }
+
+        for (idx = 0; idx < pShard->nSlots; idx++)
+        {
+            if (pShard->pInodes[idx] == 0) { continue; }
+
+            slot = (uint32_t)(pShard->pInodes[idx] * 0x9E3779B97F4A7C15ULL) & (nSlots - 1);
+            while (pInodes[slot] != 0) { slot = (slot + 1) & (nSlots - 1); }
+            pInodes[slot] = pShard->pInodes[idx];
+        }
+
+        free(pShard->pInodes);
+        pShard->pInodes = pInodes;
+        pShard->nSlots  = nSlots;
+    }
+
+    slot = (uint32_t)hash & (pShard->nSlots - 1);
+    while (pShard->pInodes[slot] != 0)
+    {
+        if (pShard->pInodes[slot] == inode)
+        {
+            inserted = 0;
+            break;
+        }
+
+        slot = (slot + 1) & (pShard->nSlots - 1);
+    }
+
+    if (inserted)
+    {
+        pShard->pInodes[slot] = inode;
+        pShard->nInodes++;
+    }
+
+    pthread_mutex_unlock(&pShard->lock);
+
+    return inserted;
+}
+
+static void insertRanked(uint32_t *pRanked, int64_t *pValues, uint32_t *pnRanked, uint32_t dirIndex, int64_t value)
+{
+    uint32_t rank;
+
+    /* Full ranking drops its last directory */
+    rank = (*pnRanked < RW_DU_INFO_MAX_ENTRIES) ? (*pnRanked)++ : (*pnRanked - 1);
+    while ( (rank > 0) &&
+            (pValues[rank - 1] < value) )
+    {
+        pRanked[rank] = pRanked[rank - 1];
+        pValues[rank] = pValues[rank - 1];
+        rank--;
+    }
+
+    pRanked[rank] = dirIndex;
+    pValues[rank] = value;
+}
+
+static int isDirLive(const RW_DuIndex_t *pIndex, uint32_t dirIndex)
+{
+    uint32_t level;
+
+    const RW_DuDir_t *pDir;
+
+    for (level = 0; level < RW_DU_MAX_LEVELS; level++)
+    {
+        pDir = getDir(pIndex, dirIndex);
+
+        if (pDir->flags & RW_DU_DIR_REMOVED) { return 0; }
+        if (dirIndex == 0)                   { return 1; }
+
+        dirIndex = pDir->parent;
+    }
+
+    return 0;
+}
+
+static void markDirty(RW_DuIndex_t *pIndex, uint32_t dirIndex)
+{
+    uint32_t nSlots;
+    uint32_t *pDirty;
+
+    RW_DuDir_t *pDir = getDir(pIndex, dirIndex);
+
+    if (pDir->flags & RW_DU_DIR_DIRTY) { return; }
+
+    if (pIndex->nDirty == pIndex->dirtySlots)
+    {
+        nSlots = (pIndex->dirtySlots == 0) ? RW_DU_DIRTY_SZ : (pIndex->dirtySlots * 2);
+        pDirty = (uint32_t *)realloc(pIndex->pDirty, nSlots * sizeof(uint32_t));
+
+        /* Change is picked up by next event of directory */
+        if (pDirty == NULL) { return; }
+
+        pIndex->pDirty     = pDirty;
+        pIndex->dirtySlots = nSlots;
+    }
+
+    pIndex->pDirty[pIndex->nDirty++] = dirIndex;
+    pDir->flags |= RW_DU_DIR_DIRTY;
+}
+
+static void paceWorker(RW_DuWorker_t *pWorker)
+{
+    int64_t wallNs, requiredNs = 0, inodeNs;
+    struct timespec pause;
+
+    const RW_DuScanConfig_t *pConfig = &pWorker->pScan->pScanner->config;
+
+    /* Every thread runs within its share of budgets since scan start */
+    if (pConfig->cpuBudget > 0)
+    {
+        requiredNs = (getClockNs(CLOCK_THREAD_CPUTIME_ID) - pWorker->startCpuNs) * 100 *
+                     pConfig->nThreads / pConfig->cpuBudget;
+    }
+
+    if (pConfig->inodeBudget > 0)
+    {
+        inodeNs = (int64_t)pWorker->nInodes * RW_DU_NSEC_PER_SEC * pConfig->nThreads / pConfig->inodeBudget;
+        if (inodeNs > requiredNs) { requiredNs = inodeNs; }
+    }
+
+    wallNs = getClockNs(CLOCK_MONOTONIC) - pWorker->startNs;
+    if (requiredNs <= wallNs) { return; }
+
+    requiredNs -= wallNs;
+    if (requiredNs > RW_DU_MAX_PAUSE_NS) { requiredNs = RW_DU_MAX_PAUSE_NS; }
+
+    pause.tv_sec  = 0;
+    pause.tv_nsec = requiredNs;
+    nanosleep(&pause, NULL);
+}
+
+static int popDir(RW_DuWorker_t *pWorker, uint32_t *pDirIndex)
+{
+    int found = 0;
+
+    pthread_mutex_lock(&pWorker->lock);
+
+    /* Owner takes newest directory, subtree stays warm in caches */
+    if (pWorker->count > 0)
+    {
+        pWorker->count--;
+        *pDirIndex = pWorker->pDeque[(pWorker->head + pWorker->count) & (pWorker->nSlots - 1)];
+        found = 1;
+    }
+
+    pthread_mutex_unlock(&pWorker->lock);
+
+    return found;
+}
+
+static int pushDir(RW_DuWorker_t *pWorker, uint32_t dirIndex)
+{
+    uint32_t idx;
+    uint32_t *pDeque;
+
+    pthread_mutex_lock(&pWorker->lock);
+
+    if (pWorker->count == pWorker->nSlots)
+    {
+        pDeque = (uint32_t *)malloc(pWorker->nSlots * 2 * sizeof(uint32_t));
+        if (pDeque == NULL)
+        {
+            pthread_mutex_unlock(&pWorker->lock);
+            return -1;
+        }
+
+        /* Unwrap ring into larger one */
+        for (idx = 0; idx < pWorker->count; idx++)
+        {
+            pDeque[idx] = pWorker->pDeque[(pWorker->head + idx) & (pWorker->nSlots - 1)];
+        }
+
+        free(pWorker->pDeque);
+        pWorker->pDeque  = pDeque;
+        pWorker->nSlots *= 2;
+        pWorker->head    = 0;
+    }
+
+    pWorker->pDeque[(pWorker->head + pWorker->count) & (pWorker->nSlots - 1)] = dirIndex;
+    pWorker->count++;
+
+    pthread_mutex_unlock(&pWorker->lock);
+
+    return 0;
+}
+
+static int rankSizes(RW_DuScanner_t *pScanner, RW_DuIndex_t *pIndex)
+{
+    uint32_t idx, nLevels = 1;
+    int64_t (*pValues)[RW_DU_INFO_MAX_ENTRIES];
+
+    const RW_DuDir_t *pDir;
+    RW_DuSizeRank_t  *pRanks, *pRank;
+
+    /* Sizes and parents change on this thread only, index is ranked outside lock */
+    for (idx = 1; idx < pIndex->nDirs; idx++)
+    {
+        pDir = getDir(pIndex, idx);
+        if (pDir->depth >= nLevels) { nLevels = (uint32_t)pDir->depth + 1; }
+    }
+
+    pRanks  = (RW_DuSizeRank_t *)calloc(nLevels, sizeof(RW_DuSizeRank_t));
+    pValues = calloc(nLevels, sizeof(*pValues));
+    if ( (pRanks  == NULL) ||
+         (pValues == NULL) )
+    {
+        LOG_ERROR("Failed to allocate size ranking of %u depths",
+                  nLevels);
+        free(pRanks);
+        free(pValues);
+        return -1;
+    }
+
+    /* Largest subtrees of every depth, queries merge depths within their limit */
+    for (idx = 1; idx < pIndex->nDirs; idx++)
+    {
+        pDir  = getDir(pIndex, idx);
+        pRank = &pRanks[pDir->depth];
+
+        if ( ( (pRank->nRanked == RW_DU_INFO_MAX_ENTRIES) &&
+               ((int64_t)pDir->bytes <= pValues[pDir->depth][RW_DU_INFO_MAX_ENTRIES - 1]) ) ||
+             !isDirLive(pIndex, idx) )
+        {
+            continue;
+        }
+
+        insertRanked(pRank->dirs, pValues[pDir->depth], &pRank->nRanked, idx, (int64_t)pDir->bytes);
+    }
+
+    free(pValues);
+
+    pthread_mutex_lock(&pScanner->lock);
+    pRank               = pIndex->pSizeRanks;
+    pIndex->pSizeRanks  = pRanks;
+    pIndex->nRankLevels = nLevels;
+    pIndex->rankStale   = 0;
+    pIndex->rankNs      = getClockNs(CLOCK_MONOTONIC);
+    pthread_mutex_unlock(&pScanner->lock);
+
+    free(pRank);
+
+    return 0;
+}
+
+static void readEvents(RW_DuScanner_t *pScanner, uint32_t minute)
+{
+    ssize_t nBytes, offset;
+    uint32_t root;
+    const char *pName;
+    struct fanotify_event_metadata event;
+
+    const struct fanotify_event_info_fid *pFid;
+    const struct file_handle             *pHandle;
+
+    /* Group is non-blocking, queue is drained every tick */
+    while ((nBytes = read(pScanner->fanFD, pScanner->pEvents, RW_DU_EVENT_BUF_SZ)) > 0)
+    {
+        pthread_mutex_lock(&pScanner->lock);
+
+        for (offset = 0; (offset + (ssize_t)sizeof(event)) <= nBytes; offset += event.event_len)
+        {
+            /* Events are 4 byte aligned, metadata is copied out */
+            memcpy(&event, &pScanner->pEvents[offset], sizeof(event));
+
+            if ( (event.event_len < sizeof(event)) ||
+                 ((offset + (ssize_t)event.event_len) > nBytes) )
+            {
+                break;
+            }
+
+            /* Lost events leave indices stale, marked trees are rescanned */
+            if (event.mask & FAN_Q_OVERFLOW)
+            {
+                for (root = 0; root < pScanner->config.nRoots; root++)
+                {
+                    if (pScanner->roots[root].watched) { pScanner->roots[root].rescan = 1; }
+                }
+
+                continue;
+            }
+
+            pFid    = (const struct fanotify_event_info_fid *)&pScanner->pEvents[offset + sizeof(event)];
+            pHandle = (const struct file_handle *)pFid->handle;
+
+            /* Directory file handle, and entry name of entry events, follow metadata */
+            if ( (event.vers != FANOTIFY_METADATA_VERSION) ||
+                 (event.event_len < (sizeof(event) + sizeof(*pFid) + sizeof(*pHandle))) ||
+                 (event.event_len < (sizeof(event) + pFid->hdr.len)) ||
+                 (pFid->hdr.len < (sizeof(*pFid) + sizeof(*pHandle) + pHandle->handle_bytes)) ||
+                 ( (pFid->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME) &&
+                   (pFid->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID) ) )
+            {
+                continue;
+            }
+
+            pName = (pFid->hdr.info_type == FAN_EVENT_INFO_TYPE_DFID_NAME) ?
+                    (const char *)&pHandle->f_handle[pHandle->handle_bytes] : "";
+
+            handleEvent(pScanner, event.mask, pFid->fsid.val, hashHandle(pHandle), pName, minute);
+        }
+
+        pthread_mutex_unlock(&pScanner->lock);
+    }
+}
+
+static int relistDirectory(RW_DuScanner_t *pScanner, uint32_t root, uint32_t dirIndex, const char *pPath,
+                           uint64_t *pBytes, uint32_t *pFiles, uint64_t *pnInodes, uint32_t minute)
+{
+    int dirFD, attach;
+    long nBytes, offset;
+    struct statx entryStats;
+
+    RW_DuRoot_t     *pRoot = &pScanner->roots[root];
+    RW_DuDirent64_t *pEntry;
+
+    /* Subdirectories of directory added from events are not indexed yet */
+    attach = ((getDir(pScanner->pIndices[root], dirIndex)->flags & RW_DU_DIR_NEW) != 0);
+
+    dirFD = open(pPath, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (dirFD < 0) { return -1; }
+
+    if (statx(dirFD, "", AT_EMPTY_PATH | RW_DU_STATX_FLAGS, RW_DU_STATX_MASK, &entryStats) < 0)
+    {
+        close(dirFD);
+        return -1;
+    }
+
+    *pBytes = entryStats.stx_blocks * RW_DU_BLOCK_SZ;
+    *pFiles = 0;
+
+    while ((nBytes = syscall(SYS_getdents64, dirFD, pScanner->pDirents, RW_DU_DIRENT_BUF_SZ)) > 0)
+    {
+        for (offset = 0; offset < nBytes; offset += pEntry->d_reclen)
+        {
+            pEntry = (RW_DuDirent64_t *)(pScanner->pDirents + offset);
+
+            /* Subdirectories are index directories of their own */
+            if ( ( (pEntry->d_type == DT_DIR) && !attach ) ||
+                 ( (pEntry->d_name[0] == '.') &&
+                   ( (pEntry->d_name[1] == '\0') ||
+                     ((pEntry->d_name[1] == '.') && (pEntry->d_name[2] == '\0')) ) ) )
+            {
+                continue;
+            }
+
+            (*pnInodes)++;
+
+            /* Entry removed since listing reports its own event */
+            if (statx(dirFD, pEntry->d_name, RW_DU_STATX_FLAGS, RW_DU_STATX_MASK, &entryStats) < 0) { continue; }
+
+            if (S_ISDIR(entryStats.stx_mode))
+            {
+                /* Subdirectory joins index and is updated in turn, mounted filesystems are skipped */
+                if ( attach &&
+                     (entryStats.stx_dev_major == pRoot->devMajor) &&
+                     (entryStats.stx_dev_minor == pRoot->devMinor) )
+                {
+                    pthread_mutex_lock(&pScanner->lock);
+                    if (attachDir(pScanner, root, dirIndex, pEntry->d_name, 0, minute) < 0) { pRoot->rescan = 1; }
+                    pthread_mutex_unlock(&pScanner->lock);
+                }
+
+                continue;
+            }
+
+            /* Files with several links keep their scan attribution */
+            if (entryStats.stx_nlink > 1) { continue; }
+
+            *pBytes += entryStats.stx_blocks * RW_DU_BLOCK_SZ;
+            (*pFiles)++;
+        }
+    }
+
+    close(dirFD);
+
+    return (nBytes < 0) ? -1 : 0;
+}
+
+static int scanAborted(RW_DuScan_t *pScan)
+{
+    return scanStopped(pScan->pScanner) || __atomic_load_n(&pScan->failed, __ATOMIC_ACQUIRE);
+}
+
+static void scanDirectory(RW_DuWorker_t *pWorker, uint32_t dirIndex)
+{
+    int dirFD;
+    long nBytes, offset;
+    uint32_t childIndex;
+    uint64_t bytes = 0, nFiles = 0, linkBytes = 0, linkFiles = 0;
+    char path[PATH_MAX];
+    const char *pPath;
+    struct statx entryStats;
+
+    RW_DuScan_t *pScan = pWorker->pScan;
+    RW_DuDir_t *pDir   = getDir(pScan->pIndex, dirIndex);
+    RW_DuDir_t *pChild;
+    RW_DuDirent64_t *pEntry;
+
+    pPath = buildDirPath(pScan->pIndex, pScan->pRootPath, dirIndex, path, sizeof(path));
+    if (pPath == NULL)
+    {
+        __atomic_fetch_add(&pScan->nErrors, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    dirFD = open(pPath, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (dirFD < 0)
+    {
+        /* Directories vanish or deny listing under a running scan */
+        __atomic_fetch_add(&pScan->nErrors, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    /* Handle identifies directory in filesystem events */
+    if (pScan->tracked) { pDir->handleHash = getHandleHash(dirFD, "", AT_EMPTY_PATH); }
+
+    while ((nBytes = syscall(SYS_getdents64, dirFD, pWorker->pDirents, RW_DU_DIRENT_BUF_SZ)) > 0)
+    {
+        for (offset = 0; offset < nBytes; offset += pEntry->d_reclen)
+        {
+            pEntry = (RW_DuDirent64_t *)(pWorker->pDirents + offset);
+
+            if ( (pEntry->d_name[0] == '.') &&
+                 ( (pEntry->d_name[1] == '\0') ||
+                   ((pEntry->d_name[1] == '.') && (pEntry->d_name[2] == '\0')) ) )
+            {
+                continue;
+            }
+
+            pWorker->nInodes++;
+
+            if (statx(dirFD, pEntry->d_name, RW_DU_STATX_FLAGS, RW_DU_STATX_MASK, &entryStats) < 0)
+            {
+                __atomic_fetch_add(&pScan->nErrors, 1, __ATOMIC_RELAXED);
+                continue;
+            }
+
+            if (S_ISDIR(entryStats.stx_mode))
+            {
+                /* Mounted filesystems below tree are not scanned */
+                if ( (entryStats.stx_dev_major != pScan->devMajor) ||
+                     (entryStats.stx_dev_minor != pScan->devMinor) )
+                {
+                    continue;
+                }
+
+                pChild = allocDir(pScan, &childIndex);
+                if (pChild == NULL)
+                {
+                    __atomic_fetch_add(&pScan->nErrors, 1, __ATOMIC_RELAXED);
+                    continue;
+                }
+
+                pChild->parent   = dirIndex;
+                pChild->depth    = (uint16_t)(pDir->depth + 1);
+                pChild->pName    = allocName(&pWorker->pArena, pEntry->d_name, strlen(pEntry->d_name));
+                pChild->ownBytes = entryStats.stx_blocks * RW_DU_BLOCK_SZ;
+                pChild->bytes    = pChild->ownBytes;
+
+                /* Child without name is kept in index, parents must precede children */
+                if (pChild->pName == NULL)
+                {
+                    pChild->pName = "";
+                    __atomic_fetch_add(&pScan->nErrors, 1, __ATOMIC_RELAXED);
+                    continue;
+                }
+
+                __atomic_fetch_add(&pScan->nPending, 1, __ATOMIC_ACQ_REL);
+                if (pushDir(pWorker, childIndex) < 0)
+                {
+                    __atomic_fetch_sub(&pScan->nPending, 1, __ATOMIC_ACQ_REL);
+                    __atomic_fetch_add(&pScan->nErrors, 1, __ATOMIC_RELAXED);
+                }
+
+                continue;
+            }
+
+            /* File with several links is counted at first link seen, updates keep it there */
+            if (entryStats.stx_nlink > 1)
+            {
+                if (insertHardlink(pScan, entryStats.stx_ino) == 0)
+                {
+                    __atomic_fetch_add(&pScan->nHardlinks, 1, __ATOMIC_RELAXED);
+                    continue;
+                }
+
+                linkBytes += entryStats.stx_blocks * RW_DU_BLOCK_SZ;
+                linkFiles++;
+            }
+
+            bytes += entryStats.stx_blocks * RW_DU_BLOCK_SZ;
+            nFiles++;
+        }
+
+        if (scanAborted(pScan)) { break; }
+    }
+
+    if (nBytes < 0) { __atomic_fetch_add(&pScan->nErrors, 1, __ATOMIC_RELAXED); }
+
+    close(dirFD);
+
+    /* Only listing thread writes directory during scan */
+    pDir->ownBytes  += bytes;
+    pDir->linkBytes  = linkBytes;
+    pDir->bytes     += bytes;
+    pDir->nFiles    += nFiles;
+    pDir->ownFiles   = (uint32_t)nFiles;
+    pDir->linkFiles  = (uint32_t)linkFiles;
+}
+
+static void* scanMain(void *pArg)
+{
+    uint32_t root, minute;
+    uint64_t nInodes;
+    struct timespec deadline;
+
+    RW_DuScanner_t *pScanner = (RW_DuScanner_t *)pArg;
+    RW_DuRoot_t    *pRoot;
+
+    while (!scanStopped(pScanner))
+    {
+        for (root = 0; (root < pScanner->config.nRoots) && !scanStopped(pScanner); root++)
+        {
+            pRoot = &pScanner->roots[root];
+
+            /* Tracked trees are rescanned only after lost events, others a period after last scan */
+            if ( (pRoot->scanNs != 0) &&
+                 ( ( pRoot->watched && !pRoot->rescan && (pScanner->pIndices[root] != NULL) ) ||
+                   ((getClockNs(CLOCK_MONOTONIC) - pRoot->scanNs) < ((int64_t)pScanner->config.period * RW_DU_NSEC_PER_SEC)) ) )
+            {
+                continue;
+            }
+
+            scanRoot(pScanner, root);
+            pRoot->scanNs = getClockNs(CLOCK_MONOTONIC);
+        }
+
+        /* Events queued meanwhile, scans included, are applied to published indices */
+        if (pScanner->fanFD >= 0)
+        {
+            minute  = getMinute();
+            nInodes = 0;
+
+            readEvents(pScanner, minute);
+
+            for (root = 0; root < pScanner->config.nRoots; root++)
+            {
+                updateDirs(pScanner, root, minute, &nInodes);
+
+                if (pScanner->pIndices[root] != NULL)
+                {
+                    pthread_mutex_lock(&pScanner->lock);
+                    trimGrowth(pScanner->pIndices[root], minute);
+                    pthread_mutex_unlock(&pScanner->lock);
+
+                    /* Changed tree is ranked again, not more often than ranking period */
+                    if ( pScanner->pIndices[root]->rankStale &&
+                         ((getClockNs(CLOCK_MONOTONIC) - pScanner->pIndices[root]->rankNs) >= (RW_DU_RANK_SEC * RW_DU_NSEC_PER_SEC)) )
+                    {
+                        rankSizes(pScanner, pScanner->pIndices[root]);
+                    }
+                }
+            }
+        }
+
+        /* Trees are checked every tick, period counts from last scan of each */
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += RW_DU_TICK_SEC;
+
+        pthread_mutex_lock(&pScanner->lock);
+        while ( (!pScanner->stop) &&
+                (pthread_cond_timedwait(&pScanner->stopCond, &pScanner->lock, &deadline) != ETIMEDOUT) );
+        pthread_mutex_unlock(&pScanner->lock);
+    }
+
+    return NULL;
+}
+
+static int scanRoot(RW_DuScanner_t *pScanner, uint32_t root)
+{
+    int64_t startNs;
+    uint32_t idx, nStarted = 0, rootIndex;
+    int mapped = 1;
+    struct statx rootStats;
+
+    RW_DuScan_t  *pScan;
+    RW_DuIndex_t *pIndex;
+    RW_DuDir_t   *pDir;
+    RW_DuArena_t *pArena;
+
+    startNs = getClockNs(CLOCK_MONOTONIC);
+
+    if (statx(AT_FDCWD, pScanner->config.pRoots[root], AT_STATX_DONT_SYNC, RW_DU_STATX_MASK, &rootStats) < 0)
+    {
+        LOG_ERROR("Failed to stat disk usage root '%s' [%m]",
+                  pScanner->config.pRoots[root]);
+        return -1;
+    }
+
+    pScan = createScan(pScanner, root);
+    if (pScan == NULL) { return -1; }
+
+    pIndex          = pScan->pIndex;
+    pScan->devMajor = rootStats.stx_dev_major;
+    pScan->devMinor = rootStats.stx_dev_minor;
+    pScan->tracked  = pScanner->roots[root].watched;
+
+    /* Root is first directory, seeded to first thread and stolen from there */
+    pDir = allocDir(pScan, &rootIndex);
+    if (pDir == NULL)
+    {
+        LOG_ERROR("Failed to allocate disk usage index");
+        destroyScan(pScan);
+        return -1;
+    }
+
+    pDir->pName    = "";
+    pDir->ownBytes = rootStats.stx_blocks * RW_DU_BLOCK_SZ;
+    pDir->bytes    = pDir->ownBytes;
+
+    pScan->nPending = 1;
+    pushDir(&pScan->workers[0], rootIndex);
+
+    for (idx = 0; idx < pScanner->config.nThreads; idx++)
+    {
+        if (pthread_create(&pScan->workers[idx].thread, NULL, workerMain, &pScan->workers[idx]) != 0)
+        {
+            LOG_ERROR("Failed to create disk usage scan thread %u [%m]",
+                      idx);
+            continue;
+        }
+
+        pScan->workers[idx].started = 1;
+        nStarted++;
+    }
+
+    for (idx = 0; idx < pScanner->config.nThreads; idx++)
+    {
+        if (pScan->workers[idx].started) { pthread_join(pScan->workers[idx].thread, NULL); }
+    }
+
+    if (pScan->failed)
+    {
+        LOG_ERROR("Disk usage scan of '%s' abandoned, index allocation failed",
+                  pScan->pRootPath);
+    }
+
+    if ( (nStarted == 0) ||
+         scanAborted(pScan) )
+    {
+        destroyScan(pScan);
+        return -1;
+    }
+
+    /* Children follow parents in index, one reverse pass sums subtrees */
+    for (idx = pIndex->nDirs - 1; idx > 0; idx--)
+    {
+        pDir = getDir(pIndex, idx);
+
+        getDir(pIndex, pDir->parent)->bytes  += pDir->bytes;
+        getDir(pIndex, pDir->parent)->nFiles += pDir->nFiles;
+    }
+
+    pIndex->scanTime     = time(NULL);
+    pIndex->scanDuration = (uint32_t)((getClockNs(CLOCK_MONOTONIC) - startNs) / RW_DU_NSEC_PER_MSEC);
+    pIndex->nHardlinks   = pScan->nHardlinks;
+    pIndex->nErrors      = pScan->nErrors;
+
+    /* Handles map event directories to index, unmapped tree is left to rescans */
+    for (idx = 0; pScan->tracked && (idx < pIndex->nDirs); idx++)
+    {
+        if ( (getDir(pIndex, idx)->handleHash != 0) &&
+             (insertHandle(pIndex, idx) < 0) )
+        {
+            LOG_ERROR("Failed to map directory handles of '%s'",
+                      pScan->pRootPath);
+            mapped = 0;
+            break;
+        }
+    }
+
+    /* Name blocks move to index */
+    for (idx = 0; idx < pScanner->config.nThreads; idx++)
+    {
+        while (pScan->workers[idx].pArena != NULL)
+        {
+            pArena                      = pScan->workers[idx].pArena;
+            pScan->workers[idx].pArena  = pArena->pNext;
+            pArena->pNext               = pIndex->pArenas;
+            pIndex->pArenas             = pArena;
+        }
+    }
+
+    /* Sizes are ranked before queries can see index */
+    rankSizes(pScanner, pIndex);
+
+    /* Publish index, previous one is released with scan outside lock */
+    pthread_mutex_lock(&pScanner->lock);
+    pScan->pIndex                   = pScanner->pIndices[root];
+    pScanner->pIndices[root]        = pIndex;
+    pScanner->roots[root].rescan    = !mapped;
+    pthread_mutex_unlock(&pScanner->lock);
+
+    destroyScan(pScan);
+
+    return 0;
+}
+
+static int scanStopped(RW_DuScanner_t *pScanner)
+{
+    return __atomic_load_n(&pScanner->stop, __ATOMIC_ACQUIRE);
+}
+
+static int stealDir(RW_DuWorker_t *pWorker, uint32_t *pDirIndex)
+{
+    uint32_t idx, nThreads;
+    int found = 0;
+
+    RW_DuWorker_t *pVictim;
+
+    nThreads = pWorker->pScan->pScanner->config.nThreads;
+
+    /* Victims are visited from next thread on, oldest directory roots largest pending subtree */
+    for (idx = 1; (idx < nThreads) && !found; idx++)
+    {
+        pVictim = &pWorker->pScan->workers[(pWorker->workerID + idx) % nThreads];
+
+        pthread_mutex_lock(&pVictim->lock);
+
+        if (pVictim->count > 0)
+        {
+            *pDirIndex      = pVictim->pDeque[pVictim->head];
+            pVictim->head   = (pVictim->head + 1) & (pVictim->nSlots - 1);
+            pVictim->count--;
+            found = 1;
+        }
+
+        pthread_mutex_unlock(&pVictim->lock);
+    }
+
+    return found;
+}
+
+static void trimGrowth(RW_DuIndex_t *pIndex, uint32_t minute)
+{
+    uint32_t idx, slot, nKept = 0;
+
+    RW_DuGrowth_t *pGrowth;
+
+    if ( (pIndex->pGrowth == NULL) ||
+         (pIndex->growthMinute == minute) )
+    {
+        return;
+    }
+
+    pIndex->growthMinute = minute;
+
+    /* Directories unchanged for longest window leave table, map is rebuilt */
+    memset(pIndex->pGrowthSlots, 0x00, RW_DU_GROWTH_SLOTS * sizeof(uint32_t));
+
+    for (idx = 0; idx < pIndex->nGrowth; idx++)
+    {
+        pGrowth = &pIndex->pGrowth[idx];
+
+        if ((minute - pGrowth->lastMinute) >= RW_DU_GROWTH_MINUTES) { continue; }
+
+        if (nKept != idx) { memcpy(&pIndex->pGrowth[nKept], pGrowth, sizeof(RW_DuGrowth_t)); }
+
+        slot = (uint32_t)(((uint64_t)pGrowth->dirIndex * 0x9E3779B97F4A7C15ULL) >> (64 - RW_DU_GROWTH_SLOT_BITS));
+        while (pIndex->pGrowthSlots[slot] != 0) { slot = (slot + 1) & (RW_DU_GROWTH_SLOTS - 1); }
+
+        pIndex->pGrowthSlots[slot] = ++nKept;
+    }
+
+    pIndex->nGrowth = nKept;
+}
+
+static void updateDirs(RW_DuScanner_t *pScanner, uint32_t root, uint32_t minute, uint64_t *pnInodes)
+{
+    uint32_t idx, dirIndex, ownFiles;
+    uint64_t ownBytes, inodeBudget;
+    char path[PATH_MAX];
+    const char *pPath;
+
+    RW_DuIndex_t *pIndex = pScanner->pIndices[root];
+    RW_DuDir_t   *pDir;
+
+    if ( (pIndex == NULL) ||
+         (pIndex->nDirty == 0) )
+    {
+        return;
+    }
+
+    /* Updates share inode budget of scans, directories left queued are updated next tick */
+    inodeBudget = (uint64_t)pScanner->config.inodeBudget * RW_DU_TICK_SEC;
+
+    for (idx = 0; idx < pIndex->nDirty; idx++)
+    {
+        if ( scanStopped(pScanner) ||
+             ((inodeBudget > 0) && (*pnInodes >= inodeBudget)) )
+        {
+            break;
+        }
+
+        dirIndex = pIndex->pDirty[idx];
+        pDir     = getDir(pIndex, dirIndex);
+
+        /* Names and parents change on this thread only, path is built outside lock */
+        pPath = NULL;
+        if (!(pDir->flags & RW_DU_DIR_REMOVED))
+        {
+            pPath = buildDirPath(pIndex, pScanner->config.pRoots[root], dirIndex, path, sizeof(path));
+        }
+
+        /* Vanished directory keeps its bytes until its removal event */
+        if ( (pPath == NULL) ||
+             (relistDirectory(pScanner, root, dirIndex, pPath, &ownBytes, &ownFiles, pnInodes, minute) < 0) )
+        {
+            pthread_mutex_lock(&pScanner->lock);
+            pDir->flags &= (uint16_t)~(RW_DU_DIR_DIRTY | RW_DU_DIR_NEW);
+            pthread_mutex_unlock(&pScanner->lock);
+            continue;
+        }
+
+        ownBytes += pDir->linkBytes;
+        ownFiles += pDir->linkFiles;
+
+        pthread_mutex_lock(&pScanner->lock);
+
+        adjustAncestors(pIndex, dirIndex, (int64_t)(ownBytes - pDir->ownBytes),
+                        (int64_t)ownFiles - (int64_t)pDir->ownFiles, minute);
+
+        pDir->ownBytes  = ownBytes;
+        pDir->ownFiles  = ownFiles;
+        pDir->flags    &= (uint16_t)~(RW_DU_DIR_DIRTY | RW_DU_DIR_NEW);
+        pIndex->nUpdates++;
+
+        pthread_mutex_unlock(&pScanner->lock);
+    }
+
+    /* Queue is touched by this thread only */
+    memmove(pIndex->pDirty, &pIndex->pDirty[idx], (pIndex->nDirty - idx) * sizeof(uint32_t));
+    pIndex->nDirty -= idx;
+}
+
+static void watchRoots(RW_DuScanner_t *pScanner)
+{
+    uint32_t root, nWatched = 0;
+    struct statfs rootStats;
+    struct statx rootDev;
+
+    const char *pPath;
+
+    /* Directory handle and entry name are reported, no descriptor is opened per event */
+    pScanner->fanFD = (int)syscall(SYS_fanotify_init, RW_DU_FAN_INIT_FLAGS, O_RDONLY | O_LARGEFILE | O_CLOEXEC);
+    if (pScanner->fanFD < 0)
+    {
+        LOG_WARNING("Disk usage is updated by rescans only, fanotify unavailable [%m]");
+        return;
+    }
+
+    pScanner->pEvents  = (char *)malloc(RW_DU_EVENT_BUF_SZ);
+    pScanner->pDirents = (char *)malloc(RW_DU_DIRENT_BUF_SZ);
+
+    if ( (pScanner->pEvents == NULL) ||
+         (pScanner->pDirents == NULL) )
+    {
+        LOG_ERROR("Failed to allocate disk usage event buffers");
+    }
+
+    for (root = 0; (root < pScanner->config.nRoots) && (pScanner->pEvents != NULL) && (pScanner->pDirents != NULL); root++)
+    {
+        pPath = pScanner->config.pRoots[root];
+
+        /* Whole filesystem is marked, events outside tree miss its index */
+        if ( (statfs(pPath, &rootStats) < 0) ||
+             (statx(AT_FDCWD, pPath, AT_STATX_DONT_SYNC, STATX_TYPE, &rootDev) < 0) ||
+             (syscall(SYS_fanotify_mark, pScanner->fanFD, RW_DU_FAN_MARK_FLAGS, (uint64_t)RW_DU_FAN_MASK, AT_FDCWD, pPath) < 0) )
+        {
+            LOG_WARNING("Disk usage of '%s' is updated by rescans only, filesystem not marked [%m]",
+                        pPath);
+            continue;
+        }
+
+        memcpy(pScanner->roots[root].fsid, &rootStats.f_fsid, sizeof(pScanner->roots[root].fsid));
+        pScanner->roots[root].devMajor = rootDev.stx_dev_major;
+        pScanner->roots[root].devMinor = rootDev.stx_dev_minor;
+        pScanner->roots[root].watched = 1;
+        nWatched++;
+    }
+
+    if (nWatched == 0)
+    {
+        close(pScanner->fanFD);
+        free(pScanner->pEvents);
+        free(pScanner->pDirents);
+
+        pScanner->fanFD    = -1;
+        pScanner->pEvents  = NULL;
+        pScanner->pDirents = NULL;
+    }
+}
+
+static void* workerMain(void *pArg)
+{
+    uint32_t dirIndex;
+    struct timespec idle = { 0, RW_DU_IDLE_NS };
+
+    RW_DuWorker_t *pWorker = (RW_DuWorker_t *)pArg;
+    RW_DuScan_t   *pScan   = pWorker->pScan;
+
+    /* Scans yield disk to every other I/O; failure leaves thread in process class */
+    syscall(SYS_ioprio_set, RW_DU_IOPRIO_WHO_PROCESS, 0, RW_DU_IOPRIO_IDLE);
+
+    pWorker->startNs    = getClockNs(CLOCK_MONOTONIC);
+    pWorker->startCpuNs = getClockNs(CLOCK_THREAD_CPUTIME_ID);
+
+    /* Scan completes once no directory is queued or being listed */
+    while (__atomic_load_n(&pScan->nPending, __ATOMIC_ACQUIRE) > 0)
+    {
+        if ( popDir(pWorker, &dirIndex) ||
+             stealDir(pWorker, &dirIndex) )
+        {
+            if (!scanAborted(pScan)) { scanDirectory(pWorker, dirIndex); }
+
+            __atomic_fetch_sub(&pScan->nPending, 1, __ATOMIC_ACQ_REL);
+
+            paceWorker(pWorker);
+            continue;
+        }
+
+        nanosleep(&idle, NULL);
+    }
+
+    return NULL;
+}
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+RW_DuScanner_t* createDuScanner(const RW_DuScanConfig_t *pConfig)
+{
+    pthread_condattr_t condAttr;
+
+    RW_DuScanner_t *pScanner;
+
+    if ( (pConfig == NULL) ||
+         (pConfig->nRoots == 0) ||
+         (pConfig->nRoots > RW_DU_MAX_ROOTS) ||
+         (pConfig->nThreads == 0) ||
+         (pConfig->nThreads > RW_DU_MAX_THREADS) )
+    {
+        LOG_ERROR("Invalid disk usage scanner configuration %p",
+                  pConfig);
+        return NULL;
+    }
+
+    pScanner = (RW_DuScanner_t *)calloc(1, sizeof(RW_DuScanner_t));
+    if (pScanner == NULL)
+    {
+        LOG_ERROR("Failed to allocate disk usage scanner");
+        return NULL;
+    }
+
+    memcpy(&pScanner->config, pConfig, sizeof(RW_DuScanConfig_t));
+
+    pthread_mutex_init(&pScanner->lock, NULL);
+
+    /* Scan period is waited on monotonic clock */
+    pthread_condattr_init(&condAttr);
+    pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC);
+    pthread_cond_init(&pScanner->stopCond, &condAttr);
+    pthread_condattr_destroy(&condAttr);
+
+    /* Trees not marked for events are rescanned every period */
+    watchRoots(pScanner);
+
+    if (pthread_create(&pScanner->thread, NULL, scanMain, pScanner) != 0)
+    {
+        LOG_ERROR("Failed to create disk usage scan thread [%m]");
+        if (pScanner->fanFD >= 0) { close(pScanner->fanFD); }
+        free(pScanner->pEvents);
+        free(pScanner->pDirents);
+        pthread_cond_destroy(&pScanner->stopCond);
+        pthread_mutex_destroy(&pScanner->lock);
+        free(pScanner);
+        return NULL;
+    }
+
+    return pScanner;
+}
+
+int destroyDuScanner(RW_DuScanner_t *pScanner)
+{
+    uint32_t root;
+
+    if (pScanner == NULL)
+    {
+        LOG_ERROR("Invalid input disk usage scanner %p",
+                  pScanner);
+        return -1;
+    }
+
+    /* Running scan drains its deques without listing */
+    pthread_mutex_lock(&pScanner->lock);
+    __atomic_store_n(&pScanner->stop, 1, __ATOMIC_RELEASE);
+    pthread_cond_signal(&pScanner->stopCond);
+    pthread_mutex_unlock(&pScanner->lock);
+
+    pthread_join(pScanner->thread, NULL);
+
+    for (root = 0; root < pScanner->config.nRoots; root++)
+    {
+        if (pScanner->pIndices[root] != NULL) { destroyIndex(pScanner->pIndices[root]); }
+    }
+
+    if (pScanner->fanFD >= 0) { close(pScanner->fanFD); }
+    free(pScanner->pEvents);
+    free(pScanner->pDirents);
+
+    pthread_cond_destroy(&pScanner->stopCond);
+    pthread_mutex_destroy(&pScanner->lock);
+    free(pScanner);
+
+    return 0;
+}
+
+int getDiskUsageInfo(RW_DuScanner_t *pScanner,
+                     uint16_t        rootIndex,
+                     uint16_t        maxDepth,
+                     uint16_t        window,
+                     RW_DuInfo_t    *pDuInfo)
+{
+    uint32_t idx, level, rank, minute, nRanked = 0;
+    uint32_t ranked[RW_DU_INFO_MAX_ENTRIES];
+    int64_t values[RW_DU_INFO_MAX_ENTRIES], growth;
+    size_t length;
+    char path[PATH_MAX];
+    const char *pPath;
+
+    const RW_DuIndex_t  *pIndex;
+    const RW_DuDir_t    *pDir;
+    const RW_DuGrowth_t   *pGrowth;
+    const RW_DuSizeRank_t *pRank;
+    RW_DuEntry_t          *pEntry;
+
+    if ( (pScanner == NULL) ||
+         (pDuInfo  == NULL) )
+    {
+        LOG_ERROR("Invalid input arguments (%p, %p)",
+                  pScanner, pDuInfo);
+        return -1;
+    }
+
+    memset(pDuInfo, 0x00, sizeof(RW_DuInfo_t));
+
+    if (window > RW_DU_GROWTH_MINUTES) { window = RW_DU_GROWTH_MINUTES; }
+
+    pDuInfo->rootIndex = rootIndex;
+    pDuInfo->nRoots    = (uint16_t)pScanner->config.nRoots;
+    pDuInfo->maxDepth  = maxDepth;
+    pDuInfo->window    = window;
+
+    /* Unknown root is answered with number of roots only */
+    if (rootIndex >= pScanner->config.nRoots) { return 0; }
+
+    snprintf(pDuInfo->rootPath, RW_DU_PATH_SZ, "%s", pScanner->config.pRoots[rootIndex]);
+
+    pthread_mutex_lock(&pScanner->lock);
+
+    /* No completed scan yet, scan time stays 0 */
+    pIndex = pScanner->pIndices[rootIndex];
+    if (pIndex == NULL)
+    {
+        pthread_mutex_unlock(&pScanner->lock);
+        return 0;
+    }
+
+    pDir = getDir(pIndex, 0);
+
+    pDuInfo->tracking     = (uint16_t)(pScanner->roots[rootIndex].watched && !pScanner->roots[rootIndex].rescan);
+    pDuInfo->scanTime     = pIndex->scanTime;
+    pDuInfo->scanDuration = pIndex->scanDuration;
+    pDuInfo->totalBytes   = pDir->bytes;
+    pDuInfo->nDirs        = pIndex->nDirs;
+    pDuInfo->nFiles       = pDir->nFiles;
+    pDuInfo->nHardlinks   = pIndex->nHardlinks;
+    pDuInfo->nErrors      = pIndex->nErrors;
+    pDuInfo->nUpdates     = pIndex->nUpdates;
+
+    if (window == 0)
+    {
+        /* Largest subtrees of depths within limit are merged, cost does not grow with tree */
+        for (level = 1; (pIndex->pSizeRanks != NULL) && (level < pIndex->nRankLevels); level++)
+        {
+            if ( (maxDepth > 0) && (level > maxDepth) ) { break; }
+
+            pRank = &pIndex->pSizeRanks[level];
+
+            for (rank = 0; rank < pRank->nRanked; rank++)
+            {
+                idx  = pRank->dirs[rank];
+                pDir = getDir(pIndex, idx);
+
+                /* Ranking may predate latest events, current size, depth and removal are checked */
+                if ( ( (maxDepth > 0) && (pDir->depth > maxDepth) ) ||
+                     ( (nRanked == RW_DU_INFO_MAX_ENTRIES) && ((int64_t)pDir->bytes <= values[nRanked - 1]) ) ||
+                     !isDirLive(pIndex, idx) )
+                {
+                    continue;
+                }
+
+                insertRanked(ranked, values, &nRanked, idx, (int64_t)pDir->bytes);
+            }
+        }
+    }
+    else
+    {
+        /* Only directories changed within longest window are ranked, cost does not grow with tree */
+        minute = getMinute();
+
+        for (idx = 0; idx < pIndex->nGrowth; idx++)
+        {
+            pGrowth = &pIndex->pGrowth[idx];
+            pDir    = getDir(pIndex, pGrowth->dirIndex);
+
+            if ( (pGrowth->dirIndex == 0) ||
+                 ( (maxDepth > 0) && (pDir->depth > maxDepth) ) )
+            {
+                continue;
+            }
+
+            growth = getGrowth(pGrowth, window, minute);
+
+            if ( (growth <= 0) ||
+                 ( (nRanked == RW_DU_INFO_MAX_ENTRIES) && (growth <= values[nRanked - 1]) ) ||
+                 !isDirLive(pIndex, pGrowth->dirIndex) )
+            {
+                continue;
+            }
+
+            insertRanked(ranked, values, &nRanked, pGrowth->dirIndex, growth);
+        }
+    }
+
+    for (rank = 0; rank < nRanked; rank++)
+    {
+        pDir   = getDir(pIndex, ranked[rank]);
+        pEntry = &pDuInfo->entries[rank];
+
+        pEntry->bytes  = pDir->bytes;
+        pEntry->nFiles = pDir->nFiles;
+        pEntry->growth = (window > 0) ? values[rank] : 0;
+        pEntry->depth  = pDir->depth;
+
+        pPath = buildDirPath(pIndex, pScanner->config.pRoots[rootIndex], ranked[rank], path, sizeof(path));
+        if (pPath == NULL) { pPath = "..."; }
+
+        /* Deepest components are kept of paths too long for reply */
+        length = strlen(pPath);
+        if (length < RW_DU_PATH_SZ)
+        {
+            memcpy(pEntry->path, pPath, length + 1);
+        }
+        else
+        {
+            snprintf(pEntry->path, RW_DU_PATH_SZ, "...%s", (pPath + length - (RW_DU_PATH_SZ - 4)));
+        }
+    }
+
+    pDuInfo->nEntries = (uint16_t)nRanked;
+
+    pthread_mutex_unlock(&pScanner->lock);
+
+    return 0;
+}
@@ -0,0 +1,436 @@
+/**
+ * @file    rw_frag_info.c
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Memory fragmentation collector for resource watcher. Free
+ * block counts per order (buddyinfo) give per-zone fragmentation and
+ * unusable free space indices (same formulas as kernel extfrag
+ * debugfs files) and blocks allocatable per order; pageblock migrate
+ * types come from pagetypeinfo and compaction counters from vmstat.
+ * Files are opened once and read with pread on every collection;
+ * collector state is read only after creation, so workers collect
+ * concurrently.
+ */
+
+
+// Library Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+
+// Module Includes
+#include "rw_frag_info.h"
+#include "com_chan_log.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define RW_FRAG_BUDDYINFO       "/proc/buddyinfo"
+#define RW_FRAG_PAGETYPEINFO    "/proc/pagetypeinfo"
+#define RW_FRAG_VMSTAT          "/proc/vmstat"
+
+#define RW_FRAG_FILE_SZ         65536       // Bytes read per file (pagetypeinfo grows ~1.5 KB per node)
+#define RW_FRAG_INDEX_SCALE     1000        // Indices are scaled like kernel extfrag indices
+#define RW_FRAG_SUCCEEDS        -1000       // Fragmentation index of order allocatable from free lists
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+struct RW_FragCollector_s
+{
+    int                     buddyinfoFD;        ///< Persistent buddyinfo descriptor
+    int                     pagetypeinfoFD;     ///< Persistent pagetypeinfo descriptor, -1 if unreadable
+    int                     vmstatFD;           ///< Persistent vmstat descriptor
+};
+
+
+//*************************************
+// Module Utility Functions
+//*************************************
+static void computeZoneIndices(RW_FragZone_t *pZone);
+static RW_FragZone_t* findZone(RW_FragInfo_t *pFragInfo, uint16_t nodeID, const char *pZoneName);
+static int parseBuddyinfo(const char *pBuf, uint16_t firstZone, RW_FragInfo_t *pFragInfo);
+static const char* parseZoneHeader(const char *pLine, uint16_t *pNodeID, char *pZoneName);
+static void parsePagetypeinfo(const char *pBuf, RW_FragInfo_t *pFragInfo);
+static void parseVmstat(const char *pBuf, RW_FragInfo_t *pFragInfo);
+static int readProcFile(int fd, char *pBuf);
+
+
+static void computeZoneIndices(RW_FragZone_t *pZone)
+{
+    uint16_t order;
+    uint16_t higher;
+    uint64_t totalBlocks = 0;
+    uint64_t suitable;
+
+    for (order = 0; order < pZone->nOrders; order++)
+    {
+        totalBlocks      += pZone->freeBlocks[order];
+        pZone->freePages += pZone->freeBlocks[order] << order;
+    }
+
+    for (order = 0; order < pZone->nOrders; order++)
+    {
+        /* Blocks of this order carved from free blocks of this order and above */
+        suitable = 0;
+        for (higher = order; higher < pZone->nOrders; higher++)
+        {
+            suitable += pZone->freeBlocks[higher] << (higher - order);
+        }
+
+        pZone->allocatable[order] = suitable;
+
+        /* Towards 0 allocation fails on low memory, towards 1000 on fragmentation */
+        if (totalBlocks == 0)
+        {
+            pZone->fragIndex[order] = 0;
+        }
+        else if (suitable > 0)
+        {
+            pZone->fragIndex[order] = RW_FRAG_SUCCEEDS;
+        }
+        else
+        {
+            pZone->fragIndex[order] = (int16_t)(RW_FRAG_INDEX_SCALE -
+                                                ((RW_FRAG_INDEX_SCALE + ((pZone->freePages * RW_FRAG_INDEX_SCALE) >> order)) / totalBlocks));
+        }
+
+        /* Share of free pages in blocks too small for order */
+        if (pZone->freePages == 0)
+        {
+            pZone->unusableIndex[order] = RW_FRAG_INDEX_SCALE;
+        }
+        else
+        {
+            pZone->unusableIndex[order] = (uint16_t)(((pZone->freePages - (suitable << order)) * RW_FRAG_INDEX_SCALE) / pZone->freePages);
+        }
+    }
+}
+
+static RW_FragZone_t* findZone(RW_FragInfo_t *pFragInfo, uint16_t nodeID, const char *pZoneName)
+{
+    uint16_t idx;
+
+    for (idx = 0; idx < pFragInfo->nEntries; idx++)
+    {
+        if ( (pFragInfo->zones[idx].nodeID == nodeID) &&
+             (strcmp(pFragInfo->zones[idx].zoneName, pZoneName) == 0) )
+        {
+            return &pFragInfo->zones[idx];
+        }
+    }
+
+    return NULL;
+}
+
+static int parseBuddyinfo(const char *pBuf, uint16_t firstZone, RW_FragInfo_t *pFragInfo)
+{
+    const char *pCur = pBuf;
+    const char *pCounts;
+    char *pEnd;
+    uint16_t nodeID;
+    uint64_t value;
+    char zoneName[RW_FRAG_ZONE_NAME_SZ];
+
+    RW_FragZone_t *pZone;
+
+    /* Lines read "Node N, zone   Name  count0 count1 ... countN", node and zone ordered */
+    while (*pCur != '\0')
+    {
+        pCounts = parseZoneHeader(pCur, &nodeID, zoneName);
+        if (pCounts == NULL) { break; }
+
+        /* Populate requested window of zones */
+        if ( (pFragInfo->nZones >= firstZone) &&
+             (pFragInfo->nEntries < RW_FRAG_INFO_MAX_ZONES) )
+        {
+            pZone = &pFragInfo->zones[pFragInfo->nEntries];
+
+            pZone->nodeID = nodeID;
+            memcpy(pZone->zoneName, zoneName, RW_FRAG_ZONE_NAME_SZ);
+
+            for (;;)
+            {
+                value = strtoull(pCounts, &pEnd, 10);
+                if (pEnd == pCounts) { break; }
+                pCounts = pEnd;
+
+                /* Orders above reported range (larger page size kernels) are not carried */
+                if (pZone->nOrders == RW_FRAG_MAX_ORDERS) { continue; }
+
+                pZone->freeBlocks[pZone->nOrders] = value;
+                pZone->nOrders++;
+            }
+
+            computeZoneIndices(pZone);
+            pFragInfo->nEntries++;
+        }
+
+        pFragInfo->nZones++;
+
+        /* Move to next line */
+        pCur = strchr(pCounts, '\n');
+        if (pCur == NULL) { break; }
+        pCur++;
+    }
+
+    return (pFragInfo->nZones > 0) ? 0 : -1;
+}
+
+static const char* parseZoneHeader(const char *pLine, uint16_t *pNodeID, char *pZoneName)
+{
+    int nParsed = 0;
+
+    /* "Node N, zone Name", zone names are short kernel identifiers */
+    if (sscanf(pLine, "Node %hu, zone %7s%n", pNodeID, pZoneName, &nParsed) != 2) { return NULL; }
+    if (nParsed == 0) { return NULL; }
+
+    return pLine + nParsed;
+}
+
+static void parsePagetypeinfo(const char *pBuf, RW_FragInfo_t *pFragInfo)
+{
+    const char *pCur;
+    const char *pEnd;
+    uint16_t nodeID;
+    uint32_t column;
+    uint32_t value;
+    char typeName[16];
+    char zoneName[RW_FRAG_ZONE_NAME_SZ];
+    int nParsed;
+    int unmovableCol   = -1;
+    int movableCol     = -1;
+    int reclaimableCol = -1;
+
+    RW_FragZone_t *pZone;
+
+    pCur = strstr(pBuf, "Page block order:");
+    if (pCur != NULL)
+    {
+        pFragInfo->pageblockOrder = (uint16_t)strtoul(pCur + strlen("Page block order:"), NULL, 10);
+    }
+
+    /* Block counts section header names migrate types, column set differs by kernel config */
+    pCur = strstr(pBuf, "Number of blocks type");
+    if (pCur == NULL) { return; }
+
+    pCur += strlen("Number of blocks type");
+    pEnd  = strchr(pCur, '\n');
+    if (pEnd == NULL) { return; }
+
+    for (column = 0; pCur < pEnd; column++)
+    {
+        if (sscanf(pCur, "%15s%n", typeName, &nParsed) != 1) { break; }
+        pCur += nParsed;
+        if (pCur > pEnd) { break; }
+
+        if      (strcmp(typeName, "Unmovable")   == 0) { unmovableCol   = (int)column; }
+        else if (strcmp(typeName, "Movable")     == 0) { movableCol     = (int)column; }
+        else if (strcmp(typeName, "Reclaimable") == 0) { reclaimableCol = (int)column; }
+    }
+
+    /* Lines read "Node N, zone   Name  count0 ... countT" */
+    pCur = pEnd + 1;
+    while (*pCur != '\0')
+    {
+        pEnd = parseZoneHeader(pCur, &nodeID, zoneName);
+        if (pEnd == NULL) { break; }
+
+        pZone = findZone(pFragInfo, nodeID, zoneName);
+
+        for (column = 0; ; column++)
+        {
+            value = (uint32_t)strtoul(pEnd, (char **)&pCur, 10);
+            if (pCur == pEnd) { break; }
+            pEnd = pCur;
+
+            if (pZone == NULL) { continue; }
+
+            if      ((int)column == unmovableCol)   { pZone->unmovableBlocks   = value; }
+            else if ((int)column == movableCol)     { pZone->movableBlocks     = value; }
+            else if ((int)column == reclaimableCol) { pZone->reclaimableBlocks = value; }
+        }
+
+        /* Move to next line */
+        pCur = strchr(pEnd, '\n');
+        if (pCur == NULL) { break; }
+        pCur++;
+    }
+}
+
+static void parseVmstat(const char *pBuf, RW_FragInfo_t *pFragInfo)
+{
+    const char *pCur = pBuf;
+    const char *pValue;
+    uint64_t value;
+
+    /* Lines read "key value" */
+    while (*pCur != '\0')
+    {
+        pValue = strchr(pCur, ' ');
+        if (pValue == NULL) { break; }
+
+        /* Only compaction and huge page fault counters are collected */
+        if ( (pCur[0] == 'c') ||
+             (pCur[0] == 't') )
+        {
+            value = strtoull(pValue, NULL, 10);
+
+            if      (strncmp(pCur, "compact_stall ",          14) == 0) { pFragInfo->compactStall          = value; }
+            else if (strncmp(pCur, "compact_fail ",           13) == 0) { pFragInfo->compactFail           = value; }
+            else if (strncmp(pCur, "compact_success ",        16) == 0) { pFragInfo->compactSuccess        = value; }
+            else if (strncmp(pCur, "compact_migrate_scanned ", 24) == 0) { pFragInfo->compactMigrateScanned = value; }
+            else if (strncmp(pCur, "compact_free_scanned ",   21) == 0) { pFragInfo->compactFreeScanned    = value; }
+            else if (strncmp(pCur, "compact_daemon_wake ",    20) == 0) { pFragInfo->compactDaemonWake     = value; }
+            else if (strncmp(pCur, "thp_fault_alloc ",        16) == 0) { pFragInfo->thpFaultAlloc         = value; }
+            else if (strncmp(pCur, "thp_fault_fallback ",     19) == 0) { pFragInfo->thpFaultFallback      = value; }
+        }
+
+        /* Move to next line */
+        pCur = strchr(pValue, '\n');
+        if (pCur == NULL) { break; }
+        pCur++;
+    }
+}
+
+static int readProcFile(int fd, char *pBuf)
+{
+    ssize_t nBytes;
+    size_t  total = 0;
+
+    /* Read whole file from offset 0, descriptor remains open; proc files are served in pages */
+    while (total < (RW_FRAG_FILE_SZ - 1))
+    {
+        nBytes = pread(fd, (pBuf + total), (RW_FRAG_FILE_SZ - 1 - total), (off_t)total);
+        if (nBytes < 0)  { return -1; }
+        if (nBytes == 0) { break; }
+
+        total += (size_t)nBytes;
+    }
+
+    pBuf[total] = '\0';
+
+    return 0;
+}
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+RW_FragCollector_t* createFragCollector(void)
+{
+    RW_FragCollector_t *pCollector;
+
+    pCollector = (RW_FragCollector_t *)calloc(1, sizeof(RW_FragCollector_t));
+    if (pCollector == NULL)
+    {
+        LOG_ERROR("Failed to allocate fragmentation collector");
+        return NULL;
+    }
+
+    pCollector->buddyinfoFD = open(RW_FRAG_BUDDYINFO, O_RDONLY | O_CLOEXEC);
+    if (pCollector->buddyinfoFD < 0)
+    {
+        LOG_ERROR("Failed to open %s [%m]",
+                  RW_FRAG_BUDDYINFO);
+        free(pCollector);
+        return NULL;
+    }
+
+    pCollector->vmstatFD = open(RW_FRAG_VMSTAT, O_RDONLY | O_CLOEXEC);
+    if (pCollector->vmstatFD < 0)
+    {
+        LOG_ERROR("Failed to open %s [%m]",
+                  RW_FRAG_VMSTAT);
+        close(pCollector->buddyinfoFD);
+        free(pCollector);
+        return NULL;
+    }
+
+    /* pagetypeinfo is root only, pageblock counts stay zero without it */
+    pCollector->pagetypeinfoFD = open(RW_FRAG_PAGETYPEINFO, O_RDONLY | O_CLOEXEC);
+    if (pCollector->pagetypeinfoFD < 0)
+    {
+        LOG_WARNING("Pageblock migrate types are not collected, failed to open %s [%m]",
+                    RW_FRAG_PAGETYPEINFO);
+    }
+
+    return pCollector;
+}
+
+int destroyFragCollector(RW_FragCollector_t *pCollector)
+{
+    if (pCollector == NULL)
+    {
+        LOG_ERROR("Invalid input fragmentation collector %p",
+                  pCollector);
+        return -1;
+    }
+
+    close(pCollector->buddyinfoFD);
+    close(pCollector->vmstatFD);
+    if (pCollector->pagetypeinfoFD >= 0) { close(pCollector->pagetypeinfoFD); }
+
+    free(pCollector);
+
+    return 0;
+}
+
+int getFragmentationInfo(const RW_FragCollector_t *pCollector,
+                         uint16_t                  firstZone,
+                         RW_FragInfo_t            *pFragInfo)
+{
+    char *pBuf;
+
+    if ( (pCollector == NULL) ||
+         (pFragInfo  == NULL) )
+    {
+        LOG_ERROR("Invalid input arguments (%p, %p)",
+                  pCollector, pFragInfo);
+        return -1;
+    }
+
+    /* pagetypeinfo outgrows a stack buffer on many node hosts */
+    pBuf = (char *)malloc(RW_FRAG_FILE_SZ);
+    if (pBuf == NULL)
+    {
+        LOG_ERROR("Failed to allocate fragmentation read buffer");
+        return -1;
+    }
+
+    memset(pFragInfo, 0x00, sizeof(RW_FragInfo_t));
+
+    pFragInfo->firstZone = firstZone;
+
+    if ( (readProcFile(pCollector->buddyinfoFD, pBuf) < 0) ||
+         (parseBuddyinfo(pBuf, firstZone, pFragInfo) < 0) )
+    {
+        LOG_ERROR("Failed to collect free blocks from %s [%m]",
+                  RW_FRAG_BUDDYINFO);
+        free(pBuf);
+        return -1;
+    }
+
+    /* Pageblock counts walk every pageblock in kernel, only the window is matched */
+    if ( (pCollector->pagetypeinfoFD >= 0) &&
+         (readProcFile(pCollector->pagetypeinfoFD, pBuf) == 0) )
+    {
+        parsePagetypeinfo(pBuf, pFragInfo);
+    }
+
+    if (readProcFile(pCollector->vmstatFD, pBuf) == 0)
+    {
+        parseVmstat(pBuf, pFragInfo);
+    }
+
+    free(pBuf);
+
+    return 0;
+}
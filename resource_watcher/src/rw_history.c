@@ -0,0 +1,272 @@
+/**
+ * @file    rw_history.c
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Fixed-memory multi-resolution metric history with
+ * incremental min/max/avg rollups for resource watcher.
+ *
+ * Every resolution is a ring of buckets indexed by
+ * (timestamp / step) % capacity; a bucket is recycled when a
+ * sample for a newer interval maps onto it. Each sample updates
+ * the current bucket of every resolution, so rollups never need
+ * a separate aggregation pass.
+ */
+
+
+// Library Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+// Module Includes
+#include "rw_history.h"
+#include "com_chan_log.h"
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+typedef struct RW_HistoryRing_s
+{
+    uint32_t                step;               ///< Seconds per bucket
+    uint32_t                capacity;           ///< Number of buckets
+
+    int64_t                *pBucketTime;        ///< Bucket start time (-1 if unused)
+
+    int64_t                *pMin[RW_METRIC_MAX];///< Per-metric bucket minimum
+    int64_t                *pMax[RW_METRIC_MAX];///< Per-metric bucket maximum
+    int64_t                *pSum[RW_METRIC_MAX];///< Per-metric bucket sum
+    uint32_t               *pCount;             ///< Samples in bucket (shared by metrics)
+} RW_HistoryRing_t;
+
+struct RW_History_s
+{
+    RW_HistoryRing_t        rings[RW_HISTORY_RES_MAX]; ///< One ring per resolution
+
+    int64_t                 latestTime;         ///< Timestamp of newest sample
+
+    void                   *pArena;             ///< Single allocation for all rings
+};
+
+
+//*************************************
+// Module Local Variables
+//*************************************
+static const struct
+{
+    uint32_t step;
+    uint32_t capacity;
+} RW_HISTORY_LAYOUT[RW_HISTORY_RES_MAX] =
+{
+    [RW_HISTORY_RES_1S]  = {  1,   600 },       // 10 minutes
+    [RW_HISTORY_RES_10S] = { 10,  2160 },       // 6 hours
+    [RW_HISTORY_RES_1M]  = { 60, 10080 },       // 7 days
+};
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+RW_History_t* createHistory(void)
+{
+    int res, metric;
+    size_t arenaSz = 0;
+    uint8_t *pArena;
+
+    RW_History_t *pHistory;
+
+    pHistory = (RW_History_t *)calloc(1, sizeof(RW_History_t));
+    if (pHistory == NULL)
+    {
+        LOG_ERROR("Failed to allocate history");
+        return NULL;
+    }
+
+    /* Compute memory for all rings, allocated once for daemon lifetime */
+    for (res = 0; res < RW_HISTORY_RES_MAX; res++)
+    {
+        uint32_t capacity = RW_HISTORY_LAYOUT[res].capacity;
+
+        arenaSz += capacity * sizeof(int64_t);                      // Bucket time
+        arenaSz += capacity * sizeof(int64_t) * 3 * RW_METRIC_MAX;  // Min, max, sum
+        arenaSz += capacity * sizeof(uint32_t);                     // Count
+    }
+
+    pArena = (uint8_t *)calloc(1, arenaSz);
+    if (pArena == NULL)
+    {
+        LOG_ERROR("Failed to allocate history rings (%zu bytes)",
+                  arenaSz);
+        free(pHistory);
+        return NULL;
+    }
+
+    pHistory->pArena = pArena;
+
+    for (res = 0; res < RW_HISTORY_RES_MAX; res++)
+    {
+        RW_HistoryRing_t *pRing = &pHistory->rings[res];
+        size_t valuesSz;
+
+        pRing->step     = RW_HISTORY_LAYOUT[res].step;
+        pRing->capacity = RW_HISTORY_LAYOUT[res].capacity;
+
+        valuesSz = pRing->capacity * sizeof(int64_t);
+
+        pRing->pBucketTime = (int64_t *)pArena; pArena += valuesSz;
+
+        for (metric = 0; metric < RW_METRIC_MAX; metric++)
+        {
+            pRing->pMin[metric] = (int64_t *)pArena; pArena += valuesSz;
+            pRing->pMax[metric] = (int64_t *)pArena; pArena += valuesSz;
+            pRing->pSum[metric] = (int64_t *)pArena; pArena += valuesSz;
+        }
+
+        pRing->pCount = (uint32_t *)pArena; pArena += (pRing->capacity * sizeof(uint32_t));
+
+        /* Mark all buckets unused */
+        memset(pRing->pBucketTime, 0xFF, valuesSz);
+    }
+
+    return pHistory;
+}
+
+int destroyHistory(RW_History_t *pHistory)
+{
+    if (pHistory == NULL)
+    {
+        LOG_ERROR("Invalid input history %p",
+                  pHistory);
+        return -1;
+    }
+
+    free(pHistory->pArena);
+    free(pHistory);
+
+    return 0;
+}
+
+int insertHistorySample(RW_History_t  *pHistory,
+                        int64_t        timestamp,
+                        const int64_t  values[RW_METRIC_MAX])
+{
+    int res, metric;
+
+    if ( (pHistory == NULL) ||
+         (values   == NULL) ||
+         (timestamp < 0) )
+    {
+        LOG_ERROR("Invalid input arguments (%p, %p, %ld)",
+                  pHistory, values, timestamp);
+        return -1;
+    }
+
+    if (timestamp > pHistory->latestTime) { pHistory->latestTime = timestamp; }
+
+    for (res = 0; res < RW_HISTORY_RES_MAX; res++)
+    {
+        RW_HistoryRing_t *pRing = &pHistory->rings[res];
+
+        int64_t  bucketTime = timestamp - (timestamp % pRing->step);
+        uint32_t idx        = (uint32_t)((bucketTime / pRing->step) % pRing->capacity);
+
+        if (pRing->pBucketTime[idx] != bucketTime)
+        {
+            /* Recycle oldest bucket for new interval */
+            pRing->pBucketTime[idx] = bucketTime;
+            pRing->pCount[idx]      = 1;
+
+            for (metric = 0; metric < RW_METRIC_MAX; metric++)
+            {
+                pRing->pMin[metric][idx] = values[metric];
+                pRing->pMax[metric][idx] = values[metric];
+                pRing->pSum[metric][idx] = values[metric];
+            }
+        }
+        else
+        {
+            /* Roll sample into current bucket */
+            pRing->pCount[idx]++;
+
+            for (metric = 0; metric < RW_METRIC_MAX; metric++)
+            {
+                if (values[metric] < pRing->pMin[metric][idx]) { pRing->pMin[metric][idx] = values[metric]; }
+                if (values[metric] > pRing->pMax[metric][idx]) { pRing->pMax[metric][idx] = values[metric]; }
+
+                pRing->pSum[metric][idx] += values[metric];
+            }
+        }
+    }
+
+    return 0;
+}
+
+int queryHistory(const RW_History_t *pHistory,
+                 RW_HistoryInfo_t   *pHistoryInfo)
+{
+    uint32_t point, nPoints;
+    int64_t  startTime, bucketTime;
+
+    const RW_HistoryRing_t *pRing;
+
+    if ( (pHistory     == NULL) ||
+         (pHistoryInfo == NULL) )
+    {
+        LOG_ERROR("Invalid input arguments (%p, %p)",
+                  pHistory, pHistoryInfo);
+        return -1;
+    }
+
+    if ( (pHistoryInfo->metricID   >= RW_METRIC_MAX) ||
+         (pHistoryInfo->resolution >= RW_HISTORY_RES_MAX) )
+    {
+        LOG_ERROR("Invalid history query (metric %u, resolution %u)",
+                  pHistoryInfo->metricID, pHistoryInfo->resolution);
+        return -1;
+    }
+
+    pRing = &pHistory->rings[pHistoryInfo->resolution];
+
+    nPoints = pHistoryInfo->nPoints;
+    if ( (nPoints == 0) || (nPoints > RW_HISTORY_MAX_POINTS) ) { nPoints = RW_HISTORY_MAX_POINTS; }
+
+    startTime = pHistoryInfo->startTime;
+    if (startTime <= 0)
+    {
+        /* Latest window, ending at bucket of newest sample */
+        startTime  = pHistory->latestTime - (pHistory->latestTime % pRing->step);
+        startTime -= (int64_t)(nPoints - 1) * pRing->step;
+        if (startTime < 0) { startTime = 0; }
+    }
+
+    /* Align window start to bucket boundary */
+    startTime -= (startTime % pRing->step);
+
+    pHistoryInfo->startTime = startTime;
+    pHistoryInfo->step      = pRing->step;
+    pHistoryInfo->nPoints   = (uint16_t)nPoints;
+    pHistoryInfo->validMask = 0;
+
+    memset(pHistoryInfo->points, 0x00, sizeof(pHistoryInfo->points));
+
+    for (point = 0; point < nPoints; point++)
+    {
+        uint32_t idx;
+
+        bucketTime = startTime + ((int64_t)point * pRing->step);
+        idx        = (uint32_t)((bucketTime / pRing->step) % pRing->capacity);
+
+        /* Bucket missing (gap) or already recycled for a newer interval */
+        if (pRing->pBucketTime[idx] != bucketTime) { continue; }
+
+        pHistoryInfo->points[point].min = pRing->pMin[pHistoryInfo->metricID][idx];
+        pHistoryInfo->points[point].max = pRing->pMax[pHistoryInfo->metricID][idx];
+        pHistoryInfo->points[point].avg = pRing->pSum[pHistoryInfo->metricID][idx] / (int64_t)pRing->pCount[idx];
+
+        pHistoryInfo->validMask |= (1ULL << point);
+    }
+
+    return 0;
+}
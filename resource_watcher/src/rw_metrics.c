@@ -0,0 +1,626 @@
+/**
+ * @file    rw_metrics.c
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Prometheus text exposition of latest resource sample;
+ * complete HTTP response is rendered into a back buffer on every
+ * sample and swapped in, scrapes are served from front buffer by
+ * a dedicated thread.
+ */
+
+
+// Library Includes
+#define _GNU_SOURCE                         // accept4(), strcasestr()
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <sys/types.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#include <netinet/in.h>
+
+// Module Includes
+#include "rw_metrics.h"
+#include "com_chan_log.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define RW_METRICS_HEADER_SZ    256         // Bytes reserved ahead of body for response head
+#define RW_METRICS_MAX_EVENTS   16
+#define RW_METRICS_STAGE_FIRST  10          // Smallest exposed stage bucket bound (2^N ns)
+#define RW_METRICS_STAGE_STEP   2           // Exposed stage bucket bounds grow by 2^N
+
+#define RW_METRICS_RESPONSE_404 "HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\nContent-Length: 10\r\n\r\nNot Found\n"
+#define RW_METRICS_RESPONSE_503 "HTTP/1.1 503 Service Unavailable\r\nContent-Type: text/plain\r\nContent-Length: 10\r\n\r\nNo sample\n"
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+typedef struct RW_MetricsClient_s
+{
+    int                     fd;                 ///< Connection socket, -1 if slot is free
+    uint32_t                reqLen;             ///< Request bytes received
+    char                    request[RW_METRICS_REQUEST_SZ]; ///< Request head
+} RW_MetricsClient_t;
+
+struct RW_MetricsServer_s
+{
+    int                     listenFD;           ///< Exposition listening socket
+    int                     stopFD;             ///< Server thread stop event
+    int                     epollFD;            ///< Server thread event polling
+    pthread_t               thread;             ///< Server thread
+
+    pthread_mutex_t         lock;               ///< Guards front buffer swap and scrape counter
+    char                   *pFront;             ///< Response served to scrapes
+    char                   *pBack;              ///< Response being rendered
+    uint32_t                bufferSz;           ///< Bytes per response buffer
+    uint32_t                frontOffset;        ///< Response start in front buffer
+    uint32_t                frontLen;           ///< Response length, 0 until first sample
+    uint64_t                nScrapes;           ///< Scrapes served
+
+    RW_MetricsClient_t      clients[RW_METRICS_CLIENTS_MAX]; ///< Scrape connections
+};
+
+
+//*************************************
+// Module Utility Functions
+//*************************************
+static int appendMetrics(char *pBuf, uint32_t bufferSz, uint32_t *pLen, const char *pFormat, ...) __attribute__((format(printf, 4, 5)));
+static void acceptMetricsClients(RW_MetricsServer_t *pServer);
+static void closeMetricsClient(RW_MetricsServer_t *pServer, RW_MetricsClient_t *pClient);
+static int renderCpuUtil(char *pBuf, uint32_t bufferSz, uint32_t *pLen, const char *pCpu, const RW_CpuUtil_t *pCpuUtil);
+static int renderLatencyHist(char                      *pBuf,
+                             uint32_t                   bufferSz,
+                             uint32_t                  *pLen,
+                             const char                *pMetric,
+                             const char                *pLabel,
+                             const char                *pValue,
+                             const ComChan_StageHist_t *pHist);
+static void serveMetricsClient(RW_MetricsServer_t *pServer, RW_MetricsClient_t *pClient);
+static void* serverMain(void *pArg);
+
+
+static int appendMetrics(char *pBuf, uint32_t bufferSz, uint32_t *pLen, const char *pFormat, ...)
+{
+    int nBytes;
+    va_list args;
+
+    va_start(args, pFormat);
+    nBytes = vsnprintf((pBuf + *pLen), (bufferSz - *pLen), pFormat, args);
+    va_end(args);
+
+    if ( (nBytes < 0) ||
+         ((uint32_t)nBytes >= (bufferSz - *pLen)) )
+    {
+        return -1;
+    }
+
+    *pLen += (uint32_t)nBytes;
+
+    return 0;
+}
+
+static void acceptMetricsClients(RW_MetricsServer_t *pServer)
+{
+    int fd;
+    uint32_t slot;
+
+    struct epoll_event epollEvent;
+
+    /* Accept every pending connection, listening socket is non-blocking */
+    while ((fd = accept4(pServer->listenFD, NULL, NULL, (SOCK_NONBLOCK | SOCK_CLOEXEC))) >= 0)
+    {
+        for (slot = 0; slot < RW_METRICS_CLIENTS_MAX; slot++)
+        {
+            if (pServer->clients[slot].fd < 0) { break; }
+        }
+
+        memset(&epollEvent, 0x00, sizeof(struct epoll_event));
+        epollEvent.events   = EPOLLIN;
+        epollEvent.data.ptr = &pServer->clients[slot];
+
+        if ( (slot == RW_METRICS_CLIENTS_MAX) ||
+             (epoll_ctl(pServer->epollFD, EPOLL_CTL_ADD, fd, &epollEvent) < 0) )
+        {
+            close(fd);
+            continue;
+        }
+
+        pServer->clients[slot].fd     = fd;
+        pServer->clients[slot].reqLen = 0;
+    }
+}
+
+static void closeMetricsClient(RW_MetricsServer_t *pServer, RW_MetricsClient_t *pClient)
+{
+    epoll_ctl(pServer->epollFD, EPOLL_CTL_DEL, pClient->fd, NULL);
+    close(pClient->fd);
+
+    pClient->fd     = -1;
+    pClient->reqLen = 0;
+}
+
+static int renderCpuUtil(char *pBuf, uint32_t bufferSz, uint32_t *pLen, const char *pCpu, const RW_CpuUtil_t *pCpuUtil)
+{
+    /* Utilisation is carried in 1/100th of percent, exposed as ratio */
+    return appendMetrics(pBuf, bufferSz, pLen,
+                         "rw_cpu_utilisation_ratio{cpu=\"%s\",mode=\"user\"} %u.%04u\n"
+                         "rw_cpu_utilisation_ratio{cpu=\"%s\",mode=\"system\"} %u.%04u\n"
+                         "rw_cpu_utilisation_ratio{cpu=\"%s\",mode=\"iowait\"} %u.%04u\n"
+                         "rw_cpu_utilisation_ratio{cpu=\"%s\",mode=\"steal\"} %u.%04u\n",
+                         pCpu, (pCpuUtil->user   / 10000), (pCpuUtil->user   % 10000),
+                         pCpu, (pCpuUtil->system / 10000), (pCpuUtil->system % 10000),
+                         pCpu, (pCpuUtil->iowait / 10000), (pCpuUtil->iowait % 10000),
+                         pCpu, (pCpuUtil->steal  / 10000), (pCpuUtil->steal  % 10000));
+}
+
+static int renderLatencyHist(char                      *pBuf,
+                             uint32_t                   bufferSz,
+                             uint32_t                  *pLen,
+                             const char                *pMetric,
+                             const char                *pLabel,
+                             const char                *pValue,
+                             const ComChan_StageHist_t *pHist)
+{
+    int      retVal = 0;
+    uint32_t bucket = 0, bound;
+    uint64_t count = 0;
+
+    /* Log2 buckets are exposed every RW_METRICS_STAGE_STEP bounds, counts are cumulative */
+    for (bound = RW_METRICS_STAGE_FIRST; bound < COM_CHAN_TRACE_BUCKETS; bound += RW_METRICS_STAGE_STEP)
+    {
+        /* Buckets below bound hold latencies under 2^bound ns */
+        for (; bucket < bound; bucket++) { count += pHist->buckets[bucket]; }
+
+        retVal |= appendMetrics(pBuf, bufferSz, pLen,
+                                "%s_bucket{%s=\"%s\",le=\"%g\"} %lu\n",
+                                pMetric, pLabel, pValue, ((double)(1ULL << bound) / 1e9), count);
+    }
+
+    retVal |= appendMetrics(pBuf, bufferSz, pLen,
+                            "%s_bucket{%s=\"%s\",le=\"+Inf\"} %lu\n"
+                            "%s_sum{%s=\"%s\"} %.9f\n"
+                            "%s_count{%s=\"%s\"} %lu\n",
+                            pMetric, pLabel, pValue, pHist->count,
+                            pMetric, pLabel, pValue, ((double)pHist->sumNs / 1e9),
+                            pMetric, pLabel, pValue, pHist->count);
+
+    return retVal;
+}
+
+static void serveMetricsClient(RW_MetricsServer_t *pServer, RW_MetricsClient_t *pClient)
+{
+    ssize_t nBytes;
+    char *pHeadEnd;
+    uint32_t headLen;
+    unsigned char isClose;
+
+    nBytes = recv(pClient->fd, (pClient->request + pClient->reqLen),
+                  (RW_METRICS_REQUEST_SZ - 1 - pClient->reqLen), 0);
+    if (nBytes <= 0)
+    {
+        if ( (nBytes < 0) && (errno == EAGAIN) ) { return; }
+
+        /* Peer closed connection or failed */
+        closeMetricsClient(pServer, pClient);
+        return;
+    }
+
+    pClient->reqLen += (uint32_t)nBytes;
+    pClient->request[pClient->reqLen] = '\0';
+
+    /* Serve every complete request head, keep-alive connections may pipeline */
+    while ((pHeadEnd = strstr(pClient->request, "\r\n\r\n")) != NULL)
+    {
+        headLen  = (uint32_t)(pHeadEnd - pClient->request) + 4;
+
+        /* Limit header lookups to this request */
+        pHeadEnd[2] = '\0';
+        isClose  = ( (strstr(pClient->request, " HTTP/1.0\r\n") != NULL) ||
+                     (strcasestr(pClient->request, "\r\nConnection: close") != NULL) ) ? 0x01 : 0x00;
+
+        if ( (strncmp(pClient->request, "GET /metrics", 12) != 0) ||
+             ( (pClient->request[12] != ' ') && (pClient->request[12] != '?') ) )
+        {
+            nBytes = send(pClient->fd, RW_METRICS_RESPONSE_404, strlen(RW_METRICS_RESPONSE_404), MSG_NOSIGNAL);
+            nBytes = (nBytes == (ssize_t)strlen(RW_METRICS_RESPONSE_404)) ? 0 : -1;
+        }
+        else
+        {
+            /* Pre-rendered response fits socket send buffer, short write drops connection */
+            pthread_mutex_lock(&pServer->lock);
+
+            if (pServer->frontLen == 0)
+            {
+                nBytes = send(pClient->fd, RW_METRICS_RESPONSE_503, strlen(RW_METRICS_RESPONSE_503), MSG_NOSIGNAL);
+                nBytes = (nBytes == (ssize_t)strlen(RW_METRICS_RESPONSE_503)) ? 0 : -1;
+            }
+            else
+            {
+                nBytes = send(pClient->fd, (pServer->pFront + pServer->frontOffset), pServer->frontLen, MSG_NOSIGNAL);
+                nBytes = (nBytes == (ssize_t)pServer->frontLen) ? 0 : -1;
+                pServer->nScrapes++;
+            }
+
+            pthread_mutex_unlock(&pServer->lock);
+        }
+
+        if ( (nBytes < 0) || (isClose) )
+        {
+            closeMetricsClient(pServer, pClient);
+            return;
+        }
+
+        /* Keep pipelined bytes of next request */
+        pClient->reqLen -= headLen;
+        memmove(pClient->request, (pClient->request + headLen), (pClient->reqLen + 1));
+    }
+
+    /* Request head larger than buffer is not served */
+    if (pClient->reqLen == (RW_METRICS_REQUEST_SZ - 1)) { closeMetricsClient(pServer, pClient); }
+}
+
+static void* serverMain(void *pArg)
+{
+    int nEvents, event;
+
+    RW_MetricsServer_t *pServer = (RW_MetricsServer_t *)pArg;
+    struct epoll_event epollEvents[RW_METRICS_MAX_EVENTS];
+
+    while (1)
+    {
+        nEvents = epoll_wait(pServer->epollFD, epollEvents, RW_METRICS_MAX_EVENTS, -1);
+        if (nEvents < 0)
+        {
+            if (errno == EINTR) { continue; }
+
+            LOG_ERROR("Failed to wait for metrics events [%m]");
+            break;
+        }
+
+        for (event = 0; event < nEvents; event++)
+        {
+            if (epollEvents[event].data.ptr == &pServer->stopFD)
+            {
+                return NULL;
+            }
+            else if (epollEvents[event].data.ptr == &pServer->listenFD)
+            {
+                acceptMetricsClients(pServer);
+            }
+            else
+            {
+                serveMetricsClient(pServer, (RW_MetricsClient_t *)epollEvents[event].data.ptr);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+RW_MetricsServer_t* createMetricsServer(uint16_t port, uint32_t nCPUs)
+{
+    int optVal = 1;
+    uint32_t slot;
+
+    RW_MetricsServer_t *pServer;
+    struct sockaddr_in  srcAddr;
+    struct epoll_event  listenEvent, stopEvent;
+
+    pServer = (RW_MetricsServer_t *)calloc(1, sizeof(RW_MetricsServer_t));
+    if (pServer == NULL)
+    {
+        LOG_ERROR("Failed to allocate metrics server");
+        return NULL;
+    }
+
+    /* Every core is exposed, response grows with host */
+    pServer->bufferSz = (RW_METRICS_BUFFER_SZ + (nCPUs * RW_METRICS_CORE_SZ));
+    pServer->pFront   = (char *)malloc(pServer->bufferSz);
+    pServer->pBack    = (char *)malloc(pServer->bufferSz);
+
+    pServer->listenFD = socket(AF_INET, (SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC), 0);
+    pServer->stopFD   = eventfd(0, EFD_CLOEXEC);
+    pServer->epollFD  = epoll_create1(EPOLL_CLOEXEC);
+
+    if ( (pServer->pFront == NULL) ||
+         (pServer->pBack  == NULL) ||
+         (pServer->listenFD < 0) ||
+         (pServer->stopFD   < 0) ||
+         (pServer->epollFD  < 0) )
+    {
+        LOG_ERROR("Failed to create metrics server resources [%m]");
+
+        if (pServer->epollFD  >= 0) { close(pServer->epollFD); }
+        if (pServer->stopFD   >= 0) { close(pServer->stopFD); }
+        if (pServer->listenFD >= 0) { close(pServer->listenFD); }
+        free(pServer->pBack);
+        free(pServer->pFront);
+        free(pServer);
+        return NULL;
+    }
+
+    /* Exposition is served on loopback only */
+    setsockopt(pServer->listenFD, SOL_SOCKET, SO_REUSEADDR, &optVal, sizeof(optVal));
+
+    memset(&srcAddr, 0x00, sizeof(struct sockaddr_in));
+    srcAddr.sin_family      = AF_INET;
+    srcAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    srcAddr.sin_port        = htons(port);
+
+    /* Listening socket and stop event are told apart from connections by their address */
+    memset(&listenEvent, 0x00, sizeof(struct epoll_event));
+    listenEvent.events   = EPOLLIN;
+    listenEvent.data.ptr = &pServer->listenFD;
+
+    memset(&stopEvent, 0x00, sizeof(struct epoll_event));
+    stopEvent.events     = EPOLLIN;
+    stopEvent.data.ptr   = &pServer->stopFD;
+
+    if ( (bind(pServer->listenFD, (struct sockaddr *)&srcAddr, sizeof(struct sockaddr_in)) < 0) ||
+         (listen(pServer->listenFD, RW_METRICS_CLIENTS_MAX) < 0) ||
+         (epoll_ctl(pServer->epollFD, EPOLL_CTL_ADD, pServer->listenFD, &listenEvent) < 0) ||
+         (epoll_ctl(pServer->epollFD, EPOLL_CTL_ADD, pServer->stopFD, &stopEvent) < 0) )
+    {
+        LOG_ERROR("Failed to listen on metrics port %u [%m]",
+                  port);
+
+        close(pServer->epollFD);
+        close(pServer->stopFD);
+        close(pServer->listenFD);
+        free(pServer->pBack);
+        free(pServer->pFront);
+        free(pServer);
+        return NULL;
+    }
+
+    for (slot = 0; slot < RW_METRICS_CLIENTS_MAX; slot++) { pServer->clients[slot].fd = -1; }
+
+    pthread_mutex_init(&pServer->lock, NULL);
+
+    if (pthread_create(&pServer->thread, NULL, serverMain, pServer) != 0)
+    {
+        LOG_ERROR("Failed to create metrics server thread");
+
+        pthread_mutex_destroy(&pServer->lock);
+        close(pServer->epollFD);
+        close(pServer->stopFD);
+        close(pServer->listenFD);
+        free(pServer->pBack);
+        free(pServer->pFront);
+        free(pServer);
+        return NULL;
+    }
+
+    return pServer;
+}
+
+int destroyMetricsServer(RW_MetricsServer_t *pServer)
+{
+    uint32_t slot;
+    uint64_t stop = 1;
+
+    if (pServer == NULL)
+    {
+        LOG_ERROR("Invalid input metrics server %p",
+                  pServer);
+        return -1;
+    }
+
+    /* Wake server thread and wait for it */
+    if (write(pServer->stopFD, &stop, sizeof(stop)) < 0)
+    {
+        LOG_ERROR("Failed to stop metrics server [%m]");
+    }
+    pthread_join(pServer->thread, NULL);
+
+    for (slot = 0; slot < RW_METRICS_CLIENTS_MAX; slot++)
+    {
+        if (pServer->clients[slot].fd >= 0) { close(pServer->clients[slot].fd); }
+    }
+
+    pthread_mutex_destroy(&pServer->lock);
+    close(pServer->epollFD);
+    close(pServer->stopFD);
+    close(pServer->listenFD);
+    free(pServer->pBack);
+    free(pServer->pFront);
+    free(pServer);
+
+    return 0;
+}
+
+int publishMetrics(RW_MetricsServer_t          *pServer,
+                   const RW_MultiInfo_t        *pSample,
+                   const RW_CpuCollector_t     *pCpuCollector,
+                   const ComChan_StageStats_t  *pStages,
+                   const RW_WorkerClassStats_t *pClasses,
+                   uint32_t                     nClasses,
+                   int64_t                      timestamp)
+{
+    int      retVal = 0;
+    char     head[RW_METRICS_HEADER_SZ];
+    char     cpu[8];
+    char    *pSwap;
+    uint16_t core;
+    uint32_t firstCPU, stage, classID;
+    uint32_t headLen, bodyLen = RW_METRICS_HEADER_SZ;
+    uint64_t nScrapes;
+
+    RW_CpuInfo_t cpuInfo;
+
+    if ( (pServer == NULL) ||
+         (pSample == NULL) )
+    {
+        LOG_ERROR("Invalid input pointer arguments (%p, %p)",
+                  pServer, pSample);
+        return -1;
+    }
+
+    pthread_mutex_lock(&pServer->lock);
+    nScrapes = pServer->nScrapes;
+    pthread_mutex_unlock(&pServer->lock);
+
+    /* Render body into back buffer behind room reserved for response head */
+    if (pSample->resourceMask & RW_RESOURCE_MASK(DISK_RESOURCE_INFO))
+    {
+        retVal |= appendMetrics(pServer->pBack, pServer->bufferSz, &bodyLen,
+                                "# HELP rw_disk_size_bytes Root file system size.\n"
+                                "# TYPE rw_disk_size_bytes gauge\n"
+                                "rw_disk_size_bytes %lu\n"
+                                "# HELP rw_disk_free_bytes Root file system free space.\n"
+                                "# TYPE rw_disk_free_bytes gauge\n"
+                                "rw_disk_free_bytes %lu\n",
+                                pSample->diskInfo.systemMemory,
+                                pSample->diskInfo.freeMemory);
+    }
+
+    if (pSample->resourceMask & RW_RESOURCE_MASK(MEMORY_RESOURCE_INFO))
+    {
+        retVal |= appendMetrics(pServer->pBack, pServer->bufferSz, &bodyLen,
+                                "# HELP rw_memory_size_bytes System memory size.\n"
+                                "# TYPE rw_memory_size_bytes gauge\n"
+                                "rw_memory_size_bytes %lu\n"
+                                "# HELP rw_memory_free_bytes System free memory.\n"
+                                "# TYPE rw_memory_free_bytes gauge\n"
+                                "rw_memory_free_bytes %lu\n",
+                                pSample->memoryInfo.systemMemory,
+                                pSample->memoryInfo.freeMemory);
+    }
+
+    if (pSample->resourceMask & RW_RESOURCE_MASK(CPU_RESOURCE_INFO))
+    {
+        retVal |= appendMetrics(pServer->pBack, pServer->bufferSz, &bodyLen,
+                                "# HELP rw_cpu_count Number of CPUs on host.\n"
+                                "# TYPE rw_cpu_count gauge\n"
+                                "rw_cpu_count %u\n"
+                                "# HELP rw_cpu_utilisation_ratio CPU time share by mode over last sampling period.\n"
+                                "# TYPE rw_cpu_utilisation_ratio gauge\n",
+                                pSample->cpuInfo.nCPUs);
+
+        retVal |= renderCpuUtil(pServer->pBack, pServer->bufferSz, &bodyLen, "all", &pSample->cpuInfo.aggregate);
+
+        /* Sample carries one window of cores, every core is read from collector window by window */
+        for (firstCPU = 0; (pCpuCollector != NULL) && (firstCPU < pSample->cpuInfo.nCPUs); firstCPU += RW_CPU_INFO_MAX_CORES)
+        {
+            if (getCpuUtilInfo(pCpuCollector, (uint16_t)firstCPU, &cpuInfo) < 0) { break; }
+
+            for (core = 0; core < cpuInfo.nEntries; core++)
+            {
+                snprintf(cpu, sizeof(cpu), "%u", (firstCPU + core));
+                retVal |= renderCpuUtil(pServer->pBack, pServer->bufferSz, &bodyLen, cpu, &cpuInfo.cores[core]);
+            }
+        }
+    }
+
+    /* Stages passed by served queries, each timed from previous passed stage */
+    if ( (pStages != NULL) &&
+         (pStages->total.count > 0) )
+    {
+        retVal |= appendMetrics(pServer->pBack, pServer->bufferSz, &bodyLen,
+                                "# HELP rw_stage_latency_seconds Served query latency from previous pipeline stage.\n"
+                                "# TYPE rw_stage_latency_seconds histogram\n");
+
+        for (stage = 0; stage < COM_CHAN_STAGE_MAX; stage++)
+        {
+            if (pStages->stages[stage].count == 0) { continue; }
+
+            retVal |= renderLatencyHist(pServer->pBack, pServer->bufferSz, &bodyLen, "rw_stage_latency_seconds", "stage",
+                                        getComChanStageName(stage), &pStages->stages[stage]);
+        }
+
+        retVal |= renderLatencyHist(pServer->pBack, pServer->bufferSz, &bodyLen, "rw_stage_latency_seconds", "stage",
+                                    getComChanStageName(COM_CHAN_STAGE_MAX), &pStages->total);
+    }
+
+    /* Worker queue per priority class */
+    if ( (pClasses != NULL) &&
+         (nClasses > 0) )
+    {
+        retVal |= appendMetrics(pServer->pBack, pServer->bufferSz, &bodyLen,
+                                "# HELP rw_queue_requests_total Requests queued for workers by priority class.\n"
+                                "# TYPE rw_queue_requests_total counter\n");
+
+        for (classID = 0; classID < nClasses; classID++)
+        {
+            retVal |= appendMetrics(pServer->pBack, pServer->bufferSz, &bodyLen,
+                                    "rw_queue_requests_total{class=\"%s\"} %lu\n",
+                                    getComChanPrioName(classID), pClasses[classID].nSubmitted);
+        }
+
+        retVal |= appendMetrics(pServer->pBack, pServer->bufferSz, &bodyLen,
+                                "# HELP rw_queue_overflows_total Requests dropped with class queue full.\n"
+                                "# TYPE rw_queue_overflows_total counter\n");
+
+        for (classID = 0; classID < nClasses; classID++)
+        {
+            retVal |= appendMetrics(pServer->pBack, pServer->bufferSz, &bodyLen,
+                                    "rw_queue_overflows_total{class=\"%s\"} %lu\n",
+                                    getComChanPrioName(classID), pClasses[classID].nOverflows);
+        }
+
+        retVal |= appendMetrics(pServer->pBack, pServer->bufferSz, &bodyLen,
+                                "# HELP rw_queue_delay_seconds Request wait from queueing to worker pickup.\n"
+                                "# TYPE rw_queue_delay_seconds histogram\n");
+
+        for (classID = 0; classID < nClasses; classID++)
+        {
+            retVal |= renderLatencyHist(pServer->pBack, pServer->bufferSz, &bodyLen, "rw_queue_delay_seconds", "class",
+                                        getComChanPrioName(classID), &pClasses[classID].queueDelay);
+        }
+    }
+
+    retVal |= appendMetrics(pServer->pBack, pServer->bufferSz, &bodyLen,
+                            "# HELP rw_sample_timestamp_seconds Time of latest sample.\n"
+                            "# TYPE rw_sample_timestamp_seconds gauge\n"
+                            "rw_sample_timestamp_seconds %ld\n"
+                            "# HELP rw_metrics_scrapes_total Scrapes served before latest sample.\n"
+                            "# TYPE rw_metrics_scrapes_total counter\n"
+                            "rw_metrics_scrapes_total %lu\n",
+                            timestamp, nScrapes);
+
+    if (retVal < 0)
+    {
+        LOG_ERROR("Metrics exceed response buffer (%u bytes)",
+                  pServer->bufferSz);
+        return -1;
+    }
+
+    /* Response head goes right in front of body, response is one contiguous send */
+    bodyLen -= RW_METRICS_HEADER_SZ;
+    headLen  = (uint32_t)snprintf(head, sizeof(head),
+                                  "HTTP/1.1 200 OK\r\n"
+                                  "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                                  "Content-Length: %u\r\n\r\n",
+                                  bodyLen);
+    memcpy((pServer->pBack + RW_METRICS_HEADER_SZ - headLen), head, headLen);
+
+    /* Swap rendered response in, scrapes never see a partial one */
+    pthread_mutex_lock(&pServer->lock);
+
+    pSwap                = pServer->pFront;
+    pServer->pFront      = pServer->pBack;
+    pServer->pBack       = pSwap;
+    pServer->frontOffset = (RW_METRICS_HEADER_SZ - headLen);
+    pServer->frontLen    = (headLen + bodyLen);
+
+    pthread_mutex_unlock(&pServer->lock);
+
+    return 0;
+}
@@ -0,0 +1,315 @@
+/**
+ * @file    rw_numa_info.c
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Per NUMA node memory collector (node meminfo/numastat)
+ * for resource watcher. Node files are opened once and kept open,
+ * every collection is a pread per file; collector state is read
+ * only after creation, so workers collect concurrently.
+ */
+
+
+// Library Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+
+// Module Includes
+#include "rw_numa_info.h"
+#include "com_chan_log.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define RW_NUMA_NODE_DIR        "/sys/devices/system/node"
+#define RW_NUMA_FILE_SZ         4096        // Bytes read per node file (meminfo is ~1.5 KB)
+#define RW_NUMA_PATH_SZ         64
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+typedef struct RW_NumaNodeFiles_s
+{
+    uint16_t                nodeID;             ///< NUMA node identifier
+    int                     meminfoFD;          ///< Persistent node meminfo descriptor
+    int                     numastatFD;         ///< Persistent node numastat descriptor
+} RW_NumaNodeFiles_t;
+
+struct RW_NumaCollector_s
+{
+    uint32_t                nNodes;             ///< Number of collected nodes
+    RW_NumaNodeFiles_t      nodes[RW_NUMA_MAX_NODES]; ///< Node files, ascending node identifiers
+};
+
+
+//*************************************
+// Module Utility Functions
+//*************************************
+static int compareNodeIDs(const void *pFirst, const void *pSecond);
+static int openNodeFiles(RW_NumaNodeFiles_t *pFiles);
+static void parseNodeMeminfo(const char *pBuf, RW_NumaNode_t *pNode);
+static void parseNodeNumastat(const char *pBuf, RW_NumaNode_t *pNode);
+static int readNodeFile(int fd, char *pBuf);
+
+
+static int compareNodeIDs(const void *pFirst, const void *pSecond)
+{
+    return (int)((const RW_NumaNodeFiles_t *)pFirst)->nodeID - (int)((const RW_NumaNodeFiles_t *)pSecond)->nodeID;
+}
+
+static int openNodeFiles(RW_NumaNodeFiles_t *pFiles)
+{
+    char path[RW_NUMA_PATH_SZ];
+
+    snprintf(path, sizeof(path), RW_NUMA_NODE_DIR "/node%u/meminfo", pFiles->nodeID);
+    pFiles->meminfoFD = open(path, O_RDONLY | O_CLOEXEC);
+    if (pFiles->meminfoFD < 0)
+    {
+        LOG_ERROR("Failed to open %s [%m]",
+                  path);
+        return -1;
+    }
+
+    /* numastat is missing on kernels without NUMA statistics, counters stay zero */
+    snprintf(path, sizeof(path), RW_NUMA_NODE_DIR "/node%u/numastat", pFiles->nodeID);
+    pFiles->numastatFD = open(path, O_RDONLY | O_CLOEXEC);
+
+    return 0;
+}
+
+static void parseNodeMeminfo(const char *pBuf, RW_NumaNode_t *pNode)
+{
+    const char *pCur = pBuf;
+    const char *pKey;
+    uint64_t value;
+
+    /* Lines read "Node N Key:   value kB" */
+    while (*pCur != '\0')
+    {
+        pKey = strchr(pCur, ':');
+        if (pKey == NULL) { break; }
+
+        /* Step back over key to its leading space */
+        while ( (pKey > pCur) && (pKey[-1] != ' ') ) { pKey--; }
+
+        value = strtoull((strchr(pKey, ':') + 1), NULL, 10) * 1024;
+
+        if      (strncmp(pKey, "MemTotal:",  9)  == 0) { pNode->systemMemory = value; }
+        else if (strncmp(pKey, "MemFree:",   8)  == 0) { pNode->freeMemory   = value; }
+        else if (strncmp(pKey, "FilePages:", 10) == 0) { pNode->fileMemory   = value; }
+        else if (strncmp(pKey, "AnonPages:", 10) == 0) { pNode->anonMemory   = value; }
+
+        /* Move to next line */
+        pCur = strchr(pKey, '\n');
+        if (pCur == NULL) { break; }
+        pCur++;
+    }
+}
+
+static void parseNodeNumastat(const char *pBuf, RW_NumaNode_t *pNode)
+{
+    const char *pCur = pBuf;
+    const char *pValue;
+    uint64_t value;
+
+    /* Lines read "key value" */
+    while (*pCur != '\0')
+    {
+        pValue = strchr(pCur, ' ');
+        if (pValue == NULL) { break; }
+
+        value = strtoull(pValue, NULL, 10);
+
+        if      (strncmp(pCur, "numa_hit ",       9)  == 0) { pNode->numaHit       = value; }
+        else if (strncmp(pCur, "numa_miss ",      10) == 0) { pNode->numaMiss      = value; }
+        else if (strncmp(pCur, "numa_foreign ",   13) == 0) { pNode->numaForeign   = value; }
+        else if (strncmp(pCur, "interleave_hit ", 15) == 0) { pNode->interleaveHit = value; }
+        else if (strncmp(pCur, "local_node ",     11) == 0) { pNode->localNode     = value; }
+        else if (strncmp(pCur, "other_node ",     11) == 0) { pNode->otherNode     = value; }
+
+        /* Move to next line */
+        pCur = strchr(pValue, '\n');
+        if (pCur == NULL) { break; }
+        pCur++;
+    }
+}
+
+static int readNodeFile(int fd, char *pBuf)
+{
+    ssize_t nBytes;
+
+    /* Read whole file from offset 0, descriptor remains open */
+    nBytes = pread(fd, pBuf, (RW_NUMA_FILE_SZ - 1), 0);
+    if (nBytes < 0) { return -1; }
+
+    pBuf[nBytes] = '\0';
+
+    return 0;
+}
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+RW_NumaCollector_t* createNumaCollector(void)
+{
+    DIR *pDir;
+    struct dirent *pEntry;
+    unsigned int nodeID;
+    char suffix;
+    uint32_t idx;
+
+    RW_NumaCollector_t *pCollector;
+
+    pCollector = (RW_NumaCollector_t *)calloc(1, sizeof(RW_NumaCollector_t));
+    if (pCollector == NULL)
+    {
+        LOG_ERROR("Failed to allocate NUMA collector");
+        return NULL;
+    }
+
+    /* Nodes with memory or CPUs are listed as nodeN directories */
+    pDir = opendir(RW_NUMA_NODE_DIR);
+    if (pDir == NULL)
+    {
+        LOG_ERROR("Failed to open %s [%m]",
+                  RW_NUMA_NODE_DIR);
+        free(pCollector);
+        return NULL;
+    }
+
+    while ((pEntry = readdir(pDir)) != NULL)
+    {
+        if (sscanf(pEntry->d_name, "node%u%c", &nodeID, &suffix) != 1) { continue; }
+
+        if (pCollector->nNodes == RW_NUMA_MAX_NODES)
+        {
+            LOG_WARNING("More than %u NUMA nodes, node %u is not collected",
+                        RW_NUMA_MAX_NODES, nodeID);
+            continue;
+        }
+
+        pCollector->nodes[pCollector->nNodes].nodeID = (uint16_t)nodeID;
+        pCollector->nNodes++;
+    }
+
+    closedir(pDir);
+
+    if (pCollector->nNodes == 0)
+    {
+        LOG_ERROR("No NUMA nodes found in %s",
+                  RW_NUMA_NODE_DIR);
+        free(pCollector);
+        return NULL;
+    }
+
+    /* Directory order is arbitrary, replies list nodes by identifier */
+    qsort(pCollector->nodes, pCollector->nNodes, sizeof(RW_NumaNodeFiles_t), compareNodeIDs);
+
+    for (idx = 0; idx < pCollector->nNodes; idx++)
+    {
+        pCollector->nodes[idx].meminfoFD  = -1;
+        pCollector->nodes[idx].numastatFD = -1;
+    }
+
+    /* Keep node files open, every collection is a pread per file */
+    for (idx = 0; idx < pCollector->nNodes; idx++)
+    {
+        if (openNodeFiles(&pCollector->nodes[idx]) < 0)
+        {
+            destroyNumaCollector(pCollector);
+            return NULL;
+        }
+    }
+
+    return pCollector;
+}
+
+int destroyNumaCollector(RW_NumaCollector_t *pCollector)
+{
+    uint32_t idx;
+
+    if (pCollector == NULL)
+    {
+        LOG_ERROR("Invalid input NUMA collector %p",
+                  pCollector);
+        return -1;
+    }
+
+    for (idx = 0; idx < pCollector->nNodes; idx++)
+    {
+        if (pCollector->nodes[idx].meminfoFD  >= 0) { close(pCollector->nodes[idx].meminfoFD); }
+        if (pCollector->nodes[idx].numastatFD >= 0) { close(pCollector->nodes[idx].numastatFD); }
+    }
+
+    free(pCollector);
+
+    return 0;
+}
+
+uint32_t getNumaNodeCount(const RW_NumaCollector_t *pCollector)
+{
+    return (pCollector != NULL) ? pCollector->nNodes : 0;
+}
+
+int getNumaMemoryInfo(const RW_NumaCollector_t *pCollector,
+                      uint16_t                  firstNode,
+                      RW_NumaInfo_t            *pNumaInfo)
+{
+    uint32_t idx;
+    char buf[RW_NUMA_FILE_SZ];
+
+    const RW_NumaNodeFiles_t *pFiles;
+    RW_NumaNode_t *pNode;
+
+    if ( (pCollector == NULL) ||
+         (pNumaInfo  == NULL) )
+    {
+        LOG_ERROR("Invalid input arguments (%p, %p)",
+                  pCollector, pNumaInfo);
+        return -1;
+    }
+
+    memset(pNumaInfo, 0x00, sizeof(RW_NumaInfo_t));
+
+    pNumaInfo->nNodes    = (uint16_t)pCollector->nNodes;
+    pNumaInfo->firstNode = firstNode;
+
+    /* Populate requested window of nodes */
+    for (idx = 0; idx < RW_NUMA_INFO_MAX_NODES; idx++)
+    {
+        if ((uint32_t)(firstNode + idx) >= pCollector->nNodes) { break; }
+
+        pFiles = &pCollector->nodes[firstNode + idx];
+        pNode  = &pNumaInfo->nodes[idx];
+
+        pNode->nodeID = pFiles->nodeID;
+
+        if (readNodeFile(pFiles->meminfoFD, buf) < 0)
+        {
+            LOG_ERROR("Failed to read meminfo of NUMA node %u [%m]",
+                      pFiles->nodeID);
+            return -1;
+        }
+
+        parseNodeMeminfo(buf, pNode);
+
+        if ( (pFiles->numastatFD >= 0) &&
+             (readNodeFile(pFiles->numastatFD, buf) == 0) )
+        {
+            parseNodeNumastat(buf, pNode);
+        }
+    }
+
+    pNumaInfo->nEntries = (uint16_t)idx;
+
+    return 0;
+}
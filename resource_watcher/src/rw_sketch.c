@@ -0,0 +1,431 @@
+/**
+ * @file    rw_sketch.c
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Mergeable streaming quantile sketches (DDSketch) per
+ * metric per rollup window for resource watcher.
+ *
+ * A value x > 0 is counted in bin ceil(log(x) / log(gamma)) with
+ * gamma = (1 + alpha) / (1 - alpha), so any quantile is returned
+ * within relative error alpha. Bins are a fixed window of
+ * RW_SKETCH_BINS indices; when values outgrow the window the
+ * lowest bins are collapsed, keeping upper quantiles accurate.
+ * Sketches are kept per minute (last hour) and per hour (last 7
+ * days); a window query merges the covering sketches.
+ */
+
+
+// Library Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+// Module Includes
+#include "rw_sketch.h"
+#include "com_chan_log.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define RW_SKETCH_GAMMA         ((1.0 + RW_SKETCH_ALPHA) / (1.0 - RW_SKETCH_ALPHA))
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+enum
+{
+    RW_SKETCH_LEVEL_1M,                         ///< 1 minute sketches for 1 hour
+    RW_SKETCH_LEVEL_1H,                         ///< 1 hour sketches for 7 days
+
+    RW_SKETCH_LEVEL_MAX,
+};
+
+typedef struct RW_SketchRing_s
+{
+    uint32_t                step;               ///< Seconds per window
+    uint32_t                capacity;           ///< Number of windows
+
+    int64_t                *pWindowTime;        ///< Window start time (-1 if unused)
+    RW_Sketch_t            *pSketches;          ///< [metric * capacity + window] sketches
+} RW_SketchRing_t;
+
+struct RW_SketchStore_s
+{
+    RW_SketchRing_t         rings[RW_SKETCH_LEVEL_MAX]; ///< One ring per window level
+
+    int64_t                 latestTime;         ///< Timestamp of newest sample
+};
+
+
+//*************************************
+// Module Local Variables
+//*************************************
+static const struct
+{
+    uint32_t step;
+    uint32_t capacity;
+} RW_SKETCH_LAYOUT[RW_SKETCH_LEVEL_MAX] =
+{
+    [RW_SKETCH_LEVEL_1M] = {   60,  60 },       // 1 hour
+    [RW_SKETCH_LEVEL_1H] = { 3600, 168 },       // 7 days
+};
+
+static double invLnGamma = 0.0;
+
+
+//*************************************
+// Module Utility Functions
+//*************************************
+static inline int32_t _SketchIndex(int64_t value);
+static int32_t getHighestBin(const RW_Sketch_t *pSketch);
+static void shiftSketch(RW_Sketch_t *pSketch, int32_t newOffset);
+static void addSketchBin(RW_Sketch_t *pSketch, int32_t index, uint64_t count);
+
+
+static inline int32_t _SketchIndex(int64_t value)
+{
+    return (int32_t)ceil(log((double)value) * invLnGamma);
+}
+
+static int32_t getHighestBin(const RW_Sketch_t *pSketch)
+{
+    int32_t bin;
+
+    for (bin = (RW_SKETCH_BINS - 1); bin > 0; bin--)
+    {
+        if (pSketch->bins[bin] != 0) { break; }
+    }
+
+    return (pSketch->offset + bin);
+}
+
+static void shiftSketch(RW_Sketch_t *pSketch, int32_t newOffset)
+{
+    int32_t  bin, shift = newOffset - pSketch->offset;
+    uint64_t collapsed = 0;
+
+    if (shift == 0) { return; }
+
+    if (shift > 0)
+    {
+        /* Window moves up, bins falling below it collapse into lowest bin */
+        for (bin = 0; (bin < shift) && (bin < RW_SKETCH_BINS); bin++) { collapsed += pSketch->bins[bin]; }
+
+        if (shift < RW_SKETCH_BINS)
+        {
+            memmove(&pSketch->bins[0], &pSketch->bins[shift], ((RW_SKETCH_BINS - shift) * sizeof(uint32_t)));
+            memset(&pSketch->bins[(RW_SKETCH_BINS - shift)], 0x00, (shift * sizeof(uint32_t)));
+        }
+        else
+        {
+            memset(pSketch->bins, 0x00, sizeof(pSketch->bins));
+        }
+
+        pSketch->bins[0] += (uint32_t)collapsed;
+    }
+    else
+    {
+        /* Window moves down, caller ensures highest bin stays in window */
+        shift = -shift;
+
+        memmove(&pSketch->bins[shift], &pSketch->bins[0], ((RW_SKETCH_BINS - shift) * sizeof(uint32_t)));
+        memset(&pSketch->bins[0], 0x00, (shift * sizeof(uint32_t)));
+    }
+
+    pSketch->offset = newOffset;
+}
+
+static void addSketchBin(RW_Sketch_t *pSketch, int32_t index, uint64_t count)
+{
+    /* First positive value centers bins window on it */
+    if (pSketch->count == pSketch->zeroCount)
+    {
+        memset(pSketch->bins, 0x00, sizeof(pSketch->bins));
+        pSketch->offset = index - (RW_SKETCH_BINS / 2);
+    }
+    else if (index < pSketch->offset)
+    {
+        int32_t newOffset = getHighestBin(pSketch) - (RW_SKETCH_BINS - 1);
+
+        /* Extend window down as far as highest bin allows, rest collapses */
+        if (index > newOffset) { newOffset = index; }
+        if (newOffset < pSketch->offset) { shiftSketch(pSketch, newOffset); }
+
+        if (index < pSketch->offset) { index = pSketch->offset; }
+    }
+    else if (index >= (pSketch->offset + RW_SKETCH_BINS))
+    {
+        shiftSketch(pSketch, (index - (RW_SKETCH_BINS - 1)));
+    }
+
+    pSketch->bins[(index - pSketch->offset)] += (uint32_t)count;
+}
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+void initSketch(RW_Sketch_t *pSketch)
+{
+    if (pSketch == NULL) { return; }
+
+    memset(pSketch, 0x00, sizeof(RW_Sketch_t));
+
+    pSketch->min = INT64_MAX;
+    pSketch->max = INT64_MIN;
+}
+
+void addSketchValue(RW_Sketch_t *pSketch, int64_t value)
+{
+    if (pSketch == NULL) { return; }
+
+    if (invLnGamma == 0.0) { invLnGamma = 1.0 / log(RW_SKETCH_GAMMA); }
+
+    if (value > 0) { addSketchBin(pSketch, _SketchIndex(value), 1); }
+    else           { pSketch->zeroCount++; }
+
+    pSketch->count++;
+
+    if (value < pSketch->min) { pSketch->min = value; }
+    if (value > pSketch->max) { pSketch->max = value; }
+}
+
+int mergeSketch(RW_Sketch_t *pDstSketch, const RW_Sketch_t *pSrcSketch)
+{
+    int32_t bin;
+
+    if ( (pDstSketch == NULL) ||
+         (pSrcSketch == NULL) )
+    {
+        LOG_ERROR("Invalid input arguments (%p, %p)",
+                  pDstSketch, pSrcSketch);
+        return -1;
+    }
+
+    if (pSrcSketch->count == 0) { return 0; }
+
+    /* Add source bins highest first, so destination window settles once */
+    for (bin = (RW_SKETCH_BINS - 1); bin >= 0; bin--)
+    {
+        if (pSrcSketch->bins[bin] == 0) { continue; }
+
+        addSketchBin(pDstSketch, (pSrcSketch->offset + bin), pSrcSketch->bins[bin]);
+
+        /* Destination counts positive values as they're merged */
+        pDstSketch->count += pSrcSketch->bins[bin];
+    }
+
+    pDstSketch->count     += pSrcSketch->zeroCount;
+    pDstSketch->zeroCount += pSrcSketch->zeroCount;
+
+    if (pSrcSketch->min < pDstSketch->min) { pDstSketch->min = pSrcSketch->min; }
+    if (pSrcSketch->max > pDstSketch->max) { pDstSketch->max = pSrcSketch->max; }
+
+    return 0;
+}
+
+int64_t getSketchQuantile(const RW_Sketch_t *pSketch, double quantile)
+{
+    int32_t  bin;
+    uint64_t rank, cumulative;
+    double   value;
+
+    if ( (pSketch == NULL) ||
+         (pSketch->count == 0) )
+    {
+        return 0;
+    }
+
+    if (quantile < 0.0) { quantile = 0.0; }
+    if (quantile > 1.0) { quantile = 1.0; }
+
+    rank = (uint64_t)(quantile * (double)(pSketch->count - 1));
+
+    /* Non-positive values aren't binned, minimum represents them */
+    cumulative = pSketch->zeroCount;
+    if (rank < cumulative) { return pSketch->min; }
+
+    for (bin = 0; bin < RW_SKETCH_BINS; bin++)
+    {
+        cumulative += pSketch->bins[bin];
+        if (cumulative > rank) { break; }
+    }
+
+    if (bin == RW_SKETCH_BINS) { return pSketch->max; }
+
+    /* Bin representative value, within alpha of any value in bin */
+    value = (2.0 * pow(RW_SKETCH_GAMMA, (double)(pSketch->offset + bin))) / (RW_SKETCH_GAMMA + 1.0);
+
+    if (value < (double)pSketch->min) { return pSketch->min; }
+    if (value > (double)pSketch->max) { return pSketch->max; }
+
+    return (int64_t)value;
+}
+
+RW_SketchStore_t* createSketchStore(void)
+{
+    int level;
+    RW_SketchStore_t *pStore;
+
+    pStore = (RW_SketchStore_t *)calloc(1, sizeof(RW_SketchStore_t));
+    if (pStore == NULL)
+    {
+        LOG_ERROR("Failed to allocate sketch store");
+        return NULL;
+    }
+
+    for (level = 0; level < RW_SKETCH_LEVEL_MAX; level++)
+    {
+        RW_SketchRing_t *pRing = &pStore->rings[level];
+
+        pRing->step     = RW_SKETCH_LAYOUT[level].step;
+        pRing->capacity = RW_SKETCH_LAYOUT[level].capacity;
+
+        pRing->pWindowTime = (int64_t *)malloc(pRing->capacity * sizeof(int64_t));
+        pRing->pSketches   = (RW_Sketch_t *)calloc((pRing->capacity * RW_METRIC_MAX), sizeof(RW_Sketch_t));
+
+        if ( (pRing->pWindowTime == NULL) ||
+             (pRing->pSketches   == NULL) )
+        {
+            LOG_ERROR("Failed to allocate sketch windows");
+            destroySketchStore(pStore);
+            return NULL;
+        }
+
+        /* Mark all windows unused */
+        memset(pRing->pWindowTime, 0xFF, (pRing->capacity * sizeof(int64_t)));
+    }
+
+    return pStore;
+}
+
+int destroySketchStore(RW_SketchStore_t *pStore)
+{
+    int level;
+
+    if (pStore == NULL)
+    {
+        LOG_ERROR("Invalid input sketch store %p",
+                  pStore);
+        return -1;
+    }
+
+    for (level = 0; level < RW_SKETCH_LEVEL_MAX; level++)
+    {
+        free(pStore->rings[level].pWindowTime);
+        free(pStore->rings[level].pSketches);
+    }
+
+    free(pStore);
+
+    return 0;
+}
+
+int insertSketchSample(RW_SketchStore_t *pStore,
+                       int64_t           timestamp,
+                       const int64_t     values[RW_METRIC_MAX])
+{
+    int level, metric;
+
+    if ( (pStore == NULL) ||
+         (values == NULL) ||
+         (timestamp < 0) )
+    {
+        LOG_ERROR("Invalid input arguments (%p, %p, %ld)",
+                  pStore, values, timestamp);
+        return -1;
+    }
+
+    if (timestamp > pStore->latestTime) { pStore->latestTime = timestamp; }
+
+    for (level = 0; level < RW_SKETCH_LEVEL_MAX; level++)
+    {
+        RW_SketchRing_t *pRing = &pStore->rings[level];
+
+        int64_t  windowTime = timestamp - (timestamp % pRing->step);
+        uint32_t idx        = (uint32_t)((windowTime / pRing->step) % pRing->capacity);
+
+        /* Recycle oldest window for new interval */
+        if (pRing->pWindowTime[idx] != windowTime)
+        {
+            pRing->pWindowTime[idx] = windowTime;
+
+            for (metric = 0; metric < RW_METRIC_MAX; metric++)
+            {
+                initSketch(&pRing->pSketches[(metric * pRing->capacity) + idx]);
+            }
+        }
+
+        for (metric = 0; metric < RW_METRIC_MAX; metric++)
+        {
+            addSketchValue(&pRing->pSketches[(metric * pRing->capacity) + idx], values[metric]);
+        }
+    }
+
+    return 0;
+}
+
+int querySketchStore(const RW_SketchStore_t *pStore,
+                     RW_QuantileInfo_t      *pQuantileInfo)
+{
+    uint32_t window;
+    int64_t  startTime, endTime, windowTime;
+
+    const RW_SketchRing_t *pRing;
+
+    if ( (pStore        == NULL) ||
+         (pQuantileInfo == NULL) )
+    {
+        LOG_ERROR("Invalid input arguments (%p, %p)",
+                  pStore, pQuantileInfo);
+        return -1;
+    }
+
+    if (pQuantileInfo->metricID >= RW_METRIC_MAX)
+    {
+        LOG_ERROR("Invalid quantile query (metric %u)",
+                  pQuantileInfo->metricID);
+        return -1;
+    }
+
+    endTime   = (pQuantileInfo->endTime   > 0) ? pQuantileInfo->endTime   : pStore->latestTime;
+    startTime = (pQuantileInfo->startTime > 0) ? pQuantileInfo->startTime : (endTime - 3600 + 1);
+
+    /* Minute windows while they still cover window start, hour windows otherwise */
+    pRing = &pStore->rings[RW_SKETCH_LEVEL_1M];
+    if (startTime <= (pStore->latestTime - (int64_t)(pRing->step * pRing->capacity)))
+    {
+        pRing = &pStore->rings[RW_SKETCH_LEVEL_1H];
+    }
+
+    initSketch(&pQuantileInfo->sketch);
+
+    windowTime = startTime - (startTime % pRing->step);
+
+    for (window = 0; (window < pRing->capacity) && (windowTime <= endTime); window++)
+    {
+        uint32_t idx = (uint32_t)((windowTime / pRing->step) % pRing->capacity);
+
+        if (pRing->pWindowTime[idx] == windowTime)
+        {
+            mergeSketch(&pQuantileInfo->sketch,
+                        &pRing->pSketches[(pQuantileInfo->metricID * pRing->capacity) + idx]);
+        }
+
+        windowTime += pRing->step;
+    }
+
+    pQuantileInfo->startTime = startTime;
+    pQuantileInfo->endTime   = endTime;
+
+    pQuantileInfo->p50 = getSketchQuantile(&pQuantileInfo->sketch, 0.50);
+    pQuantileInfo->p95 = getSketchQuantile(&pQuantileInfo->sketch, 0.95);
+    pQuantileInfo->p99 = getSketchQuantile(&pQuantileInfo->sketch, 0.99);
+
+    return 0;
+}
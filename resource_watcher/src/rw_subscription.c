@@ -0,0 +1,262 @@
+/**
+ * @file    rw_subscription.c
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Periodic resource subscriptions; compact table kept
+ * sorted by interval; push times are kept on the interval grid, so
+ * subscribers with the same interval are due together.
+ */
+
+
+// Library Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+// Module Includes
+#include "rw_subscription.h"
+#include "com_chan_log.h"
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+struct RW_SubscriptionTable_s
+{
+    RW_Subscription_t      *pSubscriptions;     ///< Active subscriptions, sorted by interval
+    uint32_t                nSubscriptions;     ///< Active subscriptions count
+    uint32_t                maxSubscriptions;   ///< Subscriptions allowed
+};
+
+
+//*************************************
+// Module Utility Functions
+//*************************************
+static int findSubscription(const RW_SubscriptionTable_t *pTable,
+                            uint32_t                      requesterSig,
+                            uint32_t                      subscriptionID);
+static int64_t nextGridTime(int64_t now, uint32_t interval);
+static void removeSubscription(RW_SubscriptionTable_t *pTable, uint32_t idx);
+static void sortSubscription(RW_SubscriptionTable_t *pTable, uint32_t idx);
+
+
+static int findSubscription(const RW_SubscriptionTable_t *pTable,
+                            uint32_t                      requesterSig,
+                            uint32_t                      subscriptionID)
+{
+    uint32_t idx;
+
+    for (idx = 0; idx < pTable->nSubscriptions; idx++)
+    {
+        if ( (pTable->pSubscriptions[idx].requesterSig   == requesterSig) &&
+             (pTable->pSubscriptions[idx].subscriptionID == subscriptionID) )
+        {
+            return (int)idx;
+        }
+    }
+
+    return -1;
+}
+
+static int64_t nextGridTime(int64_t now, uint32_t interval)
+{
+    /* First interval grid point after now */
+    return ((now - (now % interval)) + interval);
+}
+
+static void removeSubscription(RW_SubscriptionTable_t *pTable, uint32_t idx)
+{
+    /* Keep table compact and sorted */
+    memmove(&pTable->pSubscriptions[idx], &pTable->pSubscriptions[(idx + 1)],
+            ((pTable->nSubscriptions - idx - 1) * sizeof(RW_Subscription_t)));
+
+    pTable->nSubscriptions--;
+}
+
+static void sortSubscription(RW_SubscriptionTable_t *pTable, uint32_t idx)
+{
+    RW_Subscription_t subscription = pTable->pSubscriptions[idx];
+
+    /* Move updated entry to its interval position, rest of table is sorted */
+    while ( (idx > 0) &&
+            (pTable->pSubscriptions[(idx - 1)].interval > subscription.interval) )
+    {
+        pTable->pSubscriptions[idx] = pTable->pSubscriptions[(idx - 1)];
+        idx--;
+    }
+
+    while ( ((idx + 1) < pTable->nSubscriptions) &&
+            (pTable->pSubscriptions[(idx + 1)].interval < subscription.interval) )
+    {
+        pTable->pSubscriptions[idx] = pTable->pSubscriptions[(idx + 1)];
+        idx++;
+    }
+
+    pTable->pSubscriptions[idx] = subscription;
+}
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+RW_SubscriptionTable_t* createSubscriptionTable(uint32_t maxSubscriptions)
+{
+    RW_SubscriptionTable_t *pTable;
+
+    if ( (maxSubscriptions == 0) ||
+         (maxSubscriptions > RW_SUBSCRIPTIONS_MAX) )
+    {
+        LOG_ERROR("Invalid subscriptions count %u",
+                  maxSubscriptions);
+        return NULL;
+    }
+
+    pTable = (RW_SubscriptionTable_t *)calloc(1, sizeof(RW_SubscriptionTable_t));
+    if (pTable == NULL)
+    {
+        LOG_ERROR("Failed to allocate subscription table");
+        return NULL;
+    }
+
+    pTable->pSubscriptions = (RW_Subscription_t *)calloc(maxSubscriptions, sizeof(RW_Subscription_t));
+    if (pTable->pSubscriptions == NULL)
+    {
+        LOG_ERROR("Failed to allocate subscriptions");
+        free(pTable);
+        return NULL;
+    }
+
+    pTable->maxSubscriptions = maxSubscriptions;
+
+    return pTable;
+}
+
+int destroySubscriptionTable(RW_SubscriptionTable_t *pTable)
+{
+    if (pTable == NULL)
+    {
+        LOG_ERROR("Invalid input subscription table %p",
+                  pTable);
+        return -1;
+    }
+
+    free(pTable->pSubscriptions);
+    free(pTable);
+
+    return 0;
+}
+
+int updateSubscription(RW_SubscriptionTable_t *pTable,
+                       uint32_t                requesterSig,
+                       uint32_t                prioClass,
+                       RW_SubscribeInfo_t     *pSubscribeInfo,
+                       int64_t                 now)
+{
+    int idx;
+
+    RW_Subscription_t *pSubscription;
+
+    if ( (pTable == NULL) ||
+         (pSubscribeInfo == NULL) )
+    {
+        LOG_ERROR("Invalid input pointer arguments (%p, %p)",
+                  pTable, pSubscribeInfo);
+        return -1;
+    }
+
+    idx = findSubscription(pTable, requesterSig, pSubscribeInfo->subscriptionID);
+
+    /* Sections which can't be pushed are dropped, accepted mask is returned to subscriber */
+    pSubscribeInfo->resourceMask &= RW_SUBSCRIPTION_MASK;
+
+    /* Zero interval or empty mask cancels subscription */
+    if ( (pSubscribeInfo->interval == 0) ||
+         (pSubscribeInfo->resourceMask == 0) )
+    {
+        if (idx >= 0) { removeSubscription(pTable, (uint32_t)idx); }
+
+        pSubscribeInfo->resourceMask = 0;
+        return 0;
+    }
+
+    if (idx < 0)
+    {
+        if (pTable->nSubscriptions == pTable->maxSubscriptions)
+        {
+            LOG_WARNING("Subscription table is full (%u), 0x%X:%u rejected",
+                        pTable->nSubscriptions,
+                        requesterSig, pSubscribeInfo->subscriptionID);
+
+            pSubscribeInfo->resourceMask = 0;
+            return -1;
+        }
+
+        idx = (int)pTable->nSubscriptions++;
+        memset(&pTable->pSubscriptions[idx], 0x00, sizeof(RW_Subscription_t));
+    }
+
+    pSubscription = &pTable->pSubscriptions[idx];
+
+    /* New or re-timed subscription is first due on next grid point, renewal keeps its schedule */
+    if (pSubscription->interval != pSubscribeInfo->interval)
+    {
+        pSubscription->nextDue = nextGridTime((now - 1), pSubscribeInfo->interval);
+    }
+
+    pSubscription->requesterSig   = requesterSig;
+    pSubscription->subscriptionID = pSubscribeInfo->subscriptionID;
+    pSubscription->interval       = pSubscribeInfo->interval;
+    pSubscription->resourceMask   = pSubscribeInfo->resourceMask;
+    pSubscription->firstCPU       = pSubscribeInfo->firstCPU;
+    pSubscription->prioClass      = (uint16_t)prioClass;
+    pSubscription->expireTime     = now + RW_SUBSCRIPTION_LEASE;
+
+    sortSubscription(pTable, (uint32_t)idx);
+
+    return 0;
+}
+
+int pushDueSubscriptions(RW_SubscriptionTable_t  *pTable,
+                         int64_t                  now,
+                         RW_SubscriptionPushCb_t  pushCb,
+                         void                    *pArg)
+{
+    int      nPushed = 0;
+    uint32_t idx = 0;
+
+    RW_Subscription_t *pSubscription;
+
+    if ( (pTable == NULL) ||
+         (pushCb == NULL) )
+    {
+        LOG_ERROR("Invalid input pointer arguments (%p, %p)",
+                  pTable, pushCb);
+        return -1;
+    }
+
+    while (idx < pTable->nSubscriptions)
+    {
+        pSubscription = &pTable->pSubscriptions[idx];
+
+        /* Drop subscriptions whose subscriber stopped renewing */
+        if (pSubscription->expireTime <= now)
+        {
+            removeSubscription(pTable, idx);
+            continue;
+        }
+
+        /* A late pass still pushes once, next push goes back on the grid */
+        if (now >= pSubscription->nextDue)
+        {
+            pSubscription->nextDue = nextGridTime(now, pSubscription->interval);
+
+            if (pushCb(pArg, pSubscription) == 0) { nPushed++; }
+        }
+
+        idx++;
+    }
+
+    return nPushed;
+}
@@ -0,0 +1,896 @@
+/**
+ * @file    rw_tsdb.c
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Compressed append-only on-disk time-series store for
+ * resource watcher samples.
+ *
+ * Samples are encoded into chunks (Gorilla style): timestamps as
+ * delta-of-delta with variable length prefixes, metric values as
+ * XOR against previous value with leading/trailing zero windows.
+ * A chunk is appended to the active segment file once full or once
+ * it covers RW_TSDB_CHUNK_PERIOD, bounding samples lost if the
+ * process is killed; the active segment is sealed (renamed) after RW_TSDB_SEGMENT_PERIOD.
+ * Scans mmap segment files and decode only overlapping chunks.
+ *
+ * Segment file layout: [chunk header][payload] ... [chunk header][payload]
+ */
+
+
+// Library Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <endian.h>
+#include <errno.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+// Module Includes
+#include "rw_tsdb.h"
+#include "com_chan_log.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define RW_TSDB_CHUNK_MAGIC     0x43545752  // "RWTC"
+
+#define RW_TSDB_ACTIVE_NAME     "active.rwts"
+#define RW_TSDB_SEGMENT_FMT     "seg_%ld_%ld.rwts"
+
+#define RW_TSDB_PATH_SZ         512
+#define RW_TSDB_MAX_METRICS     32          // Metrics decodable from a chunk
+
+// Worst case per sample: 36 bits timestamp + 77 bits per metric value
+#define RW_TSDB_CHUNK_MAX_BYTES ((((RW_TSDB_CHUNK_SAMPLES * (36 + (77 * RW_METRIC_MAX))) + 7) / 8) + 8)
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+typedef struct RW_TsdbChunkHdr_s
+{
+    uint32_t                magic;              ///< Chunk magic (RW_TSDB_CHUNK_MAGIC)
+    uint16_t                nMetrics;           ///< Metrics per sample
+    uint16_t                nSamples;           ///< Samples in chunk
+
+    int64_t                 firstTime;          ///< Timestamp of first sample
+    int64_t                 lastTime;           ///< Timestamp of last sample
+
+    uint32_t                payloadSz;          ///< Encoded payload bytes following header
+    uint32_t                reserved;           ///< Reserved (alignment)
+} RW_TsdbChunkHdr_t;
+
+typedef struct RW_BitWriter_s
+{
+    uint8_t                *pBuf;               ///< Zeroed output buffer
+    size_t                  nBits;              ///< Bits written
+} RW_BitWriter_t;
+
+typedef struct RW_BitReader_s
+{
+    const uint8_t          *pBuf;               ///< Input buffer
+    size_t                  nBytes;             ///< Input buffer size
+    size_t                  pos;                ///< Bits consumed
+    int                     overrun;            ///< Set if read past buffer end
+} RW_BitReader_t;
+
+typedef struct RW_XorState_s
+{
+    uint64_t                prevValue;          ///< Previous value bit pattern
+    uint32_t                prevLead;           ///< Previous leading zero bits
+    uint32_t                prevLen;            ///< Previous meaningful bits (0 = no window)
+} RW_XorState_t;
+
+struct RW_Tsdb_s
+{
+    char                    dirPath[RW_TSDB_PATH_SZ]; ///< Segments directory
+
+    int                     activeFD;           ///< Active segment descriptor (-1 if none)
+    int64_t                 segFirstTime;       ///< First timestamp in active segment
+    int64_t                 segLastTime;        ///< Last timestamp in active segment
+
+    RW_TsdbChunkHdr_t       chunkHdr;           ///< Pending chunk header
+    RW_BitWriter_t          writer;             ///< Pending chunk payload writer
+
+    int64_t                 prevTime;           ///< Previous sample timestamp
+    int64_t                 prevDelta;          ///< Previous timestamp delta
+    RW_XorState_t           xorState[RW_METRIC_MAX]; ///< Per-metric XOR encoder state
+
+    uint8_t                 chunkBuf[RW_TSDB_CHUNK_MAX_BYTES]; ///< Pending chunk payload
+};
+
+typedef struct RW_TsdbSegment_s
+{
+    int64_t                 firstTime;          ///< First timestamp in segment
+    int64_t                 lastTime;           ///< Last timestamp in segment
+} RW_TsdbSegment_t;
+
+
+//*************************************
+// Module Utility Functions
+//*************************************
+static inline void     _PutBits(RW_BitWriter_t *pWriter, uint64_t value, uint32_t nBits);
+static inline uint64_t _GetBits(RW_BitReader_t *pReader, uint32_t nBits);
+static inline int64_t  _SignExtend(uint64_t value, uint32_t nBits);
+
+static void    encodeTimestamp(RW_BitWriter_t *pWriter, int64_t dod);
+static int64_t decodeTimestamp(RW_BitReader_t *pReader);
+static void    encodeValue(RW_BitWriter_t *pWriter, RW_XorState_t *pState, uint64_t value);
+static int     decodeValue(RW_BitReader_t *pReader, RW_XorState_t *pState);
+
+static int decodeChunk(const RW_TsdbChunkHdr_t *pChunkHdr,
+                       const uint8_t           *pPayload,
+                       int64_t                  startTime,
+                       int64_t                  endTime,
+                       RW_TsdbScanCb_t          scanCb,
+                       void                    *pArg);
+static int walkChunks(const uint8_t   *pBase,
+                      size_t           size,
+                      int64_t          startTime,
+                      int64_t          endTime,
+                      RW_TsdbScanCb_t  scanCb,
+                      void            *pArg,
+                      size_t          *pValidSz,
+                      RW_TsdbSegment_t *pSegment);
+
+static int scanSegmentFile(const char      *pPath,
+                           int64_t          startTime,
+                           int64_t          endTime,
+                           RW_TsdbScanCb_t  scanCb,
+                           void            *pArg);
+
+static int  flushChunk(RW_Tsdb_t *pTsdb);
+static int  sealSegment(RW_Tsdb_t *pTsdb);
+static void pruneSegments(RW_Tsdb_t *pTsdb, int64_t oldestTime);
+static void recoverActiveSegment(RW_Tsdb_t *pTsdb);
+static int  compareSegments(const void *pLeft, const void *pRight);
+
+
+static inline void _PutBits(RW_BitWriter_t *pWriter, uint64_t value, uint32_t nBits)
+{
+    /* MSB first, buffer is zeroed so bits are OR-ed in place */
+    while (nBits > 0)
+    {
+        uint32_t room = 8 - (pWriter->nBits & 7);
+        uint32_t take = (nBits < room) ? nBits : room;
+        uint8_t  part = (uint8_t)((value >> (nBits - take)) & ((1U << take) - 1));
+
+        pWriter->pBuf[pWriter->nBits >> 3] |= (uint8_t)(part << (room - take));
+
+        pWriter->nBits += take;
+        nBits          -= take;
+    }
+}
+
+static inline uint64_t _GetBits(RW_BitReader_t *pReader, uint32_t nBits)
+{
+    uint64_t value = 0;
+    size_t   byteIdx;
+
+    if (nBits == 0) { return 0; }
+
+    if (nBits > 32)
+    {
+        value = _GetBits(pReader, (nBits - 32)) << 32;
+        return (value | _GetBits(pReader, 32));
+    }
+
+    byteIdx = pReader->pos >> 3;
+
+    if ((byteIdx + sizeof(uint64_t)) <= pReader->nBytes)
+    {
+        uint64_t window;
+
+        /* Fast path, single unaligned 64 bits load */
+        memcpy(&window, &pReader->pBuf[byteIdx], sizeof(window));
+        window = be64toh(window);
+
+        value = (window << (pReader->pos & 7)) >> (64 - nBits);
+        pReader->pos += nBits;
+        return value;
+    }
+
+    /* Slow path near buffer end */
+    while (nBits-- > 0)
+    {
+        uint64_t bit = 0;
+
+        if ((pReader->pos >> 3) < pReader->nBytes)
+        {
+            bit = (pReader->pBuf[pReader->pos >> 3] >> (7 - (pReader->pos & 7))) & 0x01;
+        }
+        else { pReader->overrun = 1; }
+
+        value = (value << 1) | bit;
+        pReader->pos++;
+    }
+
+    return value;
+}
+
+static inline int64_t _SignExtend(uint64_t value, uint32_t nBits)
+{
+    return ((int64_t)(value << (64 - nBits)) >> (64 - nBits));
+}
+
+static void encodeTimestamp(RW_BitWriter_t *pWriter, int64_t dod)
+{
+    if (dod == 0)
+    {
+        _PutBits(pWriter, 0x00, 1);
+    }
+    else if ( (dod >= -64) && (dod <= 63) )
+    {
+        _PutBits(pWriter, 0x02, 2);
+        _PutBits(pWriter, (uint64_t)dod, 7);
+    }
+    else if ( (dod >= -256) && (dod <= 255) )
+    {
+        _PutBits(pWriter, 0x06, 3);
+        _PutBits(pWriter, (uint64_t)dod, 9);
+    }
+    else if ( (dod >= -2048) && (dod <= 2047) )
+    {
+        _PutBits(pWriter, 0x0E, 4);
+        _PutBits(pWriter, (uint64_t)dod, 12);
+    }
+    else
+    {
+        _PutBits(pWriter, 0x0F, 4);
+        _PutBits(pWriter, (uint64_t)dod, 32);
+    }
+}
+
+static int64_t decodeTimestamp(RW_BitReader_t *pReader)
+{
+    if (_GetBits(pReader, 1) == 0) { return 0; }
+    if (_GetBits(pReader, 1) == 0) { return _SignExtend(_GetBits(pReader, 7), 7); }
+    if (_GetBits(pReader, 1) == 0) { return _SignExtend(_GetBits(pReader, 9), 9); }
+    if (_GetBits(pReader, 1) == 0) { return _SignExtend(_GetBits(pReader, 12), 12); }
+
+    return _SignExtend(_GetBits(pReader, 32), 32);
+}
+
+static void encodeValue(RW_BitWriter_t *pWriter, RW_XorState_t *pState, uint64_t value)
+{
+    uint32_t lead, trail;
+    uint64_t xorValue = value ^ pState->prevValue;
+
+    pState->prevValue = value;
+
+    /* Unchanged value, single bit */
+    if (xorValue == 0)
+    {
+        _PutBits(pWriter, 0x00, 1);
+        return;
+    }
+
+    lead  = (uint32_t)__builtin_clzll(xorValue);
+    trail = (uint32_t)__builtin_ctzll(xorValue);
+    if (lead > 31) { lead = 31; }
+
+    if ( (pState->prevLen != 0) &&
+         (lead  >= pState->prevLead) &&
+         (trail >= (64 - pState->prevLead - pState->prevLen)) )
+    {
+        /* Meaningful bits fit in previous window */
+        _PutBits(pWriter, 0x02, 2);
+        _PutBits(pWriter, (xorValue >> (64 - pState->prevLead - pState->prevLen)), pState->prevLen);
+    }
+    else
+    {
+        uint32_t len = 64 - lead - trail;
+
+        /* New window: 5 bits leading zeros, 6 bits length (64 stored as 0) */
+        _PutBits(pWriter, 0x03, 2);
+        _PutBits(pWriter, lead, 5);
+        _PutBits(pWriter, (len & 0x3F), 6);
+        _PutBits(pWriter, (xorValue >> trail), len);
+
+        pState->prevLead = lead;
+        pState->prevLen  = len;
+    }
+}
+
+static int decodeValue(RW_BitReader_t *pReader, RW_XorState_t *pState)
+{
+    uint64_t meaningful;
+
+    if (_GetBits(pReader, 1) == 0) { return 0; }
+
+    if (_GetBits(pReader, 1) != 0)
+    {
+        pState->prevLead = (uint32_t)_GetBits(pReader, 5);
+        pState->prevLen  = (uint32_t)_GetBits(pReader, 6);
+        if (pState->prevLen == 0) { pState->prevLen = 64; }
+    }
+
+    /* Corrupted stream, window doesn't fit 64 bits */
+    if ( (pState->prevLen == 0) ||
+         ((pState->prevLead + pState->prevLen) > 64) )
+    {
+        return -1;
+    }
+
+    meaningful = _GetBits(pReader, pState->prevLen);
+    pState->prevValue ^= (meaningful << (64 - pState->prevLead - pState->prevLen));
+
+    return 0;
+}
+
+static int decodeChunk(const RW_TsdbChunkHdr_t *pChunkHdr,
+                       const uint8_t           *pPayload,
+                       int64_t                  startTime,
+                       int64_t                  endTime,
+                       RW_TsdbScanCb_t          scanCb,
+                       void                    *pArg)
+{
+    uint32_t sample, metric;
+    int64_t  timestamp, delta = 0;
+    int64_t  values[RW_TSDB_MAX_METRICS];
+
+    RW_BitReader_t reader;
+    RW_XorState_t  xorState[RW_TSDB_MAX_METRICS];
+
+    /* Skip chunks outside scan window without decoding */
+    if ( (pChunkHdr->lastTime  < startTime) ||
+         (pChunkHdr->firstTime > endTime) )
+    {
+        return 0;
+    }
+
+    if (pChunkHdr->nMetrics > RW_TSDB_MAX_METRICS) { return -1; }
+
+    memset(values,   0x00, sizeof(values));
+    memset(xorState, 0x00, sizeof(xorState));
+
+    reader.pBuf    = pPayload;
+    reader.nBytes  = pChunkHdr->payloadSz;
+    reader.pos     = 0;
+    reader.overrun = 0;
+
+    timestamp = pChunkHdr->firstTime;
+
+    for (sample = 0; sample < pChunkHdr->nSamples; sample++)
+    {
+        if (sample == 0)
+        {
+            /* First sample values are stored raw */
+            for (metric = 0; metric < pChunkHdr->nMetrics; metric++)
+            {
+                xorState[metric].prevValue = _GetBits(&reader, 64);
+            }
+        }
+        else
+        {
+            delta     += decodeTimestamp(&reader);
+            timestamp += delta;
+
+            for (metric = 0; metric < pChunkHdr->nMetrics; metric++)
+            {
+                if (decodeValue(&reader, &xorState[metric]) < 0) { return -1; }
+            }
+        }
+
+        if (reader.overrun) { return -1; }
+
+        if ( (timestamp >= startTime) &&
+             (timestamp <= endTime) )
+        {
+            for (metric = 0; metric < pChunkHdr->nMetrics; metric++)
+            {
+                values[metric] = (int64_t)xorState[metric].prevValue;
+            }
+
+            if (scanCb(pArg, timestamp, values) < 0) { return -1; }
+        }
+    }
+
+    return 0;
+}
+
+static int walkChunks(const uint8_t   *pBase,
+                      size_t           size,
+                      int64_t          startTime,
+                      int64_t          endTime,
+                      RW_TsdbScanCb_t  scanCb,
+                      void            *pArg,
+                      size_t          *pValidSz,
+                      RW_TsdbSegment_t *pSegment)
+{
+    size_t offset = 0;
+
+    while ((offset + sizeof(RW_TsdbChunkHdr_t)) <= size)
+    {
+        RW_TsdbChunkHdr_t chunkHdr;
+
+        memcpy(&chunkHdr, (pBase + offset), sizeof(chunkHdr));
+
+        /* Torn or corrupted tail, stop at last complete chunk */
+        if ( (chunkHdr.magic != RW_TSDB_CHUNK_MAGIC) ||
+             ((offset + sizeof(chunkHdr) + chunkHdr.payloadSz) > size) )
+        {
+            break;
+        }
+
+        if (pSegment != NULL)
+        {
+            if (offset == 0) { pSegment->firstTime = chunkHdr.firstTime; }
+            pSegment->lastTime = chunkHdr.lastTime;
+        }
+
+        if (scanCb != NULL)
+        {
+            if (decodeChunk(&chunkHdr, (pBase + offset + sizeof(chunkHdr)),
+                            startTime, endTime, scanCb, pArg) < 0)
+            {
+                return -1;
+            }
+        }
+
+        offset += sizeof(chunkHdr) + chunkHdr.payloadSz;
+    }
+
+    if (pValidSz != NULL) { *pValidSz = offset; }
+
+    return 0;
+}
+
+static int scanSegmentFile(const char      *pPath,
+                           int64_t          startTime,
+                           int64_t          endTime,
+                           RW_TsdbScanCb_t  scanCb,
+                           void            *pArg)
+{
+    int fd, retVal;
+    void *pBase;
+    struct stat fileStat;
+
+    fd = open(pPath, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        LOG_ERROR("Failed to open segment %s [%m]",
+                  pPath);
+        return 0;
+    }
+
+    if ( (fstat(fd, &fileStat) < 0) ||
+         (fileStat.st_size == 0) )
+    {
+        close(fd);
+        return 0;
+    }
+
+    /* Map segment, decoding reads straight from page cache */
+    pBase = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (pBase == MAP_FAILED)
+    {
+        LOG_ERROR("Failed to map segment %s [%m]",
+                  pPath);
+        return 0;
+    }
+
+    madvise(pBase, (size_t)fileStat.st_size, MADV_SEQUENTIAL);
+
+    retVal = walkChunks((const uint8_t *)pBase, (size_t)fileStat.st_size,
+                        startTime, endTime, scanCb, pArg, NULL, NULL);
+
+    munmap(pBase, (size_t)fileStat.st_size);
+
+    return retVal;
+}
+
+static int flushChunk(RW_Tsdb_t *pTsdb)
+{
+    int retVal = 0;
+    struct iovec ioVector[2];
+
+    if (pTsdb->chunkHdr.nSamples == 0) { return 0; }
+
+    pTsdb->chunkHdr.payloadSz = (uint32_t)((pTsdb->writer.nBits + 7) / 8);
+
+    /* Open active segment lazily */
+    if (pTsdb->activeFD < 0)
+    {
+        char path[RW_TSDB_PATH_SZ + 32];
+
+        snprintf(path, sizeof(path), "%s/%s", pTsdb->dirPath, RW_TSDB_ACTIVE_NAME);
+
+        pTsdb->activeFD = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (pTsdb->activeFD < 0)
+        {
+            LOG_ERROR("Failed to open active segment %s [%m]",
+                      path);
+            retVal = -1;
+        }
+        else
+        {
+            pTsdb->segFirstTime = pTsdb->chunkHdr.firstTime;
+        }
+    }
+
+    if (pTsdb->activeFD >= 0)
+    {
+        ioVector[0].iov_base = (void *)&pTsdb->chunkHdr;
+        ioVector[0].iov_len  = sizeof(RW_TsdbChunkHdr_t);
+        ioVector[1].iov_base = (void *)pTsdb->chunkBuf;
+        ioVector[1].iov_len  = pTsdb->chunkHdr.payloadSz;
+
+        /* Header and payload appended in one write */
+        if (writev(pTsdb->activeFD, ioVector, 2) < 0)
+        {
+            LOG_ERROR("Failed to append chunk [%m]");
+            retVal = -1;
+        }
+        else
+        {
+            pTsdb->segLastTime = pTsdb->chunkHdr.lastTime;
+        }
+    }
+
+    /* Reset pending chunk */
+    memset(pTsdb->chunkBuf, 0x00, pTsdb->chunkHdr.payloadSz);
+    memset(&pTsdb->chunkHdr, 0x00, sizeof(RW_TsdbChunkHdr_t));
+    pTsdb->writer.nBits = 0;
+
+    /* Seal segment once it covers segment period */
+    if ( (pTsdb->activeFD >= 0) &&
+         ((pTsdb->segLastTime - pTsdb->segFirstTime) >= RW_TSDB_SEGMENT_PERIOD) )
+    {
+        sealSegment(pTsdb);
+    }
+
+    return retVal;
+}
+
+static int sealSegment(RW_Tsdb_t *pTsdb)
+{
+    char activePath[RW_TSDB_PATH_SZ + 32];
+    char sealedPath[RW_TSDB_PATH_SZ + 64];
+
+    if (pTsdb->activeFD >= 0) { close(pTsdb->activeFD); }
+    pTsdb->activeFD = -1;
+
+    snprintf(activePath, sizeof(activePath), "%s/%s", pTsdb->dirPath, RW_TSDB_ACTIVE_NAME);
+    snprintf(sealedPath, sizeof(sealedPath), "%s/" RW_TSDB_SEGMENT_FMT, pTsdb->dirPath,
+             pTsdb->segFirstTime, pTsdb->segLastTime);
+
+    if (rename(activePath, sealedPath) < 0)
+    {
+        LOG_ERROR("Failed to seal segment %s [%m]",
+                  sealedPath);
+        return -1;
+    }
+
+    /* Drop segments past retention */
+    pruneSegments(pTsdb, (pTsdb->segLastTime - RW_TSDB_RETENTION));
+
+    pTsdb->segFirstTime = -1;
+    pTsdb->segLastTime  = -1;
+
+    return 0;
+}
+
+static void pruneSegments(RW_Tsdb_t *pTsdb, int64_t oldestTime)
+{
+    DIR *pDir;
+    struct dirent *pEntry;
+    RW_TsdbSegment_t segment;
+
+    pDir = opendir(pTsdb->dirPath);
+    if (pDir == NULL) { return; }
+
+    while ((pEntry = readdir(pDir)) != NULL)
+    {
+        if (sscanf(pEntry->d_name, RW_TSDB_SEGMENT_FMT, &segment.firstTime, &segment.lastTime) != 2) { continue; }
+
+        if (segment.lastTime < oldestTime)
+        {
+            unlinkat(dirfd(pDir), pEntry->d_name, 0);
+        }
+    }
+
+    closedir(pDir);
+}
+
+static void recoverActiveSegment(RW_Tsdb_t *pTsdb)
+{
+    int fd;
+    void *pBase;
+    size_t validSz = 0;
+    struct stat fileStat;
+    RW_TsdbSegment_t segment = { -1, -1 };
+
+    char activePath[RW_TSDB_PATH_SZ + 32];
+
+    snprintf(activePath, sizeof(activePath), "%s/%s", pTsdb->dirPath, RW_TSDB_ACTIVE_NAME);
+
+    fd = open(activePath, O_RDWR | O_CLOEXEC);
+    if (fd < 0) { return; }
+
+    if ( (fstat(fd, &fileStat) == 0) &&
+         (fileStat.st_size > 0) )
+    {
+        pBase = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (pBase != MAP_FAILED)
+        {
+            /* Find last complete chunk, previous run may have been killed mid-write */
+            walkChunks((const uint8_t *)pBase, (size_t)fileStat.st_size, 0, 0, NULL, NULL, &validSz, &segment);
+            munmap(pBase, (size_t)fileStat.st_size);
+        }
+    }
+
+    if (validSz < (size_t)fileStat.st_size)
+    {
+        if (ftruncate(fd, (off_t)validSz) < 0)
+        {
+            LOG_ERROR("Failed to truncate active segment [%m]");
+        }
+    }
+
+    close(fd);
+
+    if (validSz == 0)
+    {
+        unlink(activePath);
+        return;
+    }
+
+    /* Seal recovered segment, new samples start a new active segment */
+    pTsdb->segFirstTime = segment.firstTime;
+    pTsdb->segLastTime  = segment.lastTime;
+
+    sealSegment(pTsdb);
+}
+
+static int compareSegments(const void *pLeft, const void *pRight)
+{
+    const RW_TsdbSegment_t *pL = (const RW_TsdbSegment_t *)pLeft;
+    const RW_TsdbSegment_t *pR = (const RW_TsdbSegment_t *)pRight;
+
+    return (pL->firstTime > pR->firstTime) - (pL->firstTime < pR->firstTime);
+}
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+RW_Tsdb_t* createTsdb(const char *pDirPath)
+{
+    RW_Tsdb_t *pTsdb;
+
+    if ( (pDirPath == NULL) ||
+         (strlen(pDirPath) >= RW_TSDB_PATH_SZ) )
+    {
+        LOG_ERROR("Invalid input segments directory (%p)",
+                  pDirPath);
+        return NULL;
+    }
+
+    if ( (mkdir(pDirPath, 0755) < 0) &&
+         (errno != EEXIST) )
+    {
+        LOG_ERROR("Failed to create segments directory %s [%m]",
+                  pDirPath);
+        return NULL;
+    }
+
+    pTsdb = (RW_Tsdb_t *)calloc(1, sizeof(RW_Tsdb_t));
+    if (pTsdb == NULL)
+    {
+        LOG_ERROR("Failed to allocate time-series store");
+        return NULL;
+    }
+
+    strncpy(pTsdb->dirPath, pDirPath, (RW_TSDB_PATH_SZ - 1));
+
+    pTsdb->activeFD     = -1;
+    pTsdb->segFirstTime = -1;
+    pTsdb->segLastTime  = -1;
+    pTsdb->writer.pBuf  = pTsdb->chunkBuf;
+
+    /* Seal segment left active by previous run */
+    recoverActiveSegment(pTsdb);
+
+    return pTsdb;
+}
+
+int destroyTsdb(RW_Tsdb_t *pTsdb)
+{
+    if (pTsdb == NULL)
+    {
+        LOG_ERROR("Invalid input time-series store %p",
+                  pTsdb);
+        return -1;
+    }
+
+    /* Persist pending samples, segment remains active for next run */
+    flushChunk(pTsdb);
+
+    if (pTsdb->activeFD >= 0) { close(pTsdb->activeFD); }
+
+    free(pTsdb);
+
+    return 0;
+}
+
+int appendTsdbSample(RW_Tsdb_t     *pTsdb,
+                     int64_t        timestamp,
+                     const int64_t  values[RW_METRIC_MAX])
+{
+    int metric;
+    int64_t delta, dod;
+
+    if ( (pTsdb  == NULL) ||
+         (values == NULL) )
+    {
+        LOG_ERROR("Invalid input arguments (%p, %p)",
+                  pTsdb, values);
+        return -1;
+    }
+
+    if (pTsdb->chunkHdr.nSamples > 0)
+    {
+        delta = timestamp - pTsdb->prevTime;
+        dod   = delta - pTsdb->prevDelta;
+
+        /* Delta-of-delta doesn't fit encoding, start a new chunk */
+        if ( (dod < INT32_MIN) || (dod > INT32_MAX) )
+        {
+            flushChunk(pTsdb);
+        }
+        else
+        {
+            encodeTimestamp(&pTsdb->writer, dod);
+
+            for (metric = 0; metric < RW_METRIC_MAX; metric++)
+            {
+                encodeValue(&pTsdb->writer, &pTsdb->xorState[metric], (uint64_t)values[metric]);
+            }
+
+            pTsdb->prevDelta = delta;
+        }
+    }
+
+    if (pTsdb->chunkHdr.nSamples == 0)
+    {
+        /* First sample of chunk, timestamp in header and raw values */
+        pTsdb->chunkHdr.magic     = RW_TSDB_CHUNK_MAGIC;
+        pTsdb->chunkHdr.nMetrics  = RW_METRIC_MAX;
+        pTsdb->chunkHdr.firstTime = timestamp;
+
+        memset(pTsdb->xorState, 0x00, sizeof(pTsdb->xorState));
+
+        for (metric = 0; metric < RW_METRIC_MAX; metric++)
+        {
+            _PutBits(&pTsdb->writer, (uint64_t)values[metric], 64);
+            pTsdb->xorState[metric].prevValue = (uint64_t)values[metric];
+        }
+
+        pTsdb->prevDelta = 0;
+    }
+
+    pTsdb->prevTime = timestamp;
+
+    pTsdb->chunkHdr.lastTime = timestamp;
+    pTsdb->chunkHdr.nSamples++;
+
+    /* Append chunk once full or once it covers chunk period, bounding samples lost on kill */
+    if ( (pTsdb->chunkHdr.nSamples >= RW_TSDB_CHUNK_SAMPLES) ||
+         ((timestamp - pTsdb->chunkHdr.firstTime) >= RW_TSDB_CHUNK_PERIOD) )
+    {
+        return flushChunk(pTsdb);
+    }
+
+    return 0;
+}
+
+int scanTsdb(RW_Tsdb_t       *pTsdb,
+             int64_t          startTime,
+             int64_t          endTime,
+             RW_TsdbScanCb_t  scanCb,
+             void            *pArg)
+{
+    DIR *pDir;
+    struct dirent *pEntry;
+
+    size_t idx, nSegments = 0, maxSegments = 0;
+    RW_TsdbSegment_t segment, *pSegments = NULL;
+
+    char path[RW_TSDB_PATH_SZ + 64];
+
+    if ( (pTsdb  == NULL) ||
+         (scanCb == NULL) )
+    {
+        LOG_ERROR("Invalid input arguments (%p, %p)",
+                  pTsdb, scanCb);
+        return -1;
+    }
+
+    pDir = opendir(pTsdb->dirPath);
+    if (pDir == NULL)
+    {
+        LOG_ERROR("Failed to open segments directory %s [%m]",
+                  pTsdb->dirPath);
+        return -1;
+    }
+
+    /* Select sealed segments overlapping scan window; time range is in file name */
+    while ((pEntry = readdir(pDir)) != NULL)
+    {
+        if (sscanf(pEntry->d_name, RW_TSDB_SEGMENT_FMT, &segment.firstTime, &segment.lastTime) != 2) { continue; }
+
+        if ( (segment.lastTime  < startTime) ||
+             (segment.firstTime > endTime) )
+        {
+            continue;
+        }
+
+        if (nSegments == maxSegments)
+        {
+            RW_TsdbSegment_t *pGrown;
+
+            maxSegments = (maxSegments == 0) ? 64 : (maxSegments * 2);
+
+            pGrown = (RW_TsdbSegment_t *)realloc(pSegments, (maxSegments * sizeof(RW_TsdbSegment_t)));
+            if (pGrown == NULL)
+            {
+                LOG_ERROR("Failed to allocate segments list");
+                break;
+            }
+
+            pSegments = pGrown;
+        }
+
+        pSegments[nSegments++] = segment;
+    }
+
+    closedir(pDir);
+
+    /* Scan oldest to newest */
+    if (nSegments > 0) { qsort(pSegments, nSegments, sizeof(RW_TsdbSegment_t), compareSegments); }
+
+    for (idx = 0; idx < nSegments; idx++)
+    {
+        snprintf(path, sizeof(path), "%s/" RW_TSDB_SEGMENT_FMT, pTsdb->dirPath,
+                 pSegments[idx].firstTime, pSegments[idx].lastTime);
+
+        if (scanSegmentFile(path, startTime, endTime, scanCb, pArg) < 0)
+        {
+            free(pSegments);
+            return 0;
+        }
+    }
+
+    free(pSegments);
+
+    /* Active segment, then samples not yet appended */
+    if (pTsdb->activeFD >= 0)
+    {
+        snprintf(path, sizeof(path), "%s/%s", pTsdb->dirPath, RW_TSDB_ACTIVE_NAME);
+
+        if (scanSegmentFile(path, startTime, endTime, scanCb, pArg) < 0) { return 0; }
+    }
+
+    if (pTsdb->chunkHdr.nSamples > 0)
+    {
+        RW_TsdbChunkHdr_t chunkHdr = pTsdb->chunkHdr;
+
+        chunkHdr.payloadSz = (uint32_t)((pTsdb->writer.nBits + 7) / 8);
+        decodeChunk(&chunkHdr, pTsdb->chunkBuf, startTime, endTime, scanCb, pArg);
+    }
+
+    return 0;
+}
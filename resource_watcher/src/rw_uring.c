@@ -0,0 +1,365 @@
+/**
+ * @file    rw_uring.c
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Minimal io_uring ring (raw system calls) for resource
+ * watcher event loop backend. Submission entries are batched in
+ * user space and handed to kernel with a single io_uring_enter.
+ */
+
+
+// Library Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// Module Includes
+#include "rw_uring.h"
+#include "com_chan_log.h"
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+struct RW_Uring_s
+{
+    int                     ringFD;             ///< io_uring descriptor
+
+    void                   *pSqRing;            ///< Submission ring mapping
+    size_t                  sqRingSz;           ///< Submission ring mapping size
+    void                   *pCqRing;            ///< Completion ring mapping (may alias SQ)
+    size_t                  cqRingSz;           ///< Completion ring mapping size
+
+    struct io_uring_sqe    *pSqes;              ///< Submission entries array
+    size_t                  sqesSz;             ///< Submission entries mapping size
+
+    uint32_t               *pSqHead;            ///< Kernel consumed submissions
+    uint32_t               *pSqTail;            ///< Published submissions
+    uint32_t               *pSqArray;           ///< Submission index array
+    uint32_t                sqMask;             ///< Submission ring mask
+    uint32_t                sqEntries;          ///< Submission ring entries
+
+    uint32_t                sqeHead;            ///< First entry not yet published
+    uint32_t                sqeTail;            ///< Next entry handed to caller
+
+    uint32_t               *pCqHead;            ///< Consumed completions
+    uint32_t               *pCqTail;            ///< Kernel posted completions
+    uint32_t                cqMask;             ///< Completion ring mask
+    struct io_uring_cqe    *pCqes;              ///< Completion entries array
+};
+
+
+//*************************************
+// Module Utility Functions
+//*************************************
+static inline int _UringSetup(uint32_t nEntries, struct io_uring_params *pParams);
+static inline int _UringEnter(int ringFD, uint32_t toSubmit, uint32_t minComplete, uint32_t flags);
+static inline int _UringRegister(int ringFD, uint32_t opcode, const void *pArg, uint32_t nArgs);
+
+
+static inline int _UringSetup(uint32_t nEntries, struct io_uring_params *pParams)
+{
+    return (int)syscall(__NR_io_uring_setup, nEntries, pParams);
+}
+
+static inline int _UringEnter(int ringFD, uint32_t toSubmit, uint32_t minComplete, uint32_t flags)
+{
+    return (int)syscall(__NR_io_uring_enter, ringFD, toSubmit, minComplete, flags, NULL, 0);
+}
+
+static inline int _UringRegister(int ringFD, uint32_t opcode, const void *pArg, uint32_t nArgs)
+{
+    return (int)syscall(__NR_io_uring_register, ringFD, opcode, pArg, nArgs);
+}
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+RW_Uring_t* createUring(uint32_t nEntries)
+{
+    uint8_t *pSqRing, *pCqRing;
+
+    RW_Uring_t *pRing;
+    struct io_uring_params params;
+
+    if (nEntries == 0)
+    {
+        LOG_ERROR("Invalid input ring entries (%u)",
+                  nEntries);
+        return NULL;
+    }
+
+    pRing = (RW_Uring_t *)calloc(1, sizeof(RW_Uring_t));
+    if (pRing == NULL)
+    {
+        LOG_ERROR("Failed to allocate ring");
+        return NULL;
+    }
+
+    memset(&params, 0x00, sizeof(params));
+
+    pRing->ringFD = _UringSetup(nEntries, &params);
+    if (pRing->ringFD < 0)
+    {
+        LOG_ERROR("Failed to set up io_uring [%m]");
+        free(pRing);
+        return NULL;
+    }
+
+    /* Map submission and completion rings, single mapping on newer kernels */
+    pRing->sqRingSz = params.sq_off.array + (params.sq_entries * sizeof(uint32_t));
+    pRing->cqRingSz = params.cq_off.cqes  + (params.cq_entries * sizeof(struct io_uring_cqe));
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (pRing->cqRingSz > pRing->sqRingSz) { pRing->sqRingSz = pRing->cqRingSz; }
+        pRing->cqRingSz = pRing->sqRingSz;
+    }
+
+    pRing->pSqRing = mmap(NULL, pRing->sqRingSz, (PROT_READ | PROT_WRITE),
+                          (MAP_SHARED | MAP_POPULATE), pRing->ringFD, IORING_OFF_SQ_RING);
+    if (pRing->pSqRing == MAP_FAILED)
+    {
+        LOG_ERROR("Failed to map submission ring [%m]");
+        close(pRing->ringFD);
+        free(pRing);
+        return NULL;
+    }
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        pRing->pCqRing = pRing->pSqRing;
+    }
+    else
+    {
+        pRing->pCqRing = mmap(NULL, pRing->cqRingSz, (PROT_READ | PROT_WRITE),
+                              (MAP_SHARED | MAP_POPULATE), pRing->ringFD, IORING_OFF_CQ_RING);
+        if (pRing->pCqRing == MAP_FAILED)
+        {
+            LOG_ERROR("Failed to map completion ring [%m]");
+            munmap(pRing->pSqRing, pRing->sqRingSz);
+            close(pRing->ringFD);
+            free(pRing);
+            return NULL;
+        }
+    }
+
+    pRing->sqesSz = params.sq_entries * sizeof(struct io_uring_sqe);
+    pRing->pSqes  = (struct io_uring_sqe *)mmap(NULL, pRing->sqesSz, (PROT_READ | PROT_WRITE),
+                                                (MAP_SHARED | MAP_POPULATE), pRing->ringFD, IORING_OFF_SQES);
+    if (pRing->pSqes == MAP_FAILED)
+    {
+        LOG_ERROR("Failed to map submission entries [%m]");
+        if (pRing->pCqRing != pRing->pSqRing) { munmap(pRing->pCqRing, pRing->cqRingSz); }
+        munmap(pRing->pSqRing, pRing->sqRingSz);
+        close(pRing->ringFD);
+        free(pRing);
+        return NULL;
+    }
+
+    pSqRing = (uint8_t *)pRing->pSqRing;
+    pCqRing = (uint8_t *)pRing->pCqRing;
+
+    pRing->pSqHead   = (uint32_t *)(pSqRing + params.sq_off.head);
+    pRing->pSqTail   = (uint32_t *)(pSqRing + params.sq_off.tail);
+    pRing->pSqArray  = (uint32_t *)(pSqRing + params.sq_off.array);
+    pRing->sqMask    = *(uint32_t *)(pSqRing + params.sq_off.ring_mask);
+    pRing->sqEntries = *(uint32_t *)(pSqRing + params.sq_off.ring_entries);
+
+    pRing->pCqHead   = (uint32_t *)(pCqRing + params.cq_off.head);
+    pRing->pCqTail   = (uint32_t *)(pCqRing + params.cq_off.tail);
+    pRing->cqMask    = *(uint32_t *)(pCqRing + params.cq_off.ring_mask);
+    pRing->pCqes     = (struct io_uring_cqe *)(pCqRing + params.cq_off.cqes);
+
+    pRing->sqeHead   = *pRing->pSqTail;
+    pRing->sqeTail   = *pRing->pSqTail;
+
+    return pRing;
+}
+
+int destroyUring(RW_Uring_t *pRing)
+{
+    if (pRing == NULL)
+    {
+        LOG_ERROR("Invalid input ring %p",
+                  pRing);
+        return -1;
+    }
+
+    munmap(pRing->pSqes, pRing->sqesSz);
+    if (pRing->pCqRing != pRing->pSqRing) { munmap(pRing->pCqRing, pRing->cqRingSz); }
+    munmap(pRing->pSqRing, pRing->sqRingSz);
+
+    close(pRing->ringFD);
+    free(pRing);
+
+    return 0;
+}
+
+int registerUringBuffers(RW_Uring_t         *pRing,
+                         const struct iovec *pIoVectors,
+                         uint32_t            nVectors)
+{
+    if ( (pRing      == NULL) ||
+         (pIoVectors == NULL) )
+    {
+        LOG_ERROR("Invalid input arguments (%p, %p)",
+                  pRing, pIoVectors);
+        return -1;
+    }
+
+    /* Pin buffers once, fixed reads skip per-request page mapping */
+    if (_UringRegister(pRing->ringFD, IORING_REGISTER_BUFFERS, pIoVectors, nVectors) < 0)
+    {
+        LOG_ERROR("Failed to register ring buffers [%m]");
+        return -1;
+    }
+
+    return 0;
+}
+
+struct io_uring_sqe* getUringSqe(RW_Uring_t *pRing)
+{
+    uint32_t sqHead;
+    struct io_uring_sqe *pSqe;
+
+    sqHead = __atomic_load_n(pRing->pSqHead, __ATOMIC_ACQUIRE);
+
+    /* Submission ring is full, hand pending entries to kernel first */
+    if ((pRing->sqeTail - sqHead) >= pRing->sqEntries)
+    {
+        if (submitUring(pRing, 0) < 0) { return NULL; }
+
+        sqHead = __atomic_load_n(pRing->pSqHead, __ATOMIC_ACQUIRE);
+        if ((pRing->sqeTail - sqHead) >= pRing->sqEntries) { return NULL; }
+    }
+
+    pSqe = &pRing->pSqes[(pRing->sqeTail & pRing->sqMask)];
+    pRing->sqeTail++;
+
+    memset(pSqe, 0x00, sizeof(struct io_uring_sqe));
+
+    return pSqe;
+}
+
+int submitUring(RW_Uring_t *pRing, uint32_t waitNr)
+{
+    int retVal;
+    uint32_t sqTail, toSubmit;
+
+    /* Publish entries handed out since last submission */
+    sqTail   = *pRing->pSqTail;
+    toSubmit = pRing->sqeTail - pRing->sqeHead;
+
+    while (pRing->sqeHead != pRing->sqeTail)
+    {
+        pRing->pSqArray[(sqTail & pRing->sqMask)] = (pRing->sqeHead & pRing->sqMask);
+        sqTail++;
+        pRing->sqeHead++;
+    }
+
+    __atomic_store_n(pRing->pSqTail, sqTail, __ATOMIC_RELEASE);
+
+    if ( (toSubmit == 0) &&
+         (waitNr   == 0) )
+    {
+        return 0;
+    }
+
+    do
+    {
+        retVal = _UringEnter(pRing->ringFD, toSubmit, waitNr, ((waitNr > 0) ? IORING_ENTER_GETEVENTS : 0));
+    } while ( (retVal < 0) && (errno == EINTR) );
+
+    if (retVal < 0)
+    {
+        LOG_ERROR("Failed to enter io_uring [%m]");
+    }
+
+    return retVal;
+}
+
+struct io_uring_cqe* peekUringCqe(RW_Uring_t *pRing)
+{
+    uint32_t cqHead, cqTail;
+
+    cqHead = *pRing->pCqHead;
+    cqTail = __atomic_load_n(pRing->pCqTail, __ATOMIC_ACQUIRE);
+
+    if (cqHead == cqTail) { return NULL; }
+
+    return &pRing->pCqes[(cqHead & pRing->cqMask)];
+}
+
+void seenUringCqe(RW_Uring_t *pRing)
+{
+    __atomic_store_n(pRing->pCqHead, (*pRing->pCqHead + 1), __ATOMIC_RELEASE);
+}
+
+void prepUringRecvMultishot(struct io_uring_sqe *pSqe,
+                            int                  fd,
+                            uint16_t             bufGroup,
+                            uint64_t             userData)
+{
+    /* Stays armed, every datagram completes into a provided buffer */
+    pSqe->opcode    = IORING_OP_RECV;
+    pSqe->fd        = fd;
+    pSqe->ioprio    = IORING_RECV_MULTISHOT;
+    pSqe->flags     = IOSQE_BUFFER_SELECT;
+    pSqe->buf_group = bufGroup;
+    pSqe->user_data = userData;
+}
+
+void prepUringProvideBuffers(struct io_uring_sqe *pSqe,
+                             void                *pBuffers,
+                             uint32_t             bufLen,
+                             uint32_t             nBuffers,
+                             uint16_t             bufGroup,
+                             uint16_t             firstBufID,
+                             uint64_t             userData)
+{
+    pSqe->opcode    = IORING_OP_PROVIDE_BUFFERS;
+    pSqe->fd        = (int)nBuffers;
+    pSqe->addr      = (uint64_t)(uintptr_t)pBuffers;
+    pSqe->len       = bufLen;
+    pSqe->off       = firstBufID;
+    pSqe->buf_group = bufGroup;
+    pSqe->user_data = userData;
+}
+
+void prepUringReadFixed(struct io_uring_sqe *pSqe,
+                        int                  fd,
+                        void                *pBuf,
+                        uint32_t             len,
+                        uint64_t             offset,
+                        uint16_t             bufIndex,
+                        uint64_t             userData)
+{
+    pSqe->opcode    = IORING_OP_READ_FIXED;
+    pSqe->fd        = fd;
+    pSqe->addr      = (uint64_t)(uintptr_t)pBuf;
+    pSqe->len       = len;
+    pSqe->off       = offset;
+    pSqe->buf_index = bufIndex;
+    pSqe->user_data = userData;
+}
+
+void prepUringSendmsg(struct io_uring_sqe *pSqe,
+                      int                  fd,
+                      const struct msghdr *pMsgHdr,
+                      uint64_t             userData)
+{
+    pSqe->opcode    = IORING_OP_SENDMSG;
+    pSqe->fd        = fd;
+    pSqe->addr      = (uint64_t)(uintptr_t)pMsgHdr;
+    pSqe->len       = 1;
+    pSqe->user_data = userData;
+}
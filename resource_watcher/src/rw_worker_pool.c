@@ -0,0 +1,428 @@
+/**
+ * @file    rw_worker_pool.c
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Request worker pool for resource watcher; every worker
+ * owns its context (netlink socket, message buffer) and serves
+ * queued requests in parallel. Requests are queued per class and
+ * classes are served by weighted round robin.
+ */
+
+
+// Library Includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+// Module Includes
+#include "rw_worker_pool.h"
+#include "com_chan_log.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define RW_WORKER_NSEC_PER_SEC  1000000000LL
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+typedef struct RW_WorkerClass_s
+{
+    uint8_t                *pQueue;             ///< Request slots
+    int64_t                *pQueuedNs;          ///< Submission time per slot (monotonic ns)
+    uint32_t                head;               ///< Next slot to serve
+    uint32_t                count;              ///< Queued requests
+    uint32_t                weight;             ///< Requests served per round
+    uint32_t                deficit;            ///< Requests left in current round
+
+    uint64_t                nSubmitted;         ///< Requests queued
+    uint64_t                nOverflows;         ///< Requests refused with queue full
+    ComChan_StageHist_t     queueDelay;         ///< Time from submission to worker pickup
+} RW_WorkerClass_t;
+
+typedef struct RW_Worker_s
+{
+    RW_WorkerPool_t        *pPool;              ///< Owning pool
+    uint32_t                workerID;           ///< Worker index
+    pthread_t               thread;             ///< Worker thread
+    int                     started;            ///< Set if thread was created
+} RW_Worker_t;
+
+struct RW_WorkerPool_s
+{
+    pthread_mutex_t         lock;               ///< Protects queue and state
+    pthread_cond_t          notEmpty;           ///< Signalled on submission/stop
+    pthread_cond_t          readyCond;          ///< Signalled as workers finish init
+
+    RW_WorkerClass_t        classes[RW_WORKER_POOL_MAX_CLASSES]; ///< Request queue per class
+    uint32_t                nClasses;           ///< Number of classes
+    uint32_t                current;            ///< Class served in current round
+    size_t                  requestSz;          ///< Bytes per request slot
+    uint32_t                count;              ///< Queued requests of all classes
+
+    uint32_t                nWorkers;           ///< Number of workers
+    uint32_t                nReady;             ///< Workers done with init
+    uint32_t                nFailed;            ///< Workers failed init
+    int                     stop;               ///< Set on pool destruction
+
+    RW_WorkerInit_t         initCb;             ///< Worker context constructor
+    RW_WorkerHandler_t      handlerCb;          ///< Request handler
+    RW_WorkerExit_t         exitCb;             ///< Worker context destructor
+
+    RW_Worker_t             workers[RW_WORKER_POOL_MAX_WORKERS]; ///< Workers
+};
+
+
+//*************************************
+// Module Utility Functions
+//*************************************
+static inline int64_t getMonotonicNs(void);
+static void freeWorkerClasses(RW_WorkerPool_t *pPool);
+static uint32_t takeWorkerRequests(RW_WorkerPool_t *pPool, uint8_t *pRequests, uint32_t nRequests);
+static void* workerMain(void *pArg);
+
+
+static inline int64_t getMonotonicNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((int64_t)ts.tv_sec * RW_WORKER_NSEC_PER_SEC) + ts.tv_nsec;
+}
+
+static void freeWorkerClasses(RW_WorkerPool_t *pPool)
+{
+    uint32_t classID;
+
+    for (classID = 0; classID < pPool->nClasses; classID++)
+    {
+        free(pPool->classes[classID].pQueuedNs);
+        free(pPool->classes[classID].pQueue);
+    }
+}
+
+static uint32_t takeWorkerRequests(RW_WorkerPool_t *pPool, uint8_t *pRequests, uint32_t nRequests)
+{
+    uint32_t nTaken = 0;
+    int64_t  now = getMonotonicNs();
+
+    RW_WorkerClass_t *pClass;
+
+    /* Weighted round robin: class keeps turn until its weight is served or its queue is empty;
+       a round spans batches, so shares hold whatever batch size workers take */
+    while ( (nTaken < nRequests) &&
+            (pPool->count > 0) )
+    {
+        pClass = &pPool->classes[pPool->current];
+
+        if (pClass->count == 0)
+        {
+            pClass->deficit = 0;
+            pPool->current  = (pPool->current + 1) % pPool->nClasses;
+            continue;
+        }
+
+        if (pClass->deficit == 0) { pClass->deficit = pClass->weight; }
+
+        memcpy((pRequests + (nTaken * pPool->requestSz)),
+               (pClass->pQueue + (pClass->head * pPool->requestSz)),
+               pPool->requestSz);
+
+        recordComChanLatency(&pClass->queueDelay, (uint64_t)(now - pClass->pQueuedNs[pClass->head]));
+
+        pClass->head = (pClass->head + 1) % RW_WORKER_POOL_QUEUE_DEPTH;
+        pClass->count--;
+        pClass->deficit--;
+        pPool->count--;
+        nTaken++;
+
+        if ( (pClass->deficit == 0) ||
+             (pClass->count   == 0) )
+        {
+            pClass->deficit = 0;
+            pPool->current  = (pPool->current + 1) % pPool->nClasses;
+        }
+    }
+
+    return nTaken;
+}
+
+
+static void* workerMain(void *pArg)
+{
+    RW_Worker_t     *pWorker = (RW_Worker_t *)pArg;
+    RW_WorkerPool_t *pPool   = pWorker->pPool;
+
+    void *pWorkerCtx;
+    uint8_t *pRequests;
+    uint32_t nRequests;
+
+    /* Worker owned context and request batch buffer */
+    pWorkerCtx = pPool->initCb(pWorker->workerID);
+    pRequests  = (uint8_t *)malloc(pPool->requestSz * RW_WORKER_POOL_MAX_BATCH);
+
+    pthread_mutex_lock(&pPool->lock);
+
+    if ( (pWorkerCtx == NULL) ||
+         (pRequests  == NULL) )
+    {
+        pPool->nFailed++;
+        pthread_cond_signal(&pPool->readyCond);
+        pthread_mutex_unlock(&pPool->lock);
+
+        if (pWorkerCtx != NULL) { pPool->exitCb(pWorkerCtx); }
+        free(pRequests);
+        return NULL;
+    }
+
+    pPool->nReady++;
+    pthread_cond_signal(&pPool->readyCond);
+
+    while (1)
+    {
+        while ( (pPool->count == 0) &&
+                (pPool->stop  == 0) )
+        {
+            pthread_cond_wait(&pPool->notEmpty, &pPool->lock);
+        }
+
+        if (pPool->count == 0) { break; }   // Stopped and drained
+
+        /* Take fair share of queued requests, leaving the rest to other workers */
+        nRequests = (pPool->count + pPool->nWorkers - 1) / pPool->nWorkers;
+        if (nRequests > RW_WORKER_POOL_MAX_BATCH) { nRequests = RW_WORKER_POOL_MAX_BATCH; }
+
+        nRequests = takeWorkerRequests(pPool, pRequests, nRequests);
+
+        pthread_mutex_unlock(&pPool->lock);
+
+        /* Serve requests outside pool lock */
+        pPool->handlerCb(pWorkerCtx, pRequests, nRequests);
+
+        pthread_mutex_lock(&pPool->lock);
+    }
+
+    pthread_mutex_unlock(&pPool->lock);
+
+    pPool->exitCb(pWorkerCtx);
+    free(pRequests);
+
+    return NULL;
+}
+
+
+//*************************************
+// Module Interface Functions
+//*************************************
+RW_WorkerPool_t* createWorkerPool(uint32_t           nWorkers,
+                                  size_t             requestSz,
+                                  uint32_t           nClasses,
+                                  const uint32_t    *pWeights,
+                                  RW_WorkerInit_t    initCb,
+                                  RW_WorkerHandler_t handlerCb,
+                                  RW_WorkerExit_t    exitCb)
+{
+    uint32_t idx;
+    RW_WorkerPool_t *pPool;
+
+    if ( (nWorkers  == 0) ||
+         (requestSz == 0) ||
+         (nClasses  == 0) ||
+         (nClasses  > RW_WORKER_POOL_MAX_CLASSES) ||
+         (pWeights  == NULL) ||
+         (initCb    == NULL) ||
+         (handlerCb == NULL) ||
+         (exitCb    == NULL) )
+    {
+        LOG_ERROR("Invalid input arguments (%u, %zu, %u, %p, %p, %p, %p)",
+                  nWorkers, requestSz,
+                  nClasses, pWeights,
+                  initCb, handlerCb, exitCb);
+        return NULL;
+    }
+
+    if (nWorkers > RW_WORKER_POOL_MAX_WORKERS) { nWorkers = RW_WORKER_POOL_MAX_WORKERS; }
+
+    pPool = (RW_WorkerPool_t *)calloc(1, sizeof(RW_WorkerPool_t));
+    if (pPool == NULL)
+    {
+        LOG_ERROR("Failed to allocate worker pool");
+        return NULL;
+    }
+
+    pPool->nClasses = nClasses;
+
+    for (idx = 0; idx < nClasses; idx++)
+    {
+        pPool->classes[idx].weight    = (pWeights[idx] > 0) ? pWeights[idx] : 1;
+        pPool->classes[idx].pQueue    = (uint8_t *)malloc(RW_WORKER_POOL_QUEUE_DEPTH * requestSz);
+        pPool->classes[idx].pQueuedNs = (int64_t *)malloc(RW_WORKER_POOL_QUEUE_DEPTH * sizeof(int64_t));
+
+        if ( (pPool->classes[idx].pQueue    == NULL) ||
+             (pPool->classes[idx].pQueuedNs == NULL) )
+        {
+            LOG_ERROR("Failed to allocate worker queue of class %u",
+                      idx);
+            freeWorkerClasses(pPool);
+            free(pPool);
+            return NULL;
+        }
+    }
+
+    pthread_mutex_init(&pPool->lock, NULL);
+    pthread_cond_init(&pPool->notEmpty, NULL);
+    pthread_cond_init(&pPool->readyCond, NULL);
+
+    pPool->requestSz = requestSz;
+    pPool->nWorkers  = nWorkers;
+    pPool->initCb    = initCb;
+    pPool->handlerCb = handlerCb;
+    pPool->exitCb    = exitCb;
+
+    for (idx = 0; idx < nWorkers; idx++)
+    {
+        pPool->workers[idx].pPool    = pPool;
+        pPool->workers[idx].workerID = idx;
+
+        if (pthread_create(&pPool->workers[idx].thread, NULL, workerMain, &pPool->workers[idx]) != 0)
+        {
+            LOG_ERROR("Failed to create worker %u",
+                      idx);
+
+            pthread_mutex_lock(&pPool->lock);
+            pPool->nFailed++;
+            pthread_mutex_unlock(&pPool->lock);
+            continue;
+        }
+
+        pPool->workers[idx].started = 1;
+    }
+
+    /* Wait for all workers to set up their contexts */
+    pthread_mutex_lock(&pPool->lock);
+    while ((pPool->nReady + pPool->nFailed) < nWorkers)
+    {
+        pthread_cond_wait(&pPool->readyCond, &pPool->lock);
+    }
+    pthread_mutex_unlock(&pPool->lock);
+
+    if (pPool->nFailed > 0)
+    {
+        LOG_ERROR("%u of %u workers failed to start",
+                  pPool->nFailed, nWorkers);
+        destroyWorkerPool(pPool);
+        return NULL;
+    }
+
+    return pPool;
+}
+
+int destroyWorkerPool(RW_WorkerPool_t *pPool)
+{
+    uint32_t idx;
+
+    if (pPool == NULL)
+    {
+        LOG_ERROR("Invalid input worker pool %p",
+                  pPool);
+        return -1;
+    }
+
+    /* Workers drain queued requests before exiting */
+    pthread_mutex_lock(&pPool->lock);
+    pPool->stop = 1;
+    pthread_cond_broadcast(&pPool->notEmpty);
+    pthread_mutex_unlock(&pPool->lock);
+
+    for (idx = 0; idx < pPool->nWorkers; idx++)
+    {
+        if (pPool->workers[idx].started) { pthread_join(pPool->workers[idx].thread, NULL); }
+    }
+
+    pthread_cond_destroy(&pPool->readyCond);
+    pthread_cond_destroy(&pPool->notEmpty);
+    pthread_mutex_destroy(&pPool->lock);
+
+    freeWorkerClasses(pPool);
+    free(pPool);
+
+    return 0;
+}
+
+int submitWorkerRequest(RW_WorkerPool_t *pPool, const void *pRequest, uint32_t classID)
+{
+    uint32_t tail;
+    int64_t  now = getMonotonicNs();
+
+    RW_WorkerClass_t *pClass;
+
+    if ( (pPool    == NULL) ||
+         (pRequest == NULL) )
+    {
+        LOG_ERROR("Invalid input arguments (%p, %p)",
+                  pPool, pRequest);
+        return -1;
+    }
+
+    /* Unknown class is queued with first class */
+    if (classID >= pPool->nClasses) { classID = 0; }
+    pClass = &pPool->classes[classID];
+
+    pthread_mutex_lock(&pPool->lock);
+
+    /* Full class doesn't take slots of other classes */
+    if (pClass->count == RW_WORKER_POOL_QUEUE_DEPTH)
+    {
+        pClass->nOverflows++;
+        pthread_mutex_unlock(&pPool->lock);
+        return -1;
+    }
+
+    tail = (pClass->head + pClass->count) % RW_WORKER_POOL_QUEUE_DEPTH;
+    memcpy((pClass->pQueue + (tail * pPool->requestSz)), pRequest, pPool->requestSz);
+    pClass->pQueuedNs[tail] = now;
+    pClass->count++;
+    pClass->nSubmitted++;
+    pPool->count++;
+
+    pthread_cond_signal(&pPool->notEmpty);
+    pthread_mutex_unlock(&pPool->lock);
+
+    return 0;
+}
+
+uint32_t getWorkerCount(const RW_WorkerPool_t *pPool)
+{
+    return (pPool != NULL) ? pPool->nWorkers : 0;
+}
+
+int getWorkerClassStats(RW_WorkerPool_t *pPool, uint32_t classID, RW_WorkerClassStats_t *pStats)
+{
+    const RW_WorkerClass_t *pClass;
+
+    if ( (pPool  == NULL) ||
+         (pStats == NULL) ||
+         (classID >= pPool->nClasses) )
+    {
+        return -1;
+    }
+
+    pClass = &pPool->classes[classID];
+
+    pthread_mutex_lock(&pPool->lock);
+
+    pStats->nSubmitted = pClass->nSubmitted;
+    pStats->nOverflows = pClass->nOverflows;
+    pStats->nQueued    = pClass->count;
+    pStats->weight     = pClass->weight;
+    memcpy(&pStats->queueDelay, &pClass->queueDelay, sizeof(ComChan_StageHist_t));
+
+    pthread_mutex_unlock(&pPool->lock);
+
+    return 0;
+}
@@ -0,0 +1,465 @@
+/**
+ * @file    traffic_replay_main.c
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Relay traffic replay; queries captured by resource
+ * watcher are sent back through communication module, at original
+ * pacing or as fast as reply window allows, and replies are timed.
+ */
+
+
+// Library Includes
+#define _GNU_SOURCE                         // recvmmsg(), sendmmsg()
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+#include <sys/types.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+
+#include <linux/netlink.h>
+
+// Module Includes
+#include "com_chan_capture.h"
+#include "com_chan_client.h"
+#include "com_chan_socket.h"
+#include "com_chan_trace.h"
+#include "com_chan_log.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define MAX_EPOLL_EVENTS        2
+#define EPOLL_EVENTS_TIMEOUT    1           // Seconds
+
+#define QUERY_MAX_OUTSTANDING   1024        // Default replay window (queries in flight)
+#define QUERY_REPLY_TIMEOUT     2           // Seconds
+
+#define REPLAY_NSEC_PER_SEC     1000000000LL
+#define REPLAY_OPTIONS          "f:ps:w:x:h"
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+typedef struct ReplaySignature_s
+{
+    const char             *pName;              ///< Signature name on command line
+    uint32_t                serviceSig;         ///< Service signature queries are replayed with
+} ReplaySignature_t;
+
+typedef struct ReplayContext_s
+{
+    ComChan_Client_t        *pClient;           ///< Asynchronous query client
+    ComChan_CaptureReader_t *pReader;           ///< Captured trace
+    int                      timerFD;           ///< Pacing timer, armed at next record due time
+
+    ComChan_Message_t        nextMsg;           ///< Next record to submit
+    int64_t                  nextOffsetNs;      ///< Trace offset of next record
+    int                      nextValid;         ///< Next record loaded, 0 at end of trace
+
+    int64_t                  startNs;           ///< Replay start (monotonic ns)
+    int64_t                  firstOffsetNs;     ///< Trace offset of first record
+
+    uint64_t                 nSubmitted;        ///< Records submitted
+    uint64_t                 nSkipped;          ///< Records not replayed (subscriptions, registrations)
+    uint64_t                 nReplies;          ///< Queries completed by a reply
+    uint64_t                 nExpired;          ///< Queries expired without reply
+
+    int64_t                  sumLateNs;         ///< Paced submissions lateness sum
+    int64_t                  maxLateNs;         ///< Paced submissions largest lateness
+} ReplayContext_t;
+
+
+//*************************************
+// Module Utility Functions
+//*************************************
+static inline int64_t getMonotonicNs(void);
+static void handleReplayReply(void *pArg, uint32_t seqID, const ComChan_Message_t *pReply);
+static int loadNextRecord(ReplayContext_t *pContext);
+static int parseReplayOptions(int argc, char **args);
+static void printReplayReport(const ReplayContext_t *pContext, int64_t durationNs);
+static void printUsage(const char *pExecutable);
+static int submitDueRecords(ReplayContext_t *pContext);
+
+
+//*************************************
+// Module Local Variables
+//*************************************
+static const ReplaySignature_t replaySignatures[] =
+{
+    { "wa", COM_NETLINK_WA_SIG },
+    { "dw", COM_NETLINK_DW_SIG },
+    { "mw", COM_NETLINK_MW_SIG },
+    { "lg", COM_NETLINK_LG_SIG },
+};
+
+#define REPLAY_SIGNATURES_MAX   (sizeof(replaySignatures) / sizeof(replaySignatures[0]))
+
+static const char *pTracePath   = NULL;
+static uint32_t    replaySig    = COM_NETLINK_WA_SIG;
+static uint32_t    replayWindow = QUERY_MAX_OUTSTANDING;
+static int         replayPaced  = 0;
+static double      replaySpeed  = 1.0;
+
+
+static inline int64_t getMonotonicNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((int64_t)ts.tv_sec * REPLAY_NSEC_PER_SEC) + ts.tv_nsec;
+}
+
+static void handleReplayReply(void *pArg, __attribute__((unused)) uint32_t seqID, const ComChan_Message_t *pReply)
+{
+    ReplayContext_t *pContext = (ReplayContext_t *)pArg;
+
+    /* Reply latencies are recorded by client, only outcome is counted here */
+    if (pReply == NULL) { pContext->nExpired++; }
+    else                { pContext->nReplies++; }
+}
+
+static int loadNextRecord(ReplayContext_t *pContext)
+{
+    int retVal;
+
+    /* Subscriptions would keep pushing after replay ends, registrations belong to capturing host */
+    while ((retVal = readCaptureRecord(pContext->pReader, &pContext->nextOffsetNs, &pContext->nextMsg)) > 0)
+    {
+        if ( (pContext->nextMsg.resourceInfoID != SUBSCRIBE_RESOURCE_INFO) &&
+             (pContext->nextMsg.resourceInfoID != SERVICE_RESOURCE_INFO) &&
+             (pContext->nextMsg.resourceInfoID != INVALID_RESOURCE_INFO_ID) )
+        {
+            break;
+        }
+
+        pContext->nSkipped++;
+    }
+
+    pContext->nextValid = (retVal > 0);
+
+    return retVal;
+}
+
+static int parseReplayOptions(int argc, char **args)
+{
+    int option;
+    uint32_t sig;
+
+    char *pEnd;
+    unsigned long window;
+
+    while ((option = getopt(argc, args, REPLAY_OPTIONS)) != -1)
+    {
+        if (option == 'f')
+        {
+            pTracePath = optarg;
+        }
+        else if (option == 'p')
+        {
+            replayPaced = 1;
+        }
+        else if (option == 'x')
+        {
+            /* Pacing speed up, implies original pacing */
+            errno       = 0;
+            replaySpeed = strtod(optarg, &pEnd);
+
+            if ( (errno != 0) ||
+                 (*pEnd != '\0') ||
+                 (replaySpeed <= 0.0) )
+            {
+                LOG_ERROR("Invalid replay speed '%s'",
+                          optarg);
+                return -1;
+            }
+
+            replayPaced = 1;
+        }
+        else if (option == 'w')
+        {
+            errno  = 0;
+            window = strtoul(optarg, &pEnd, 10);
+
+            if ( (errno != 0) ||
+                 (*pEnd != '\0') ||
+                 (window == 0) ||
+                 (window > 65536) )
+            {
+                LOG_ERROR("Invalid replay window '%s'",
+                          optarg);
+                return -1;
+            }
+
+            replayWindow = (uint32_t)window;
+        }
+        else if (option == 's')
+        {
+            for (sig = 0; sig < REPLAY_SIGNATURES_MAX; sig++)
+            {
+                if (strcmp(optarg, replaySignatures[sig].pName) == 0) { break; }
+            }
+
+            if (sig == REPLAY_SIGNATURES_MAX)
+            {
+                LOG_ERROR("Unknown signature '%s'",
+                          optarg);
+                return -1;
+            }
+
+            replaySig = replaySignatures[sig].serviceSig;
+        }
+        else
+        {
+            printUsage(args[0]);
+            return -1;
+        }
+    }
+
+    if (pTracePath == NULL)
+    {
+        printUsage(args[0]);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void printReplayReport(const ReplayContext_t *pContext, int64_t durationNs)
+{
+    double durationSec = (double)durationNs / REPLAY_NSEC_PER_SEC;
+
+    ComChan_ClientStats_t clientStats;
+
+    if (durationSec <= 0.0) { durationSec = 1e-9; }
+
+    printf("Replay Summary (%lu queries in %.3f s | %.1f queries/s | %lu replies | %lu expired | %lu skipped)\n",
+            pContext->nSubmitted, durationSec,
+            ((double)pContext->nSubmitted / durationSec),
+            pContext->nReplies, pContext->nExpired,
+            pContext->nSkipped);
+
+    if ( replayPaced &&
+         (pContext->nSubmitted > 0) )
+    {
+        printf("Replay Pacing (x%.2f | lateness avg %ld us, max %ld us)\n",
+                replaySpeed,
+                (pContext->sumLateNs / (int64_t)pContext->nSubmitted / 1000),
+                (pContext->maxLateNs / 1000));
+    }
+
+    if (getComChanClientStats(pContext->pClient, &clientStats) == 0)
+    {
+        printComChanStages(&clientStats.stages, "Replay");
+    }
+}
+
+static void printUsage(const char *pExecutable)
+{
+    printf("Usage: %s -f trace [-p] [-x speed] [-w window] [-s wa|dw|mw|lg]\n", pExecutable);
+    printf("  -f trace   Trace captured by resource watcher (rwatcher_1.0 -r trace)\n");
+    printf("  -p         Replay at original pacing, default is as fast as possible\n");
+    printf("  -x speed   Replay at original pacing sped up by speed (e.g. 2.5)\n");
+    printf("  -w window  Queries in flight (default %u)\n", QUERY_MAX_OUTSTANDING);
+    printf("  -s sig     Signature replayed queries are sent with (default wa), its service must not be running\n");
+}
+
+static int submitDueRecords(ReplayContext_t *pContext)
+{
+    int64_t now, dueNs, lateNs;
+    struct itimerspec timerSpec;
+
+    while (pContext->nextValid)
+    {
+        if (replayPaced)
+        {
+            /* Record is due at its trace offset from first record, scaled by speed */
+            now   = getMonotonicNs();
+            dueNs = pContext->startNs + (int64_t)((double)(pContext->nextOffsetNs - pContext->firstOffsetNs) / replaySpeed);
+
+            if (dueNs > now)
+            {
+                memset(&timerSpec, 0x00, sizeof(timerSpec));
+                timerSpec.it_value.tv_sec  = (dueNs / REPLAY_NSEC_PER_SEC);
+                timerSpec.it_value.tv_nsec = (dueNs % REPLAY_NSEC_PER_SEC);
+
+                if (timerfd_settime(pContext->timerFD, TFD_TIMER_ABSTIME, &timerSpec, NULL) < 0)
+                {
+                    LOG_ERROR("Failed to arm pacing timer [%m]");
+                    return -1;
+                }
+                break;
+            }
+
+            lateNs = now - dueNs;
+            pContext->sumLateNs += lateNs;
+            if (lateNs > pContext->maxLateNs) { pContext->maxLateNs = lateNs; }
+        }
+
+        /* Window full, submission resumes as replies arrive */
+        if (submitComChanQuery(pContext->pClient, &pContext->nextMsg, handleReplayReply, pContext) == COM_CHAN_SEQ_NONE)
+        {
+            if (errno == EAGAIN) { break; }
+            return -1;
+        }
+
+        pContext->nSubmitted++;
+
+        if (loadNextRecord(pContext) < 0) { return -1; }
+    }
+
+    return flushComChanClient(pContext->pClient);
+}
+
+
+//*************************************
+// Module Main Function
+//*************************************
+int main(int argc, char **args)
+{
+    unsigned char TR_SERVICE_RUNNING = 0x01;
+
+    uint64_t nExpirations;
+    int64_t  durationNs;
+
+    ComChan_Client_t *pClient;
+    ComChan_CaptureReader_t *pReader;
+    ReplayContext_t replayContext;
+
+    int epollFD, timerFD, nEvents;
+    struct epoll_event epollEvents[MAX_EPOLL_EVENTS];
+
+    /* Errors and warnings are written by log thread */
+    if (startComChanLog(STDOUT_FILENO) < 0) { return EXIT_FAILURE; }
+
+    /* Configure trace, pacing and window */
+    if (parseReplayOptions(argc, args) < 0) { return EXIT_FAILURE; }
+
+    /* Open captured trace */
+    pReader = openCaptureReader(pTracePath);
+    if (pReader == NULL) { return EXIT_FAILURE; }
+
+    /* Create asynchronous query client, window bounds queries in flight */
+    pClient = createComChanClient(replaySig, replayWindow, (QUERY_REPLY_TIMEOUT * REPLAY_NSEC_PER_SEC));
+    if (pClient == NULL)
+    {
+        closeCaptureReader(pReader);
+        return EXIT_FAILURE;
+    }
+
+    /* Create pacing timer */
+    timerFD = timerfd_create(CLOCK_MONOTONIC, (TFD_NONBLOCK | TFD_CLOEXEC));
+    if (timerFD < 0)
+    {
+        LOG_ERROR("Failed to create pacing timer [%m]");
+
+        destroyComChanClient(pClient);
+        closeCaptureReader(pReader);
+        return EXIT_FAILURE;
+    }
+
+    /* Create event polling setup */
+    epollFD = epoll_create1(0);
+    if (epollFD < 0)
+    {
+        LOG_ERROR("Failed to create epoll [%m]");
+
+        close(timerFD);
+        destroyComChanClient(pClient);
+        closeCaptureReader(pReader);
+        return EXIT_FAILURE;
+    }
+
+    /* Register query client and pacing timer for events polling */
+    if ( (registerEvent(epollFD, getComChanClientFD(pClient)) < 0) ||
+         (registerEvent(epollFD, timerFD) < 0) )
+    {
+        close(epollFD);
+        close(timerFD);
+        destroyComChanClient(pClient);
+        closeCaptureReader(pReader);
+        return EXIT_FAILURE;
+    }
+
+
+    /* Send service information message, replies are routed back by replay signature */
+    if (registerComChanClient(pClient, "127.0.0.1") < 0)
+    {
+        close(epollFD);
+        close(timerFD);
+        destroyComChanClient(pClient);
+        closeCaptureReader(pReader);
+        return EXIT_FAILURE;
+    }
+
+
+    /* Load first record, pacing is relative to it */
+    memset(&replayContext, 0x00, sizeof(ReplayContext_t));
+    replayContext.pClient = pClient;
+    replayContext.pReader = pReader;
+    replayContext.timerFD = timerFD;
+
+    if (loadNextRecord(&replayContext) < 0) { TR_SERVICE_RUNNING = 0; }
+
+    replayContext.firstOffsetNs = replayContext.nextOffsetNs;
+    replayContext.startNs       = getMonotonicNs();
+
+    if (submitDueRecords(&replayContext) < 0) { TR_SERVICE_RUNNING = 0; }
+
+    /* Traffic replay business logic, runs until trace is sent and every query completed */
+    while ( TR_SERVICE_RUNNING &&
+            ( replayContext.nextValid ||
+              (replayContext.nSubmitted > (replayContext.nReplies + replayContext.nExpired)) ) )
+    {
+        /* Wait for events */
+        nEvents = epoll_wait(epollFD, epollEvents, MAX_EPOLL_EVENTS, (EPOLL_EVENTS_TIMEOUT * 1000));
+
+        /* Process events */
+        while (nEvents > 0)
+        {
+            if (epollEvents[(nEvents - 1)].data.fd == getComChanClientFD(pClient))
+            {
+                /* Complete queries with received replies, expire overdue ones */
+                if (handleComChanClient(pClient) < 0)
+                {
+                    TR_SERVICE_RUNNING = 0;
+                    break;
+                }
+            }
+            else if (epollEvents[(nEvents - 1)].data.fd == timerFD)
+            {
+                /* Acknowledge pacing timer, due records are submitted below */
+                if (read(timerFD, &nExpirations, sizeof(nExpirations)) < 0) { nExpirations = 0; }
+            }
+
+            nEvents--;
+        }
+
+        /* Submit records due by now or admitted by freed window slots */
+        if (submitDueRecords(&replayContext) < 0) { TR_SERVICE_RUNNING = 0; }
+    }
+
+    durationNs = getMonotonicNs() - replayContext.startNs;
+
+    /* Report throughput and stage latencies */
+    printReplayReport(&replayContext, durationNs);
+
+
+    /* Close polling descriptor and pacing timer */
+    close(epollFD);
+    close(timerFD);
+
+    /* Destroy query client and close trace */
+    destroyComChanClient(pClient);
+    closeCaptureReader(pReader);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,661 @@
+/**
+ * @file    watcher_agent_main.c
+ * @author  Kamran Rauf
+ * @date    25 July 2017
+ * @version 0.1
+ * @brief  Multiplexed system resource (disk, memory, cpu)
+ * watcher agent; any set of resource queries served over one
+ * registration, one socket and one event loop.
+ */
+
+
+// Library Includes
+#define _GNU_SOURCE                         // recvmmsg(), sendmmsg()
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+#include <sys/types.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include <linux/netlink.h>
+
+// Module Includes
+#include "com_chan_cache.h"
+#include "com_chan_client.h"
+#include "com_chan_socket.h"
+#include "com_chan_timer_wheel.h"
+#include "com_chan_log.h"
+
+
+//*************************************
+// Module Macro Definitions
+//*************************************
+#define MAX_EPOLL_EVENTS        2
+#define EPOLL_EVENTS_TIMEOUT    10          // Seconds
+
+#define STATS_REPORT_TIMEOUT    60          // Seconds
+
+#define QUERY_SCHEDULES_MAX     16          // Timer wheel capacity
+
+#define QUERY_MAX_OUTSTANDING   256         // Queries in flight
+#define QUERY_REPLY_TIMEOUT     2           // Seconds
+
+#define RESOURCE_CACHE_ENTRIES  16          // Cached resource keys
+
+#define AGENT_OPTIONS           "a:d:m:c:n:f:u:g:D:M:Q:s:h"
+
+#define AGENT_FRAG_COSTLY_ORDER 3           // Highest order kernel retries hard (network stack page frags)
+#define AGENT_FRAG_HUGE_ORDER   9           // Huge page order if pageblock order is not reported
+#define AGENT_DU_MAX_DEPTH      2           // Deepest directory level ranked by usage queries
+#define AGENT_DU_GROWTH_WINDOW  15          // Minutes of growth ranked by growth queries
+
+#define AGENT_SUMMARY_MASK      (RW_RESOURCE_MASK(DISK_RESOURCE_INFO)   | \
+                                 RW_RESOURCE_MASK(MEMORY_RESOURCE_INFO) | \
+                                 RW_RESOURCE_MASK(CPU_RESOURCE_INFO))
+
+
+//*************************************
+// Module Data Structures
+//*************************************
+struct AgentContext_s;
+
+typedef struct AgentQuery_s
+{
+    char                    option;             ///< Command line option setting query period
+    const char             *pName;              ///< Query name, printed with results
+
+    uint32_t                resourceInfoID;     ///< Resource information identifier
+    uint16_t                metricID;           ///< History/quantile metric (RW_METRIC_*)
+    uint16_t                resolution;         ///< History resolution (RW_HISTORY_RES_*), growth window (minutes) of usage
+
+    uint32_t                period;             ///< Query period (seconds), 0 if disabled
+    int                     timerID;            ///< Query schedule
+
+    void                  (*printCb)(const struct AgentQuery_s *pQuery, const ComChan_Message_t *pInfo);
+    struct AgentContext_s  *pContext;           ///< Agent context
+} AgentQuery_t;
+
+typedef struct AgentContext_s
+{
+    ComChan_Client_t       *pClient;            ///< Asynchronous query client
+    ComChan_Cache_t        *pCache;             ///< Resource information cache
+
+    TW_TimerWheel_t        *pWheel;             ///< Query schedules
+    int                     statsTimerID;       ///< Statistics report schedule
+} AgentContext_t;
+
+
+//*************************************
+// Module Utility Functions
+//*************************************
+static void handleQueryReply(void *pArg, uint32_t seqID, const ComChan_Message_t *pReply);
+static int parseAgentOptions(int argc, char **args);
+static void printAgentStats(void *pArg);
+static void printCpuInfo(const AgentQuery_t *pQuery, const ComChan_Message_t *pInfo);
+static void printCpuUtil(const char *pName, const RW_CpuInfo_t *pCpuInfo);
+static void printDuInfo(const AgentQuery_t *pQuery, const ComChan_Message_t *pInfo);
+static void printFragInfo(const AgentQuery_t *pQuery, const ComChan_Message_t *pInfo);
+static void printHistoryInfo(const AgentQuery_t *pQuery, const ComChan_Message_t *pInfo);
+static void printNumaInfo(const AgentQuery_t *pQuery, const ComChan_Message_t *pInfo);
+static void printQuantileInfo(const AgentQuery_t *pQuery, const ComChan_Message_t *pInfo);
+static void printStorageInfo(const AgentQuery_t *pQuery, const ComChan_Message_t *pInfo);
+static void printSummaryInfo(const AgentQuery_t *pQuery, const ComChan_Message_t *pInfo);
+static void printUsage(const char *pExecutable);
+static void runAgentQuery(void *pArg);
+
+
+//*************************************
+// Module Local Variables
+//*************************************
+static AgentQuery_t agentQueries[] =
+{
+    { 'a', "Resource Summary",   MULTI_RESOURCE_INFO,    0,                     0,                       5,  -1, printSummaryInfo,  NULL },
+    { 'd', "Disk Information",   DISK_RESOURCE_INFO,     0,                     0,                       0,  -1, printStorageInfo,  NULL },
+    { 'm', "Memory Information", MEMORY_RESOURCE_INFO,   0,                     0,                       0,  -1, printStorageInfo,  NULL },
+    { 'c', "CPU Information",    CPU_RESOURCE_INFO,      0,                     0,                       0,  -1, printCpuInfo,      NULL },
+    { 'n', "NUMA Information",   NUMA_RESOURCE_INFO,     0,                     0,                       0,  -1, printNumaInfo,     NULL },
+    { 'f', "Fragmentation",      FRAG_RESOURCE_INFO,     0,                     0,                       0,  -1, printFragInfo,     NULL },
+    { 'u', "Disk Usage",         DU_RESOURCE_INFO,       0,                     0,                       0,  -1, printDuInfo,       NULL },
+    { 'g', "Disk Growth",        DU_RESOURCE_INFO,       0,                     AGENT_DU_GROWTH_WINDOW,  0,  -1, printDuInfo,       NULL },
+    { 'D', "Disk History",       HISTORY_RESOURCE_INFO,  RW_METRIC_DISK_FREE,   RW_HISTORY_RES_10S,      60, -1, printHistoryInfo,  NULL },
+    { 'M', "Memory History",     HISTORY_RESOURCE_INFO,  RW_METRIC_MEMORY_FREE, RW_HISTORY_RES_1S,       60, -1, printHistoryInfo,  NULL },
+    { 'Q', "Memory Quantiles",   QUANTILE_RESOURCE_INFO, RW_METRIC_MEMORY_FREE, 0,                       60, -1, printQuantileInfo, NULL },
+};
+
+#define AGENT_QUERIES_MAX       (sizeof(agentQueries) / sizeof(agentQueries[0]))
+
+static uint32_t statsPeriod = STATS_REPORT_TIMEOUT;
+
+
+static void handleQueryReply(void *pArg, uint32_t seqID, const ComChan_Message_t *pReply)
+{
+    AgentQuery_t *pQuery = (AgentQuery_t *)pArg;
+
+    if (pReply == NULL)
+    {
+        LOG_WARNING("%s query %u expired without reply",
+                    pQuery->pName, seqID);
+        return;
+    }
+
+    pQuery->printCb(pQuery, pReply);
+}
+
+static int parseAgentOptions(int argc, char **args)
+{
+    int option;
+    uint32_t query;
+
+    char *pEnd;
+    unsigned long period;
+
+    while ((option = getopt(argc, args, AGENT_OPTIONS)) != -1)
+    {
+        if (option == 'h')
+        {
+            printUsage(args[0]);
+            return -1;
+        }
+
+        /* Every option but help carries a period in seconds */
+        if (option != '?')
+        {
+            errno  = 0;
+            period = strtoul(optarg, &pEnd, 10);
+
+            if ( (errno != 0) ||
+                 (*pEnd != '\0') ||
+                 (period > UINT32_MAX) )
+            {
+                LOG_ERROR("Invalid period '%s' for option -%c",
+                          optarg, option);
+                return -1;
+            }
+
+            if (option == 's')
+            {
+                /* Statistics report period is not a query */
+                statsPeriod = (uint32_t)period;
+                continue;
+            }
+
+            for (query = 0; query < AGENT_QUERIES_MAX; query++)
+            {
+                if (agentQueries[query].option == option)
+                {
+                    agentQueries[query].period = (uint32_t)period;
+                    break;
+                }
+            }
+
+            if (query < AGENT_QUERIES_MAX) { continue; }
+        }
+
+        printUsage(args[0]);
+        return -1;
+    }
+
+    return 0;
+}
+
+static void printAgentStats(void *pArg)
+{
+    AgentContext_t *pContext = (AgentContext_t *)pArg;
+
+    uint32_t query;
+
+    TW_TimerStats_t       timerStats;
+    ComChan_ClientStats_t clientStats;
+    ComChan_CacheStats_t  cacheStats;
+
+    /* Report query schedules precision */
+    for (query = 0; query < AGENT_QUERIES_MAX; query++)
+    {
+        if ( (agentQueries[query].timerID < 0) ||
+             (getTimerStats(pContext->pWheel, agentQueries[query].timerID, &timerStats) < 0) ||
+             (timerStats.nFired == 0) )
+        {
+            continue;
+        }
+
+        printf("%s Schedule (%lu fired, %lu missed | late avg %ld us, max %ld us | jitter avg %ld us, max %ld us)\n",
+                agentQueries[query].pName,
+                timerStats.nFired, timerStats.nMissed,
+                (timerStats.sumLateNs / (int64_t)timerStats.nFired / 1000), (timerStats.maxLateNs / 1000),
+                (timerStats.sumJitterNs / (int64_t)timerStats.nFired / 1000), (timerStats.maxJitterNs / 1000));
+    }
+
+    /* Report traffic shared by all queries */
+    if ( (getComChanClientStats(pContext->pClient, &clientStats) == 0) &&
+         (getComChanCacheStats(pContext->pCache, &cacheStats) == 0) )
+    {
+        printf("Agent Queries (%lu submitted, %lu completed, %lu expired | cache %lu fresh, %lu stale, %lu refreshes)\n",
+                clientStats.nSubmitted, clientStats.nCompleted, clientStats.nExpired,
+                cacheStats.nFresh, cacheStats.nStale, cacheStats.nRefreshes);
+
+        printComChanStages(&clientStats.stages, "Agent");
+    }
+}
+
+static void printCpuInfo(const AgentQuery_t *pQuery, const ComChan_Message_t *pInfo)
+{
+    printCpuUtil(pQuery->pName, &pInfo->res_info.cpuInfo);
+}
+
+static void printCpuUtil(const char *pName, const RW_CpuInfo_t *pCpuInfo)
+{
+    printf("%s (%u CPUs | user %u.%02u%% | system %u.%02u%% | iowait %u.%02u%% | steal %u.%02u%%)\n",
+            pName,
+            pCpuInfo->nCPUs,
+            (pCpuInfo->aggregate.user   / 100), (pCpuInfo->aggregate.user   % 100),
+            (pCpuInfo->aggregate.system / 100), (pCpuInfo->aggregate.system % 100),
+            (pCpuInfo->aggregate.iowait / 100), (pCpuInfo->aggregate.iowait % 100),
+            (pCpuInfo->aggregate.steal  / 100), (pCpuInfo->aggregate.steal  % 100));
+}
+
+static void printDuInfo(const AgentQuery_t *pQuery, const ComChan_Message_t *pInfo)
+{
+    uint16_t entry;
+
+    const RW_DuInfo_t *pDuInfo = &pInfo->res_info.duInfo;
+
+    /* Root is scanned in background, first scan may still be running */
+    if (pDuInfo->scanTime == 0)
+    {
+        printf("%s (%s | no completed scan)\n", pQuery->pName, pDuInfo->rootPath);
+        return;
+    }
+
+    printf("%s (%s | %lu bytes | %lu directories, %lu files, %lu hardlinks, %lu errors | scanned in %u ms | %s, %lu updates)\n",
+            pQuery->pName, pDuInfo->rootPath, pDuInfo->totalBytes,
+            pDuInfo->nDirs, pDuInfo->nFiles, pDuInfo->nHardlinks, pDuInfo->nErrors,
+            pDuInfo->scanDuration, (pDuInfo->tracking ? "tracked" : "rescanned"), pDuInfo->nUpdates);
+
+    /* One line per subtree carried, largest or fastest growing first */
+    for (entry = 0; (entry < pDuInfo->nEntries) && (entry < RW_DU_INFO_MAX_ENTRIES); entry++)
+    {
+        if (pDuInfo->window > 0)
+        {
+            printf("  %s (%+ld bytes in %u minutes, %lu bytes, %lu files)\n",
+                    pDuInfo->entries[entry].path,
+                    pDuInfo->entries[entry].growth, pDuInfo->window,
+                    pDuInfo->entries[entry].bytes,
+                    pDuInfo->entries[entry].nFiles);
+            continue;
+        }
+
+        printf("  %s (%lu bytes, %lu files)\n",
+                pDuInfo->entries[entry].path,
+                pDuInfo->entries[entry].bytes,
+                pDuInfo->entries[entry].nFiles);
+    }
+}
+
+static void printFragInfo(const AgentQuery_t *pQuery, const ComChan_Message_t *pInfo)
+{
+    uint16_t zone, hugeOrder;
+
+    const RW_FragInfo_t *pFragInfo = &pInfo->res_info.fragInfo;
+    const RW_FragZone_t *pZone;
+
+    hugeOrder = (pFragInfo->pageblockOrder > 0) ? pFragInfo->pageblockOrder : AGENT_FRAG_HUGE_ORDER;
+
+    printf("%s (%u zones | compaction stall %lu, fail %lu, success %lu | huge page fault %lu, fallback %lu)\n",
+            pQuery->pName, pFragInfo->nZones,
+            pFragInfo->compactStall, pFragInfo->compactFail, pFragInfo->compactSuccess,
+            pFragInfo->thpFaultAlloc, pFragInfo->thpFaultFallback);
+
+    /* One line per zone carried, first window of zones only; readiness at costly and huge page orders */
+    for (zone = 0; (zone < pFragInfo->nEntries) && (zone < RW_FRAG_INFO_MAX_ZONES); zone++)
+    {
+        pZone = &pFragInfo->zones[zone];
+
+        if (hugeOrder >= pZone->nOrders) { continue; }
+
+        printf("  Node %u %s (free %lu | order %u: %lu allocatable, index %d | order %u: %lu allocatable, index %d | unmovable %u of %u blocks)\n",
+                pZone->nodeID, pZone->zoneName, pZone->freePages,
+                AGENT_FRAG_COSTLY_ORDER, pZone->allocatable[AGENT_FRAG_COSTLY_ORDER], pZone->fragIndex[AGENT_FRAG_COSTLY_ORDER],
+                hugeOrder, pZone->allocatable[hugeOrder], pZone->fragIndex[hugeOrder],
+                pZone->unmovableBlocks,
+                (pZone->unmovableBlocks + pZone->movableBlocks + pZone->reclaimableBlocks));
+    }
+}
+
+static void printHistoryInfo(const AgentQuery_t *pQuery, const ComChan_Message_t *pInfo)
+{
+    uint16_t point, nValid = 0;
+    int64_t  minFree = INT64_MAX, maxFree = 0, sumAvg = 0;
+
+    const RW_HistoryInfo_t *pHistoryInfo = &pInfo->res_info.historyInfo;
+
+    /* Summarize history window over points holding samples */
+    for (point = 0; point < pHistoryInfo->nPoints; point++)
+    {
+        if ((pHistoryInfo->validMask & (1ULL << point)) == 0) { continue; }
+
+        if (pHistoryInfo->points[point].min < minFree) { minFree = pHistoryInfo->points[point].min; }
+        if (pHistoryInfo->points[point].max > maxFree) { maxFree = pHistoryInfo->points[point].max; }
+
+        sumAvg += pHistoryInfo->points[point].avg;
+        nValid++;
+    }
+
+    if (nValid > 0)
+    {
+        printf("%s (last %u s | min %ld, max %ld, avg %ld)\n",
+                pQuery->pName,
+                (pHistoryInfo->nPoints * pHistoryInfo->step),
+                minFree, maxFree, (sumAvg / nValid));
+    }
+}
+
+static void printNumaInfo(const AgentQuery_t *pQuery, const ComChan_Message_t *pInfo)
+{
+    uint16_t node;
+
+    const RW_NumaInfo_t *pNumaInfo = &pInfo->res_info.numaInfo;
+
+    printf("%s (%u nodes)\n", pQuery->pName, pNumaInfo->nNodes);
+
+    /* One line per node carried, first window of nodes only */
+    for (node = 0; (node < pNumaInfo->nEntries) && (node < RW_NUMA_INFO_MAX_NODES); node++)
+    {
+        printf("  Node %u (%lu, %lu | file %lu, anon %lu | hit %lu, miss %lu, foreign %lu)\n",
+                pNumaInfo->nodes[node].nodeID,
+                pNumaInfo->nodes[node].systemMemory,
+                pNumaInfo->nodes[node].freeMemory,
+                pNumaInfo->nodes[node].fileMemory,
+                pNumaInfo->nodes[node].anonMemory,
+                pNumaInfo->nodes[node].numaHit,
+                pNumaInfo->nodes[node].numaMiss,
+                pNumaInfo->nodes[node].numaForeign);
+    }
+}
+
+static void printQuantileInfo(const AgentQuery_t *pQuery, const ComChan_Message_t *pInfo)
+{
+    printf("%s (last %ld s | %lu samples | p50 %ld, p95 %ld, p99 %ld)\n",
+            pQuery->pName,
+            (pInfo->res_info.quantileInfo.endTime - pInfo->res_info.quantileInfo.startTime + 1),
+            pInfo->res_info.quantileInfo.sketch.count,
+            pInfo->res_info.quantileInfo.p50,
+            pInfo->res_info.quantileInfo.p95,
+            pInfo->res_info.quantileInfo.p99);
+}
+
+static void printStorageInfo(const AgentQuery_t *pQuery, const ComChan_Message_t *pInfo)
+{
+    /* Disk and memory information share layout (total, free) */
+    printf("%s (%lu, %lu)\n",
+            pQuery->pName,
+            ((pInfo->resourceInfoID == DISK_RESOURCE_INFO) ? pInfo->res_info.diskInfo.systemMemory : pInfo->res_info.memoryInfo.systemMemory),
+            ((pInfo->resourceInfoID == DISK_RESOURCE_INFO) ? pInfo->res_info.diskInfo.freeMemory   : pInfo->res_info.memoryInfo.freeMemory));
+}
+
+static void printSummaryInfo(__attribute__((unused)) const AgentQuery_t *pQuery, const ComChan_Message_t *pInfo)
+{
+    const RW_MultiInfo_t *pMultiInfo = &pInfo->res_info.multiInfo;
+
+    /* Print sections carried by combined reply */
+    if (pMultiInfo->resourceMask & RW_RESOURCE_MASK(DISK_RESOURCE_INFO))
+    {
+        printf("Disk Information (%lu, %lu)\n",
+                pMultiInfo->diskInfo.systemMemory,
+                pMultiInfo->diskInfo.freeMemory);
+    }
+
+    if (pMultiInfo->resourceMask & RW_RESOURCE_MASK(MEMORY_RESOURCE_INFO))
+    {
+        printf("Memory Information (%lu, %lu)\n",
+                pMultiInfo->memoryInfo.systemMemory,
+                pMultiInfo->memoryInfo.freeMemory);
+    }
+
+    if (pMultiInfo->resourceMask & RW_RESOURCE_MASK(CPU_RESOURCE_INFO))
+    {
+        printCpuUtil("CPU Information", &pMultiInfo->cpuInfo);
+    }
+}
+
+static void printUsage(const char *pExecutable)
+{
+    uint32_t query;
+
+    printf("Usage: %s [options]\n", pExecutable);
+
+    for (query = 0; query < AGENT_QUERIES_MAX; query++)
+    {
+        printf("  -%c <seconds>  %s query period (default %u, 0 disables)\n",
+                agentQueries[query].option,
+                agentQueries[query].pName,
+                agentQueries[query].period);
+    }
+
+    printf("  -s <seconds>  Statistics report period (default %u, 0 disables)\n", STATS_REPORT_TIMEOUT);
+    printf("  -h            Print this help\n");
+}
+
+static void runAgentQuery(void *pArg)
+{
+    AgentQuery_t *pQuery = (AgentQuery_t *)pArg;
+
+    ComChan_Message_t agentMsg, resourceInfo;
+
+    /* Populate query message, relay stamps agent signature as requester */
+    memset(&agentMsg, 0x00, sizeof(ComChan_Message_t));
+    agentMsg.serviceSig        = COM_NETLINK_WA_SIG;
+    agentMsg.resourceInfoID    = pQuery->resourceInfoID;
+
+    /* History windows, quantiles, fragmentation (pageblock walk in kernel) and directory usage (index ranking) yield to live information under load */
+    agentMsg.flags             = ( (pQuery->resourceInfoID == HISTORY_RESOURCE_INFO)  ||
+                                   (pQuery->resourceInfoID == QUANTILE_RESOURCE_INFO) ||
+                                   (pQuery->resourceInfoID == FRAG_RESOURCE_INFO)     ||
+                                   (pQuery->resourceInfoID == DU_RESOURCE_INFO) ) ? COM_CHAN_PRIO_BULK : COM_CHAN_PRIO_NORMAL;
+
+    /* Usage ranked down to agent depth on first root, deeper subtrees are summed into their ancestors; growth queries rank over their window */
+    if (pQuery->resourceInfoID == DU_RESOURCE_INFO)
+    {
+        agentMsg.res_info.duInfo.maxDepth = AGENT_DU_MAX_DEPTH;
+        agentMsg.res_info.duInfo.window   = pQuery->resolution;
+    }
+
+    switch (pQuery->resourceInfoID)
+    {
+        case HISTORY_RESOURCE_INFO:
+        {
+            agentMsg.res_info.historyInfo.metricID   = pQuery->metricID;
+            agentMsg.res_info.historyInfo.resolution = pQuery->resolution;
+            agentMsg.res_info.historyInfo.startTime  = 0;
+            agentMsg.res_info.historyInfo.nPoints    = RW_HISTORY_MAX_POINTS;
+
+            /* Send history query message */
+            submitComChanQuery(pQuery->pContext->pClient, &agentMsg, handleQueryReply, pQuery);
+            break;
+        }
+
+        case QUANTILE_RESOURCE_INFO:
+        {
+            agentMsg.res_info.quantileInfo.metricID = pQuery->metricID;
+
+            /* Send quantile query message */
+            submitComChanQuery(pQuery->pContext->pClient, &agentMsg, handleQueryReply, pQuery);
+            break;
+        }
+
+        case MULTI_RESOURCE_INFO:
+        {
+            /* Disk, memory and CPU sections in one round trip, cores window starting at core 0 */
+            agentMsg.res_info.multiInfo.resourceMask = AGENT_SUMMARY_MASK;
+        }
+        /* fall through */
+
+        default:
+        {
+            /* Read cached information, staleness bound of two and a half periods keeps it fresh at every read */
+            if (readComChanCache(pQuery->pContext->pCache, &agentMsg,
+                                 ((int64_t)pQuery->period * TW_NSEC_PER_SEC * 5 / 2),
+                                 &resourceInfo, NULL) == COM_CHAN_CACHE_FRESH)
+            {
+                pQuery->printCb(pQuery, &resourceInfo);
+            }
+            break;
+        }
+    }
+}
+
+
+//*************************************
+// Module Main Function
+//*************************************
+int main(int argc, char **args)
+{
+    unsigned char WA_SERVICE_RUNNING = 0x01;
+
+    uint32_t query;
+    int64_t  firstNs, periodNs;
+
+    ComChan_Client_t *pClient;
+    ComChan_Cache_t *pCache;
+
+    TW_TimerWheel_t *pWheel;
+    AgentContext_t agentContext;
+
+    int epollFD, nEvents;
+    struct epoll_event epollEvents[MAX_EPOLL_EVENTS];
+
+    /* Errors and warnings are written by log thread */
+    if (startComChanLog(STDOUT_FILENO) < 0) { return EXIT_FAILURE; }
+
+    /* Configure query periods */
+    if (parseAgentOptions(argc, args) < 0) { return EXIT_FAILURE; }
+
+    /* Create asynchronous query client, single socket for all resources */
+    pClient = createComChanClient(COM_NETLINK_WA_SIG, QUERY_MAX_OUTSTANDING, (QUERY_REPLY_TIMEOUT * TW_NSEC_PER_SEC));
+    if (pClient == NULL) { return EXIT_FAILURE; }
+
+    /* Create resource information cache on top of query client */
+    pCache = createComChanCache(pClient, RESOURCE_CACHE_ENTRIES);
+    if (pCache == NULL)
+    {
+        destroyComChanClient(pClient);
+        return EXIT_FAILURE;
+    }
+
+    /* Create query schedules timer wheel */
+    pWheel = createTimerWheel(QUERY_SCHEDULES_MAX);
+    if (pWheel == NULL)
+    {
+        destroyComChanCache(pCache);
+        destroyComChanClient(pClient);
+        return EXIT_FAILURE;
+    }
+
+    /* Create event polling setup */
+    epollFD = epoll_create1(0);
+    if (epollFD < 0)
+    {
+        LOG_ERROR("Failed to create epoll [%m]");
+
+        destroyTimerWheel(pWheel);
+        destroyComChanCache(pCache);
+        destroyComChanClient(pClient);
+        return EXIT_FAILURE;
+    }
+
+    /* Register query client and query schedules for events polling */
+    if ( (registerEvent(epollFD, getComChanClientFD(pClient)) < 0) ||
+         (registerEvent(epollFD, getTimerWheelFD(pWheel)) < 0) )
+    {
+        destroyTimerWheel(pWheel);
+        destroyComChanCache(pCache);
+        destroyComChanClient(pClient);
+        close(epollFD);
+        return EXIT_FAILURE;
+    }
+
+
+    /* Send service information message, one registration for all resources */
+    if (registerComChanClient(pClient, "127.0.0.1") < 0)
+    {
+        destroyTimerWheel(pWheel);
+        destroyComChanCache(pCache);
+        destroyComChanClient(pClient);
+        close(epollFD);
+        return EXIT_FAILURE;
+    }
+
+
+    /* Schedule resource queries right away and history/quantile queries after first window */
+    agentContext.pClient = pClient;
+    agentContext.pCache  = pCache;
+    agentContext.pWheel  = pWheel;
+
+    for (query = 0; query < AGENT_QUERIES_MAX; query++)
+    {
+        agentQueries[query].pContext = &agentContext;
+        if (agentQueries[query].period == 0) { continue; }
+
+        periodNs = ((int64_t)agentQueries[query].period * TW_NSEC_PER_SEC);
+        firstNs  = ( (agentQueries[query].resourceInfoID == HISTORY_RESOURCE_INFO) ||
+                     (agentQueries[query].resourceInfoID == QUANTILE_RESOURCE_INFO) ) ? periodNs : 0;
+
+        agentQueries[query].timerID = addTimer(pWheel, firstNs, periodNs, runAgentQuery, &agentQueries[query]);
+    }
+
+    agentContext.statsTimerID = -1;
+    if (statsPeriod > 0)
+    {
+        periodNs = ((int64_t)statsPeriod * TW_NSEC_PER_SEC);
+        agentContext.statsTimerID = addTimer(pWheel, periodNs, periodNs, printAgentStats, &agentContext);
+    }
+
+    /* Watcher agent business logic */
+    while (WA_SERVICE_RUNNING)
+    {
+        /* Wait for events */
+        nEvents = epoll_wait(epollFD, epollEvents, MAX_EPOLL_EVENTS, (EPOLL_EVENTS_TIMEOUT * 1000));
+
+        /* Process events */
+        while (nEvents > 0)
+        {
+            if (epollEvents[(nEvents - 1)].data.fd == getComChanClientFD(pClient))
+            {
+                /* Complete queries with received replies, expire overdue ones */
+                if (handleComChanClient(pClient) < 0)
+                {
+                    WA_SERVICE_RUNNING = 0;
+                    break;
+                }
+            }
+            else if (epollEvents[(nEvents - 1)].data.fd == getTimerWheelFD(pWheel))
+            {
+                /* Run due query schedules */
+                handleTimerWheel(pWheel);
+            }
+
+            nEvents--;
+        }
+
+        /* Transmit queries submitted by schedules */
+        flushComChanClient(pClient);
+    }
+
+
+    /* Destroy query schedules */
+    destroyTimerWheel(pWheel);
+
+    /* Destroy resource cache and query client */
+    destroyComChanCache(pCache);
+    destroyComChanClient(pClient);
+
+    /* Close polling descriptor */
+    if (epollFD > 0) { close(epollFD); }
+
+    return EXIT_SUCCESS;
+}